@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <nba/integer.hpp>
+
+namespace nba {
+
+/**
+ * A single memory access, as recorded by cores built with NBA_BUS_TRACE.
+ * The cycles include wait states, prefetch buffer stalls and PPU contention,
+ * but not the cycles of DMA transfers that ran before the access.
+ * Those are recorded as separate accesses with the Dma flag set.
+ */
+struct BusTraceRecord {
+  // Same encoding as the access flags of the bus.
+  enum Access : u8 {
+    Sequential = 1,
+    Code = 2,
+    Dma = 4,
+    Lock = 8
+  };
+
+  u64 timestamp;
+  u32 address;
+  u32 value;
+  u32 cycles;
+  u8 access;
+  u8 size;
+  u8 write;
+  u8 reserved;
+};
+
+static_assert(sizeof(BusTraceRecord) == 24, "BusTraceRecord must have a fixed 24-byte layout");
+
+/**
+ * A trace file starts with this header, followed by records until the end of the file.
+ * All fields are stored in host byte order.
+ */
+struct BusTraceHeader {
+  static constexpr u32 kMagic = 0x5254424E; // "NBTR"
+  static constexpr u32 kVersion = 1;
+
+  u32 magic = kMagic;
+  u32 version = kVersion;
+  u32 record_size = sizeof(BusTraceRecord);
+  u32 reserved = 0;
+};
+
+/**
+ * Returns the name of the MMIO register which holds the halfword at the given address
+ * (for example "DISPCNT" or "DMA0SAD_H"), or nullptr if no register is mapped there.
+ * Available whether or not the core was built with NBA_BUS_TRACE.
+ */
+auto GetIORegisterName(u32 address) -> char const*;
+
+} // namespace nba
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <nba/device/audio_device.hpp>
 #include <nba/device/input_device.hpp>
@@ -19,6 +20,10 @@ namespace nba {
 struct Config {
   bool skip_bios = false;
 
+  // Execute common BIOS calls natively instead of running the BIOS code.
+  // Without a BIOS image, a minimal replacement BIOS is used and the boot sequence is skipped.
+  bool hle_bios = false;
+
   enum class BackupType {
     Detect,
     None,
@@ -30,6 +35,39 @@ struct Config {
     EEPROM_DETECT // for internal use
   };
 
+  struct CPU {
+    enum class Backend {
+      Interpreter,
+      CachedInterpreter,
+      JIT
+    } backend = Backend::Interpreter;
+
+    // Advance time to the next event while the CPU spins in an idle loop.
+    bool idle_loop_skip = false;
+
+    // Known idle loop addresses, keyed by the four character game code.
+    std::map<std::string, u32> idle_loop_overrides;
+  } cpu;
+
+  struct PPU {
+    enum class Renderer {
+      // Runs the PPU engines cycle by cycle, alongside the CPU.
+      Accurate,
+
+      // Draws each scanline in one go when it has ended. If video memory is
+      // accessed or the registers are written while it is drawn, the engines
+      // catch up from the start of the scanline instead, so that the output
+      // and the access timing are the same as with Accurate.
+      Scanline,
+
+      // Like Scanline, but the scanlines which are drawn in one go
+      // are drawn on a separate thread. This only pays off with a spare CPU core.
+      // Scanlines that catch up on the emulation thread first wait for
+      // the render thread, which makes them slower than with Scanline.
+      Threaded
+    } renderer = Renderer::Accurate;
+  } ppu;
+
   struct Audio {
     enum class Interpolation {
       Cosine,
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <nba/rom/gpio/rtc.hpp>
 #include <nba/rom/gpio/solar_sensor.hpp>
@@ -15,6 +16,8 @@
 #include <nba/integer.hpp>
 #include <nba/save_state.hpp>
 #include <nba/scheduler.hpp>
+#include <nba/video_pages.hpp>
+#include <string>
 #include <vector>
 
 namespace nba {
@@ -37,6 +40,14 @@ struct CoreBase {
   virtual auto GetROM() -> ROM& = 0;
   virtual auto GetPRAM() -> u8* = 0;
   virtual auto GetVRAM() -> u8* = 0;
+
+  /**
+   * Returns the pages of PRAM, OAM and VRAM which were written by the CPU or a DMA
+   * since the previous call and clears them. Resetting the core or loading a save state
+   * marks all pages as written.
+   */
+  virtual auto GetDirtyVideoPages() -> VideoPages = 0;
+
   // @todo: come up with a solution for reading write-only registers.
   virtual auto PeekByteIO(u32 address) -> u8  = 0;
   virtual auto PeekHalfIO(u32 address) -> u16 = 0;
@@ -46,6 +57,43 @@ struct CoreBase {
 
   virtual core::Scheduler& GetScheduler() = 0;
 
+  // Empty unless the core was built with NBA_SCHEDULER_STATS.
+  virtual auto GetSchedulerStats(core::Scheduler::EventClass event_class) -> core::Scheduler::EventClassStats = 0;
+
+  using WatchpointCallback = std::function<void(u32 address, int size, u32 value, u64 timestamp)>;
+
+  /**
+   * Calls the callback after each write to the given range of EWRAM or IWRAM,
+   * with the address, size and value of the write and the emulated timestamp.
+   * Only writes to memory pages that contain a watchpoint are checked.
+   * The callback must not call back into the core.
+   * Returns an ID for RemoveWatchpoint(), or -1 if the range is not in work RAM.
+   */
+  virtual auto AddWatchpoint(u32 address, u32 size, WatchpointCallback callback) -> int = 0;
+  virtual void RemoveWatchpoint(int id) = 0;
+
+  using PCHookCallback = std::function<void(u32 address)>;
+
+  /**
+   * Calls the callback right before the CPU executes the instruction at the given address,
+   * for example to stop at a breakpoint. Code in the same 256-byte page as a hook is run
+   * one instruction at a time, all other code is not slowed down.
+   * The callback must not call back into the core. Hooks are kept when the core is reset.
+   * Returns an ID for RemovePCHook().
+   */
+  virtual auto AddPCHook(u32 address, PCHookCallback callback) -> int = 0;
+  virtual void RemovePCHook(int id) = 0;
+
+  // Only available if the core was built with NBA_BUS_TRACE.
+  // See nba/bus_trace.hpp for the format of the trace file.
+  virtual bool StartBusTrace(std::string const& path) = 0;
+  virtual void StopBusTrace() = 0;
+
+  // Only available if the core was built with NBA_ARM_TRACE.
+  // See nba/cpu_trace.hpp for the format of the trace file.
+  virtual bool StartCPUTrace(std::string const& path) = 0;
+  virtual void StopCPUTrace() = 0;
+
   void RunForOneFrame() {
     Run(kCyclesPerFrame);
   }
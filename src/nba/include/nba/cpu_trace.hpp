@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <nba/integer.hpp>
+
+namespace nba {
+
+/**
+ * An instruction retired by the CPU, as recorded by cores built with NBA_ARM_TRACE.
+ * The CPSR is the value before the instruction was executed. The cycles include
+ * all memory accesses of the instruction and any DMA transfer that ran during them,
+ * as well as the IRQ entry sequence if an IRQ was taken right before the instruction.
+ */
+struct CPUTraceRecord {
+  u32 pc;
+  u32 opcode;
+  u32 cpsr;
+  u32 cycles;
+
+  bool IsThumb() const {
+    return cpsr & (1 << 5);
+  }
+};
+
+/**
+ * A trace file starts with this header, followed by the encoded records.
+ * All fields are stored in host byte order.
+ */
+struct CPUTraceHeader {
+  static constexpr u32 kMagic = 0x5443424E; // "NBCT"
+  static constexpr u32 kVersion = 1;
+
+  u32 magic = kMagic;
+  u32 version = kVersion;
+};
+
+/**
+ * Delta encoding of the instruction stream. Each record starts with a flags byte:
+ *
+ *   bit 0:    the PC is not the PC of the previous record plus the opcode width.
+ *             The difference follows as a zig-zag encoded varint.
+ *   bit 1:    the CPSR has changed. The new CPSR follows (4 bytes).
+ *   bit 2:    the opcode differs from the last opcode seen at this PC.
+ *             The opcode follows (2 bytes in Thumb state, 4 bytes in ARM state).
+ *   bit 3-7:  the cycle count. 31 means that a varint with the cycle count follows.
+ *
+ * The last opcode seen at each PC is tracked in a small direct-mapped cache,
+ * so that instructions in loops usually encode to a single byte.
+ * Encoder and decoder must both start from a default constructed codec.
+ */
+struct CPUTraceCodec {
+  static constexpr int kMaxRecordSize = 1 + 5 + 4 + 4 + 5;
+
+  auto Encode(CPUTraceRecord const& record, u8* data) -> int {
+    const bool thumb = record.IsThumb();
+    const u32 pc_delta = record.pc - pc_next;
+    auto& entry = opcode_cache[GetCacheIndex(record.pc)];
+
+    u8* out = data + 1;
+    u8 flags = 0;
+
+    if(pc_delta != 0) {
+      flags |= 1;
+      out = WriteVarInt(out, ((s32)pc_delta >> 31) ^ (pc_delta << 1));
+    }
+
+    if(record.cpsr != cpsr) {
+      flags |= 2;
+      out = WriteBytes(out, record.cpsr, 4);
+      cpsr = record.cpsr;
+    }
+
+    if(entry.pc != record.pc || entry.opcode != record.opcode) {
+      flags |= 4;
+      out = WriteBytes(out, record.opcode, thumb ? 2 : 4);
+      entry = {record.pc, record.opcode};
+    }
+
+    if(record.cycles < 31) {
+      flags |= record.cycles << 3;
+    } else {
+      flags |= 31 << 3;
+      out = WriteVarInt(out, record.cycles);
+    }
+
+    data[0] = flags;
+    pc_next = record.pc + (thumb ? 2 : 4);
+    return int(out - data);
+  }
+
+  /**
+   * Decodes a single record. Returns the number of bytes consumed or zero,
+   * if the data is not long enough to hold the complete record.
+   */
+  auto Decode(u8 const* data, size_t size, CPUTraceRecord& record) -> int {
+    u8 const* in = data;
+    u8 const* end = data + size;
+
+    if(in == end) {
+      return 0;
+    }
+
+    const u8 flags = *in++;
+
+    record.pc = pc_next;
+
+    if(flags & 1) {
+      u32 value;
+      if(!ReadVarInt(in, end, value)) return 0;
+      record.pc += (value >> 1) ^ -(value & 1);
+    }
+
+    record.cpsr = cpsr;
+
+    if(flags & 2) {
+      if(!ReadBytes(in, end, record.cpsr, 4)) return 0;
+    }
+
+    const bool thumb = record.IsThumb();
+    auto& entry = opcode_cache[GetCacheIndex(record.pc)];
+
+    record.opcode = entry.opcode;
+
+    if(flags & 4) {
+      if(!ReadBytes(in, end, record.opcode, thumb ? 2 : 4)) return 0;
+    }
+
+    record.cycles = flags >> 3;
+
+    if(record.cycles == 31) {
+      if(!ReadVarInt(in, end, record.cycles)) return 0;
+    }
+
+    // Only update the state once the record is known to be complete.
+    cpsr = record.cpsr;
+    entry = {record.pc, record.opcode};
+    pc_next = record.pc + (thumb ? 2 : 4);
+    return int(in - data);
+  }
+
+private:
+  static constexpr int kCacheSize = 4096;
+
+  static auto GetCacheIndex(u32 pc) -> int {
+    return (pc >> 1) & (kCacheSize - 1);
+  }
+
+  static auto WriteVarInt(u8* out, u32 value) -> u8* {
+    while(value >= 0x80) {
+      *out++ = u8(value | 0x80);
+      value >>= 7;
+    }
+    *out++ = u8(value);
+    return out;
+  }
+
+  static auto WriteBytes(u8* out, u32 value, int count) -> u8* {
+    for(int i = 0; i < count; i++) {
+      *out++ = u8(value >> (i * 8));
+    }
+    return out;
+  }
+
+  static bool ReadVarInt(u8 const*& in, u8 const* end, u32& value) {
+    value = 0;
+
+    for(int shift = 0; shift < 35; shift += 7) {
+      if(in == end) return false;
+      const u8 byte = *in++;
+      value |= u32(byte & 0x7F) << shift;
+      if(!(byte & 0x80)) return true;
+    }
+
+    return false;
+  }
+
+  static bool ReadBytes(u8 const*& in, u8 const* end, u32& value, int count) {
+    if(end - in < count) return false;
+
+    value = 0;
+    for(int i = 0; i < count; i++) {
+      value |= u32(*in++) << (i * 8);
+    }
+    return true;
+  }
+
+  struct CacheEntry {
+    u32 pc = ~0U;
+    u32 opcode = 0;
+  };
+
+  u32 pc_next = 0;
+  u32 cpsr = 0;
+  std::array<CacheEntry, kCacheSize> opcode_cache{};
+};
+
+} // namespace nba
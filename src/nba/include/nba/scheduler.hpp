@@ -11,18 +11,22 @@
 #include <nba/common/compiler.hpp>
 #include <nba/integer.hpp>
 #include <nba/save_state.hpp>
-#include <functional>
+#include <algorithm>
 #include <limits>
+#include <type_traits>
 
-namespace nba::core {
+#ifdef NBA_SCHEDULER_STATS
+  #include <chrono>
+#endif
 
-struct Scheduler {
-  template<class T>
-  using EventMethod = void (T::*)();
+#ifdef NBA_SCHEDULER_TRACE
+  #include <nba/scheduler_trace.hpp>
+  #include <vector>
+#endif
 
-  template<class T>
-  using EventMethodWithUserData = void (T::*)(u64);
+namespace nba::core {
 
+struct Scheduler {
   enum class EventClass : u16 {
     // ARM
     ARM_ldm_usermode_conflict,
@@ -80,36 +84,39 @@ struct Scheduler {
   
   private:
     friend class Scheduler;
-    int handle;
-    u64 key;
     u64 uid;
     u64 user_data;
     EventClass event_class;
   };
 
+  struct EventClassStats {
+    u64 fire_count = 0;
+    u64 host_ns = 0;
+    u64 cycles_between_fires = 0;
+    u64 timestamp_last_fire = 0;
+
+    auto GetAverageInterval() const -> double {
+      return fire_count > 1 ? (double)cycles_between_fires / (fire_count - 1) : 0;
+    }
+  };
+
   Scheduler() {
-    Register(EventClass::EndOfQueue, this, &Scheduler::EndOfQueue);
+    Register<&Scheduler::EndOfQueue>(EventClass::EndOfQueue, this);
 
     for(int i = 0; i < kMaxEvents; i++) {
-      heap[i] = new Event();
-      heap[i]->handle = i;
+      heap_slot[i] = (u8)i;
     }
 
+    // The fallback gets the event class in place of an object.
     for(int i = 0; i < (int)EventClass::Count; i++) {
-      callbacks[i] = [i](u64 user_data) {
-        Assert(false, "Scheduler: unhandled event class: {}", i);
-      };
+      callbacks[i] = { (void*)(uintptr_t)i, [](void* event_class, u64) {
+        Assert(false, "Scheduler: unhandled event class: {}", (int)(uintptr_t)event_class);
+      }};
     }
 
     Reset();
   }
 
- ~Scheduler() {
-    for(int i = 0; i < kMaxEvents; i++) {
-      delete heap[i];
-    }
-  }
-
   void Reset() {
     heap_size = 0;
     timestamp_now = 0;
@@ -127,74 +134,100 @@ struct Scheduler {
   }
 
   auto GetTimestampTarget() const -> u64 {
-    return heap[0]->timestamp;
+    return timestamp_target;
   }
 
   auto GetRemainingCycleCount() const -> int {
     return int(GetTimestampTarget() - GetTimestampNow());
   }
 
+  /**
+   * Advances the current time. The timestamp of the next event is cached,
+   * so that the common case (no event is due) costs a single comparison.
+   */
   void AddCycles(int cycles) {
+#ifdef NBA_SCHEDULER_TRACE
+    if(unlikely(trace_active)) {
+      RecordAddCycles(cycles);
+    }
+#endif
+
     auto timestamp_next = timestamp_now + cycles;
-    Step(timestamp_next);
+    if(unlikely(timestamp_next >= timestamp_target)) {
+      Step(timestamp_next);
+    }
     timestamp_now = timestamp_next;
   }
 
-  template<class T>
-  void Register(EventClass event_class, T* object, EventMethod<T> method, uint priority = 0) {
-    callbacks[(int)event_class] = [object, method](u64 user_data) {
-      (object->*method)();
-    };
-  }
-
-  template<class T>
-  void Register(EventClass event_class, T* object, EventMethodWithUserData<T> method, uint priority = 0) {
-    callbacks[(int)event_class] = [object, method](u64 user_data) {
-      (object->*method)(user_data);
-    };
+  /**
+   * Binds an event class to a member function of an object.
+   * The member function is a template argument, so that each event class
+   * resolves to a plain function pointer which calls the method directly.
+   */
+  template<auto method, class T>
+  void Register(EventClass event_class, T* object) {
+    callbacks[(int)event_class] = { object, [](void* object, u64 user_data) {
+      if constexpr(std::is_invocable_v<decltype(method), T*, u64>) {
+        (((T*)object)->*method)(user_data);
+      } else {
+        (((T*)object)->*method)();
+      }
+    }};
   }
 
   auto Add(u64 delay, EventClass event_class, uint priority = 0, u64 user_data = 0) -> Event* {
-    int n = heap_size++;
-    int p = Parent(n);
-
     Assert(
-      heap_size <= kMaxEvents,
+      heap_size < kMaxEvents,
       "Scheduler: reached maximum number of events."
     );
 
     Assert(priority <= 3, "Scheduler: priority must be between 0 and 3.");
 
-    auto event = heap[n];
+    // Slots of unused events are kept in the heap array past the last live node.
+    int n = heap_size++;
+    int slot = heap_slot[n];
+
+    auto event = &events[slot];
     event->timestamp = GetTimestampNow() + delay;
-    event->key = (event->timestamp << 2) | priority;
-    event->uid = next_uid++;
+    event->uid = (next_uid++ << kSlotBits) | slot;
     event->user_data = user_data;
     event->event_class = event_class;
 
-    while(n != 0 && heap[p]->key > heap[n]->key) {
-      Swap(n, p);
-      n = p;
-      p = Parent(n);
+#ifdef NBA_SCHEDULER_TRACE
+    if(unlikely(trace_active)) {
+      Record(SchedulerTraceRecord::Op::Add, event->uid, delay, event_class, priority);
     }
+#endif
 
-    return event;
-  }
+    SiftUp(n, (event->timestamp << 2) | priority, slot);
+    UpdateTimestampTarget();
 
-  template<class T>
-  auto Add(u64 delay, T* object, EventMethod<T> method, uint priority = 0) -> Event* {
-    return Add(delay, [object, method](int cycles_late) {
-      (object->*method)(cycles_late);
-    }, priority);
+    return event;
   }
 
   void Cancel(Event* event) {
-    Remove(event->handle);
+#ifdef NBA_SCHEDULER_TRACE
+    if(unlikely(trace_active)) {
+      Record(SchedulerTraceRecord::Op::Cancel, event->uid);
+    }
+#endif
+
+    Remove(heap_position[event - events]);
+    UpdateTimestampTarget();
   }
 
   auto GetEventByUID(u64 uid) -> Event* {
+    // The lower bits of an UID encode the slot of the event.
+    int slot = uid & (kMaxEvents - 1);
+    int n = heap_position[slot];
+
+    if(n < heap_size && heap_slot[n] == slot && events[slot].uid == uid) {
+      return &events[slot];
+    }
+
+    // Events restored from older save states may not follow this scheme.
     for(int i = 0; i < heap_size; i++) {
-      auto event = heap[i];
+      auto event = &events[heap_slot[i]];
 
       if(event->uid == uid) {
         return event;
@@ -206,35 +239,191 @@ struct Scheduler {
 
   void LoadState(SaveState const& state) {
     auto& ss_scheduler = state.scheduler;
+    int event_count = ss_scheduler.event_count;
 
-    for(int i = 0; i < ss_scheduler.event_count; i++) {
-      auto& event = ss_scheduler.events[i];
+    int event_slot[kMaxEvents];
+    bool slot_used[kMaxEvents] {};
 
-      u64 timestamp = event.key >> 2;
-      int priority = event.key & 3;
-      u64 uid = event.uid;
-      u64 user_data = event.user_data;
-      EventClass event_class = (EventClass)event.event_class;
+    // Place each event in the slot encoded in its UID, so that UID lookups remain fast.
+    for(int i = 0; i < event_count; i++) {
+      int slot = ss_scheduler.events[i].uid & (kMaxEvents - 1);
 
-      // This event already was created on Scheduler::Reset()
-      if(event_class == EventClass::EndOfQueue) {
-        continue;
+      if(slot_used[slot]) {
+        event_slot[i] = -1;
+      } else {
+        event_slot[i] = slot;
+        slot_used[slot] = true;
+      }
+    }
+
+    for(int i = 0, free_slot = 0; i < event_count; i++) {
+      if(event_slot[i] == -1) {
+        while(slot_used[free_slot]) free_slot++;
+        event_slot[i] = free_slot;
+        slot_used[free_slot] = true;
+      }
+    }
+
+    for(int i = 0; i < event_count; i++) {
+      auto& ss_event = ss_scheduler.events[i];
+      int slot = event_slot[i];
+      auto& event = events[slot];
+
+      event.uid = ss_event.uid;
+      event.user_data = ss_event.user_data;
+      event.event_class = (EventClass)ss_event.event_class;
+
+      if(event.event_class == EventClass::EndOfQueue) {
+        event.timestamp = std::numeric_limits<u64>::max();
+      } else {
+        event.timestamp = ss_event.key >> 2;
+      }
+
+      Place(i, ss_event.key, slot);
+    }
+
+    heap_size = event_count;
+
+    for(int slot = 0, n = heap_size; slot < kMaxEvents; slot++) {
+      if(!slot_used[slot]) {
+        heap_slot[n++] = (u8)slot;
       }
+    }
 
-      Add(timestamp - state.timestamp, event_class, priority, user_data)->uid = uid;
+    // Restore the heap property bottom-up in a single pass.
+    for(int n = Parent(heap_size - 1); n >= 0; n--) {
+      SiftDown(n, Key(n), heap_slot[n]);
     }
 
-    // This must happen after deserializing all events, because calling Add() modifies `next_uid`.
     next_uid = ss_scheduler.next_uid;
+
+    UpdateTimestampTarget();
+  }
+
+#ifdef NBA_SCHEDULER_STATS
+  auto GetEventClassStats(EventClass event_class) const -> EventClassStats const& {
+    return stats[(int)event_class];
+  }
+
+  void ResetStats() {
+    for(auto& entry : stats) entry = {};
+  }
+
+  void PrintStats() const {
+    int order[(int)EventClass::Count];
+    u64 host_ns_total = 0;
+
+    for(int i = 0; i < (int)EventClass::Count; i++) {
+      order[i] = i;
+      host_ns_total += stats[i].host_ns;
+    }
+
+    std::sort(std::begin(order), std::end(order), [this](int a, int b) {
+      return stats[a].host_ns > stats[b].host_ns;
+    });
+
+    Log<Info>("Scheduler: {:<26} {:>12} {:>14} {:>12} {:>8} {:>7}", "event class", "count", "avg. interval", "host ms", "ns/call", "share");
+
+    for(int i : order) {
+      auto& entry = stats[i];
+
+      if(entry.fire_count == 0) {
+        continue;
+      }
+
+      Log<Info>("Scheduler: {:<26} {:>12} {:>14.1f} {:>12.3f} {:>8.1f} {:>6.2f}%",
+        GetEventClassName((EventClass)i),
+        entry.fire_count,
+        entry.GetAverageInterval(),
+        entry.host_ns / 1e6,
+        (double)entry.host_ns / entry.fire_count,
+        host_ns_total != 0 ? entry.host_ns * 100.0 / host_ns_total : 0.0
+      );
+    }
+  }
+
+  static auto GetEventClassName(EventClass event_class) -> char const* {
+    static constexpr char const* kNames[] {
+      "ARM_ldm_usermode_conflict",
+      "PPU_hdraw_vdraw",
+      "PPU_hblank_vdraw",
+      "PPU_hdraw_vblank",
+      "PPU_hblank_vblank",
+      "PPU_begin_sprite_fetch",
+      "PPU_update_vcount_flag",
+      "PPU_video_dma",
+      "PPU_latch_dispcnt",
+      "PPU_hblank_irq",
+      "PPU_vblank_irq",
+      "PPU_vcount_irq",
+      "APU_mixer",
+      "APU_sequencer",
+      "APU_PSG1_generate",
+      "APU_PSG2_generate",
+      "APU_PSG3_generate",
+      "APU_PSG4_generate",
+      "IRQ_write_io",
+      "IRQ_update_ie_and_if",
+      "IRQ_update_irq_line",
+      "TM_overflow",
+      "TM_write_reload",
+      "TM_write_control",
+      "DMA_activated",
+      "EEPROM_ready",
+      "SIO_transfer_done",
+      "KeyPad_Poll",
+      "EndOfQueue"
+    };
+
+    static_assert(sizeof(kNames) / sizeof(kNames[0]) == (int)EventClass::Count);
+
+    return kNames[(int)event_class];
+  }
+#endif
+
+#ifdef NBA_SCHEDULER_TRACE
+  /**
+   * Starts recording all operations on the event queue into memory.
+   * The trace should be started and stopped outside of event callbacks.
+   */
+  void StartTrace() {
+    int order[kMaxEvents];
+    int event_count = 0;
+
+    for(int i = 0; i < heap_size; i++) {
+      if(events[heap_slot[i]].event_class != EventClass::EndOfQueue) {
+        order[event_count++] = i;
+      }
+    }
+
+    std::sort(order, order + event_count, [this](int a, int b) {
+      return events[heap_slot[a]].uid < events[heap_slot[b]].uid;
+    });
+
+    trace.clear();
+    trace_active = true;
+
+    // The trace begins with the events which are already scheduled.
+    for(int i = 0; i < event_count; i++) {
+      auto& event = events[heap_slot[order[i]]];
+
+      Record(SchedulerTraceRecord::Op::Add, event.uid, event.timestamp - timestamp_now, event.event_class, Key(order[i]) & 3);
+    }
   }
 
+  auto StopTrace() -> std::vector<SchedulerTraceRecord> {
+    trace_active = false;
+    return std::move(trace);
+  }
+#endif
+
   void CopyState(SaveState& state) {
     auto& ss_scheduler = state.scheduler;
 
     for(int i = 0; i < heap_size; i++) {
-      auto event = heap[i];
+      auto& event = events[heap_slot[i]];
 
-      ss_scheduler.events[i] = { event->key, event->uid, event->user_data, (u16)event->event_class };
+      ss_scheduler.events[i] = { Key(i), event.uid, event.user_data, (u16)event.event_class };
     }
 
     ss_scheduler.event_count = heap_size;
@@ -243,68 +432,174 @@ struct Scheduler {
 
 private:
   static constexpr int kMaxEvents = 64;
+  static constexpr int kSlotBits = 6;
+
+  /**
+   * The event queue is a 4-ary min-heap. Keys are stored apart from the events,
+   * so that sifting only ever touches the key and slot arrays.
+   * The key array is offset such that the four children of each node
+   * share one 32-byte aligned block and thus a single cache line.
+   */
+  static constexpr int kKeyOffset = 3;
 
-  static constexpr int Parent(int n) { return (n - 1) / 2; }
-  static constexpr int LeftChild(int n) { return n * 2 + 1; }
-  static constexpr int RightChild(int n) { return n * 2 + 2; }
+  static constexpr int Parent(int n) { return (n - 1) >> 2; }
+  static constexpr int FirstChild(int n) { return (n << 2) + 1; }
+
+  auto Key(int n) -> u64& { return heap_key[kKeyOffset + n]; }
+  auto Key(int n) const -> u64 { return heap_key[kKeyOffset + n]; }
 
   void Step(u64 timestamp_next) {
-    while(heap[0]->timestamp <= timestamp_next && heap_size > 0) {
-      auto event = heap[0];
-      timestamp_now = event->timestamp;
-      callbacks[(int)event->event_class](event->user_data);
-      Remove(event->handle);
+    while(Key(0) >> 2 <= timestamp_next && heap_size > 0) {
+      int slot = heap_slot[0];
+      auto& event = events[slot];
+      timestamp_now = event.timestamp;
+      auto& callback = callbacks[(int)event.event_class];
+
+#ifdef NBA_SCHEDULER_TRACE
+      if(unlikely(trace_active)) {
+        Record(SchedulerTraceRecord::Op::Fire, event.uid);
+      }
+#endif
+
+#ifdef NBA_SCHEDULER_STATS
+      auto& entry = stats[(int)event.event_class];
+      const auto time_start = std::chrono::steady_clock::now();
+
+      callback.thunk(callback.object, event.user_data);
+
+      const auto time_end = std::chrono::steady_clock::now();
+
+      entry.host_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(time_end - time_start).count();
+      if(entry.fire_count++ != 0) {
+        entry.cycles_between_fires += timestamp_now - entry.timestamp_last_fire;
+      }
+      entry.timestamp_last_fire = timestamp_now;
+#else
+      callback.thunk(callback.object, event.user_data);
+#endif
+
+#ifdef NBA_SCHEDULER_TRACE
+      if(unlikely(trace_active)) {
+        Record(SchedulerTraceRecord::Op::Return);
+      }
+#endif
+
+      Remove(heap_position[slot]);
     }
+
+    UpdateTimestampTarget();
   }
 
-  void Remove(int n) {
-    Swap(n, --heap_size);
-
-    int p = Parent(n);
-    if(n != 0 && heap[p]->key > heap[n]->key) {
-      do {
-        Swap(n, p);
-        n = p;
-        p = Parent(n);
-      } while(n != 0 && heap[p]->key > heap[n]->key);
+  void UpdateTimestampTarget() {
+    timestamp_target = Key(0) >> 2;
+  }
+
+#ifdef NBA_SCHEDULER_TRACE
+  void Record(SchedulerTraceRecord::Op op, u64 uid = 0, u64 value = 0, EventClass event_class = {}, uint priority = 0) {
+    trace.push_back({value, uid, op, (u8)event_class, (u8)priority, 0, 0});
+  }
+
+  void RecordAddCycles(int cycles) {
+    // Consecutive calls which do not fire any event are merged into one record.
+    if(!trace.empty() && trace.back().op == SchedulerTraceRecord::Op::AddCycles) {
+      trace.back().value += cycles;
+      trace.back().count++;
     } else {
-      Heapify(n);
+      trace.push_back({(u64)cycles, 0, SchedulerTraceRecord::Op::AddCycles, 0, 0, 0, 1});
     }
   }
+#endif
+
+  void Remove(int n) {
+    int slot = heap_slot[n];
+    int last = --heap_size;
+
+    if(n != last) {
+      u64 key = Key(last);
+      int last_slot = heap_slot[last];
+
+      if(n != 0 && Key(Parent(n)) > key) {
+        SiftUp(n, key, last_slot);
+      } else {
+        SiftDown(n, key, last_slot);
+      }
+    }
 
-  void Swap(int i, int j) {
-    auto tmp = heap[i];
-    heap[i] = heap[j];
-    heap[j] = tmp;
-    heap[i]->handle = i;
-    heap[j]->handle = j;
+    // Keep the slot of the removed event around, so that Add() can reuse it.
+    heap_slot[last] = (u8)slot;
   }
 
-  void Heapify(int n) {
-    int l = LeftChild(n);
-    int r = RightChild(n);
+  void Place(int n, u64 key, int slot) {
+    Key(n) = key;
+    heap_slot[n] = (u8)slot;
+    heap_position[slot] = (u8)n;
+  }
 
-    if(l < heap_size && heap[l]->key < heap[n]->key) {
-      Swap(l, n);
-      Heapify(l);
+  void SiftUp(int n, u64 key, int slot) {
+    while(n != 0) {
+      int p = Parent(n);
+      if(Key(p) <= key) {
+        break;
+      }
+      Place(n, Key(p), heap_slot[p]);
+      n = p;
     }
 
-    if(r < heap_size && heap[r]->key < heap[n]->key) {
-      Swap(r, n);
-      Heapify(r);
+    Place(n, key, slot);
+  }
+
+  void SiftDown(int n, u64 key, int slot) {
+    while(true) {
+      int c = FirstChild(n);
+      if(c >= heap_size) {
+        break;
+      }
+
+      int c_min = c;
+      int c_end = std::min(c + 4, heap_size);
+
+      for(int i = c + 1; i < c_end; i++) {
+        if(Key(i) < Key(c_min)) {
+          c_min = i;
+        }
+      }
+
+      if(Key(c_min) >= key) {
+        break;
+      }
+      Place(n, Key(c_min), heap_slot[c_min]);
+      n = c_min;
     }
+
+    Place(n, key, slot);
   }
 
   void EndOfQueue() {
     Assert(false, "Scheduler: reached end of the event queue.");
   }
 
-  Event* heap[kMaxEvents];
+  alignas(64) u64 heap_key[kKeyOffset + kMaxEvents];
+  u8 heap_slot[kMaxEvents];
+  u8 heap_position[kMaxEvents];
   int heap_size;
+  Event events[kMaxEvents];
   u64 timestamp_now;
+  u64 timestamp_target; // timestamp of the next event
   u64 next_uid;
 
-  std::function<void(u64)> callbacks[(int)EventClass::Count];
+  struct Callback {
+    void* object;
+    void (*thunk)(void*, u64);
+  } callbacks[(int)EventClass::Count];
+
+#ifdef NBA_SCHEDULER_STATS
+  EventClassStats stats[(int)EventClass::Count];
+#endif
+
+#ifdef NBA_SCHEDULER_TRACE
+  bool trace_active = false;
+  std::vector<SchedulerTraceRecord> trace;
+#endif
 };
 
 inline u64 GetEventUID(Scheduler::Event* event) {
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <nba/integer.hpp>
+
+namespace nba {
+
+/**
+ * A single scheduler operation, as recorded by cores built with NBA_SCHEDULER_TRACE.
+ * Operations done by an event callback are recorded between the Fire and Return
+ * records of that event, so that a trace can be replayed without the emulator.
+ */
+struct SchedulerTraceRecord {
+  enum class Op : u8 {
+    // AddCycles() was called 'count' times, adding up to 'value' cycles.
+    AddCycles,
+    // Add() with a delay of 'value' cycles. The event has the given UID.
+    Add,
+    // Cancel() of the event with the given UID.
+    Cancel,
+    // The event with the given UID fires. Its callback runs until the next Return.
+    Fire,
+    Return
+  };
+
+  u64 value;
+  u64 uid;
+  Op op;
+  u8 event_class;
+  u8 priority;
+  u8 reserved;
+  u32 count;
+};
+
+static_assert(sizeof(SchedulerTraceRecord) == 24, "SchedulerTraceRecord must have a fixed 24-byte layout");
+
+/**
+ * A trace file starts with this header, followed by records until the end of the file.
+ * All fields are stored in host byte order.
+ */
+struct SchedulerTraceHeader {
+  static constexpr u32 kMagic = 0x5453424E; // "NBST"
+  static constexpr u32 kVersion = 1;
+
+  u32 magic = kMagic;
+  u32 version = kVersion;
+  u32 record_size = sizeof(SchedulerTraceRecord);
+  u32 reserved = 0;
+};
+
+} // namespace nba
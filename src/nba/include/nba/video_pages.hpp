@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <array>
+#include <nba/integer.hpp>
+
+namespace nba {
+
+/**
+ * One bit for each 256-byte page of PRAM, OAM and VRAM.
+ * Page n of a memory holds its bytes n * 256 to n * 256 + 255
+ * and is represented by bit (n & 63) of word (n >> 6).
+ */
+struct VideoPages {
+  static constexpr int kPageShift = 8;
+
+  static constexpr int kPRAMPageCount = 0x00400 >> kPageShift;
+  static constexpr int kOAMPageCount  = 0x00400 >> kPageShift;
+  static constexpr int kVRAMPageCount = 0x18000 >> kPageShift;
+
+  std::array<u64, (kPRAMPageCount + 63) / 64> pram{};
+  std::array<u64, (kOAMPageCount  + 63) / 64> oam{};
+  std::array<u64, (kVRAMPageCount + 63) / 64> vram{};
+
+  template<size_t n>
+  static bool Test(std::array<u64, n> const& pages, int page) {
+    return pages[page >> 6] & (1ULL << (page & 63));
+  }
+};
+
+} // namespace nba
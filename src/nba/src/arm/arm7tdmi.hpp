@@ -14,8 +14,15 @@
 #include <nba/scheduler.hpp>
 
 #include "bus/bus.hpp"
+#include "arm/block_cache.hpp"
+#include "arm/hle/bios.hpp"
+#include "arm/jit/jit.hpp"
 #include "arm/state.hpp"
 
+#ifdef NBA_ARM_TRACE
+  #include "arm/trace.hpp"
+#endif
+
 namespace nba::core::arm {
 
 struct ARM7TDMI {
@@ -23,14 +30,21 @@ struct ARM7TDMI {
 
   ARM7TDMI(Scheduler& scheduler, Bus& bus)
       : scheduler(scheduler)
-      , bus(bus) {
-    scheduler.Register(Scheduler::EventClass::ARM_ldm_usermode_conflict, this, &ARM7TDMI::ClearLDMUsermodeConflictFlag);
+      , bus(bus)
+      , block_cache(bus.memory.code_pages.data())
+      , hle_bios(bus) {
+    scheduler.Register<&ARM7TDMI::ClearLDMUsermodeConflictFlag>(Scheduler::EventClass::ARM_ldm_usermode_conflict, this);
 
     Reset();
   }
 
   auto IRQLine() -> bool& { return irq_line; }
 
+  /**
+   * Whether supported SWIs are executed natively instead of by the BIOS.
+   */
+  auto HLEBIOS() -> bool& { return hle_bios_enable; }
+
   void Reset() {
     state.Reset();
     SwitchMode(state.cpsr.f.mode);
@@ -42,6 +56,11 @@ struct ARM7TDMI {
     latch_irq_disable = state.cpsr.f.mask_irq;
     ldm_usermode_conflict = false;
     cpu_mode_is_invalid = false;
+    block_cache.Reset();
+    jit.Flush();
+#ifdef NBA_ARM_LAZY_FLAGS
+    lazy_flags = {};
+#endif
   }
 
   auto GetFetchedOpcode(int slot) -> u32 {
@@ -49,8 +68,34 @@ struct ARM7TDMI {
   }
 
   void Run() {
+#ifdef NBA_ARM_TRACE
+    if(unlikely(trace.IsActive())) {
+      const u64 timestamp = scheduler.GetTimestampNow();
+
+      if(IRQLine()) SignalIRQ();
+
+      const u32 pc = (state.r15 & ~1) - (state.cpsr.f.thumb ? 4 : 8);
+      const u32 opcode = pipe.opcode[0];
+
+      MaterializeFlags();
+
+      const u32 cpsr = state.cpsr.v;
+
+      Execute();
+      trace.Record(pc, opcode, cpsr, scheduler.GetTimestampNow() - timestamp);
+      return;
+    }
+#endif
+
     if(IRQLine()) SignalIRQ();
 
+    Execute();
+  }
+
+  /**
+   * Executes the instruction in the first pipeline stage.
+   */
+  void ALWAYS_INLINE Execute() {
     auto instruction = pipe.opcode[0];
 
     latch_irq_disable = state.cpsr.f.mask_irq;
@@ -59,12 +104,12 @@ struct ARM7TDMI {
 
     if(state.cpsr.f.thumb) {
       pipe.opcode[0] = pipe.opcode[1];
-      pipe.opcode[1] = ReadHalf(state.r15, pipe.access);
+      pipe.opcode[1] = bus.ReadCode<u16>(state.r15, pipe.access);
 
       (this->*s_opcode_lut_16[instruction >> 6])(instruction);
     } else {
       pipe.opcode[0] = pipe.opcode[1];
-      pipe.opcode[1] = ReadWord(state.r15, pipe.access);
+      pipe.opcode[1] = bus.ReadCode<u32>(state.r15, pipe.access);
 
       if(CheckCondition(static_cast<Condition>(instruction >> 28))) {
         int hash = ((instruction >> 16) & 0xFF0) |
@@ -77,18 +122,219 @@ struct ARM7TDMI {
     }
   }
 
+  /**
+   * Runs instructions until timestamp_limit has been reached or the CPU halts.
+   * Scheduler events are dispatched from within bus accesses and Run() takes
+   * pending IRQs at instruction boundaries, so neither requires a return
+   * to the caller. Only a halt must be handled outside of the CPU.
+   */
+  void RunUntil(u64 timestamp_limit) {
+    while(scheduler.GetTimestampNow() < timestamp_limit &&
+          bus.hw.haltcnt == Bus::Hardware::HaltControl::Run) {
+      Run();
+    }
+  }
+
+  /**
+   * Same as RunUntil(), but runs code through the cached interpreter.
+   */
+  void RunBlocksUntil(u64 timestamp_limit) {
+    while(scheduler.GetTimestampNow() < timestamp_limit &&
+          bus.hw.haltcnt == Bus::Hardware::HaltControl::Run) {
+      RunBlock(timestamp_limit);
+    }
+  }
+
+  /**
+   * Same as RunUntil(), but runs code through the JIT.
+   */
+  void RunCompiledUntil(u64 timestamp_limit) {
+    while(scheduler.GetTimestampNow() < timestamp_limit &&
+          bus.hw.haltcnt == Bus::Hardware::HaltControl::Run) {
+      RunCompiledBlock(timestamp_limit);
+    }
+  }
+
+  /**
+   * Cached interpreter: runs code from the basic block cache for as long as
+   * execution moves forward inside the current cache page. Each entry holds
+   * the handler and, for ARM, the condition of its instruction, so neither the
+   * opcode tables nor the opcode are looked at again. Instruction fetches still
+   * go through the bus and each instruction is executed exactly like in Run(),
+   * so timing is unchanged. Execution also stops on a backward jump (which
+   * makes loops visible to the caller), a change of the instruction set,
+   * a pending IRQ, a halt or once timestamp_limit has been reached.
+   */
+  void RunBlock(u64 timestamp_limit) {
+    if(IRQLine() && !latch_irq_disable) {
+      Run();
+      return;
+    }
+
+#ifdef NBA_ARM_TRACE
+    // Only Run() records instructions.
+    if(unlikely(trace.IsActive())) {
+      Run();
+      return;
+    }
+#endif
+
+    state.r15 &= ~1;
+
+    const bool thumb = state.cpsr.f.thumb;
+    const u32 pc_offset = thumb ? 4 : 8;
+    const u32 page_address = (state.r15 - pc_offset) & ~(BlockCache::kPageSize - 1);
+
+    auto page = block_cache.Get(page_address);
+
+    if(!page) {
+      Run();
+      return;
+    }
+
+    u32 offset = state.r15 - pc_offset - page_address;
+
+    do {
+      auto instruction = pipe.opcode[0];
+      auto instr = &page[offset >> 1];
+
+      latch_irq_disable = state.cpsr.f.mask_irq;
+
+      if(thumb) {
+        pipe.opcode[0] = pipe.opcode[1];
+        pipe.opcode[1] = bus.ReadCode<u16>(state.r15, pipe.access);
+
+        if(likely(instr->kind == BlockCache::Instruction::Kind::Thumb)) {
+          (this->*instr->handler16)(instruction);
+        } else {
+          (this->*DecodeThumb(instr, page_address + offset, instruction))(instruction);
+        }
+      } else {
+        pipe.opcode[0] = pipe.opcode[1];
+        pipe.opcode[1] = bus.ReadCode<u32>(state.r15, pipe.access);
+
+        if(unlikely(instr->kind != BlockCache::Instruction::Kind::ARM)) {
+          DecodeARM(instr, page_address + offset, instruction);
+        }
+
+        if(instr->condition == COND_AL || CheckCondition(static_cast<Condition>(instr->condition))) {
+          (this->*instr->handler32)(instruction);
+        } else {
+          pipe.access = Access::Code | Access::Sequential;
+          state.r15 += 4;
+        }
+      }
+
+      state.r15 &= ~1;
+
+      u32 offset_next = state.r15 - pc_offset - page_address;
+
+      if(offset_next <= offset || offset_next >= BlockCache::kPageSize) {
+        break;
+      }
+
+      offset = offset_next;
+    } while(state.cpsr.f.thumb == thumb &&
+            !(IRQLine() && !latch_irq_disable) &&
+            bus.hw.haltcnt == Bus::Hardware::HaltControl::Run &&
+            scheduler.GetTimestampNow() < timestamp_limit);
+  }
+
+  /**
+   * JIT: runs the compiled block at the current address, compiling it first if necessary.
+   * A block returns after a taken branch, a change of the instruction set, a pending IRQ,
+   * a halt, a prefetched opcode which differs from the compiled one or once timestamp_limit
+   * has been reached. The interpreter runs a single instruction instead while an LDM
+   * with user mode registers or an invalid CPU mode redirect register accesses,
+   * and whenever no block can be compiled. Work RAM pages whose code keeps being overwritten
+   * are run by the cached interpreter.
+   */
+  void RunCompiledBlock(u64 timestamp_limit) {
+    if(IRQLine() && !latch_irq_disable) {
+      Run();
+      return;
+    }
+
+    if(ldm_usermode_conflict || cpu_mode_is_invalid) {
+      Run();
+      return;
+    }
+
+#ifdef NBA_ARM_TRACE
+    // Only Run() records instructions.
+    if(unlikely(trace.IsActive())) {
+      Run();
+      return;
+    }
+#endif
+
+    state.r15 &= ~1;
+
+    const bool thumb = state.cpsr.f.thumb;
+    const u32 address = state.r15 - (thumb ? 4 : 8);
+
+    if(jit.IsFull()) {
+      block_cache.Reset();
+      jit.Flush();
+    }
+
+    auto page = block_cache.Get(address & ~(BlockCache::kPageSize - 1));
+
+    if(!page) {
+      Run();
+      return;
+    }
+
+    auto& block = page[(address & (BlockCache::kPageSize - 1)) >> 1].block;
+
+    if(!block.function || block.address != address || block.thumb != thumb || block.opcode != pipe.opcode[0]) {
+      // Recompiling code which keeps being overwritten costs more than interpreting it.
+      if(!block_cache.ShouldCompile(address)) {
+        RunBlock(timestamp_limit);
+        return;
+      }
+
+      block = jit.Compile(*this, address, thumb);
+
+      if(!block.function) {
+        Run();
+        return;
+      }
+
+      block_cache.OnBlockCompiled(address);
+
+      // Memory has been written after the opcode was fetched.
+      if(block.opcode != pipe.opcode[0]) {
+        Run();
+        return;
+      }
+    }
+
+    jit.timestamp_limit = timestamp_limit;
+    block.function(this);
+  }
+
+  /**
+   * Notifies the block cache that a page of work RAM with decoded code has been
+   * written, so that decoded instructions and compiled blocks at that location are discarded.
+   */
+  void InvalidateCode(int wram_page, u32 offset, int size) {
+    block_cache.Invalidate(wram_page, offset, size);
+  }
+
   void SwitchMode(Mode new_mode) {
     auto old_bank = GetRegisterBankByMode(state.cpsr.f.mode);
     auto new_bank = GetRegisterBankByMode(new_mode);
 
     state.cpsr.f.mode = new_mode;
 
-    if(new_bank != BANK_NONE) {
+    if(new_bank != BANK_NONE && new_bank != BANK_INVALID) {
       p_spsr = &state.spsr[new_bank];
     } else {
       /* In system/user mode reading from SPSR returns the current CPSR value.
        * However writes to SPSR appear to do nothing.
        * We take care of this fact in the MSR implementation.
+       * Invalid modes have no SPSR either (see GetSPSR()).
        */
       p_spsr = &state.cpsr;
     }
@@ -115,25 +361,91 @@ struct ARM7TDMI {
       }
     }
 
-    state.bank[old_bank][5] = state.r13;
-    state.bank[old_bank][6] = state.r14;
+    /* Invalid modes have no banked registers (see GetReg() and SetReg()),
+     * r13 and r14 of the previous mode stay in the register file.
+     */
+    if(old_bank != BANK_INVALID) {
+      state.bank[old_bank][5] = state.r13;
+      state.bank[old_bank][6] = state.r14;
+    }
 
-    state.r13 = state.bank[new_bank][5];
-    state.r14 = state.bank[new_bank][6];
+    if(new_bank != BANK_INVALID) {
+      state.r13 = state.bank[new_bank][5];
+      state.r14 = state.bank[new_bank][6];
+    }
 
     cpu_mode_is_invalid = new_bank == BANK_INVALID;
   }
 
+  /**
+   * Writes flags which are still pending evaluation to the CPSR.
+   * This must be done before N, Z, C or V are read from state.cpsr.
+   */
+  void ALWAYS_INLINE MaterializeFlags() {
+#ifdef NBA_ARM_LAZY_FLAGS
+    if(lazy_flags.nz_pending) {
+      state.cpsr.f.n = lazy_flags.result >> 31;
+      state.cpsr.f.z = lazy_flags.result == 0;
+      lazy_flags.nz_pending = false;
+    }
+
+    MaterializeCarryAndOverflowFlags();
+#endif
+  }
+
   void LoadState(SaveState const& save_state);
   void CopyState(SaveState& save_state);
 
   RegisterFile state;
 
+#ifdef NBA_ARM_TRACE
+  CPUTrace trace;
+#endif
+
   typedef void (ARM7TDMI::*Handler16)(u16);
   typedef void (ARM7TDMI::*Handler32)(u32);
 
+  using BlockCache = BasicBlockCache<Handler16, Handler32, JIT::Block>;
+
 private:
   friend struct TableGen;
+  friend struct JITCompiler;
+
+  /**
+   * Returns true if the opcode in memory at the given address matches the fetched opcode.
+   * Otherwise memory has been written after the fetch and the opcode must not be cached.
+   */
+  template<typename T>
+  bool IsCacheableOpcode(u32 address, T instruction) {
+    auto host_address = bus.GetHostAddress<T>(BlockCache::GetCanonicalAddress(address));
+
+    return host_address != nullptr && *host_address == instruction;
+  }
+
+  auto DecodeThumb(BlockCache::Instruction* instr, u32 address, u16 instruction) -> Handler16 {
+    auto handler = s_opcode_lut_16[instruction >> 6];
+
+    if(IsCacheableOpcode<u16>(address, instruction)) {
+      instr->kind = BlockCache::Instruction::Kind::Thumb;
+      instr->handler16 = handler;
+    }
+    return handler;
+  }
+
+  void DecodeARM(BlockCache::Instruction* instr, u32 address, u32 instruction) {
+    int hash = ((instruction >> 16) & 0xFF0) |
+               ((instruction >>  4) & 0x00F);
+
+    instr->condition = instruction >> 28;
+    instr->handler32 = s_opcode_lut_32[hash];
+
+    if(IsCacheableOpcode<u32>(address, instruction)) {
+      instr->kind = BlockCache::Instruction::Kind::ARM;
+    } else {
+      // The entry is used for this one execution only.
+      instr->kind = BlockCache::Instruction::Kind::Invalid;
+    }
+  }
 
   auto GetReg(int id) -> u32 {
     u32 result = 0;
@@ -163,6 +475,9 @@ private:
   }
 
   auto GetSPSR() -> StatusRegister {
+    // In system and user mode the SPSR is an alias of the CPSR.
+    MaterializeFlags();
+
     // CPSR/SPSR bit4 is forced to one on the ARM7TDMI:
     u32 spsr = 0x00000010;
 
@@ -196,6 +511,7 @@ private:
     }
 
     // Save current program status register.
+    MaterializeFlags();
     state.spsr[BANK_IRQ].v = state.cpsr.v;
 
     // Enter IRQ mode and disable IRQs.
@@ -218,6 +534,7 @@ private:
   bool CheckCondition(Condition condition) {
     if(condition == COND_AL)
       return true;
+    MaterializeFlags();
     return s_condition_lut[(static_cast<int>(condition) << 4) | (state.cpsr.v >> 28)];
   }
 
@@ -259,6 +576,33 @@ private:
     return BANK_INVALID;
   }
 
+#ifdef NBA_ARM_LAZY_FLAGS
+  void ALWAYS_INLINE MaterializeCarryAndOverflowFlags() {
+    const u32 op1 = lazy_flags.op1;
+    const u32 op2 = lazy_flags.op2;
+
+    switch(lazy_flags.cv_op) {
+      case LazyFlags::Op::None: {
+        return;
+      }
+      case LazyFlags::Op::Add: {
+        u32 result = op1 + op2;
+        state.cpsr.f.c = result < op1;
+        state.cpsr.f.v = (~(op1 ^ op2) & (op2 ^ result)) >> 31;
+        break;
+      }
+      case LazyFlags::Op::Sub: {
+        u32 result = op1 - op2;
+        state.cpsr.f.c = op1 >= op2;
+        state.cpsr.f.v = ((op1 ^ op2) & (op1 ^ result)) >> 31;
+        break;
+      }
+    }
+
+    lazy_flags.cv_op = LazyFlags::Op::None;
+  }
+#endif
+
   void ClearLDMUsermodeConflictFlag() {
     ldm_usermode_conflict = false;
   }
@@ -282,6 +626,31 @@ private:
   bool irq_line;
   bool latch_irq_disable;
 
+#ifdef NBA_ARM_LAZY_FLAGS
+  /* Flag-setting instructions only record their result and operands here.
+   * N and Z are derived from the last result, C and V from the operands
+   * of the last ADD or SUB. See MaterializeFlags().
+   */
+  struct LazyFlags {
+    enum class Op : u8 {
+      None,
+      Add,
+      Sub
+    } cv_op = Op::None;
+
+    bool nz_pending = false;
+    u32 result = 0;
+    u32 op1 = 0;
+    u32 op2 = 0;
+  } lazy_flags;
+#endif
+
+  BlockCache block_cache;
+  JIT jit;
+
+  BIOS hle_bios;
+  bool hle_bios_enable = false;
+
   static std::array<bool, 256> s_condition_lut;
   static std::array<Handler16, 1024> s_opcode_lut_16;
   static std::array<Handler32, 4096> s_opcode_lut_32;
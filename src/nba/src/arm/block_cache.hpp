@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <nba/integer.hpp>
+#include <vector>
+
+namespace nba::core::arm {
+
+/**
+ * Cache of pre-decoded instructions for the cached interpreter and of compiled blocks for the JIT.
+ * Code in BIOS, EWRAM, IWRAM and ROM is split into 256-byte pages which hold
+ * one decoded entry per halfword. Mirrors map onto the same page.
+ * Pages are allocated on first execution and straight-line code inside
+ * a page forms a basic block that is run without any further lookups.
+ * A compiled block is stored in the entry of its first instruction
+ * and never extends past the end of its page.
+ *
+ * A valid entry always matches the opcode in memory: entries are only filled
+ * in if the fetched opcode matches memory, and writes to EWRAM and IWRAM pages
+ * with decoded code invalidate the entries and compiled blocks they overlap.
+ * The bus tracks these pages in a bitmap with one bit per page of EWRAM and IWRAM,
+ * so that writes to other pages do not have to look up the cache.
+ * Work RAM pages whose compiled blocks keep being overwritten are no longer compiled,
+ * since recompiling them costs more than interpreting them.
+ */
+template<typename Handler16, typename Handler32, typename CompiledBlock>
+struct BasicBlockCache {
+  static constexpr int kPageShift = 8;
+  static constexpr int kPageSize = 1 << kPageShift;
+
+  // Number of times compiled blocks may be dropped from a work RAM page before it is no longer compiled.
+  static constexpr int kMaxInvalidations = 16;
+
+  struct Instruction {
+    enum class Kind : u8 {
+      Invalid,
+      Thumb,
+      ARM
+    } kind = Kind::Invalid;
+
+    // Condition field of an ARM instruction.
+    u8 condition = 0;
+
+    union {
+      Handler16 handler16;
+      Handler32 handler32;
+    };
+
+    // Compiled block which starts at this instruction.
+    // Writes to its code (size bytes) set its function to nullptr.
+    CompiledBlock block;
+
+    Instruction() : handler16{} {}
+  };
+
+  struct Page {
+    std::array<Instruction, kPageSize / sizeof(u16)> instructions;
+  };
+
+  BasicBlockCache(u64* wram_code_pages) : wram_code_pages(wram_code_pages) {
+    pages.resize(kPageCountTotal);
+  }
+
+  void Reset() {
+    compiled_pages.fill(false);
+    invalidations.fill(0);
+
+    for(int page_index = 0; page_index < kPageCountTotal; page_index++) {
+      if(pages[page_index]) {
+        pages[page_index].reset();
+
+        if(IsWRAMPage(page_index)) {
+          const int wram_page = page_index - kPageBaseEWRAM;
+
+          wram_code_pages[wram_page >> 6] &= ~(1ULL << (wram_page & 63));
+        }
+      }
+    }
+  }
+
+  /**
+   * Returns the decoded entries of the page containing the given address,
+   * allocating the page if necessary. Entry i covers the halfword at byte
+   * offset i * 2 into the page.
+   * The result is nullptr if the address is not backed by cacheable memory.
+   */
+  auto Get(u32 address) -> Instruction* {
+    int page_index = GetPageIndex(address);
+
+    if(page_index < 0) {
+      return nullptr;
+    }
+
+    auto& page = pages[page_index];
+
+    if(!page) {
+      page = std::make_unique<Page>();
+
+      if(IsWRAMPage(page_index)) {
+        const int wram_page = page_index - kPageBaseEWRAM;
+
+        wram_code_pages[wram_page >> 6] |= 1ULL << (wram_page & 63);
+      }
+    }
+
+    return page->instructions.data();
+  }
+
+  /**
+   * Invalidates all decoded entries overlapping a write to work RAM.
+   * The page is given as its index into the bitmap of work RAM pages.
+   * Entries are only invalidated and never freed, so that a block which
+   * overwrites its own code can keep running safely.
+   */
+  void Invalidate(int wram_page, u32 offset, int size) {
+    auto& instructions = pages[kPageBaseEWRAM + wram_page]->instructions;
+
+    const int first = (offset & (kPageSize - 1) & ~1) >> 1;
+    const int last  = std::min(first + ((size + 1) >> 1), (int)instructions.size());
+
+    for(int i = first; i < last; i++) {
+      instructions[i].kind = Instruction::Kind::Invalid;
+    }
+
+    // A halfword write may hit the upper half of an ARM instruction.
+    if(first & 1) {
+      instructions[first - 1].kind = Instruction::Kind::Invalid;
+    }
+
+    if(compiled_pages[wram_page]) {
+      bool have_blocks = false;
+      bool dropped_blocks = false;
+
+      for(int i = 0; i < (int)instructions.size(); i++) {
+        auto& block = instructions[i].block;
+
+        if(block.function) {
+          if(i < last && i + (block.size >> 1) > first) {
+            block.function = nullptr;
+            dropped_blocks = true;
+          } else {
+            have_blocks = true;
+          }
+        }
+      }
+
+      compiled_pages[wram_page] = have_blocks;
+
+      if(dropped_blocks && invalidations[wram_page] < kMaxInvalidations) {
+        invalidations[wram_page]++;
+      }
+    }
+  }
+
+  /**
+   * Whether a block starting at the given address should be compiled.
+   * This is false for work RAM pages whose compiled blocks have been overwritten
+   * too often, which the cached interpreter runs instead.
+   */
+  bool ShouldCompile(u32 address) const {
+    const int page_index = GetPageIndex(address);
+
+    return !IsWRAMPage(page_index) || invalidations[page_index - kPageBaseEWRAM] < kMaxInvalidations;
+  }
+
+  /**
+   * Must be called when a compiled block has been stored in an entry of a work RAM page,
+   * so that writes to the page check the compiled blocks for overlap.
+   */
+  void OnBlockCompiled(u32 address) {
+    const int page_index = GetPageIndex(address);
+
+    if(page_index >= 0 && IsWRAMPage(page_index)) {
+      compiled_pages[page_index - kPageBaseEWRAM] = true;
+    }
+  }
+
+  /**
+   * Maps mirrors of cacheable memory onto the address of the mirrored location.
+   */
+  static auto GetCanonicalAddress(u32 address) -> u32 {
+    switch(address >> 24) {
+      case 0x02: return 0x02000000 | (address & 0x3FFFF);
+      case 0x03: return 0x03000000 | (address & 0x7FFF);
+      case 0x08 ... 0x0D: return 0x08000000 | (address & 0x1FFFFFF);
+    }
+
+    return address;
+  }
+
+private:
+  static constexpr int kPageCountBIOS = 0x04000 >> kPageShift;
+  static constexpr int kPageCountEWRAM = 0x40000 >> kPageShift;
+  static constexpr int kPageCountIWRAM = 0x08000 >> kPageShift;
+  static constexpr int kPageCountROM = 0x2000000 >> kPageShift;
+
+  static constexpr int kPageBaseEWRAM = kPageCountBIOS;
+  static constexpr int kPageBaseIWRAM = kPageBaseEWRAM + kPageCountEWRAM;
+  static constexpr int kPageBaseROM = kPageBaseIWRAM + kPageCountIWRAM;
+  static constexpr int kPageCountTotal = kPageBaseROM + kPageCountROM;
+
+  static bool IsWRAMPage(int page_index) {
+    return page_index >= kPageBaseEWRAM && page_index < kPageBaseROM;
+  }
+
+  static auto GetPageIndex(u32 address) -> int {
+    switch(address >> 24) {
+      case 0x00: {
+        if(address < 0x4000) {
+          return address >> kPageShift;
+        }
+        return -1;
+      }
+      case 0x02: return kPageBaseEWRAM + ((address & 0x3FFFF) >> kPageShift);
+      case 0x03: return kPageBaseIWRAM + ((address & 0x7FFF) >> kPageShift);
+      case 0x08 ... 0x0D: {
+        // The ROM header may overlap the GPIO registers, which read back different values than the ROM.
+        if((address & 0x1FFFFFF) < kPageSize) {
+          return -1;
+        }
+        return kPageBaseROM + ((address & 0x1FFFFFF) >> kPageShift);
+      }
+    }
+
+    return -1;
+  }
+
+  std::vector<std::unique_ptr<Page>> pages;
+  u64* wram_code_pages;
+
+  // Work RAM pages which may hold compiled blocks.
+  std::array<bool, kPageCountEWRAM + kPageCountIWRAM> compiled_pages{};
+
+  // Number of writes to each work RAM page which have dropped compiled blocks, up to kMaxInvalidations.
+  std::array<u8, kPageCountEWRAM + kPageCountIWRAM> invalidations{};
+};
+
+} // namespace nba::core::arm
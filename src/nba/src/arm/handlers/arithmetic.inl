@@ -6,8 +6,54 @@
  */
 
 void SetZeroAndSignFlag(u32 value) {
+#ifdef NBA_ARM_LAZY_FLAGS
+  lazy_flags.result = value;
+  lazy_flags.nz_pending = true;
+#else
   state.cpsr.f.n = value >> 31;
   state.cpsr.f.z = (value == 0);
+#endif
+}
+
+auto GetCarryFlag() -> int {
+#ifdef NBA_ARM_LAZY_FLAGS
+  MaterializeCarryAndOverflowFlags();
+#endif
+  return state.cpsr.f.c;
+}
+
+void SetCarryFlag(int carry) {
+#ifdef NBA_ARM_LAZY_FLAGS
+  // The overflow flag of a pending ADD or SUB must survive.
+  MaterializeCarryAndOverflowFlags();
+#endif
+  state.cpsr.f.c = carry;
+}
+
+void SetAddFlags(u32 op1, u32 op2, u32 result) {
+#ifdef NBA_ARM_LAZY_FLAGS
+  lazy_flags.op1 = op1;
+  lazy_flags.op2 = op2;
+  lazy_flags.cv_op = LazyFlags::Op::Add;
+  SetZeroAndSignFlag(result);
+#else
+  SetZeroAndSignFlag(result);
+  state.cpsr.f.c = result < op1;
+  state.cpsr.f.v = (~(op1 ^ op2) & (op2 ^ result)) >> 31;
+#endif
+}
+
+void SetSubFlags(u32 op1, u32 op2, u32 result) {
+#ifdef NBA_ARM_LAZY_FLAGS
+  lazy_flags.op1 = op1;
+  lazy_flags.op2 = op2;
+  lazy_flags.cv_op = LazyFlags::Op::Sub;
+  SetZeroAndSignFlag(result);
+#else
+  SetZeroAndSignFlag(result);
+  state.cpsr.f.c = op1 >= op2;
+  state.cpsr.f.v = ((op1 ^ op2) & (op1 ^ result)) >> 31;
+#endif
 }
 
 template<bool is_signed = true>
@@ -34,9 +80,7 @@ u32 ADD(u32 op1, u32 op2, bool set_flags) {
   u32 result = op1 + op2;
 
   if (set_flags) {
-    SetZeroAndSignFlag(result);
-    state.cpsr.f.c = result < op1;
-    state.cpsr.f.v = (~(op1 ^ op2) & (op2 ^ result)) >> 31;
+    SetAddFlags(op1, op2, result);
   }
 
   return result;
@@ -44,7 +88,7 @@ u32 ADD(u32 op1, u32 op2, bool set_flags) {
 
 u32 ADC(u32 op1, u32 op2, bool set_flags) {
   if (set_flags) {
-    u64 result64 = (u64)op1 + (u64)op2 + (u64)state.cpsr.f.c;
+    u64 result64 = (u64)op1 + (u64)op2 + (u64)GetCarryFlag();
     u32 result32 = (u32)result64;
 
     SetZeroAndSignFlag(result32);
@@ -52,7 +96,7 @@ u32 ADC(u32 op1, u32 op2, bool set_flags) {
     state.cpsr.f.v = (~(op1 ^ op2) & (op2 ^ result32)) >> 31;
     return result32;
   } else {
-    return op1 + op2 + state.cpsr.f.c;
+    return op1 + op2 + GetCarryFlag();
   }
 }
 
@@ -60,16 +104,14 @@ u32 SUB(u32 op1, u32 op2, bool set_flags) {
   u32 result = op1 - op2;
 
   if (set_flags) {
-    SetZeroAndSignFlag(result);
-    state.cpsr.f.c = op1 >= op2;
-    state.cpsr.f.v = ((op1 ^ op2) & (op1 ^ result)) >> 31;
+    SetSubFlags(op1, op2, result);
   }
 
   return result;
 }
 
 u32 SBC(u32 op1, u32 op2, bool set_flags) {
-  u32 op3 = (state.cpsr.f.c) ^ 1;
+  u32 op3 = GetCarryFlag() ^ 1;
   u32 result = op1 - op2 - op3;
 
   if (set_flags) {
@@ -29,15 +29,17 @@ void Thumb_MoveShiftedRegister(u16 instruction) {
   // THUMB.1 Move shifted register
   int dst   = (instruction >> 0) & 7;
   int src   = (instruction >> 3) & 7;
-  int carry = state.cpsr.f.c;
+  int carry = 0;
 
   u32 result = state.reg[src];
 
   DoShift(op, result, imm, carry, true);
 
-  state.cpsr.f.c = carry;
-  state.cpsr.f.z = (result == 0);
-  state.cpsr.f.n = result >> 31;
+  // LSL #0 leaves the carry flag unchanged.
+  if constexpr (op != 0 || imm != 0) {
+    SetCarryFlag(carry);
+  }
+  SetZeroAndSignFlag(result);
 
   state.reg[dst] = result;
   pipe.access = Access::Code | Access::Sequential;
@@ -69,8 +71,7 @@ void Thumb_Op3(u16 instruction) {
     case 0b00:
       // MOV rD, #imm 
       state.reg[dst] = imm;
-      state.cpsr.f.n = 0;
-      state.cpsr.f.z = imm == 0;
+      SetZeroAndSignFlag(imm);
       break;
     case 0b01:
       // CMP rD, #imm
@@ -114,10 +115,10 @@ void Thumb_ALU(u16 instruction) {
       bus.Idle();
       pipe.access = Access::Code | Access::Nonsequential;
 
-      int carry = state.cpsr.f.c;
+      int carry = GetCarryFlag();
       LSL(state.reg[dst], shift, carry);
       SetZeroAndSignFlag(state.reg[dst]);
-      state.cpsr.f.c = carry;
+      SetCarryFlag(carry);
       break;
     }
     case ThumbDataOp::LSR: {
@@ -125,10 +126,10 @@ void Thumb_ALU(u16 instruction) {
       bus.Idle();
       pipe.access = Access::Code | Access::Nonsequential;
 
-      int carry = state.cpsr.f.c;
+      int carry = GetCarryFlag();
       LSR(state.reg[dst], shift, carry, false);
       SetZeroAndSignFlag(state.reg[dst]);
-      state.cpsr.f.c = carry;
+      SetCarryFlag(carry);
       break;
     }
     case ThumbDataOp::ASR: {
@@ -136,10 +137,10 @@ void Thumb_ALU(u16 instruction) {
       bus.Idle();
       pipe.access = Access::Code | Access::Nonsequential;
 
-      int carry = state.cpsr.f.c;
+      int carry = GetCarryFlag();
       ASR(state.reg[dst], shift, carry, false);
       SetZeroAndSignFlag(state.reg[dst]);
-      state.cpsr.f.c = carry;
+      SetCarryFlag(carry);
       break;
     }
     case ThumbDataOp::ADC: {
@@ -155,10 +156,10 @@ void Thumb_ALU(u16 instruction) {
       bus.Idle();
       pipe.access = Access::Code | Access::Nonsequential;      
 
-      int carry = state.cpsr.f.c;
+      int carry = GetCarryFlag();
       ROR(state.reg[dst], shift, carry, false);
       SetZeroAndSignFlag(state.reg[dst]);
-      state.cpsr.f.c = carry;
+      SetCarryFlag(carry);
       break;
     }
     case ThumbDataOp::TST: {
@@ -188,7 +189,7 @@ void Thumb_ALU(u16 instruction) {
 
       state.reg[dst] *= state.reg[src];
       SetZeroAndSignFlag(state.reg[dst]);
-      state.cpsr.f.c = 0;
+      SetCarryFlag(0);
       break;
     }
     case ThumbDataOp::BIC: {
@@ -562,7 +563,15 @@ void Thumb_ConditionalBranch(u16 instruction) {
 }
 
 void Thumb_SWI(u16 instruction) {
+  if(hle_bios_enable && hle_bios.Call(instruction & 0xFF, state)) {
+    // Return to the next instruction, like the BIOS would.
+    state.r15 -= 2;
+    ReloadPipeline16();
+    return;
+  }
+
   // Save current program status register.
+  MaterializeFlags();
   state.spsr[BANK_SVC].v = state.cpsr.v;
 
   // Enter SVC mode and disable IRQs.
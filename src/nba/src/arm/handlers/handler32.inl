@@ -29,14 +29,24 @@ void ARM_DataProcessing(u32 instruction) {
   constexpr int  shift_type = ( field4 >> 1) & 3;
   constexpr bool shift_imm  = (~field4 >> 0) & 1;
 
+  constexpr bool logical_flags = opcode == DataOp::TST || opcode == DataOp::TEQ || (set_flags && (
+                                 opcode == DataOp::AND || opcode == DataOp::EOR ||
+                                 opcode == DataOp::ORR || opcode == DataOp::MOV ||
+                                 opcode == DataOp::BIC || opcode == DataOp::MVN));
+
   int reg_dst = (instruction >> 12) & 0xF;
   int reg_op1 = (instruction >> 16) & 0xF;
   int reg_op2 = (instruction >>  0) & 0xF;
 
-  int carry = state.cpsr.f.c;
+  int carry = 0;
   u32 op1;
   u32 op2;
 
+  // The old carry is only observable through logical operations and RRX.
+  if constexpr (logical_flags || (!immediate && shift_imm && shift_type == 3)) {
+    carry = GetCarryFlag();
+  }
+
   pipe.access = Access::Code | Access::Sequential;
 
   if constexpr (immediate) {
@@ -70,7 +80,6 @@ void ARM_DataProcessing(u32 instruction) {
     DoShift(shift_type, op2, shift, carry, shift_imm);
   }
 
-  auto& cpsr = state.cpsr;
   u32 result;
 
   switch (opcode) {
@@ -78,7 +87,7 @@ void ARM_DataProcessing(u32 instruction) {
       result = op1 & op2;
       if constexpr (set_flags) {
         SetZeroAndSignFlag(result);
-        cpsr.f.c = carry;
+        SetCarryFlag(carry);
       }
       SetReg(reg_dst, result);
       break;
@@ -86,7 +95,7 @@ void ARM_DataProcessing(u32 instruction) {
       result = op1 ^ op2;
       if constexpr (set_flags) {
         SetZeroAndSignFlag(result);
-        cpsr.f.c = carry;
+        SetCarryFlag(carry);
       }
       SetReg(reg_dst, result);
       break;
@@ -110,11 +119,11 @@ void ARM_DataProcessing(u32 instruction) {
       break;
     case DataOp::TST:
       SetZeroAndSignFlag(op1 & op2);
-      cpsr.f.c = carry;
+      SetCarryFlag(carry);
       break;
     case DataOp::TEQ:
       SetZeroAndSignFlag(op1 ^ op2);
-      cpsr.f.c = carry;
+      SetCarryFlag(carry);
       break;
     case DataOp::CMP:
       SUB(op1, op2, true);
@@ -126,14 +135,14 @@ void ARM_DataProcessing(u32 instruction) {
       result = op1 | op2;
       if (set_flags) {
         SetZeroAndSignFlag(result);
-        cpsr.f.c = carry;
+        SetCarryFlag(carry);
       }
       SetReg(reg_dst, result);
       break;
     case DataOp::MOV:
       if constexpr (set_flags) {
         SetZeroAndSignFlag(op2);
-        cpsr.f.c = carry;
+        SetCarryFlag(carry);
       }
       SetReg(reg_dst, op2);
       break;
@@ -141,7 +150,7 @@ void ARM_DataProcessing(u32 instruction) {
       result = op1 & ~op2;
       if constexpr (set_flags) {
         SetZeroAndSignFlag(result);
-        cpsr.f.c = carry;
+        SetCarryFlag(carry);
       }
       SetReg(reg_dst, result);
       break;
@@ -149,7 +158,7 @@ void ARM_DataProcessing(u32 instruction) {
       result = ~op2;
       if constexpr (set_flags) {
         SetZeroAndSignFlag(result);
-        cpsr.f.c = carry;
+        SetCarryFlag(carry);
       }
       SetReg(reg_dst, result);
       break;
@@ -204,6 +213,8 @@ void ARM_StatusTransfer(u32 instruction) {
 
     // Apply masked replace to SPSR or CPSR.
     if (!use_spsr) {
+      MaterializeFlags();
+
       // In non-privileged mode (user mode): only condition code bits of CPSR can be changed, control bits can't.
       if (state.cpsr.f.mode == MODE_USR) {
         mask &= 0xFF000000;
@@ -225,6 +236,7 @@ void ARM_StatusTransfer(u32 instruction) {
     if (use_spsr) {
       SetReg(dst, GetSPSR().v);
     } else {
+      MaterializeFlags();
       SetReg(dst, state.cpsr.v);
     }
   }
@@ -304,6 +316,7 @@ void ARM_MultiplyLong(u32 instruction) {
   u32 result_hi = result >> 32;
 
   if (set_flags) {
+    MaterializeFlags();
     state.cpsr.f.n = result_hi >> 31;
     state.cpsr.f.z = result == 0;
   }
@@ -471,10 +484,15 @@ void ARM_SingleDataTransfer(u32 instruction) {
   if constexpr (immediate) {
     offset = instruction & 0xFFF;
   } else {
-    int carry  = state.cpsr.f.c;
+    int carry  = 0;
     int opcode = (instruction >> 5) & 3;
     int amount = (instruction >> 7) & 0x1F;
 
+    // Only RRX depends on the carry flag.
+    if (opcode == 3 && amount == 0) {
+      carry = GetCarryFlag();
+    }
+
     offset = GetReg(instruction & 0xF);
     DoShift(opcode, offset, amount, carry, true);
   }
@@ -647,6 +665,7 @@ void ARM_BlockDataTransfer(u32 instruction) {
 
 void ARM_Undefined(u32 instruction) {
   // Save current program status register.
+  MaterializeFlags();
   state.spsr[BANK_UND].v = state.cpsr.v;
 
   // Enter UND mode and disable IRQs.
@@ -660,7 +679,15 @@ void ARM_Undefined(u32 instruction) {
 }
 
 void ARM_SWI(u32 instruction) {
+  if(hle_bios_enable && hle_bios.Call((instruction >> 16) & 0xFF, state)) {
+    // Return to the next instruction, like the BIOS would.
+    state.r15 -= 4;
+    ReloadPipeline32();
+    return;
+  }
+
   // Save current program status register.
+  MaterializeFlags();
   state.spsr[BANK_SVC].v = state.cpsr.v;
 
   // Enter SVC mode and disable IRQs.
@@ -0,0 +1,654 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <nba/common/punning.hpp>
+
+#include "arm/hle/bios.hpp"
+
+namespace nba::core::arm {
+
+/* Approximate number of internal cycles spent in the BIOS code.
+ * Memory accesses to the source and destination go through the bus
+ * and are charged on top of these.
+ */
+static constexpr int kCallCycles = 24;
+static constexpr int kDivCyclesPerBit = 12;
+static constexpr int kSqrtCycles = 180;
+static constexpr int kArcTanCycles = 60;
+static constexpr int kArcTan2Cycles = 160;
+static constexpr int kCpuSetCyclesPerUnit = 6;
+static constexpr int kCpuFastSetCyclesPerBlock = 6;
+static constexpr int kAffineSetCyclesPerEntry = 40;
+static constexpr int kUnCompCyclesPerByte = 8;
+
+// After returning from a SWI the BIOS open bus value is the opcode at 0x188.
+static constexpr u32 kBIOSLatchAfterSWI = 0xE3A02004;
+
+// Sine table in 1.14 fixed-point, for angles in steps of 1/256 of a full circle.
+const std::array<s16, 256> BIOS::s_sine_lut = []() {
+  std::array<s16, 256> lut;
+
+  for(int i = 0; i < 256; i++) {
+    lut[i] = (s16)std::round(std::sin(i * 3.141592653589793 / 128.0) * 16384.0);
+  }
+  return lut;
+}();
+
+/* Used in place of the BIOS image when BIOS calls are emulated but no BIOS has been loaded.
+ * It provides the exception vectors and the IRQ dispatch of the real BIOS. Halt, IntrWait and
+ * VBlankIntrWait are implemented like in the BIOS, all other SWIs which are not emulated return
+ * immediately. There is no boot sequence: Core starts the game like it does when the BIOS is skipped.
+ */
+static const std::array<u32, 60> s_replacement_image{
+  // Exception vectors
+  0xE3A0F302, // 0x0000: mov pc, #0x08000000
+  0xE1B0F00E, // 0x0004: movs pc, lr
+  0xEA00000A, // 0x0008: b swi
+  0xE25EF004, // 0x000C: subs pc, lr, #4
+  0xE25EF008, // 0x0010: subs pc, lr, #8
+  0xE1B0F00E, // 0x0014: movs pc, lr
+  0xEA000000, // 0x0018: b irq
+  0xE25EF004, // 0x001C: subs pc, lr, #4
+  // irq: call the handler at 0x03FFFFFC (mirrors 0x03007FFC)
+  0xE92D500F, // 0x0020: stmfd sp!, {r0-r3, r12, lr}
+  0xE3A00301, // 0x0024: mov r0, #0x04000000
+  0xE28FE000, // 0x0028: add lr, pc, #0
+  0xE510F004, // 0x002C: ldr pc, [r0, #-4]
+  0xE8BD500F, // 0x0030: ldmfd sp!, {r0-r3, r12, lr}
+  0xE25EF004, // 0x0034: subs pc, lr, #4
+  // swi: run the call in system mode, with IRQs enabled if the caller had them enabled
+  0xE92D5800, // 0x0038: stmfd sp!, {r11, r12, lr}
+  0xE55EC002, // 0x003C: ldrb r12, [lr, #-2]
+  0xE14FB000, // 0x0040: mrs r11, spsr
+  0xE92D0800, // 0x0044: stmfd sp!, {r11}
+  0xE20BB080, // 0x0048: and r11, r11, #0x80
+  0xE38BB01F, // 0x004C: orr r11, r11, #0x1F
+  0xE129F00B, // 0x0050: msr cpsr_fc, r11
+  0xE92D4004, // 0x0054: stmfd sp!, {r2, lr}
+  0xE35C0002, // 0x0058: cmp r12, #2
+  0x0A000019, // 0x005C: beq halt
+  0xE35C0004, // 0x0060: cmp r12, #4
+  0x0A000003, // 0x0064: beq intr_wait
+  0xE35C0005, // 0x0068: cmp r12, #5
+  0x1A000018, // 0x006C: bne return
+  0xE3A00001, // 0x0070: mov r0, #1
+  0xE3A01001, // 0x0074: mov r1, #1
+  // intr_wait: r0 = discard old flags, r1 = flags to wait for in 0x03FFFFF8 (mirrors 0x03007FF8)
+  0xE3A0C301, // 0x0078: mov r12, #0x04000000
+  0xE3A02000, // 0x007C: mov r2, #0
+  0xE5CC2208, // 0x0080: strb r2, [r12, #0x208]
+  0xE3500000, // 0x0084: cmp r0, #0
+  0x115C20B8, // 0x0088: ldrhne r2, [r12, #-8]
+  0x11C22001, // 0x008C: bicne r2, r2, r1
+  0x114C20B8, // 0x0090: strhne r2, [r12, #-8]
+  // wait
+  0xE3A02001, // 0x0094: mov r2, #1
+  0xE5CC2208, // 0x0098: strb r2, [r12, #0x208]
+  0xE3A02000, // 0x009C: mov r2, #0
+  0xE5CC2301, // 0x00A0: strb r2, [r12, #0x301]
+  0xE5CC2208, // 0x00A4: strb r2, [r12, #0x208]
+  0xE15C20B8, // 0x00A8: ldrh r2, [r12, #-8]
+  0xE1120001, // 0x00AC: tst r2, r1
+  0x0AFFFFF7, // 0x00B0: beq wait
+  0xE1C22001, // 0x00B4: bic r2, r2, r1
+  0xE14C20B8, // 0x00B8: strh r2, [r12, #-8]
+  0xE3A02001, // 0x00BC: mov r2, #1
+  0xE5CC2208, // 0x00C0: strb r2, [r12, #0x208]
+  0xEA000002, // 0x00C4: b return
+  // halt
+  0xE3A0C301, // 0x00C8: mov r12, #0x04000000
+  0xE3A02000, // 0x00CC: mov r2, #0
+  0xE5CC2301, // 0x00D0: strb r2, [r12, #0x301]
+  // return
+  0xE8BD4004, // 0x00D4: ldmfd sp!, {r2, lr}
+  0xE3A0C0D3, // 0x00D8: mov r12, #0xD3
+  0xE129F00C, // 0x00DC: msr cpsr_fc, r12
+  0xE8BD0800, // 0x00E0: ldmfd sp!, {r11}
+  0xE169F00B, // 0x00E4: msr spsr_fc, r11
+  0xE8BD5800, // 0x00E8: ldmfd sp!, {r11, r12, lr}
+  0xE1B0F00E  // 0x00EC: movs pc, lr
+};
+
+bool BIOS::Call(int number, RegisterFile& state) {
+  bool handled = true;
+
+  switch(number) {
+    case 0x06: handled = Div(state, state.reg[0], state.reg[1]); break;
+    case 0x07: handled = Div(state, state.reg[1], state.reg[0]); break;
+    case 0x08: Sqrt(state); break;
+    case 0x09: ArcTan(state); break;
+    case 0x0A: ArcTan2(state); break;
+    case 0x0B: CpuSet(state); break;
+    case 0x0C: CpuFastSet(state); break;
+    case 0x0E: BgAffineSet(state); break;
+    case 0x0F: ObjAffineSet(state); break;
+    case 0x11: handled = LZ77UnComp(state, false); break;
+    case 0x12: handled = LZ77UnComp(state, true); break;
+    case 0x13: handled = HuffUnComp(state); break;
+    case 0x14: handled = RLUnComp(state, false); break;
+    case 0x15: handled = RLUnComp(state, true); break;
+    default: {
+      handled = false;
+      break;
+    }
+  }
+
+  if(handled) {
+    Idle(kCallCycles);
+    bus.memory.latch.bios = kBIOSLatchAfterSWI;
+  }
+
+  return handled;
+}
+
+bool BIOS::Div(RegisterFile& state, s32 numerator, s32 denominator) {
+  // The BIOS never returns from a division by zero.
+  if(denominator == 0) {
+    return false;
+  }
+
+  // Dividing INT32_MIN by -1 does not fit into 32 bits.
+  s64 quotient = (s64)numerator / denominator;
+  s64 remainder = (s64)numerator % denominator;
+  u32 magnitude = (u32)std::abs(quotient);
+
+  state.reg[0] = (u32)quotient;
+  state.reg[1] = (u32)remainder;
+  state.reg[3] = magnitude;
+
+  int bits = 1;
+  while(magnitude >>= 1) bits++;
+  Idle(bits * kDivCyclesPerBit);
+  return true;
+}
+
+void BIOS::Sqrt(RegisterFile& state) {
+  u32 value = state.reg[0];
+  u32 result = 0;
+  u32 bit = 1 << 30;
+
+  while(bit > value) bit >>= 2;
+
+  while(bit != 0) {
+    if(value >= result + bit) {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  state.reg[0] = result;
+  Idle(kSqrtCycles);
+}
+
+/**
+ * Polynomial approximation of arctan used by the BIOS. The input and result
+ * are 1.14 fixed-point; the full circle is 0x10000 in the result.
+ * r1 and r3 are left with intermediate values, like in the BIOS.
+ */
+auto BIOS::ArcTanKernel(s32 x, RegisterFile& state) -> s32 {
+  // The products wrap around like the ARM multiply instructions do.
+  const auto multiply = [](s32 a, s32 b) { return (s32)((u32)a * (u32)b); };
+
+  s32 a = -(multiply(x, x) >> 14);
+  s32 b = (multiply(0xA9, a) >> 14) + 0x390;
+
+  b = (multiply(b, a) >> 14) + 0x91C;
+  b = (multiply(b, a) >> 14) + 0xFB6;
+  b = (multiply(b, a) >> 14) + 0x16AA;
+  b = (multiply(b, a) >> 14) + 0x2081;
+  b = (multiply(b, a) >> 14) + 0x3651;
+  b = (multiply(b, a) >> 14) + 0xA2F9;
+
+  state.reg[1] = a;
+  state.reg[3] = b;
+  return multiply(x, b) >> 16;
+}
+
+void BIOS::ArcTan(RegisterFile& state) {
+  state.reg[0] = ArcTanKernel((s32)state.reg[0], state);
+  Idle(kArcTanCycles);
+}
+
+void BIOS::ArcTan2(RegisterFile& state) {
+  // 64-bit, so that -x and -y do not overflow for INT32_MIN.
+  const s64 x = (s32)state.reg[0];
+  const s64 y = (s32)state.reg[1];
+
+  s32 result;
+
+  if(y == 0) {
+    result = x >= 0 ? 0 : 0x8000;
+  } else if(x == 0) {
+    result = y >= 0 ? 0x4000 : 0xC000;
+  } else if(y >= 0) {
+    if(x >= 0 && x >= y) {
+      result = ArcTanKernel((s32)((s32)((u32)y << 14) / x), state);
+    } else if(x < 0 && -x >= y) {
+      result = ArcTanKernel((s32)((s32)((u32)y << 14) / x), state) + 0x8000;
+    } else {
+      result = 0x4000 - ArcTanKernel((s32)((s32)((u32)x << 14) / y), state);
+    }
+  } else {
+    if(x <= 0 && -x > -y) {
+      result = ArcTanKernel((s32)((s32)((u32)y << 14) / x), state) + 0x8000;
+    } else if(x > 0 && x >= -y) {
+      result = ArcTanKernel((s32)((s32)((u32)y << 14) / x), state) + 0x10000;
+    } else {
+      result = 0xC000 - ArcTanKernel((s32)((s32)((u32)x << 14) / y), state);
+    }
+  }
+
+  // The BIOS returns the angle as a halfword, so 0x10000 wraps around to zero.
+  state.reg[0] = (u32)(result & 0xFFFF);
+  Idle(kArcTan2Cycles);
+}
+
+void BIOS::CpuSet(RegisterFile& state) {
+  u32 src = state.reg[0];
+  u32 dst = state.reg[1];
+  u32 control = state.reg[2];
+
+  const int count = control & 0x1FFFFF;
+  const bool fill = control & (1 << 24);
+
+  // The BIOS refuses to copy from its own memory region.
+  if((src & 0x0E000000) == 0) {
+    return;
+  }
+
+  if(control & (1 << 26)) {
+    src &= ~3;
+    dst &= ~3;
+
+    u32 value = fill ? ReadWord(src) : 0;
+
+    for(int i = 0; i < count; i++) {
+      if(!fill) {
+        value = ReadWord(src);
+        src += sizeof(u32);
+      }
+      bus.WriteWord(dst, value, Bus::Access::Nonsequential);
+      dst += sizeof(u32);
+      Idle(kCpuSetCyclesPerUnit);
+    }
+  } else {
+    src &= ~1;
+    dst &= ~1;
+
+    u16 value = fill ? ReadHalf(src) : 0;
+
+    for(int i = 0; i < count; i++) {
+      if(!fill) {
+        value = ReadHalf(src);
+        src += sizeof(u16);
+      }
+      bus.WriteHalf(dst, value, Bus::Access::Nonsequential);
+      dst += sizeof(u16);
+      Idle(kCpuSetCyclesPerUnit);
+    }
+  }
+}
+
+void BIOS::CpuFastSet(RegisterFile& state) {
+  u32 src = state.reg[0] & ~3;
+  u32 dst = state.reg[1] & ~3;
+  u32 control = state.reg[2];
+
+  // The length is rounded up to a multiple of eight words.
+  const int count = ((control & 0x1FFFFF) + 7) & ~7;
+  const bool fill = control & (1 << 24);
+
+  if((src & 0x0E000000) == 0) {
+    return;
+  }
+
+  u32 value = fill ? ReadWord(src) : 0;
+  u32 block[8];
+
+  for(int i = 0; i < count; i += 8) {
+    for(int j = 0; j < 8; j++) {
+      if(fill) {
+        block[j] = value;
+      } else {
+        block[j] = bus.ReadWord(src, j == 0 ? Bus::Access::Nonsequential : Bus::Access::Sequential);
+        src += sizeof(u32);
+      }
+    }
+
+    for(int j = 0; j < 8; j++) {
+      bus.WriteWord(dst, block[j], j == 0 ? Bus::Access::Nonsequential : Bus::Access::Sequential);
+      dst += sizeof(u32);
+    }
+
+    Idle(kCpuFastSetCyclesPerBlock);
+  }
+}
+
+void BIOS::BgAffineSet(RegisterFile& state) {
+  u32 src = state.reg[0];
+  u32 dst = state.reg[1];
+  int count = (int)state.reg[2];
+
+  for(int i = 0; i < count; i++) {
+    s32 texture_x = (s32)ReadWord(src + 0);
+    s32 texture_y = (s32)ReadWord(src + 4);
+    s16 screen_x = (s16)ReadHalf(src + 8);
+    s16 screen_y = (s16)ReadHalf(src + 10);
+    s16 scale_x = (s16)ReadHalf(src + 12);
+    s16 scale_y = (s16)ReadHalf(src + 14);
+    int angle = ReadHalf(src + 16) >> 8;
+
+    s32 sin = Sine(angle);
+    s32 cos = Cosine(angle);
+
+    s32 pa =  (scale_x * cos) >> 14;
+    s32 pb = -(scale_x * sin) >> 14;
+    s32 pc =  (scale_y * sin) >> 14;
+    s32 pd =  (scale_y * cos) >> 14;
+
+    bus.WriteHalf(dst + 0, (u16)pa, Bus::Access::Nonsequential);
+    bus.WriteHalf(dst + 2, (u16)pb, Bus::Access::Sequential);
+    bus.WriteHalf(dst + 4, (u16)pc, Bus::Access::Sequential);
+    bus.WriteHalf(dst + 6, (u16)pd, Bus::Access::Sequential);
+    bus.WriteWord(dst + 8, (u32)(texture_x - (pa * screen_x + pb * screen_y)), Bus::Access::Sequential);
+    bus.WriteWord(dst + 12, (u32)(texture_y - (pc * screen_x + pd * screen_y)), Bus::Access::Sequential);
+
+    src += 20;
+    dst += 16;
+    Idle(kAffineSetCyclesPerEntry);
+  }
+}
+
+void BIOS::ObjAffineSet(RegisterFile& state) {
+  u32 src = state.reg[0];
+  u32 dst = state.reg[1];
+  int count = (int)state.reg[2];
+  u32 stride = state.reg[3];
+
+  for(int i = 0; i < count; i++) {
+    s16 scale_x = (s16)ReadHalf(src + 0);
+    s16 scale_y = (s16)ReadHalf(src + 2);
+    int angle = ReadHalf(src + 4) >> 8;
+
+    s32 sin = Sine(angle);
+    s32 cos = Cosine(angle);
+
+    bus.WriteHalf(dst + stride * 0, (u16)( (scale_x * cos) >> 14), Bus::Access::Nonsequential);
+    bus.WriteHalf(dst + stride * 1, (u16)(-(scale_x * sin) >> 14), Bus::Access::Nonsequential);
+    bus.WriteHalf(dst + stride * 2, (u16)( (scale_y * sin) >> 14), Bus::Access::Nonsequential);
+    bus.WriteHalf(dst + stride * 3, (u16)( (scale_y * cos) >> 14), Bus::Access::Nonsequential);
+
+    src += 8;
+    dst += stride * 4;
+    Idle(kAffineSetCyclesPerEntry);
+  }
+}
+
+bool BIOS::LZ77UnComp(RegisterFile& state, bool vram) {
+  u32 src = state.reg[0];
+  u32 header;
+
+  if(!PeekHeader(src, header) || ((header >> 4) & 15) != 1) {
+    return false;
+  }
+
+  const u32 size = header >> 8;
+
+  ReadWord(src);
+  src += sizeof(u32);
+  BeginOutput(state.reg[1], vram);
+
+  while(output.count < size) {
+    u8 flags = ReadByte(src++);
+
+    for(int i = 0; i < 8 && output.count < size; i++) {
+      if(flags & 0x80) {
+        u8 byte0 = ReadByte(src++);
+        u8 byte1 = ReadByte(src++);
+        u32 length = (byte0 >> 4) + 3;
+        u32 distance = (((byte0 & 15) << 8) | byte1) + 1;
+
+        for(u32 j = 0; j < length && output.count < size; j++) {
+          OutputByte(ReadOutputByte(distance));
+        }
+      } else {
+        OutputByte(ReadByte(src++));
+      }
+
+      flags <<= 1;
+    }
+  }
+
+  return true;
+}
+
+bool BIOS::HuffUnComp(RegisterFile& state) {
+  u32 src = state.reg[0];
+  u32 dst = state.reg[1];
+  u32 header;
+
+  if(!PeekHeader(src, header)) {
+    return false;
+  }
+
+  int data_size = header & 15;
+  s32 remaining = header >> 8;
+
+  if(((header >> 4) & 15) != 2 || (data_size != 4 && data_size != 8)) {
+    return false;
+  }
+
+  ReadWord(src);
+
+  const u32 tree = src + 5;
+  const u32 data_mask = (1 << data_size) - 1;
+
+  u32 bitstream = src + 4 + (ReadByte(src + 4) + 1) * 2;
+  u32 node_address = tree;
+  u8  node = ReadByte(tree);
+  u32 word = 0;
+  int shift = 0;
+
+  while(remaining > 0) {
+    u32 bits = ReadWord(bitstream);
+
+    bitstream += sizeof(u32);
+
+    for(int i = 31; i >= 0 && remaining > 0; i--) {
+      int bit = (bits >> i) & 1;
+      u32 child_address = (node_address & ~1) + (node & 63) * 2 + 2 + bit;
+
+      // Bit 7 marks child 0 and bit 6 marks child 1 as a data node.
+      if(node & (0x80 >> bit)) {
+        word |= (ReadByte(child_address) & data_mask) << shift;
+        shift += data_size;
+
+        if(shift == 32) {
+          bus.WriteWord(dst, word, Bus::Access::Nonsequential);
+          dst += sizeof(u32);
+          remaining -= sizeof(u32);
+          word = 0;
+          shift = 0;
+          Idle(kUnCompCyclesPerByte * sizeof(u32));
+        }
+
+        node_address = tree;
+      } else {
+        node_address = child_address;
+      }
+
+      node = ReadByte(node_address);
+    }
+  }
+
+  return true;
+}
+
+bool BIOS::RLUnComp(RegisterFile& state, bool vram) {
+  u32 src = state.reg[0];
+  u32 header;
+
+  if(!PeekHeader(src, header) || ((header >> 4) & 15) != 3) {
+    return false;
+  }
+
+  const u32 size = header >> 8;
+
+  ReadWord(src);
+  src += sizeof(u32);
+  BeginOutput(state.reg[1], vram);
+
+  while(output.count < size) {
+    u8 flag = ReadByte(src++);
+
+    if(flag & 0x80) {
+      u32 length = (flag & 0x7F) + 3;
+      u8 value = ReadByte(src++);
+
+      for(u32 i = 0; i < length && output.count < size; i++) {
+        OutputByte(value);
+      }
+    } else {
+      u32 length = (flag & 0x7F) + 1;
+
+      for(u32 i = 0; i < length && output.count < size; i++) {
+        OutputByte(ReadByte(src++));
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Reads the header of compressed data without going through the bus.
+ * Calls with an unsupported header are left to the BIOS image,
+ * which then must not be charged for a second read of the header.
+ * Sources whose reads have side effects or which are not backed by memory
+ * (I/O, SRAM, past the end of the ROM) are left to the BIOS image as well.
+ */
+bool BIOS::PeekHeader(u32 src, u32& header) {
+  auto& memory = bus.memory;
+
+  src &= ~3;
+
+  switch(src >> 24) {
+    // The BIOS refuses to decompress from its own memory region.
+    case 0x00 ... 0x01: return false;
+    case 0x02: header = read<u32>(memory.wram.data(), src & 0x3FFFF); break;
+    case 0x03: header = read<u32>(memory.iram.data(), src & 0x7FFF); break;
+    case 0x05: header = bus.hw.ppu.ReadPRAM<u32>(src); break;
+    case 0x06: {
+      u32 offset = src & 0x1FFFF;
+
+      if(offset >= 0x18000) {
+        offset &= ~0x8000;
+      }
+      header = bus.hw.ppu.ReadVRAM_BG<u32>(offset);
+      break;
+    }
+    case 0x07: header = bus.hw.ppu.ReadOAM<u32>(src); break;
+    case 0x08 ... 0x0D: {
+      auto& rom = memory.rom.GetRawROM();
+      const u32 offset = src & 0x1FFFFFF;
+
+      if(offset + sizeof(u32) > rom.size()) {
+        return false;
+      }
+      header = read<u32>(rom.data(), offset);
+      break;
+    }
+    default: return false;
+  }
+
+  return true;
+}
+
+/**
+ * Decompressed data is written to memory as soon as it has been produced,
+ * so that overlapping source and destination buffers behave like in the BIOS.
+ * The VRAM variants of the decompression routines write halfwords,
+ * because VRAM ignores byte writes. Like in the BIOS, a trailing odd byte is dropped.
+ */
+void BIOS::BeginOutput(u32 address, bool vram) {
+  output = {};
+  output.address = address;
+  output.vram = vram;
+}
+
+void BIOS::OutputByte(u8 value) {
+  const u32 address = output.address + output.count;
+
+  if(output.vram) {
+    if(output.count & 1) {
+      bus.WriteHalf(address - 1, output.pending | (value << 8), Bus::Access::Nonsequential);
+    } else {
+      output.pending = value;
+    }
+  } else {
+    bus.WriteByte(address, value, Bus::Access::Nonsequential);
+  }
+
+  output.count++;
+  Idle(kUnCompCyclesPerByte);
+}
+
+/**
+ * Reads back a previously decompressed byte from the destination, like the BIOS does.
+ * In the VRAM variant a byte that is still waiting for its upper half has not been
+ * written yet, so the BIOS reads a stale value from memory in that case too.
+ */
+auto BIOS::ReadOutputByte(u32 distance) -> u8 {
+  const u32 address = output.address + output.count - distance;
+
+  if(output.vram) {
+    return ReadHalf(address & ~1) >> ((address & 1) * 8);
+  }
+  return ReadByte(address);
+}
+
+void BIOS::Idle(int cycles) {
+  for(int i = 0; i < cycles; i++) {
+    bus.Idle();
+  }
+}
+
+auto BIOS::ReadByte(u32 address) -> u8 {
+  return bus.ReadByte(address, Bus::Access::Nonsequential);
+}
+
+auto BIOS::ReadHalf(u32 address) -> u16 {
+  return bus.ReadHalf(address, Bus::Access::Nonsequential);
+}
+
+auto BIOS::ReadWord(u32 address) -> u32 {
+  return bus.ReadWord(address, Bus::Access::Nonsequential);
+}
+
+auto BIOS::GetReplacementImage() -> std::vector<u8> {
+  std::vector<u8> image(s_replacement_image.size() * sizeof(u32));
+
+  for(size_t i = 0; i < s_replacement_image.size(); i++) {
+    write<u32>(image.data(), i * sizeof(u32), s_replacement_image[i]);
+  }
+  return image;
+}
+
+auto BIOS::Sine(int angle) -> s32 {
+  return s_sine_lut[angle & 255];
+}
+
+auto BIOS::Cosine(int angle) -> s32 {
+  return s_sine_lut[(angle + 64) & 255];
+}
+
+} // namespace nba::core::arm
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <array>
+#include <nba/integer.hpp>
+#include <vector>
+
+#include "arm/state.hpp"
+#include "bus/bus.hpp"
+
+namespace nba::core::arm {
+
+/**
+ * High-level emulation of the most frequently used BIOS calls.
+ * The routines run natively and access memory through the bus,
+ * so that memory access timing and side effects are preserved.
+ * The cost of the BIOS code itself is only approximated.
+ * Unlike in the real BIOS, interrupts cannot be serviced while
+ * a call is in progress.
+ */
+struct BIOS {
+  BIOS(Bus& bus) : bus(bus) {}
+
+  /**
+   * Executes the BIOS call with the given SWI number.
+   * Returns false if the call is not implemented or if its arguments are
+   * not supported, in which case the SWI must be handled by the BIOS image.
+   */
+  bool Call(int number, RegisterFile& state);
+
+  /**
+   * Returns a minimal BIOS image which lets games run without the real BIOS,
+   * as long as BIOS calls are emulated. See s_replacement_image in bios.cpp.
+   */
+  static auto GetReplacementImage() -> std::vector<u8>;
+
+private:
+  bool Div(RegisterFile& state, s32 numerator, s32 denominator);
+  void Sqrt(RegisterFile& state);
+  void ArcTan(RegisterFile& state);
+  void ArcTan2(RegisterFile& state);
+  void CpuSet(RegisterFile& state);
+  void CpuFastSet(RegisterFile& state);
+  void BgAffineSet(RegisterFile& state);
+  void ObjAffineSet(RegisterFile& state);
+  bool LZ77UnComp(RegisterFile& state, bool vram);
+  bool HuffUnComp(RegisterFile& state);
+  bool RLUnComp(RegisterFile& state, bool vram);
+
+  auto ArcTanKernel(s32 x, RegisterFile& state) -> s32;
+  bool PeekHeader(u32 src, u32& header);
+  void BeginOutput(u32 address, bool vram);
+  void OutputByte(u8 value);
+  auto ReadOutputByte(u32 distance) -> u8;
+  void Idle(int cycles);
+
+  auto ReadByte(u32 address) -> u8;
+  auto ReadHalf(u32 address) -> u16;
+  auto ReadWord(u32 address) -> u32;
+
+  static auto Sine(int angle) -> s32;
+  static auto Cosine(int angle) -> s32;
+
+  static const std::array<s16, 256> s_sine_lut;
+
+  Bus& bus;
+
+  // Destination of the decompression routine in progress.
+  struct Output {
+    u32 address;
+    u32 count;
+    bool vram;
+    u8 pending; // lower byte of the next halfword in the VRAM variant
+  } output;
+};
+
+} // namespace nba::core::arm
@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <nba/common/punning.hpp>
+
+#include "arm/idle_loop.hpp"
+#include "bus/io.hpp"
+
+namespace nba::core::arm {
+
+bool IdleLoopDetector::Update() {
+  const bool thumb = cpu.state.cpsr.f.thumb;
+  const u32 pc = (cpu.state.r15 & ~1) - (thumb ? 4 : 8);
+  const u32 previous_pc = last_pc;
+
+  last_pc = pc;
+
+  if(pc == override_address) {
+    // Run one pass through the loop after each skip, so that it can exit.
+    override_skipped = !override_skipped;
+    return override_skipped;
+  }
+
+  if(loop.active) {
+    if(thumb == loop.thumb && pc >= loop.start && pc <= loop.end) {
+      u32 load_address;
+
+      // A loop that polls an I/O register which changes without any scheduler event is not idle.
+      if(GetLoadAddress(pc, thumb, load_address) && !IsEventDrivenLoad(load_address)) {
+        loop.active = false;
+        rejected_pc = loop.start;
+        return false;
+      }
+
+      if(pc != loop.start) {
+        return false;
+      }
+
+      auto registers = GetRegisters();
+
+      if(loop.have_registers && registers == loop.registers) {
+        // Run one pass through the loop after the skip, so that it can exit.
+        loop.have_registers = false;
+        return true;
+      }
+
+      loop.registers = registers;
+      loop.have_registers = true;
+      return false;
+    }
+
+    loop.active = false;
+  }
+
+  // Only a backward jump may close a loop.
+  if(pc > previous_pc || pc == rejected_pc) {
+    return false;
+  }
+
+  u32 loop_end;
+
+  if(Analyze(pc, thumb, loop_end)) {
+    loop.active = true;
+    loop.thumb = thumb;
+    loop.start = pc;
+    loop.end = loop_end;
+    loop.registers = GetRegisters();
+    loop.have_registers = true;
+  } else {
+    rejected_pc = pc;
+  }
+
+  return false;
+}
+
+auto IdleLoopDetector::Analyze(u32 address, bool thumb, u32& loop_end) -> bool {
+  const int size = thumb ? sizeof(u16) : sizeof(u32);
+
+  u32 pc = address;
+
+  for(int i = 0; i < kMaxLoopLength; i++) {
+    u32 instruction;
+    bool loop_closed = false;
+
+    if(!ReadCode(pc, size, instruction)) {
+      return false;
+    }
+
+    if(thumb) {
+      if(!AnalyzeThumb(pc, (u16)instruction, address, loop_closed)) return false;
+    } else {
+      if(!AnalyzeARM(pc, instruction, address, loop_closed)) return false;
+    }
+
+    if(loop_closed) {
+      loop_end = pc;
+      return true;
+    }
+
+    pc += size;
+  }
+
+  return false;
+}
+
+auto IdleLoopDetector::AnalyzeThumb(u32 address, u16 instruction, u32 loop_start, bool& loop_closed) -> bool {
+  // THUMB.1 - THUMB.4: shifts, add/subtract, immediate operations and ALU operations
+  if((instruction & 0xE000) == 0x0000 ||
+     (instruction & 0xE000) == 0x2000 ||
+     (instruction & 0xFC00) == 0x4000) {
+    return true;
+  }
+
+  // THUMB.5: high register operations (BX is not allowed)
+  if((instruction & 0xFC00) == 0x4400) {
+    int op = (instruction >> 8) & 3;
+    int dst = (instruction & 7) | ((instruction >> 4) & 8);
+
+    return op != 3 && (op == 1 || dst != 15);
+  }
+
+  // THUMB.6: PC-relative load
+  if((instruction & 0xF800) == 0x4800) {
+    return true;
+  }
+
+  // THUMB.7, THUMB.8: load/store with register offset
+  if((instruction & 0xF000) == 0x5000) {
+    if(instruction & (1 << 9)) {
+      return (instruction & 0x0C00) != 0;
+    }
+    return instruction & (1 << 11);
+  }
+
+  // THUMB.9 - THUMB.11: load/store with immediate offset, SP-relative load/store
+  if((instruction & 0xE000) == 0x6000 ||
+     (instruction & 0xF000) == 0x8000 ||
+     (instruction & 0xF000) == 0x9000) {
+    return instruction & (1 << 11);
+  }
+
+  // THUMB.12, THUMB.13: get relative address, add offset to SP
+  if((instruction & 0xF000) == 0xA000 || (instruction & 0xFF00) == 0xB000) {
+    return true;
+  }
+
+  // THUMB.16: conditional branch (condition 0xE is undefined, 0xF is SWI)
+  if((instruction & 0xF000) == 0xD000 && (instruction & 0x0E00) != 0x0E00) {
+    u32 target = address + 4 + (s32)((s8)(instruction & 0xFF) * 2);
+
+    loop_closed = target == loop_start;
+    return true;
+  }
+
+  // THUMB.18: unconditional branch
+  if((instruction & 0xF800) == 0xE000) {
+    u32 target = address + 4 + (((s32)((u32)instruction << 21)) >> 20);
+
+    loop_closed = target == loop_start;
+    return loop_closed;
+  }
+
+  return false;
+}
+
+auto IdleLoopDetector::AnalyzeARM(u32 address, u32 instruction, u32 loop_start, bool& loop_closed) -> bool {
+  const int condition = instruction >> 28;
+  const int dst = (instruction >> 12) & 15;
+
+  if(condition == 0xF) {
+    return false;
+  }
+
+  // Branch (but not branch with link)
+  if((instruction & 0x0F000000) == 0x0A000000) {
+    u32 target = address + 8 + (((s32)(instruction << 8)) >> 6);
+
+    loop_closed = target == loop_start;
+    return loop_closed || condition != 0xE;
+  }
+
+  // Branch and exchange, single data swap, MSR
+  if((instruction & 0x0FFFFFF0) == 0x012FFF10 ||
+     (instruction & 0x0FB00FF0) == 0x01000090 ||
+     (instruction & 0x0DB0F000) == 0x0120F000) {
+    return false;
+  }
+
+  // Multiply and multiply long
+  if((instruction & 0x0FC000F0) == 0x00000090 ||
+     (instruction & 0x0F8000F0) == 0x00800090) {
+    return ((instruction >> 16) & 15) != 15;
+  }
+
+  // Halfword and signed data transfer
+  if((instruction & 0x0E000090) == 0x00000090) {
+    return (instruction & (1 << 20)) && dst != 15;
+  }
+
+  // MRS
+  if((instruction & 0x0FBF0FFF) == 0x010F0000) {
+    return dst != 15;
+  }
+
+  // Data processing
+  if((instruction & 0x0C000000) == 0x00000000) {
+    int opcode = (instruction >> 21) & 15;
+
+    // TST, TEQ, CMP and CMN do not write a result.
+    return (opcode >= 8 && opcode <= 11) || dst != 15;
+  }
+
+  // Single data transfer
+  if((instruction & 0x0C000000) == 0x04000000) {
+    if((instruction & 0x02000010) == 0x02000010) {
+      return false;
+    }
+    return (instruction & (1 << 20)) && dst != 15;
+  }
+
+  return false;
+}
+
+auto IdleLoopDetector::GetLoadAddress(u32 address, bool thumb, u32& load_address) -> bool {
+  u32 instruction;
+
+  if(!ReadCode(address, thumb ? sizeof(u16) : sizeof(u32), instruction)) {
+    return false;
+  }
+
+  auto& reg = cpu.state.reg;
+
+  if(thumb) {
+    const u32 base = reg[(instruction >> 3) & 7];
+
+    // THUMB.7, THUMB.8: load/store with register offset
+    if((instruction & 0xF000) == 0x5000) {
+      load_address = base + reg[(instruction >> 6) & 7];
+      return true;
+    }
+
+    // THUMB.9: load/store with immediate offset
+    if((instruction & 0xE000) == 0x6000) {
+      const u32 offset = (instruction >> 6) & 31;
+
+      load_address = base + ((instruction & (1 << 12)) ? offset : offset * 4);
+      return true;
+    }
+
+    // THUMB.10: load/store halfword
+    if((instruction & 0xF000) == 0x8000) {
+      load_address = base + ((instruction >> 6) & 31) * 2;
+      return true;
+    }
+
+    // THUMB.11: SP-relative load/store
+    if((instruction & 0xF000) == 0x9000) {
+      load_address = reg[13] + (instruction & 0xFF) * 4;
+      return true;
+    }
+
+    return false;
+  }
+
+  // The base register reads as the address of the instruction plus eight, which r15 holds already.
+  const u32 base = reg[(instruction >> 16) & 15];
+  const bool pre_index = instruction & (1 << 24);
+  const bool add = instruction & (1 << 23);
+
+  u32 offset;
+
+  if((instruction & 0x0E000090) == 0x00000090 && (instruction & 0x60) != 0) {
+    // Halfword and signed data transfer
+    if(instruction & (1 << 22)) {
+      offset = ((instruction >> 4) & 0xF0) | (instruction & 0xF);
+    } else {
+      offset = reg[instruction & 15];
+    }
+  } else if((instruction & 0x0C000000) == 0x04000000) {
+    // Single data transfer (the analysis rejects register-specified shift amounts)
+    if(instruction & (1 << 25)) {
+      const u32 value = reg[instruction & 15];
+      const int amount = (instruction >> 7) & 31;
+
+      switch((instruction >> 5) & 3) {
+        case 0: offset = value << amount; break;
+        case 1: offset = amount == 0 ? 0 : (value >> amount); break;
+        case 2: offset = (u32)((s32)value >> (amount == 0 ? 31 : amount)); break;
+        default: {
+          // RRX depends on the carry flag, so its result is not known here.
+          if(amount == 0) return false;
+          offset = (value >> amount) | (value << (32 - amount));
+          break;
+        }
+      }
+    } else {
+      offset = instruction & 0xFFF;
+    }
+  } else {
+    return false;
+  }
+
+  if(pre_index) {
+    load_address = add ? base + offset : base - offset;
+  } else {
+    load_address = base;
+  }
+  return true;
+}
+
+/**
+ * Returns false for loads from I/O registers which may change between two scheduler events,
+ * for example the timer counters, which are derived from the current timestamp.
+ * Loads from memory and from registers that are only updated by events are fine.
+ */
+bool IdleLoopDetector::IsEventDrivenLoad(u32 address) {
+  if((address >> 24) != 0x04) {
+    return true;
+  }
+
+  return (address >= DISPCNT && address < BG0CNT) ||
+         (address >= SOUNDCNT_X && address < SOUNDBIAS) ||
+         (address >= DMA0SAD && address < TM0CNT_L) ||
+         (address >= KEYINPUT && address < RCNT) ||
+         (address >= IE && address < WAITCNT) ||
+         (address >= IME && address < IME + 4);
+}
+
+auto IdleLoopDetector::ReadCode(u32 address, int size, u32& instruction) -> bool {
+  u8* data;
+  u32 offset;
+  size_t length;
+
+  switch(address >> 24) {
+    case 0x02: {
+      data = bus.memory.wram.data();
+      offset = address & 0x3FFFF;
+      length = bus.memory.wram.size();
+      break;
+    }
+    case 0x03: {
+      data = bus.memory.iram.data();
+      offset = address & 0x7FFF;
+      length = bus.memory.iram.size();
+      break;
+    }
+    case 0x08 ... 0x0D: {
+      auto& rom = bus.memory.rom.GetRawROM();
+      data = rom.data();
+      offset = address & 0x1FFFFFF;
+      length = rom.size();
+      break;
+    }
+    default: {
+      return false;
+    }
+  }
+
+  if(offset + size > length) {
+    return false;
+  }
+
+  if(size == sizeof(u16)) {
+    instruction = read<u16>(data, offset);
+  } else {
+    instruction = read<u32>(data, offset);
+  }
+
+  return true;
+}
+
+auto IdleLoopDetector::GetRegisters() -> Registers {
+  Registers registers;
+
+  cpu.MaterializeFlags();
+
+  for(int i = 0; i < 16; i++) {
+    registers[i] = cpu.state.reg[i];
+  }
+  registers[16] = cpu.state.cpsr.v;
+
+  return registers;
+}
+
+} // namespace nba::core::arm
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <array>
+#include <nba/integer.hpp>
+
+#include "arm/arm7tdmi.hpp"
+#include "bus/bus.hpp"
+
+namespace nba::core::arm {
+
+/**
+ * Detects loops in which the CPU only waits for a change in hardware state,
+ * for example by polling VCOUNT, DISPSTAT or a flag in RAM.
+ *
+ * A loop is a candidate if it is closed by a short backward branch and its body
+ * only loads from memory and computes on registers. Such a loop is idle once
+ * two consecutive iterations begin with identical register state: until the
+ * next scheduler event fires, every further iteration will be identical too.
+ * This does not hold for loops that load from I/O registers which change without
+ * a scheduler event (like the timer counters), so these loops are rejected.
+ */
+struct IdleLoopDetector {
+  IdleLoopDetector(ARM7TDMI& cpu, Bus& bus) : cpu(cpu), bus(bus) {
+    Reset();
+  }
+
+  void Reset() {
+    last_pc = 0xFFFFFFFF;
+    rejected_pc = 0xFFFFFFFF;
+    loop = {};
+    override_skipped = false;
+  }
+
+  /**
+   * Sets the address of a known idle loop, which is treated as idle
+   * without analysis. Pass 0xFFFFFFFF to disable the override.
+   */
+  void SetOverrideAddress(u32 address) {
+    override_address = address;
+  }
+
+  /**
+   * Whether the CPU currently executes a candidate loop.
+   * The loop must then be run one instruction at a time,
+   * so that every pass through the loop can be observed.
+   */
+  bool IsWatching() const {
+    return loop.active;
+  }
+
+  /**
+   * Must be called before each instruction or block that the CPU executes.
+   * Returns true if the CPU is spinning in an idle loop and the
+   * emulated time may be advanced to the next scheduler event.
+   */
+  bool Update();
+
+private:
+  static constexpr int kMaxLoopLength = 16;
+
+  using Registers = std::array<u32, 17>;
+
+  auto Analyze(u32 address, bool thumb, u32& loop_end) -> bool;
+  auto AnalyzeThumb(u32 address, u16 instruction, u32 loop_start, bool& loop_closed) -> bool;
+  auto AnalyzeARM(u32 address, u32 instruction, u32 loop_start, bool& loop_closed) -> bool;
+  auto GetLoadAddress(u32 address, bool thumb, u32& load_address) -> bool;
+  auto ReadCode(u32 address, int size, u32& instruction) -> bool;
+  auto GetRegisters() -> Registers;
+
+  static bool IsEventDrivenLoad(u32 address);
+
+  ARM7TDMI& cpu;
+  Bus& bus;
+
+  u32 last_pc;
+  u32 rejected_pc;
+  u32 override_address = 0xFFFFFFFF;
+  bool override_skipped;
+
+  struct Loop {
+    bool active = false;
+    bool thumb = false;
+    u32 start = 0;
+    u32 end = 0;
+    bool have_registers = false;
+    Registers registers{};
+  } loop;
+};
+
+} // namespace nba::core::arm
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include "arm/jit/compiler.hpp"
+
+namespace nba::core::arm {
+
+using namespace x64;
+
+void JITCompiler::CompileARMDataProcessing(u32 address, u32 instruction) {
+  using DataOp = ARM7TDMI::DataOp;
+
+  const bool immediate = instruction & (1 << 25);
+  const auto opcode = static_cast<DataOp>((instruction >> 21) & 0xF);
+  const bool set_flags = instruction & (1 << 20);
+  const int reg_op1 = (instruction >> 16) & 0xF;
+  const int reg_dst = (instruction >> 12) & 0xF;
+  const u32 r15 = address + 8;
+
+  const bool logical = opcode == DataOp::AND || opcode == DataOp::EOR ||
+                       opcode == DataOp::TST || opcode == DataOp::TEQ ||
+                       opcode == DataOp::ORR || opcode == DataOp::MOV ||
+                       opcode == DataOp::BIC || opcode == DataOp::MVN;
+
+  const bool compare = opcode == DataOp::TST || opcode == DataOp::TEQ ||
+                       opcode == DataOp::CMP || opcode == DataOp::CMN;
+
+  // The carry out of the shifter is either known at compile time or in R10B.
+  bool update_carry = false;
+  int carry = -1;
+
+  // Second operand in ECX
+  if(immediate) {
+    const u32 value = instruction & 0xFF;
+    const int shift = ((instruction >> 8) & 0xF) * 2;
+
+    if(shift != 0) {
+      const u32 op2 = (value >> shift) | (value << (32 - shift));
+
+      code.MovRegImm(RCX, op2);
+      update_carry = true;
+      carry = op2 >> 31;
+    } else {
+      code.MovRegImm(RCX, value);
+    }
+  } else {
+    EmitLoadGuestReg(RCX, instruction & 0xF, r15);
+    update_carry = EmitShiftImm((instruction >> 5) & 3, (instruction >> 7) & 0x1F, logical && set_flags);
+  }
+
+  // First operand and result in EAX
+  if(opcode != DataOp::MOV && opcode != DataOp::MVN) {
+    EmitLoadGuestReg(RAX, reg_op1, r15);
+  }
+
+  x64::Condition carry_condition = CC_B;
+
+  switch(opcode) {
+    case DataOp::AND:
+    case DataOp::TST: {
+      code.Alu(AluOp::AND, RAX, RCX);
+      break;
+    }
+    case DataOp::EOR:
+    case DataOp::TEQ: {
+      code.Alu(AluOp::XOR, RAX, RCX);
+      break;
+    }
+    case DataOp::ORR: {
+      code.Alu(AluOp::OR, RAX, RCX);
+      break;
+    }
+    case DataOp::BIC: {
+      code.Not(RCX);
+      code.Alu(AluOp::AND, RAX, RCX);
+      break;
+    }
+    case DataOp::MOV: {
+      code.MovRegReg(RAX, RCX);
+      break;
+    }
+    case DataOp::MVN: {
+      code.MovRegReg(RAX, RCX);
+      code.Not(RAX);
+      break;
+    }
+    case DataOp::ADD:
+    case DataOp::CMN: {
+      code.Alu(AluOp::ADD, RAX, RCX);
+      break;
+    }
+    case DataOp::SUB:
+    case DataOp::CMP: {
+      code.Alu(AluOp::SUB, RAX, RCX);
+      carry_condition = CC_AE;
+      break;
+    }
+    case DataOp::RSB: {
+      code.Alu(AluOp::SUB, RCX, RAX);
+      code.MovRegReg(RAX, RCX);
+      carry_condition = CC_AE;
+      break;
+    }
+    case DataOp::ADC: {
+      code.BtMemImm(CPSR(), 29);
+      code.Alu(AluOp::ADC, RAX, RCX);
+      break;
+    }
+    // The host borrow is the inverted ARM carry.
+    case DataOp::SBC: {
+      code.BtMemImm(CPSR(), 29);
+      code.Cmc();
+      code.Alu(AluOp::SBB, RAX, RCX);
+      carry_condition = CC_AE;
+      break;
+    }
+    case DataOp::RSC: {
+      code.BtMemImm(CPSR(), 29);
+      code.Cmc();
+      code.Alu(AluOp::SBB, RCX, RAX);
+      code.MovRegReg(RAX, RCX);
+      carry_condition = CC_AE;
+      break;
+    }
+  }
+
+  if(set_flags) {
+    if(logical) {
+      if(carry != -1) {
+        code.MovRegImm(R10, carry);
+      }
+      code.TestRegReg(RAX, RAX);
+      EmitSetLogicalFlags(update_carry);
+    } else {
+      EmitSetArithmeticFlags(carry_condition);
+    }
+  }
+
+  if(!compare) {
+    code.MovMemReg(GuestReg(reg_dst), RAX);
+  }
+
+  EmitAdvance(address + 12, true);
+}
+
+void JITCompiler::CompileARMSingleDataTransfer(u32 address, u32 instruction) {
+  const bool immediate = !(instruction & (1 << 25));
+  const bool pre = instruction & (1 << 24);
+  const bool add = instruction & (1 << 23);
+  const bool byte = instruction & (1 << 22);
+  const bool writeback = (instruction & (1 << 21)) || !pre;
+  const bool load = instruction & (1 << 20);
+  const int reg_base = (instruction >> 16) & 0xF;
+  const int reg_dst = (instruction >> 12) & 0xF;
+
+  if(immediate) {
+    code.MovRegImm(RCX, instruction & 0xFFF);
+  } else {
+    EmitLoadGuestReg(RCX, instruction & 0xF, address + 8);
+    EmitShiftImm((instruction >> 5) & 3, (instruction >> 7) & 0x1F, false);
+  }
+
+  // Stores read the source register after r15 has been incremented.
+  if(!load) {
+    EmitLoadGuestReg(R11, reg_dst, address + 12);
+  }
+
+  EmitTransferAddress(reg_base, address + 8, pre, add, writeback);
+  EmitAdvance(address + 12, false);
+
+  if(load) {
+    EmitTransfer(byte ? Transfer::LoadByte : Transfer::LoadWordRotate, reg_dst);
+  } else {
+    EmitTransfer(byte ? Transfer::StoreByte : Transfer::StoreWord, reg_dst);
+  }
+}
+
+void JITCompiler::CompileARMHalfwordTransfer(u32 address, u32 instruction) {
+  const bool pre = instruction & (1 << 24);
+  const bool add = instruction & (1 << 23);
+  const bool immediate = instruction & (1 << 22);
+  const bool writeback = (instruction & (1 << 21)) || !pre;
+  const bool load = instruction & (1 << 20);
+  const int reg_base = (instruction >> 16) & 0xF;
+  const int reg_dst = (instruction >> 12) & 0xF;
+  const int opcode = (instruction >> 5) & 3;
+
+  if(immediate) {
+    code.MovRegImm(RCX, (instruction & 0xF) | ((instruction >> 4) & 0xF0));
+  } else {
+    EmitLoadGuestReg(RCX, instruction & 0xF, address + 8);
+  }
+
+  if(!load) {
+    EmitLoadGuestReg(R11, reg_dst, address + 12);
+  }
+
+  EmitTransferAddress(reg_base, address + 8, pre, add, writeback);
+  EmitAdvance(address + 12, false);
+
+  switch(opcode) {
+    case 1: EmitTransfer(load ? Transfer::LoadHalfRotate : Transfer::StoreHalf, reg_dst); break;
+    case 2: EmitTransfer(Transfer::LoadByteSigned, reg_dst); break;
+    case 3: EmitTransfer(Transfer::LoadHalfSigned, reg_dst); break;
+  }
+}
+
+void JITCompiler::CompileARMBranch(u32 address, u32 instruction) {
+  const bool link = instruction & (1 << 24);
+
+  u32 offset = instruction & 0xFFFFFF;
+
+  if(offset & 0x800000) {
+    offset |= 0xFF000000;
+  }
+
+  if(link) {
+    code.MovMemImm(GuestReg(14), address + 4);
+  }
+
+  const u32 target = address + 8 + offset * 4;
+
+  code.MovMemImm(GuestReg(15), target);
+  EmitCall((void const*)&ReloadPipeline32);
+  EmitBranchExit(target);
+}
+
+/**
+ * Computes the address of a load or store from the base register and the offset in ECX into R10D.
+ * The base register is written back right away, loads and stores do not depend on it.
+ */
+void JITCompiler::EmitTransferAddress(int reg_base, u32 r15, bool pre, bool add, bool writeback) {
+  EmitLoadGuestReg(RAX, reg_base, r15);
+  code.MovRegReg(RDX, RAX);
+  code.Alu(add ? AluOp::ADD : AluOp::SUB, RDX, RCX);
+  code.MovRegReg(R10, pre ? RDX : RAX);
+
+  if(writeback) {
+    code.MovMemReg(GuestReg(reg_base), RDX);
+  }
+}
+
+} // namespace nba::core::arm
+
+#endif
@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include "arm/jit/compiler.hpp"
+
+namespace nba::core::arm {
+
+using namespace x64;
+
+bool JITCompiler::CompileThumbNative(u32 address, u16 instruction) {
+  // THUMB.1 Move shifted register
+  if((instruction & 0xF800) < 0x1800) {
+    const int dst = (instruction >> 0) & 7;
+    const int src = (instruction >> 3) & 7;
+
+    EmitMaterializeFlags();
+    code.MovRegMem(RCX, GuestReg(src));
+
+    const bool update_carry = EmitShiftImm((instruction >> 11) & 3, (instruction >> 6) & 0x1F, true);
+
+    code.TestRegReg(RCX, RCX);
+    EmitSetLogicalFlags(update_carry);
+    code.MovMemReg(GuestReg(dst), RCX);
+    EmitAdvance(address + 6, true);
+    return true;
+  }
+
+  // THUMB.2 Add/subtract
+  if((instruction & 0xF800) == 0x1800) {
+    const int dst = (instruction >> 0) & 7;
+    const int src = (instruction >> 3) & 7;
+    const int field3 = (instruction >> 6) & 7;
+    const bool immediate = instruction & (1 << 10);
+    const bool subtract = instruction & (1 << 9);
+
+    EmitMaterializeFlags();
+    code.MovRegMem(RAX, GuestReg(src));
+
+    if(immediate) {
+      code.MovRegImm(RCX, field3);
+    } else {
+      code.MovRegMem(RCX, GuestReg(field3));
+    }
+
+    code.Alu(subtract ? AluOp::SUB : AluOp::ADD, RAX, RCX);
+    EmitSetArithmeticFlags(subtract ? CC_AE : CC_B);
+    code.MovMemReg(GuestReg(dst), RAX);
+    EmitAdvance(address + 6, true);
+    return true;
+  }
+
+  // THUMB.3 Move/compare/add/subtract immediate
+  if((instruction & 0xE000) == 0x2000) {
+    const int opcode = (instruction >> 11) & 3;
+    const int dst = (instruction >> 8) & 7;
+    const u32 imm = instruction & 0xFF;
+
+    EmitMaterializeFlags();
+
+    switch(opcode) {
+      case 0b00: {
+        code.MovRegImm(RAX, imm);
+        code.TestRegReg(RAX, RAX);
+        EmitSetLogicalFlags(false);
+        break;
+      }
+      case 0b01: {
+        code.MovRegMem(RAX, GuestReg(dst));
+        code.AluImm(AluOp::CMP, RAX, imm);
+        EmitSetArithmeticFlags(CC_AE);
+        break;
+      }
+      case 0b10: {
+        code.MovRegMem(RAX, GuestReg(dst));
+        code.AluImm(AluOp::ADD, RAX, imm);
+        EmitSetArithmeticFlags(CC_B);
+        break;
+      }
+      case 0b11: {
+        code.MovRegMem(RAX, GuestReg(dst));
+        code.AluImm(AluOp::SUB, RAX, imm);
+        EmitSetArithmeticFlags(CC_AE);
+        break;
+      }
+    }
+
+    if(opcode != 0b01) {
+      code.MovMemReg(GuestReg(dst), RAX);
+    }
+
+    EmitAdvance(address + 6, true);
+    return true;
+  }
+
+  // THUMB.4 ALU operations
+  if((instruction & 0xFC00) == 0x4000) {
+    return CompileThumbALU(address, instruction);
+  }
+
+  // THUMB.5 Hi register operations/branch exchange
+  if((instruction & 0xFC00) == 0x4400) {
+    return CompileThumbHighRegisterOps(address, instruction);
+  }
+
+  // THUMB.12 Load address
+  if((instruction & 0xF000) == 0xA000) {
+    const int dst = (instruction >> 8) & 7;
+    const u32 offset = (instruction & 0xFF) << 2;
+
+    if(instruction & (1 << 11)) {
+      code.MovRegMem(RAX, GuestReg(13));
+      code.AluImm(AluOp::ADD, RAX, offset);
+      code.MovMemReg(GuestReg(dst), RAX);
+    } else {
+      code.MovMemImm(GuestReg(dst), ((address + 4) & ~2) + offset);
+    }
+
+    EmitAdvance(address + 6, true);
+    return true;
+  }
+
+  // THUMB.13 Add offset to stack pointer
+  if((instruction & 0xFF00) == 0xB000) {
+    const u32 offset = (instruction & 0x7F) * 4;
+
+    code.AluMemImm((instruction & (1 << 7)) ? AluOp::SUB : AluOp::ADD, GuestReg(13), offset);
+    EmitAdvance(address + 6, true);
+    return true;
+  }
+
+  if(CompileThumbTransfer(address, instruction)) {
+    return true;
+  }
+
+  return CompileThumbBranch(address, instruction);
+}
+
+bool JITCompiler::CompileThumbALU(u32 address, u16 instruction) {
+  using ThumbDataOp = ARM7TDMI::ThumbDataOp;
+
+  const int dst = (instruction >> 0) & 7;
+  const int src = (instruction >> 3) & 7;
+  const auto opcode = static_cast<ThumbDataOp>((instruction >> 6) & 0xF);
+
+  // Shifts by register and MUL take internal cycles.
+  switch(opcode) {
+    case ThumbDataOp::LSL:
+    case ThumbDataOp::LSR:
+    case ThumbDataOp::ASR:
+    case ThumbDataOp::ROR:
+    case ThumbDataOp::MUL: {
+      return false;
+    }
+    default: {
+      break;
+    }
+  }
+
+  EmitMaterializeFlags();
+  code.MovRegMem(RAX, GuestReg(dst));
+  code.MovRegMem(RCX, GuestReg(src));
+
+  bool logical = true;
+  bool store = true;
+
+  switch(opcode) {
+    case ThumbDataOp::AND: {
+      code.Alu(AluOp::AND, RAX, RCX);
+      break;
+    }
+    case ThumbDataOp::EOR: {
+      code.Alu(AluOp::XOR, RAX, RCX);
+      break;
+    }
+    case ThumbDataOp::ADC: {
+      code.BtMemImm(CPSR(), 29);
+      code.Alu(AluOp::ADC, RAX, RCX);
+      EmitSetArithmeticFlags(CC_B);
+      logical = false;
+      break;
+    }
+    case ThumbDataOp::SBC: {
+      code.BtMemImm(CPSR(), 29);
+      code.Cmc();
+      code.Alu(AluOp::SBB, RAX, RCX);
+      EmitSetArithmeticFlags(CC_AE);
+      logical = false;
+      break;
+    }
+    case ThumbDataOp::TST: {
+      code.Alu(AluOp::AND, RAX, RCX);
+      store = false;
+      break;
+    }
+    case ThumbDataOp::NEG: {
+      code.MovRegImm(RAX, 0);
+      code.Alu(AluOp::SUB, RAX, RCX);
+      EmitSetArithmeticFlags(CC_AE);
+      logical = false;
+      break;
+    }
+    case ThumbDataOp::CMP: {
+      code.Alu(AluOp::SUB, RAX, RCX);
+      EmitSetArithmeticFlags(CC_AE);
+      logical = false;
+      store = false;
+      break;
+    }
+    case ThumbDataOp::CMN: {
+      code.Alu(AluOp::ADD, RAX, RCX);
+      EmitSetArithmeticFlags(CC_B);
+      logical = false;
+      store = false;
+      break;
+    }
+    case ThumbDataOp::ORR: {
+      code.Alu(AluOp::OR, RAX, RCX);
+      break;
+    }
+    case ThumbDataOp::BIC: {
+      code.Not(RCX);
+      code.Alu(AluOp::AND, RAX, RCX);
+      break;
+    }
+    case ThumbDataOp::MVN: {
+      code.MovRegReg(RAX, RCX);
+      code.Not(RAX);
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+
+  if(logical) {
+    code.TestRegReg(RAX, RAX);
+    EmitSetLogicalFlags(false);
+  }
+
+  if(store) {
+    code.MovMemReg(GuestReg(dst), RAX);
+  }
+
+  EmitAdvance(address + 6, true);
+  return true;
+}
+
+bool JITCompiler::CompileThumbHighRegisterOps(u32 address, u16 instruction) {
+  const int opcode = (instruction >> 8) & 3;
+  const int dst = ((instruction >> 0) & 7) | ((instruction >> 4) & 8);
+  const int src = ((instruction >> 3) & 7) | ((instruction >> 3) & 8);
+  const u32 r15 = address + 4;
+
+  // BX and writes to r15 reload the pipeline.
+  if(opcode == 3 || (opcode != 1 && dst == 15)) {
+    return false;
+  }
+
+  if(opcode == 1) {
+    EmitMaterializeFlags();
+  }
+
+  EmitLoadGuestReg(RCX, src, r15);
+
+  switch(opcode) {
+    case 0: {
+      code.MovRegMem(RAX, GuestReg(dst));
+      code.Alu(AluOp::ADD, RAX, RCX);
+      code.MovMemReg(GuestReg(dst), RAX);
+      break;
+    }
+    case 1: {
+      EmitLoadGuestReg(RAX, dst, r15);
+      code.Alu(AluOp::SUB, RAX, RCX);
+      EmitSetArithmeticFlags(CC_AE);
+      break;
+    }
+    case 2: {
+      code.MovMemReg(GuestReg(dst), RCX);
+      break;
+    }
+  }
+
+  EmitAdvance(address + 6, true);
+  return true;
+}
+
+bool JITCompiler::CompileThumbTransfer(u32 address, u16 instruction) {
+  const int base = (instruction >> 3) & 7;
+
+  // The address goes to R10D.
+  Transfer transfer;
+  int dst = (instruction >> 0) & 7;
+
+  // THUMB.6 PC-relative load
+  if((instruction & 0xF800) == 0x4800) {
+    transfer = Transfer::LoadWord;
+    dst = (instruction >> 8) & 7;
+
+    code.MovRegImm(R10, ((address + 4) & ~2) + ((instruction & 0xFF) << 2));
+  }
+
+  // THUMB.7 Load/store with register offset
+  // THUMB.8 Load/store sign-extended byte/halfword
+  else if((instruction & 0xF000) == 0x5000) {
+    static constexpr Transfer kTransfers[2][4] {
+      { Transfer::StoreWord, Transfer::StoreByte, Transfer::LoadWordRotate, Transfer::LoadByte },
+      { Transfer::StoreHalf, Transfer::LoadByteSigned, Transfer::LoadHalfRotate, Transfer::LoadHalfSigned }
+    };
+
+    transfer = kTransfers[(instruction >> 9) & 1][(instruction >> 10) & 3];
+
+    code.MovRegMem(R10, GuestReg(base));
+    code.MovRegMem(RAX, GuestReg((instruction >> 6) & 7));
+    code.Alu(AluOp::ADD, R10, RAX);
+  }
+
+  // THUMB.9 Load store with immediate offset
+  else if((instruction & 0xE000) == 0x6000) {
+    const int opcode = (instruction >> 11) & 3;
+    const u32 imm = (instruction >> 6) & 0x1F;
+
+    static constexpr Transfer kTransfers[4] {
+      Transfer::StoreWord, Transfer::LoadWordRotate, Transfer::StoreByte, Transfer::LoadByte
+    };
+
+    transfer = kTransfers[opcode];
+
+    code.MovRegMem(R10, GuestReg(base));
+    code.AluImm(AluOp::ADD, R10, (opcode & 2) ? imm : imm * 4);
+  }
+
+  // THUMB.10 Load/store halfword
+  else if((instruction & 0xF000) == 0x8000) {
+    transfer = (instruction & (1 << 11)) ? Transfer::LoadHalfRotate : Transfer::StoreHalf;
+
+    code.MovRegMem(R10, GuestReg(base));
+    code.AluImm(AluOp::ADD, R10, ((instruction >> 6) & 0x1F) * 2);
+  }
+
+  // THUMB.11 SP-relative load/store
+  else if((instruction & 0xF000) == 0x9000) {
+    transfer = (instruction & (1 << 11)) ? Transfer::LoadWordRotate : Transfer::StoreWord;
+    dst = (instruction >> 8) & 7;
+
+    code.MovRegMem(R10, GuestReg(13));
+    code.AluImm(AluOp::ADD, R10, (instruction & 0xFF) * 4);
+  }
+
+  else {
+    return false;
+  }
+
+  // Stores write the value in R11D.
+  switch(transfer) {
+    case Transfer::StoreWord:
+    case Transfer::StoreHalf:
+    case Transfer::StoreByte: {
+      code.MovRegMem(R11, GuestReg(dst));
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+
+  EmitAdvance(address + 6, false);
+  EmitTransfer(transfer, dst);
+  return true;
+}
+
+bool JITCompiler::CompileThumbBranch(u32 address, u16 instruction) {
+  // THUMB.16 Conditional branch (except for the undefined condition 14)
+  if((instruction & 0xF000) == 0xD000 && (instruction & 0xF00) < 0xE00) {
+    u32 imm = instruction & 0xFF;
+
+    if(imm & 0x80) {
+      imm |= 0xFFFFFF00;
+    }
+
+    EmitMaterializeFlags();
+
+    auto skip = EmitConditionCheck((instruction >> 8) & 0xF);
+
+    const u32 target = address + 4 + imm * 2;
+
+    code.MovMemImm(GuestReg(15), target);
+    EmitCall((void const*)&ReloadPipeline16);
+    EmitBranchExit(target);
+
+    code.Bind(skip);
+    EmitAdvance(address + 6, true);
+    return true;
+  }
+
+  // THUMB.18 Unconditional branch
+  if((instruction & 0xF800) == 0xE000) {
+    u32 imm = (instruction & 0x3FF) * 2;
+
+    if(instruction & 0x400) {
+      imm |= 0xFFFFF800;
+    }
+
+    const u32 target = address + 4 + imm;
+
+    code.MovMemImm(GuestReg(15), target);
+    EmitCall((void const*)&ReloadPipeline16);
+    EmitBranchExit(target);
+    return true;
+  }
+
+  // THUMB.19 Long branch with link
+  if((instruction & 0xF000) == 0xF000) {
+    u32 imm = instruction & 0x7FF;
+
+    if(!(instruction & (1 << 11))) {
+      imm <<= 12;
+      if(imm & 0x400000) {
+        imm |= 0xFF800000;
+      }
+      code.MovMemImm(GuestReg(14), address + 4 + imm);
+      EmitAdvance(address + 6, true);
+    } else {
+      code.MovRegMem(RAX, GuestReg(14));
+      code.AluImm(AluOp::ADD, RAX, imm * 2);
+      code.AluImm(AluOp::AND, RAX, ~1U);
+      code.MovMemReg(GuestReg(15), RAX);
+      code.MovMemImm(GuestReg(14), (address + 2) | 1);
+      EmitCall((void const*)&ReloadPipeline16);
+      exits.push_back(code.Jmp());
+    }
+    return true;
+  }
+
+  return false;
+}
+
+} // namespace nba::core::arm
+
+#endif
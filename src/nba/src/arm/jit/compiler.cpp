@@ -0,0 +1,572 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <cstring>
+
+#include "arm/jit/compiler.hpp"
+
+namespace nba::core::arm {
+
+using namespace x64;
+
+#ifdef _WIN32
+  static constexpr Reg kArg0 = RCX;
+  static constexpr Reg kArg1 = RDX;
+  static constexpr Reg kArg2 = R8;
+#else
+  static constexpr Reg kArg0 = RDI;
+  static constexpr Reg kArg1 = RSI;
+  static constexpr Reg kArg2 = RDX;
+#endif
+
+JITCompiler::JITCompiler(ARM7TDMI& cpu, Emitter& code) : cpu(cpu), code(code) {
+}
+
+bool JITCompiler::CompileBlock(u32 address, bool thumb, JIT::Block& block) {
+  using BlockCache = ARM7TDMI::BlockCache;
+
+  const u32 size = thumb ? sizeof(u16) : sizeof(u32);
+  const u32 page_end = (address & ~(BlockCache::kPageSize - 1)) + BlockCache::kPageSize;
+
+  auto function = code.GetCurrent();
+
+  code.Push(RBX);
+#ifdef _WIN32
+  code.AluReg64Imm(AluOp::SUB, RSP, 32); // shadow space
+#endif
+  code.MovReg64Reg64(RBX, kArg0);
+
+  block_address = address;
+  block_thumb = thumb;
+
+  u32 pc = address;
+  int length = 0;
+  bool proceed = true;
+
+  while(proceed && length < kMaxBlockLength && pc + size <= page_end) {
+    auto host_address = cpu.bus.GetHostAddress<u8>(BlockCache::GetCanonicalAddress(pc), size);
+
+    if(host_address == nullptr) {
+      break;
+    }
+
+    u32 instruction = 0;
+
+    if(thumb) {
+      u16 half;
+      std::memcpy(&half, host_address, sizeof(half));
+      instruction = half;
+    } else {
+      std::memcpy(&instruction, host_address, sizeof(instruction));
+    }
+
+    // The dispatcher checks the first instruction against the pipeline.
+    if(length == 0) {
+      block.opcode = instruction;
+      block_opcode = instruction;
+      EmitCall(thumb ? (void const*)&Fetch<true> : (void const*)&Fetch<false>);
+      block_entry = code.GetCurrent();
+    } else {
+      code.MovRegImm(kArg1, instruction);
+      EmitCall(thumb ? (void const*)&Step<true> : (void const*)&Step<false>);
+      EmitExitIfZero();
+    }
+
+    if(thumb) {
+      proceed = CompileThumb(pc, (u16)instruction);
+    } else {
+      proceed = CompileARM(pc, instruction);
+    }
+
+    pc += size;
+    length++;
+  }
+
+  if(length == 0) {
+    return false;
+  }
+
+  for(auto exit : exits) {
+    code.Bind(exit);
+  }
+
+#ifdef _WIN32
+  code.AluReg64Imm(AluOp::ADD, RSP, 32);
+#endif
+  code.Pop(RBX);
+  code.Ret();
+
+  if(code.Overflowed()) {
+    return false;
+  }
+
+  block.function = (JIT::Function)function;
+  block.size = (u16)(length * size);
+  block.thumb = thumb;
+  block.address = address;
+  return true;
+}
+
+bool JITCompiler::CompileARM(u32 address, u32 instruction) {
+  const int condition = instruction >> 28;
+  const int reg_dst = (instruction >> 12) & 0xF;
+  const int reg_base = (instruction >> 16) & 0xF;
+  const bool set_flags = instruction & (1 << 20);
+  const bool load = instruction & (1 << 20);
+  const bool writeback = (instruction & (1 << 21)) || !(instruction & (1 << 24));
+
+  bool reads_flags = condition != COND_AL;
+  bool writes_flags = false;
+
+  enum class Form {
+    None,
+    DataProcessing,
+    SingleDataTransfer,
+    HalfwordTransfer,
+    Branch
+  } form = Form::None;
+
+  switch((instruction >> 25) & 7) {
+    case 0b000:
+    case 0b001: {
+      const bool immediate = instruction & (1 << 25);
+      const int opcode = (instruction >> 21) & 0xF;
+
+      if(!immediate && (instruction & 0x90) == 0x90) {
+        // Halfword and signed transfers, except for the ARMv5 LDRD and STRD opcodes.
+        const int kind = (instruction >> 5) & 3;
+
+        if(kind != 0 && (load || kind == 1) && !(load && reg_dst == 15) && !(writeback && reg_base == 15)) {
+          form = Form::HalfwordTransfer;
+        }
+        break;
+      }
+
+      // Data processing with an immediate or a register shifted by an immediate, except for PSR transfers.
+      if((immediate || !(instruction & 0x10)) && (set_flags || opcode < 8 || opcode > 11) && reg_dst != 15) {
+        const int shift_type = (instruction >> 5) & 3;
+        const int shift_amount = (instruction >> 7) & 0x1F;
+
+        form = Form::DataProcessing;
+        writes_flags = set_flags;
+        reads_flags |= set_flags ||
+          opcode == 5 || opcode == 6 || opcode == 7 || // ADC, SBC, RSC
+          (!immediate && shift_type == 3 && shift_amount == 0); // RRX
+      }
+      break;
+    }
+    case 0b010:
+    case 0b011: {
+      const bool immediate = !(instruction & (1 << 25));
+
+      if((immediate || !(instruction & 0x10)) && !(load && reg_dst == 15) && !(writeback && reg_base == 15)) {
+        form = Form::SingleDataTransfer;
+        reads_flags |= !immediate && (instruction & 0xFE0) == 0x060; // RRX
+      }
+      break;
+    }
+    case 0b101: {
+      form = Form::Branch;
+      break;
+    }
+  }
+
+  if(form == Form::None || condition == COND_NV) {
+    CallHandlerARM(address, instruction);
+
+    // Returns and other writes to r15 end the block if they are not conditional.
+    if(condition == COND_AL) {
+      const bool is_bx = (instruction & 0x0FFFFFF0) == 0x012FFF10;
+      const bool is_swi = (instruction & 0x0F000000) == 0x0F000000;
+      const bool is_ldm_pc = (instruction & 0x0E108000) == 0x08108000;
+
+      return !is_bx && !is_swi && !is_ldm_pc;
+    }
+    return true;
+  }
+
+  if(reads_flags || writes_flags) {
+    EmitMaterializeFlags();
+  }
+
+  u8* skip = nullptr;
+
+  if(condition != COND_AL) {
+    skip = EmitConditionCheck(condition);
+  }
+
+  switch(form) {
+    case Form::DataProcessing: CompileARMDataProcessing(address, instruction); break;
+    case Form::SingleDataTransfer: CompileARMSingleDataTransfer(address, instruction); break;
+    case Form::HalfwordTransfer: CompileARMHalfwordTransfer(address, instruction); break;
+    case Form::Branch: CompileARMBranch(address, instruction); break;
+    default: break;
+  }
+
+  if(skip != nullptr) {
+    auto done = code.Jmp();
+    code.Bind(skip);
+    EmitAdvance(address + 12, true);
+    code.Bind(done);
+    return true;
+  }
+
+  return form != Form::Branch;
+}
+
+bool JITCompiler::CompileThumb(u32 address, u16 instruction) {
+  if(CompileThumbNative(address, instruction)) {
+    // Only branches end the block, the conditional branch continues if it is not taken.
+    if((instruction & 0xF000) == 0xD000) {
+      return true;
+    }
+    return (instruction & 0xF800) != 0xE000 && (instruction & 0xF800) != 0xF800;
+  }
+
+  CallHandlerThumb(address, instruction);
+
+  const bool is_bx = (instruction & 0xFF00) == 0x4700;
+  const bool is_pop_pc = (instruction & 0xFF00) == 0xBD00;
+  const bool is_swi = (instruction & 0xFF00) == 0xDF00;
+
+  return !is_bx && !is_pop_pc && !is_swi;
+}
+
+void JITCompiler::CallHandlerARM(u32 address, u32 instruction) {
+  code.MovRegImm(kArg1, instruction);
+  code.MovRegImm(kArg2, address + 12);
+  EmitCall((void const*)&CallARM);
+  EmitExitIfZero();
+
+  flags_materialized = false;
+}
+
+void JITCompiler::CallHandlerThumb(u32 address, u16 instruction) {
+  code.MovRegImm(kArg1, instruction);
+  code.MovRegImm(kArg2, address + 6);
+  EmitCall((void const*)&CallThumb);
+  EmitExitIfZero();
+
+  flags_materialized = false;
+}
+
+auto JITCompiler::GuestReg(int id) const -> Mem {
+  return {RBX, (s32)((u8 const*)&cpu.state.reg[id] - (u8 const*)&cpu)};
+}
+
+auto JITCompiler::CPSR() const -> Mem {
+  return {RBX, (s32)((u8 const*)&cpu.state.cpsr - (u8 const*)&cpu)};
+}
+
+auto JITCompiler::PipeAccess() const -> Mem {
+  return {RBX, (s32)((u8 const*)&cpu.pipe.access - (u8 const*)&cpu)};
+}
+
+void JITCompiler::EmitCall(void const* function) {
+  code.MovReg64Reg64(kArg0, RBX);
+  code.Call(function);
+}
+
+void JITCompiler::EmitExitIfZero() {
+  code.TestRegReg8(RAX, RAX);
+  exits.push_back(code.Jcc(CC_E));
+}
+
+void JITCompiler::EmitMaterializeFlags() {
+#ifdef NBA_ARM_LAZY_FLAGS
+  if(!flags_materialized) {
+    EmitCall((void const*)&MaterializeFlags);
+    flags_materialized = true;
+  }
+#endif
+}
+
+/**
+ * Looks the condition up in the same table as the interpreter.
+ * Returns the jump which is taken if the condition is false.
+ */
+auto JITCompiler::EmitConditionCheck(int condition) -> u8* {
+  code.MovRegMem(RAX, CPSR());
+  code.Shift(ShiftOp::SHR, RAX, 28);
+  code.MovReg64Imm(RCX, (u64)&ARM7TDMI::s_condition_lut[condition << 4]);
+  code.AluReg64Reg64(AluOp::ADD, RCX, RAX);
+  code.MovzxRegMem8(RAX, {RCX, 0});
+  code.TestRegReg(RAX, RAX);
+  return code.Jcc(CC_E);
+}
+
+// Reading r15 returns the address of the instruction plus 8 (ARM) or 4 (Thumb), which is known at compile time.
+void JITCompiler::EmitLoadGuestReg(Reg dst, int id, u32 r15) {
+  if(id == 15) {
+    code.MovRegImm(dst, r15);
+  } else {
+    code.MovRegMem(dst, GuestReg(id));
+  }
+}
+
+/**
+ * Shifts ECX by an immediate like the barrel shifter does (LSR #0, ASR #0 and ROR #0 encode LSR #32, ASR #32 and RRX).
+ * If carry_out is set, the carry out is written to R10B. Returns false if the shift leaves the carry unchanged (LSL #0).
+ */
+bool JITCompiler::EmitShiftImm(int type, int amount, bool carry_out) {
+  switch(type) {
+    case 0: {
+      if(amount == 0) {
+        return false;
+      }
+      code.Shift(ShiftOp::SHL, RCX, amount);
+      break;
+    }
+    case 1: {
+      if(amount == 0) {
+        if(carry_out) {
+          code.BtImm(RCX, 31);
+          code.Setcc(CC_B, R10);
+        }
+        code.Alu(AluOp::XOR, RCX, RCX);
+        return true;
+      }
+      code.Shift(ShiftOp::SHR, RCX, amount);
+      break;
+    }
+    case 2: {
+      if(amount == 0) {
+        code.Shift(ShiftOp::SAR, RCX, 31);
+        code.BtImm(RCX, 0);
+      } else {
+        code.Shift(ShiftOp::SAR, RCX, amount);
+      }
+      break;
+    }
+    case 3: {
+      if(amount == 0) {
+        code.BtMemImm(CPSR(), 29);
+        code.Shift(ShiftOp::RCR, RCX, 1);
+      } else {
+        code.Shift(ShiftOp::ROR, RCX, amount);
+      }
+      break;
+    }
+  }
+
+  if(carry_out) {
+    code.Setcc(CC_B, R10);
+  }
+  return true;
+}
+
+// Sets N and Z from the host flags and, if update_carry is set, C from R10B.
+void JITCompiler::EmitSetLogicalFlags(bool update_carry) {
+  code.Setcc(CC_S, R8);
+  code.Setcc(CC_E, R9);
+  EmitWriteFlags(update_carry ? 0xE0000000 : 0xC0000000);
+}
+
+// Sets N, Z, C and V from the host flags. The carry is CC_B for additions and CC_AE for subtractions.
+void JITCompiler::EmitSetArithmeticFlags(x64::Condition carry) {
+  code.Setcc(CC_S, R8);
+  code.Setcc(CC_E, R9);
+  code.Setcc(carry, R10);
+  code.Setcc(CC_O, R11);
+  EmitWriteFlags(0xF0000000);
+}
+
+// Writes the flags in R8B (N), R9B (Z), R10B (C) and R11B (V) selected by the mask to the CPSR.
+void JITCompiler::EmitWriteFlags(u32 mask) {
+  code.MovzxRegReg8(R8, R8);
+  code.Shift(ShiftOp::SHL, R8, 31);
+  code.MovzxRegReg8(R9, R9);
+  code.Shift(ShiftOp::SHL, R9, 30);
+  code.Alu(AluOp::OR, R8, R9);
+
+  if(mask & (1 << 29)) {
+    code.MovzxRegReg8(R10, R10);
+    code.Shift(ShiftOp::SHL, R10, 29);
+    code.Alu(AluOp::OR, R8, R10);
+  }
+
+  if(mask & (1 << 28)) {
+    code.MovzxRegReg8(R11, R11);
+    code.Shift(ShiftOp::SHL, R11, 28);
+    code.Alu(AluOp::OR, R8, R11);
+  }
+
+  code.MovRegMem(RDX, CPSR());
+  code.AluImm(AluOp::AND, RDX, ~mask);
+  code.Alu(AluOp::OR, RDX, R8);
+  code.MovMemReg(CPSR(), RDX);
+}
+
+void JITCompiler::EmitAdvance(u32 r15, bool sequential) {
+  code.MovMemImm(PipeAccess(), Access::Code | (sequential ? Access::Sequential : Access::Nonsequential));
+  code.MovMemImm(GuestReg(15), r15);
+}
+
+/**
+ * Ends the block after a taken branch. A branch to the start of the block continues there
+ * if Step() allows it, which makes the same checks as the dispatcher.
+ */
+void JITCompiler::EmitBranchExit(u32 target) {
+  if(target == block_address) {
+    code.MovRegImm(kArg1, block_opcode);
+    EmitCall(block_thumb ? (void const*)&Step<true> : (void const*)&Step<false>);
+    EmitExitIfZero();
+    code.Jmp(block_entry);
+  } else {
+    exits.push_back(code.Jmp());
+  }
+}
+
+// Calls the bus for a transfer at the address in R10D. Stores write the value in R11D.
+void JITCompiler::EmitTransfer(Transfer transfer, int reg_dst) {
+  void const* function = nullptr;
+  bool load = true;
+
+  switch(transfer) {
+    case Transfer::LoadWord:       function = (void const*)&LoadWord; break;
+    case Transfer::LoadWordRotate: function = (void const*)&LoadWordRotate; break;
+    case Transfer::LoadHalfRotate: function = (void const*)&LoadHalfRotate; break;
+    case Transfer::LoadHalfSigned: function = (void const*)&LoadHalfSigned; break;
+    case Transfer::LoadByte:       function = (void const*)&LoadByte; break;
+    case Transfer::LoadByteSigned: function = (void const*)&LoadByteSigned; break;
+    case Transfer::StoreWord:      function = (void const*)&StoreWord; load = false; break;
+    case Transfer::StoreHalf:      function = (void const*)&StoreHalf; load = false; break;
+    case Transfer::StoreByte:      function = (void const*)&StoreByte; load = false; break;
+  }
+
+  code.MovRegReg(kArg1, R10);
+
+  if(!load) {
+    code.MovRegReg(kArg2, R11);
+  }
+
+  EmitCall(function);
+
+  if(load) {
+    code.MovMemReg(GuestReg(reg_dst), RAX);
+  }
+}
+
+template<bool thumb>
+ALWAYS_INLINE void JITCompiler::Fetch(ARM7TDMI* cpu) {
+  cpu->latch_irq_disable = cpu->state.cpsr.f.mask_irq;
+  cpu->pipe.opcode[0] = cpu->pipe.opcode[1];
+
+  if constexpr(thumb) {
+    cpu->pipe.opcode[1] = cpu->bus.ReadCode<u16>(cpu->state.r15, cpu->pipe.access);
+  } else {
+    cpu->pipe.opcode[1] = cpu->bus.ReadCode<u32>(cpu->state.r15, cpu->pipe.access);
+  }
+}
+
+/**
+ * Fetches the next instruction, unless the block must return to the dispatcher.
+ * The dispatcher then runs the instruction or handles the IRQ.
+ */
+template<bool thumb>
+bool JITCompiler::Step(ARM7TDMI* cpu, u32 opcode) {
+  if(cpu->scheduler.GetTimestampNow() >= cpu->jit.timestamp_limit ||
+     cpu->bus.hw.haltcnt != Bus::Hardware::HaltControl::Run ||
+     (cpu->irq_line && !cpu->latch_irq_disable) ||
+     cpu->pipe.opcode[0] != opcode) {
+    return false;
+  }
+
+  Fetch<thumb>(cpu);
+  return true;
+}
+
+/**
+ * Runs an instruction through the interpreter. Returns true if execution
+ * continues with the next instruction and the register file is still accessed directly.
+ */
+bool JITCompiler::CallARM(ARM7TDMI* cpu, u32 instruction, u32 r15_next) {
+  if(cpu->CheckCondition(static_cast<arm::Condition>(instruction >> 28))) {
+    int hash = ((instruction >> 16) & 0xFF0) |
+               ((instruction >>  4) & 0x00F);
+    (cpu->*ARM7TDMI::s_opcode_lut_32[hash])(instruction);
+  } else {
+    cpu->pipe.access = Access::Code | Access::Sequential;
+    cpu->state.r15 += 4;
+  }
+
+  return cpu->state.r15 == r15_next && !cpu->state.cpsr.f.thumb &&
+        !cpu->ldm_usermode_conflict && !cpu->cpu_mode_is_invalid;
+}
+
+bool JITCompiler::CallThumb(ARM7TDMI* cpu, u32 instruction, u32 r15_next) {
+  (cpu->*ARM7TDMI::s_opcode_lut_16[instruction >> 6])((u16)instruction);
+
+  return cpu->state.r15 == r15_next && cpu->state.cpsr.f.thumb &&
+        !cpu->ldm_usermode_conflict && !cpu->cpu_mode_is_invalid;
+}
+
+void JITCompiler::MaterializeFlags(ARM7TDMI* cpu) {
+  cpu->MaterializeFlags();
+}
+
+void JITCompiler::ReloadPipeline16(ARM7TDMI* cpu) {
+  cpu->ReloadPipeline16();
+}
+
+void JITCompiler::ReloadPipeline32(ARM7TDMI* cpu) {
+  cpu->ReloadPipeline32();
+}
+
+auto JITCompiler::LoadWord(ARM7TDMI* cpu, u32 address) -> u32 {
+  u32 value = cpu->ReadWord(address, Access::Nonsequential);
+  cpu->bus.Idle();
+  return value;
+}
+
+auto JITCompiler::LoadWordRotate(ARM7TDMI* cpu, u32 address) -> u32 {
+  u32 value = cpu->ReadWordRotate(address, Access::Nonsequential);
+  cpu->bus.Idle();
+  return value;
+}
+
+auto JITCompiler::LoadHalfRotate(ARM7TDMI* cpu, u32 address) -> u32 {
+  u32 value = cpu->ReadHalfRotate(address, Access::Nonsequential);
+  cpu->bus.Idle();
+  return value;
+}
+
+auto JITCompiler::LoadHalfSigned(ARM7TDMI* cpu, u32 address) -> u32 {
+  u32 value = cpu->ReadHalfSigned(address, Access::Nonsequential);
+  cpu->bus.Idle();
+  return value;
+}
+
+auto JITCompiler::LoadByte(ARM7TDMI* cpu, u32 address) -> u32 {
+  u32 value = cpu->ReadByte(address, Access::Nonsequential);
+  cpu->bus.Idle();
+  return value;
+}
+
+auto JITCompiler::LoadByteSigned(ARM7TDMI* cpu, u32 address) -> u32 {
+  u32 value = cpu->ReadByteSigned(address, Access::Nonsequential);
+  cpu->bus.Idle();
+  return value;
+}
+
+void JITCompiler::StoreWord(ARM7TDMI* cpu, u32 address, u32 value) {
+  cpu->WriteWord(address, value, Access::Nonsequential);
+}
+
+void JITCompiler::StoreHalf(ARM7TDMI* cpu, u32 address, u32 value) {
+  cpu->WriteHalf(address, (u16)value, Access::Nonsequential);
+}
+
+void JITCompiler::StoreByte(ARM7TDMI* cpu, u32 address, u32 value) {
+  cpu->WriteByte(address, (u8)value, Access::Nonsequential);
+}
+
+} // namespace nba::core::arm
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "arm/jit/jit.hpp"
+#include "arm/jit/x64_emitter.hpp"
+#include "arm/arm7tdmi.hpp"
+
+namespace nba::core::arm {
+
+/**
+ * Translates one basic block to x86-64 code.
+ *
+ * Guest registers and the CPSR are not cached in host registers, every instruction
+ * loads its operands from and stores its result to the register file (pointed to by RBX).
+ * Before each instruction the compiled code calls Step(), which does the same
+ * prefetch as the interpreter and returns to the dispatcher if the timestamp limit
+ * has been reached, the CPU has been halted through HALTCNT, an IRQ is pending
+ * or the prefetched opcode differs from the compiled one. Memory accesses call into the bus.
+ * Instructions without a native translation call their interpreter handler,
+ * after which the block is left unless execution continues with the next instruction.
+ */
+struct JITCompiler {
+  JITCompiler(ARM7TDMI& cpu, x64::Emitter& code);
+
+  /**
+   * Compiles the block at the given address into the emitter's buffer.
+   * Returns false if nothing could be compiled or the buffer is full.
+   */
+  bool CompileBlock(u32 address, bool thumb, JIT::Block& block);
+
+private:
+  using Access = Bus::Access;
+
+  static constexpr int kMaxBlockLength = 64;
+
+  enum class Transfer {
+    LoadWord,
+    LoadWordRotate,
+    LoadHalfRotate,
+    LoadHalfSigned,
+    LoadByte,
+    LoadByteSigned,
+    StoreWord,
+    StoreHalf,
+    StoreByte
+  };
+
+  // Each of these returns false if the block must end after the instruction.
+  bool CompileARM(u32 address, u32 instruction);
+  bool CompileThumb(u32 address, u16 instruction);
+
+  // Native translations, see compile_arm.cpp and compile_thumb.cpp
+  void CompileARMDataProcessing(u32 address, u32 instruction);
+  void CompileARMSingleDataTransfer(u32 address, u32 instruction);
+  void CompileARMHalfwordTransfer(u32 address, u32 instruction);
+  void CompileARMBranch(u32 address, u32 instruction);
+
+  // These return false if the instruction has no native translation.
+  bool CompileThumbNative(u32 address, u16 instruction);
+  bool CompileThumbALU(u32 address, u16 instruction);
+  bool CompileThumbHighRegisterOps(u32 address, u16 instruction);
+  bool CompileThumbTransfer(u32 address, u16 instruction);
+  bool CompileThumbBranch(u32 address, u16 instruction);
+
+  void CallHandlerARM(u32 address, u32 instruction);
+  void CallHandlerThumb(u32 address, u16 instruction);
+
+  auto GuestReg(int id) const -> x64::Mem;
+  auto CPSR() const -> x64::Mem;
+  auto PipeAccess() const -> x64::Mem;
+
+  void EmitCall(void const* function);
+  void EmitExitIfZero();
+  void EmitMaterializeFlags();
+  auto EmitConditionCheck(int condition) -> u8*;
+  void EmitLoadGuestReg(x64::Reg dst, int id, u32 r15);
+  bool EmitShiftImm(int type, int amount, bool carry_out);
+  void EmitSetLogicalFlags(bool update_carry);
+  void EmitSetArithmeticFlags(x64::Condition carry);
+  void EmitWriteFlags(u32 mask);
+  void EmitAdvance(u32 r15, bool sequential);
+  void EmitBranchExit(u32 target);
+  void EmitTransferAddress(int reg_base, u32 r15, bool pre, bool add, bool writeback);
+  void EmitTransfer(Transfer transfer, int reg_dst);
+
+  // Called from compiled code:
+  template<bool thumb> static void Fetch(ARM7TDMI* cpu);
+  template<bool thumb> static bool Step(ARM7TDMI* cpu, u32 opcode);
+  static bool CallARM(ARM7TDMI* cpu, u32 instruction, u32 r15_next);
+  static bool CallThumb(ARM7TDMI* cpu, u32 instruction, u32 r15_next);
+  static void MaterializeFlags(ARM7TDMI* cpu);
+  static void ReloadPipeline16(ARM7TDMI* cpu);
+  static void ReloadPipeline32(ARM7TDMI* cpu);
+  static auto LoadWord(ARM7TDMI* cpu, u32 address) -> u32;
+  static auto LoadWordRotate(ARM7TDMI* cpu, u32 address) -> u32;
+  static auto LoadHalfRotate(ARM7TDMI* cpu, u32 address) -> u32;
+  static auto LoadHalfSigned(ARM7TDMI* cpu, u32 address) -> u32;
+  static auto LoadByte(ARM7TDMI* cpu, u32 address) -> u32;
+  static auto LoadByteSigned(ARM7TDMI* cpu, u32 address) -> u32;
+  static void StoreWord(ARM7TDMI* cpu, u32 address, u32 value);
+  static void StoreHalf(ARM7TDMI* cpu, u32 address, u32 value);
+  static void StoreByte(ARM7TDMI* cpu, u32 address, u32 value);
+
+  ARM7TDMI& cpu;
+  x64::Emitter& code;
+
+  // Jumps to the end of the block, which returns to the dispatcher.
+  std::vector<u8*> exits;
+
+  // Branches to the start of the block continue at its first instruction.
+  u32 block_address = 0;
+  u32 block_opcode = 0;
+  bool block_thumb = false;
+  u8* block_entry = nullptr;
+
+  // Whether lazily evaluated flags are known to be in the CPSR.
+  bool flags_materialized = false;
+};
+
+} // namespace nba::core::arm
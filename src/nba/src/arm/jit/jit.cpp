@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <algorithm>
+#include <nba/log.hpp>
+
+#include "arm/jit/jit.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #define NBA_ARM_JIT_X64
+
+  #include "arm/jit/compiler.hpp"
+
+  #ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+  #else
+    #include <sys/mman.h>
+  #endif
+#endif
+
+namespace nba::core::arm {
+
+JIT::~JIT() {
+#ifdef NBA_ARM_JIT_X64
+  if(buffer != nullptr) {
+  #ifdef _WIN32
+    VirtualFree(buffer, 0, MEM_RELEASE);
+  #else
+    munmap(buffer, kBufferSize);
+  #endif
+  }
+#endif
+}
+
+auto JIT::Compile([[maybe_unused]] ARM7TDMI& cpu, [[maybe_unused]] u32 address, [[maybe_unused]] bool thumb) -> Block {
+  Block block;
+
+#ifdef NBA_ARM_JIT_X64
+  if(buffer == nullptr && !Allocate()) {
+    return block;
+  }
+
+  // The first page may still hold the end of the previous block.
+  const size_t begin = used & ~(kHostPageSize - 1);
+  const size_t end = std::min(used + kMaxBlockSize + kHostPageSize - 1, kBufferSize) & ~(kHostPageSize - 1);
+
+  const bool writable = Protect(begin, end, false);
+
+  Assert(writable, "JIT: failed to make the code buffer writable.");
+
+  x64::Emitter code{buffer + used, end - used};
+
+  if(JITCompiler{cpu, code}.CompileBlock(address, thumb, block)) {
+    used = code.GetCurrent() - buffer;
+  } else {
+    block.function = nullptr;
+
+    // The block did not fit, flush before compiling the next one.
+    if(code.Overflowed()) {
+      used = kBufferSize;
+    }
+  }
+
+  const bool executable = Protect(begin, end, true);
+
+  Assert(executable, "JIT: failed to make the code buffer executable.");
+#endif
+
+  return block;
+}
+
+#ifdef NBA_ARM_JIT_X64
+
+bool JIT::Allocate() {
+  if(allocation_failed) {
+    return false;
+  }
+
+#ifdef _WIN32
+  buffer = (u8*)VirtualAlloc(nullptr, kBufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+  void* memory = mmap(nullptr, kBufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if(memory != MAP_FAILED) {
+    buffer = (u8*)memory;
+  }
+#endif
+
+  // Some systems do not allow making memory executable at all.
+  if(buffer != nullptr && !Protect(0, kBufferSize, true)) {
+#ifdef _WIN32
+    VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+    munmap(buffer, kBufferSize);
+#endif
+    buffer = nullptr;
+  }
+
+  if(buffer == nullptr) {
+    Log<Warn>("JIT: failed to allocate executable memory, falling back to the interpreter");
+    allocation_failed = true;
+    return false;
+  }
+
+  return true;
+}
+
+bool JIT::Protect(size_t begin, size_t end, bool executable) {
+#ifdef _WIN32
+  DWORD old_protect;
+
+  return VirtualProtect(buffer + begin, end - begin, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old_protect);
+#else
+  return mprotect(buffer + begin, end - begin, executable ? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE)) == 0;
+#endif
+}
+
+#endif
+
+} // namespace nba::core::arm
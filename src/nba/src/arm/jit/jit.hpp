@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <nba/integer.hpp>
+
+namespace nba::core::arm {
+
+struct ARM7TDMI;
+
+/**
+ * Recompiles basic blocks of ARM and Thumb code to x86-64 machine code.
+ * Compiled code performs the same bus accesses in the same order as the interpreter,
+ * so timing is unchanged. Instructions which are not translated to native code
+ * call their interpreter handler. On other hosts nothing is compiled
+ * and the CPU falls back to the interpreter.
+ *
+ * The code buffer is only allocated once the first block is compiled.
+ * It is never writable and executable at the same time: the pages which a block
+ * is emitted into are writable while the block is compiled and executable afterwards.
+ */
+struct JIT {
+  using Function = void (*)(ARM7TDMI*);
+
+  struct Block {
+    Function function = nullptr;
+    u32 address = 0; // mirrors of a page share their block cache entries
+    u32 opcode = 0; // first instruction, as it was in memory when it was compiled
+    u16 size = 0;   // in bytes
+    bool thumb = false;
+  };
+
+ ~JIT();
+
+  /**
+   * Compiles the block starting at the given address.
+   * The function of the result is nullptr if the block could not be compiled.
+   */
+  auto Compile(ARM7TDMI& cpu, u32 address, bool thumb) -> Block;
+
+  /**
+   * Whether the code buffer must be flushed before the next block can be compiled.
+   */
+  bool IsFull() const {
+    return buffer != nullptr && kBufferSize - used < kMaxBlockSize;
+  }
+
+  /**
+   * Discards all compiled code. Must not be called while a block is running.
+   */
+  void Flush() {
+    used = 0;
+  }
+
+  // Compiled code returns once this timestamp has been reached.
+  u64 timestamp_limit = 0;
+
+private:
+  static constexpr size_t kBufferSize = 32 * 1024 * 1024;
+  static constexpr size_t kMaxBlockSize = 64 * 1024;
+  static constexpr size_t kHostPageSize = 4096;
+
+  bool Allocate();
+  bool Protect(size_t begin, size_t end, bool executable);
+
+  u8* buffer = nullptr;
+  size_t used = 0;
+  bool allocation_failed = false;
+};
+
+} // namespace nba::core::arm
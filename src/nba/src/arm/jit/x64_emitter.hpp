@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <nba/integer.hpp>
+
+namespace nba::core::arm::x64 {
+
+enum Reg : u8 {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8,  R9,  R10, R11, R12, R13, R14, R15
+};
+
+enum Condition : u8 {
+  CC_O  = 0x0,
+  CC_NO = 0x1,
+  CC_B  = 0x2, // carry set
+  CC_AE = 0x3, // carry clear
+  CC_E  = 0x4,
+  CC_NE = 0x5,
+  CC_BE = 0x6,
+  CC_A  = 0x7,
+  CC_S  = 0x8,
+  CC_NS = 0x9,
+  CC_P  = 0xA,
+  CC_NP = 0xB,
+  CC_L  = 0xC,
+  CC_GE = 0xD,
+  CC_LE = 0xE,
+  CC_G  = 0xF
+};
+
+enum class AluOp : u8 {
+  ADD = 0,
+  OR  = 1,
+  ADC = 2,
+  SBB = 3,
+  AND = 4,
+  SUB = 5,
+  XOR = 6,
+  CMP = 7
+};
+
+enum class ShiftOp : u8 {
+  ROL = 0,
+  ROR = 1,
+  RCL = 2,
+  RCR = 3,
+  SHL = 4,
+  SHR = 5,
+  SAR = 7
+};
+
+// A memory operand of the form [base + displacement].
+struct Mem {
+  Reg base;
+  s32 displacement;
+};
+
+/**
+ * Minimal x86-64 assembler for the instructions the recompiler emits.
+ * Operands are 32-bit unless the name of the method says otherwise.
+ * Memory operands always use a 32-bit displacement.
+ * Emitting past the end of the buffer does not write anything,
+ * but sets a flag which the caller must check with Overflowed().
+ */
+struct Emitter {
+  Emitter(u8* buffer, size_t size) : current(buffer), end(buffer + size) {}
+
+  auto GetCurrent() const -> u8* {
+    return current;
+  }
+
+  bool Overflowed() const {
+    return overflowed;
+  }
+
+  void MovRegMem(Reg dst, Mem src) {
+    Rex(false, dst, src.base);
+    Byte(0x8B);
+    ModRMMem(dst, src);
+  }
+
+  void MovMemReg(Mem dst, Reg src) {
+    Rex(false, src, dst.base);
+    Byte(0x89);
+    ModRMMem(src, dst);
+  }
+
+  void MovMemImm(Mem dst, u32 imm) {
+    Rex(false, 0, dst.base);
+    Byte(0xC7);
+    ModRMMem(0, dst);
+    Dword(imm);
+  }
+
+  void MovRegReg(Reg dst, Reg src) {
+    Rex(false, src, dst);
+    Byte(0x89);
+    ModRMReg(src, dst);
+  }
+
+  void MovRegImm(Reg dst, u32 imm) {
+    Rex(false, 0, dst);
+    Byte(0xB8 + (dst & 7));
+    Dword(imm);
+  }
+
+  void MovReg64Imm(Reg dst, u64 imm) {
+    Rex(true, 0, dst);
+    Byte(0xB8 + (dst & 7));
+    Qword(imm);
+  }
+
+  void MovReg64Reg64(Reg dst, Reg src) {
+    Rex(true, src, dst);
+    Byte(0x89);
+    ModRMReg(src, dst);
+  }
+
+  void MovzxRegReg8(Reg dst, Reg src) {
+    Rex(false, dst, src, src >= RSP);
+    Byte(0x0F);
+    Byte(0xB6);
+    ModRMReg(dst, src);
+  }
+
+  void MovzxRegMem8(Reg dst, Mem src) {
+    Rex(false, dst, src.base);
+    Byte(0x0F);
+    Byte(0xB6);
+    ModRMMem(dst, src);
+  }
+
+  void Alu(AluOp op, Reg dst, Reg src) {
+    Rex(false, src, dst);
+    Byte(((u8)op << 3) | 1);
+    ModRMReg(src, dst);
+  }
+
+  void AluImm(AluOp op, Reg dst, u32 imm) {
+    Rex(false, 0, dst);
+    Byte(0x81);
+    ModRMReg((u8)op, dst);
+    Dword(imm);
+  }
+
+  void AluMemImm(AluOp op, Mem dst, u32 imm) {
+    Rex(false, 0, dst.base);
+    Byte(0x81);
+    ModRMMem((u8)op, dst);
+    Dword(imm);
+  }
+
+  void AluReg64Reg64(AluOp op, Reg dst, Reg src) {
+    Rex(true, src, dst);
+    Byte(((u8)op << 3) | 1);
+    ModRMReg(src, dst);
+  }
+
+  void AluReg64Imm(AluOp op, Reg dst, u32 imm) {
+    Rex(true, 0, dst);
+    Byte(0x81);
+    ModRMReg((u8)op, dst);
+    Dword(imm);
+  }
+
+  void Not(Reg reg) {
+    Rex(false, 0, reg);
+    Byte(0xF7);
+    ModRMReg(2, reg);
+  }
+
+  void Shift(ShiftOp op, Reg reg, u8 amount) {
+    Rex(false, 0, reg);
+    Byte(0xC1);
+    ModRMReg((u8)op, reg);
+    Byte(amount);
+  }
+
+  void BtImm(Reg reg, u8 bit) {
+    Rex(false, 0, reg);
+    Byte(0x0F);
+    Byte(0xBA);
+    ModRMReg(4, reg);
+    Byte(bit);
+  }
+
+  void BtMemImm(Mem mem, u8 bit) {
+    Rex(false, 0, mem.base);
+    Byte(0x0F);
+    Byte(0xBA);
+    ModRMMem(4, mem);
+    Byte(bit);
+  }
+
+  void Cmc() {
+    Byte(0xF5);
+  }
+
+  void Setcc(Condition condition, Reg dst) {
+    Rex(false, 0, dst, dst >= RSP);
+    Byte(0x0F);
+    Byte(0x90 + condition);
+    ModRMReg(0, dst);
+  }
+
+  void TestRegReg(Reg a, Reg b) {
+    Rex(false, b, a);
+    Byte(0x85);
+    ModRMReg(b, a);
+  }
+
+  void TestRegReg8(Reg a, Reg b) {
+    Rex(false, b, a, a >= RSP || b >= RSP);
+    Byte(0x84);
+    ModRMReg(b, a);
+  }
+
+  void Push(Reg reg) {
+    Rex(false, 0, reg);
+    Byte(0x50 + (reg & 7));
+  }
+
+  void Pop(Reg reg) {
+    Rex(false, 0, reg);
+    Byte(0x58 + (reg & 7));
+  }
+
+  void Ret() {
+    Byte(0xC3);
+  }
+
+  void CallReg(Reg reg) {
+    Rex(false, 0, reg);
+    Byte(0xFF);
+    ModRMReg(2, reg);
+  }
+
+  // Calls a function at any address. Clobbers RAX.
+  void Call(void const* function) {
+    MovReg64Imm(RAX, (u64)function);
+    CallReg(RAX);
+  }
+
+  // Forward jumps return the location of their displacement, which Bind() patches.
+  auto Jcc(Condition condition) -> u8* {
+    Byte(0x0F);
+    Byte(0x80 + condition);
+    Dword(0);
+    return current - sizeof(u32);
+  }
+
+  auto Jmp() -> u8* {
+    Byte(0xE9);
+    Dword(0);
+    return current - sizeof(u32);
+  }
+
+  // Jumps back to a location which has already been emitted.
+  void Jmp(u8 const* target) {
+    Byte(0xE9);
+    Dword((u32)(s32)(target - (current + sizeof(u32))));
+  }
+
+  // Points a forward jump at the current location.
+  void Bind(u8* displacement) {
+    if(!overflowed) {
+      const s32 value = (s32)(current - (displacement + sizeof(u32)));
+
+      std::memcpy(displacement, &value, sizeof(value));
+    }
+  }
+
+private:
+  void Byte(u8 value) {
+    if(current < end) {
+      *current++ = value;
+    } else {
+      overflowed = true;
+    }
+  }
+
+  void Dword(u32 value) {
+    for(int i = 0; i < 4; i++) {
+      Byte((u8)(value >> (i * 8)));
+    }
+  }
+
+  void Qword(u64 value) {
+    Dword((u32)value);
+    Dword((u32)(value >> 32));
+  }
+
+  // Byte registers 4 to 7 are SPL, BPL, SIL and DIL only with a REX prefix (force).
+  void Rex(bool w, int reg, int rm, bool force = false) {
+    const u8 rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+
+    if(rex != 0x40 || force) {
+      Byte(rex);
+    }
+  }
+
+  void ModRMReg(int reg, int rm) {
+    Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+  }
+
+  void ModRMMem(int reg, Mem mem) {
+    Byte(0x80 | ((reg & 7) << 3) | (mem.base & 7));
+
+    // RSP and R12 as base register require a SIB byte.
+    if((mem.base & 7) == RSP) {
+      Byte(0x24);
+    }
+    Dword((u32)mem.displacement);
+  }
+
+  u8* current;
+  u8* end;
+  bool overflowed = false;
+};
+
+} // namespace nba::core::arm::x64
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <nba/common/compiler.hpp>
+#include <nba/integer.hpp>
+#include <type_traits>
+#include <vector>
+
+namespace nba::core::arm {
+
+/**
+ * Registry of functions which are called right before the CPU executes
+ * the instruction at a given address.
+ * Hooked addresses are marked in a bitmap with one bit per 256-byte page,
+ * which matches the page size of the block cache. The emulation loop only
+ * tests that bitmap while hooks are registered and only compares
+ * exact addresses inside of hooked pages.
+ */
+struct PCHooks {
+  static constexpr int kPageShift = 8;
+
+  PCHooks() {
+    pages.resize(kPageCount / 64);
+  }
+
+  bool Empty() const {
+    return hooks.empty();
+  }
+
+  /**
+   * Calls a member function of an object whenever the instruction at the
+   * given address is about to be executed. The member function may take the
+   * address as an argument. Returns an ID for Unregister().
+   */
+  template<auto method, class T>
+  auto Register(u32 address, T* object) -> int {
+    return Add({0, address, object, [](void* object, u32 address) {
+      if constexpr(std::is_invocable_v<decltype(method), T*, u32>) {
+        (((T*)object)->*method)(address);
+      } else {
+        (((T*)object)->*method)();
+      }
+    }, {}});
+  }
+
+  /**
+   * Calls a function whenever the instruction at the given address is about to be executed.
+   * Returns an ID for Unregister().
+   */
+  auto Register(u32 address, std::function<void(u32)> callback) -> int {
+    return Add({0, address, nullptr, nullptr, std::move(callback)});
+  }
+
+  void Unregister(int id) {
+    hooks.erase(std::remove_if(hooks.begin(), hooks.end(), [&](Hook const& hook) {
+      return hook.id == id;
+    }), hooks.end());
+
+    // Other hooks may still be located in the same pages.
+    std::fill(pages.begin(), pages.end(), 0);
+
+    for(auto const& hook : hooks) {
+      SetPageBit(hook.address);
+    }
+  }
+
+  bool ALWAYS_INLINE IsPageHooked(u32 address) const {
+    const u32 page = GetPageIndex(address);
+
+    return pages[page >> 6] & (1ULL << (page & 63));
+  }
+
+  /**
+   * Calls all hooks that are registered at the given address.
+   */
+  void Call(u32 address) {
+    for(auto const& hook : hooks) {
+      if(hook.address == address) {
+        if(hook.thunk) {
+          hook.thunk(hook.object, address);
+        } else {
+          hook.callback(address);
+        }
+      }
+    }
+  }
+
+private:
+  // The upper four address bits are not decoded by the GBA.
+  static constexpr int kPageCount = 0x10000000 >> kPageShift;
+
+  struct Hook {
+    int id;
+    u32 address;
+    void* object;
+    void (*thunk)(void*, u32);
+    std::function<void(u32)> callback;
+  };
+
+  auto Add(Hook&& hook) -> int {
+    const int id = next_id++;
+
+    hook.id = id;
+    SetPageBit(hook.address);
+    hooks.push_back(std::move(hook));
+    return id;
+  }
+
+  static auto GetPageIndex(u32 address) -> u32 {
+    return (address & 0x0FFFFFFF) >> kPageShift;
+  }
+
+  void SetPageBit(u32 address) {
+    const u32 page = GetPageIndex(address);
+
+    pages[page >> 6] |= 1ULL << (page & 63);
+  }
+
+  std::vector<Hook> hooks;
+  std::vector<u64> pages;
+  int next_id = 0;
+};
+
+} // namespace nba::core::arm
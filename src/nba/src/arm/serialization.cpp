@@ -22,9 +22,12 @@ void ARM7TDMI::LoadState(SaveState const& save_state) {
   }
 
   state.cpsr.v = save_state.arm.regs.cpsr;
+#ifdef NBA_ARM_LAZY_FLAGS
+  lazy_flags = {};
+#endif
 
   auto bank = GetRegisterBankByMode(state.cpsr.f.mode);
-  if(bank != BANK_NONE) {
+  if(bank != BANK_NONE && bank != BANK_INVALID) {
     p_spsr = &state.spsr[bank];
   } else {
     p_spsr = &state.cpsr;
@@ -38,13 +41,20 @@ void ARM7TDMI::LoadState(SaveState const& save_state) {
 
   irq_line = save_state.arm.irq_line;
 
+  cpu_mode_is_invalid = bank == BANK_INVALID;
+
   // TODO: save and restore these variables:
   ldm_usermode_conflict = false;
-  cpu_mode_is_invalid = false;
   latch_irq_disable = state.cpsr.f.mask_irq;
+
+  // Memory is restored without going through the bus.
+  block_cache.Reset();
+  jit.Flush();
 }
 
 void ARM7TDMI::CopyState(SaveState& save_state) {
+  MaterializeFlags();
+
   for(int i = 0; i < 16; i++) {
     save_state.arm.regs.gpr[i] = state.reg[i];
   }
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <nba/log.hpp>
+
+#include "arm/trace.hpp"
+
+namespace nba::core::arm {
+
+bool CPUTrace::Start(std::string const& path) {
+  const CPUTraceHeader header{};
+
+  codec = {};
+
+  if(!writer.Start(path, &header, sizeof(header))) {
+    Log<Error>("CPUTrace: failed to open '{}' for writing", path);
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace nba::core::arm
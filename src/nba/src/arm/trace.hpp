@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <nba/common/compiler.hpp>
+#include <nba/cpu_trace.hpp>
+#include <nba/integer.hpp>
+#include <string>
+
+#include "trace_writer.hpp"
+
+namespace nba::core::arm {
+
+/**
+ * Encodes retired instructions into a trace file, see nba/cpu_trace.hpp.
+ */
+struct CPUTrace {
+  bool Start(std::string const& path);
+
+  void Stop() {
+    writer.Stop();
+  }
+
+  bool ALWAYS_INLINE IsActive() const {
+    return writer.IsActive();
+  }
+
+  void ALWAYS_INLINE Record(u32 pc, u32 opcode, u32 cpsr, u64 cycles) {
+    u8 data[CPUTraceCodec::kMaxRecordSize];
+
+    const int size = codec.Encode({pc, opcode, cpsr, (u32)cycles}, data);
+
+    writer.Write(data, size);
+  }
+
+private:
+  CPUTraceCodec codec;
+  TraceWriter writer{0x400000};
+};
+
+} // namespace nba::core::arm
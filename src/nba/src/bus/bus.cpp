@@ -20,7 +20,7 @@ namespace nba::core {
 Bus::Bus(Scheduler& scheduler, Hardware&& hw)
     : scheduler(scheduler)
     , hw(hw) {
-  scheduler.Register(Scheduler::EventClass::SIO_transfer_done, this, &Bus::SIOTransferDone);
+  scheduler.Register<&Bus::SIOTransferDone>(Scheduler::EventClass::SIO_transfer_done, this);
 
   this->hw.bus = this;
   memory.bios.fill(0);
@@ -84,6 +84,23 @@ void Bus::WriteWord(u32 address, u32 value, int access) {
 
 template<typename T>
 auto Bus::Read(u32 address, int access) -> T {
+  if(!(access & (Dma | Lock)) && hw.dma.IsRunning()) hw.dma.Run();
+
+#ifdef NBA_BUS_TRACE
+  if(unlikely(trace.IsActive())) {
+    const u64 timestamp = scheduler.GetTimestampNow();
+    const T value = ReadMemory<T>(address, access);
+
+    trace.Record(timestamp, address, value, scheduler.GetTimestampNow() - timestamp, access, sizeof(T), false);
+    return value;
+  }
+#endif
+
+  return ReadMemory<T>(address, access);
+}
+
+template<typename T>
+auto ALWAYS_INLINE Bus::ReadMemory(u32 address, int access) -> T {
   auto page = address >> 24;
   auto is_u32 = std::is_same_v<T, u32>;
 
@@ -92,8 +109,6 @@ auto Bus::Read(u32 address, int access) -> T {
     last_access = access;
   }};
 
-  if(!(access & (Dma | Lock)) && hw.dma.IsRunning()) hw.dma.Run();
-
   parallel_internal_cpu_cycle_limit = 0;
 
   switch(page) {
@@ -184,26 +199,68 @@ auto Bus::Read(u32 address, int access) -> T {
   return 0;
 }
 
+template<typename T>
+auto Bus::ReadCodeSlow(u32 address, int access) -> T {
+  UpdateCodeRegion(address >> 24);
+
+  return Read<T>(address, access);
+}
+
+template auto Bus::ReadCodeSlow<u16>(u32 address, int access) -> u16;
+template auto Bus::ReadCodeSlow<u32>(u32 address, int access) -> u32;
+
 template<typename T>
 void Bus::Write(u32 address, int access, T value) {
+  if(!(access & (Dma | Lock)) && hw.dma.IsRunning()) hw.dma.Run();
+
+#ifdef NBA_BUS_TRACE
+  if(unlikely(trace.IsActive())) {
+    const u64 timestamp = scheduler.GetTimestampNow();
+
+    WriteMemory<T>(address, access, value);
+
+    trace.Record(timestamp, address, value, scheduler.GetTimestampNow() - timestamp, access, sizeof(T), true);
+    return;
+  }
+#endif
+
+  WriteMemory<T>(address, access, value);
+}
+
+template<typename T>
+void ALWAYS_INLINE Bus::WriteMemory(u32 address, int access, T value) {
   auto page = address >> 24;
   auto is_u32 = std::is_same_v<T, u32>;
 
-  if(!(access & (Dma | Lock)) && hw.dma.IsRunning()) hw.dma.Run();
-
   parallel_internal_cpu_cycle_limit = 0;
 
   switch(page) {
     // EWRAM (external work RAM)
     case 0x02: {
       Step(is_u32 ? 6 : 3);
-      write<T>(memory.wram.data(), Align<T>(address) & 0x3FFFF, value);
+      const u32 offset = Align<T>(address) & 0x3FFFF;
+      write<T>(memory.wram.data(), offset, value);
+      const u32 wram_page = GetWRAMPageIndex(page, offset);
+      if(unlikely(IsPageSet(memory.code_pages, wram_page))) {
+        hw.cpu.InvalidateCode(wram_page, offset, sizeof(T));
+      }
+      if(unlikely(IsPageSet(memory.watched_pages, wram_page))) {
+        CheckWatchpoints<T>(Align<T>(address), value);
+      }
       break;
     }
     // IWRAM (internal work RAM)
     case 0x03: {
       Step(1);
-      write<T>(memory.iram.data(), Align<T>(address) & 0x7FFF,  value);
+      const u32 offset = Align<T>(address) & 0x7FFF;
+      write<T>(memory.iram.data(), offset, value);
+      const u32 wram_page = GetWRAMPageIndex(page, offset);
+      if(unlikely(IsPageSet(memory.code_pages, wram_page))) {
+        hw.cpu.InvalidateCode(wram_page, offset, sizeof(T));
+      }
+      if(unlikely(IsPageSet(memory.watched_pages, wram_page))) {
+        CheckWatchpoints<T>(Align<T>(address), value);
+      }
       break;
     }
     // MMIO
@@ -211,7 +268,12 @@ void Bus::Write(u32 address, int access, T value) {
       Step(1);
       address = Align<T>(address);
       if(address >= DISPCNT && address <= BLDY) {
-        hw.ppu.Sync();
+        // Of the PPU registers only DISPCNT and MOSAIC are read by the sprite engine.
+        if(address < GREENSWAP || (address & ~3) == MOSAIC) {
+          hw.ppu.Sync();
+        } else {
+          hw.ppu.Sync(PPU::SYNC_BG);
+        }
       }
       if constexpr(std::is_same_v<T,  u8>) hw.WriteByte(address, value);
       if constexpr(std::is_same_v<T, u16>) hw.WriteHalf(address, value);
@@ -284,6 +346,60 @@ void Bus::Write(u32 address, int access, T value) {
   last_access = access;
 }
 
+template<typename T>
+void Bus::CheckWatchpoints(u32 address, T value) {
+  const u32 page = address >> 24;
+  const u32 offset = address & GetWRAMMask(page);
+
+  for(auto const& watchpoint : watchpoints) {
+    const u32 watch_page = watchpoint.address >> 24;
+    const u32 watch_offset = watchpoint.address & GetWRAMMask(watch_page);
+
+    if(watch_page == page && offset < watch_offset + watchpoint.size && watch_offset < offset + sizeof(T)) {
+      watchpoint.callback(address, sizeof(T), value, scheduler.GetTimestampNow());
+    }
+  }
+}
+
+auto Bus::AddWatchpoint(u32 address, u32 size, WatchpointCallback callback) -> int {
+  const u32 page = address >> 24;
+
+  if((page != 0x02 && page != 0x03) || size == 0 || (address & GetWRAMMask(page)) + size > GetWRAMMask(page) + 1) {
+    Log<Error>("Bus: cannot watch 0x{:08X} ({} bytes), only EWRAM and IWRAM can be watched", address, size);
+    return -1;
+  }
+
+  const int id = next_watchpoint_id++;
+
+  watchpoints.push_back({id, address, size, std::move(callback)});
+  UpdateWatchedPages();
+  return id;
+}
+
+void Bus::RemoveWatchpoint(int id) {
+  watchpoints.erase(std::remove_if(watchpoints.begin(), watchpoints.end(), [&](Watchpoint const& watchpoint) {
+    return watchpoint.id == id;
+  }), watchpoints.end());
+
+  UpdateWatchedPages();
+}
+
+void Bus::UpdateWatchedPages() {
+  memory.watched_pages.fill(0);
+
+  for(auto const& watchpoint : watchpoints) {
+    const u32 page = watchpoint.address >> 24;
+    const u32 offset = watchpoint.address & GetWRAMMask(page);
+
+    const u32 first = GetWRAMPageIndex(page, offset);
+    const u32 last = GetWRAMPageIndex(page, offset + watchpoint.size - 1);
+
+    for(u32 index = first; index <= last; index++) {
+      memory.watched_pages[index >> 6] |= 1ULL << (index & 63);
+    }
+  }
+}
+
 auto Bus::ReadBIOS(u32 address) -> u32 {
   if(address >= 0x4000) {
     return ReadOpenBus(address);
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <array>
+#include <functional>
 #include <nba/rom/rom.hpp>
 #include <nba/integer.hpp>
 #include <nba/save_state.hpp>
@@ -20,6 +21,10 @@
 #include "hw/keypad/keypad.hpp"
 #include "hw/timer/timer.hpp"
 
+#ifdef NBA_BUS_TRACE
+  #include "bus/trace.hpp"
+#endif
+
 namespace nba::core {
 
 namespace {
@@ -43,6 +48,71 @@ struct Bus {
   auto ReadHalf(u32 address, int access) -> u16;
   auto ReadWord(u32 address, int access) -> u32;
 
+  /**
+   * Instruction fetch path. Sequential fetches from the memory region that
+   * the previous fetch was from are served from the cached code region:
+   * work RAM is read from host memory and ROM fetches which are served by
+   * the prefetch buffer only update the buffer state. Everything else
+   * (branches, region changes, DMA or a prefetch buffer miss) goes through
+   * the generic path.
+   */
+  template<typename T>
+  auto ALWAYS_INLINE ReadCode(u32 address, int access) -> T {
+    constexpr bool is_u32 = std::is_same_v<T, u32>;
+
+#ifdef NBA_BUS_TRACE
+    // The generic path records the access.
+    if(unlikely(trace.IsActive())) {
+      return ReadCodeSlow<T>(address, access);
+    }
+#endif
+
+    if(likely((access & Sequential) && (address >> 24) == code_region.page &&
+              !(last_access & Dma) && !hw.dma.IsRunning())) {
+      if(code_region.kind == CodeRegion::Kind::WRAM) {
+        Step(is_u32 ? code_region.cycles32 : code_region.cycles16);
+        parallel_internal_cpu_cycle_limit = 0;
+        last_access = access;
+        return read<T>(code_region.data, Align<T>(address) & code_region.mask);
+      }
+
+      if(code_region.kind == CodeRegion::Kind::ROM) {
+        // Crossing a 128 KiB boundary forces a non-sequential access.
+        const bool sequential = (address & 0x1'FFFF) != 0;
+
+        if(prefetch.active) {
+          // Same as case #1 and case #2 in Prefetch()
+          if(prefetch.count != 0 && address == prefetch.head_address) {
+            prefetch.count--;
+            prefetch.head_address += prefetch.opcode_width;
+            Step(1);
+          } else if(prefetch.countdown > 0 && address == prefetch.last_address) {
+            Step(prefetch.countdown);
+            prefetch.head_address = prefetch.last_address;
+            prefetch.count = 0;
+          } else {
+            return ReadCodeSlow<T>(address, access);
+          }
+        } else if(sequential && !hw.waitcnt.prefetch && !hw.prefetch_buffer_was_disabled) {
+          Step(is_u32 ? code_region.cycles32 : code_region.cycles16);
+        } else {
+          return ReadCodeSlow<T>(address, access);
+        }
+
+        parallel_internal_cpu_cycle_limit = 0;
+        last_access = access;
+
+        if constexpr(is_u32) {
+          return memory.rom.ReadROM32(address, sequential);
+        } else {
+          return memory.rom.ReadROM16(address, sequential);
+        }
+      }
+    }
+
+    return ReadCodeSlow<T>(address, access);
+  }
+
   void WriteByte(u32 address, u8  value, int access);
   void WriteHalf(u32 address, u16 value, int access);
   void WriteWord(u32 address, u32 value, int access);
@@ -60,6 +130,17 @@ struct Bus {
       u32 bios = 0;
     } latch;
     ROM rom;
+
+    /* One bit per 256-byte page of EWRAM and IWRAM (in that order).
+     * A bit in code_pages is set if the CPU block cache holds decoded code
+     * from the page, a bit in watched_pages if the page contains at least
+     * one watchpoint.
+     */
+    static constexpr int kWRAMPageShift = 8;
+    static constexpr int kWRAMPageCount = (0x40000 + 0x8000) >> kWRAMPageShift;
+
+    std::array<u64, kWRAMPageCount / 64> code_pages{};
+    std::array<u64, kWRAMPageCount / 64> watched_pages{};
   } memory;
 
   struct Hardware {
@@ -106,6 +187,25 @@ struct Bus {
     void WriteByte(u32 address,  u8 value);
     void WriteHalf(u32 address, u16 value);
     void WriteWord(u32 address, u32 value);
+
+    /**
+     * Register map of the first 1 KiB of MMIO, with one entry per halfword.
+     * 16-bit and 32-bit accesses are dispatched through this table directly,
+     * while 8-bit accesses go through ReadByte() and WriteByte().
+     * Entries without a dedicated handler compose the access from two 8-bit accesses.
+     * read32 and write32 are only set for registers which must be accessed as a whole.
+     */
+    struct IORegister {
+      char const* name = nullptr;
+      auto (*read)(Hardware& hw, u32 address) -> u16;
+      void (*write)(Hardware& hw, u32 address, u16 value);
+      auto (*read32)(Hardware& hw, u32 address) -> u32 = nullptr;
+      void (*write32)(Hardware& hw, u32 address, u32 value) = nullptr;
+    };
+
+    static constexpr u32 kIOTableRange = 0x400;
+
+    static const std::array<IORegister, kIOTableRange / 2> s_io_table;
   } hw;
 
   struct Prefetch {
@@ -129,20 +229,38 @@ struct Bus {
   template<typename T>
   void Write(u32 address, int access, T value);
 
+  template<typename T>
+  auto ReadMemory(u32 address, int access) -> T;
+
+  template<typename T>
+  void WriteMemory(u32 address, int access, T value);
+
   template<typename T>
   auto Align(u32 address) -> u32 {
     return address & ~(sizeof(T) - 1);
   }
 
+  /* Steps one cycle at a time and synchronizes the PPU until it has not
+   * fetched from a memory in the current cycle, so that CPU and DMA accesses
+   * are ordered against PPU fetches. No sync is needed while the engines which
+   * fetch from that memory are done with the current scanline. Only the engines
+   * in targets, those which read the memory, are synchronized.
+   */
+  template<bool (PPU::*is_idle)() const noexcept, bool (PPU::*did_access)() noexcept, int targets>
+  void SyncPPU() noexcept {
+    do {
+      Step(1);
+      if((hw.ppu.*is_idle)()) break;
+      hw.ppu.Sync(targets);
+    } while((hw.ppu.*did_access)());
+  }
+
   template<typename T>
   auto ALWAYS_INLINE ReadPRAM(u32 address) noexcept -> T {
     constexpr int cycles = std::is_same_v<T, u32> ? 2 : 1;
 
     for(int i = 0; i < cycles; i++) {
-      do {
-        Step(1);
-        hw.ppu.Sync();
-      } while(hw.ppu.DidAccessPRAM());
+      SyncPPU<&PPU::IsIdlePRAM, &PPU::DidAccessPRAM, PPU::SYNC_BG>();
     }
 
     return hw.ppu.ReadPRAM<T>(address);
@@ -151,10 +269,7 @@ struct Bus {
   template<typename T>
   void ALWAYS_INLINE WritePRAM(u32 address, T value) noexcept {
     if constexpr (!std::is_same_v<T, u32>) {
-      do {
-        Step(1);
-        hw.ppu.Sync();
-      } while(hw.ppu.DidAccessPRAM());
+      SyncPPU<&PPU::IsIdlePRAM, &PPU::DidAccessPRAM, PPU::SYNC_BG>();
 
       hw.ppu.WritePRAM<T>(address, value);
     } else {
@@ -173,19 +288,13 @@ struct Bus {
 
     if(address >= boundary) {
       for(int i = 0; i < cycles; i++) {
-        do {
-          Step(1);
-          hw.ppu.Sync();
-        } while(hw.ppu.DidAccessVRAM_OBJ());
+        SyncPPU<&PPU::IsIdleVRAM_OBJ, &PPU::DidAccessVRAM_OBJ, PPU::SYNC_OBJ>();
       }
 
       return hw.ppu.ReadVRAM_OBJ<T>(address, boundary);
     } else {
       for(int i = 0; i < cycles; i++) {
-        do {
-          Step(1);
-          hw.ppu.Sync();
-        } while(hw.ppu.DidAccessVRAM_BG());
+        SyncPPU<&PPU::IsIdleVRAM_BG, &PPU::DidAccessVRAM_BG, PPU::SYNC_BG>();
       }
 
       return hw.ppu.ReadVRAM_BG<T>(address);
@@ -200,19 +309,11 @@ struct Bus {
       address &= 0x1FFFF;
 
       if(address >= boundary) {
-        // TODO: de-duplicate this code (see ReadVRAM):
-        do {
-          Step(1);
-          hw.ppu.Sync();
-        } while(hw.ppu.DidAccessVRAM_OBJ());
+        SyncPPU<&PPU::IsIdleVRAM_OBJ, &PPU::DidAccessVRAM_OBJ, PPU::SYNC_OBJ>();
 
         hw.ppu.WriteVRAM_OBJ<T>(address, value, boundary);
       } else {
-        // TODO: de-duplicate this code (see ReadVRAM):
-        do {
-          Step(1);
-          hw.ppu.Sync();
-        } while(hw.ppu.DidAccessVRAM_BG());
+        SyncPPU<&PPU::IsIdleVRAM_BG, &PPU::DidAccessVRAM_BG, PPU::SYNC_BG>();
 
         hw.ppu.WriteVRAM_BG<T>(address, value);
       }
@@ -224,20 +325,14 @@ struct Bus {
 
   template<typename T>
   auto ALWAYS_INLINE ReadOAM(u32 address) noexcept -> T {
-    do {
-      Step(1);
-      hw.ppu.Sync();
-    } while(hw.ppu.DidAccessOAM());
+    SyncPPU<&PPU::IsIdleOAM, &PPU::DidAccessOAM, PPU::SYNC_OBJ>();
 
     return hw.ppu.ReadOAM<T>(address);
   }
 
   template<typename T>
   void ALWAYS_INLINE WriteOAM(u32 address, T value) noexcept {
-    do {
-      Step(1);
-      hw.ppu.Sync();
-    } while(hw.ppu.DidAccessOAM());
+    SyncPPU<&PPU::IsIdleOAM, &PPU::DidAccessOAM, PPU::SYNC_OBJ>();
 
     hw.ppu.WriteOAM<T>(address, value);
   }
@@ -265,11 +360,80 @@ struct Bus {
     { 1, 1, 6, 1, 1, 2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 1 }
   };
 
+  static auto GetWRAMPageIndex(u32 page, u32 offset) -> u32 {
+    // IWRAM pages follow the EWRAM pages.
+    return ((page & 1) * sizeof(Memory::wram) + offset) >> Memory::kWRAMPageShift;
+  }
+
+  // Mask for the offset into EWRAM (page 0x02) or IWRAM (page 0x03), which are mirrored.
+  static auto GetWRAMMask(u32 page) -> u32 {
+    return page == 0x02 ? 0x3FFFF : 0x7FFF;
+  }
+
+  static bool ALWAYS_INLINE IsPageSet(std::array<u64, Memory::kWRAMPageCount / 64> const& pages, u32 index) {
+    return pages[index >> 6] & (1ULL << (index & 63));
+  }
+
+  /* The memory region that code is currently fetched from and the timing
+   * of sequential opcode fetches from it. Invalidated whenever the wait
+   * state tables are updated.
+   */
+  struct CodeRegion {
+    enum class Kind {
+      Generic,
+      WRAM,
+      ROM
+    } kind = Kind::Generic;
+
+    u32 page = ~0U;
+    u8* data = nullptr;
+    u32 mask = 0;
+    int cycles16 = 0;
+    int cycles32 = 0;
+  } code_region;
+
+  template<typename T>
+  auto ReadCodeSlow(u32 address, int access) -> T;
+
+  void UpdateCodeRegion(u32 page);
+
+#ifdef NBA_BUS_TRACE
+  BusTrace trace;
+#endif
+
+  using WatchpointCallback = std::function<void(u32 address, int size, u32 value, u64 timestamp)>;
+
+  struct Watchpoint {
+    int id;
+    u32 address;
+    u32 size;
+    WatchpointCallback callback;
+  };
+
+  std::vector<Watchpoint> watchpoints;
+  int next_watchpoint_id = 0;
+
+  template<typename T>
+  void CheckWatchpoints(u32 address, T value);
+
+  void UpdateWatchedPages();
+
 public:
   Bus(Scheduler& scheduler, Hardware&& hw);
 
   auto GetHostAddress(u32 address, size_t size) -> u8*;
 
+  /**
+   * Calls the callback whenever the CPU or a DMA writes to the given range
+   * of EWRAM or IWRAM. Mirrors of the range are watched as well.
+   * The callback is called right after the write, with the timestamp at
+   * which the access has completed. It must not access the core.
+   * Returns the ID of the watchpoint or -1 if the range is not in work RAM.
+   */
+  auto AddWatchpoint(u32 address, u32 size, WatchpointCallback callback) -> int;
+
+  void RemoveWatchpoint(int id);
+
   template<typename T>
   auto GetHostAddress(u32 address, size_t count = 1) -> T* {
     return (T*)GetHostAddress(address, sizeof(T) * count);
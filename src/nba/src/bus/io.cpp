@@ -203,32 +203,28 @@ auto Bus::Hardware::ReadByte(u32 address) ->  u8 {
 }
 
 auto Bus::Hardware::ReadHalf(u32 address) -> u16 {
-  switch(address) {
-    // Timer 0 - 3
-    case TM0CNT_L: return timer.ReadHalf(0, 0);
-    case TM0CNT_H: return timer.ReadHalf(0, 2);
-    case TM1CNT_L: return timer.ReadHalf(1, 0);
-    case TM1CNT_H: return timer.ReadHalf(1, 2);
-    case TM2CNT_L: return timer.ReadHalf(2, 0);
-    case TM2CNT_H: return timer.ReadHalf(2, 2);
-    case TM3CNT_L: return timer.ReadHalf(3, 0);
-    case TM3CNT_H: return timer.ReadHalf(3, 2);
+  const u32 offset = address - DISPCNT;
 
-    // IRQ controller
-    case IE:  return irq.ReadHalf(0);
-    case IF:  return irq.ReadHalf(2);
-    case IME: return irq.ReadHalf(4);
+  if(offset < kIOTableRange) {
+    return s_io_table[offset >> 1].read(*this, address);
   }
 
   return ReadByte(address) | (ReadByte(address + 1) << 8);
 }
 
 auto Bus::Hardware::ReadWord(u32 address) -> u32 {
-  switch(address) {
-    case TM0CNT_L: return timer.ReadWord(0);
-    case TM1CNT_L: return timer.ReadWord(1);
-    case TM2CNT_L: return timer.ReadWord(2);
-    case TM3CNT_L: return timer.ReadWord(3);
+  const u32 offset = address - DISPCNT;
+
+  if(offset < kIOTableRange) {
+    auto& reg = s_io_table[offset >> 1];
+
+    if(reg.read32) {
+      return reg.read32(*this, address);
+    }
+
+    const u16 lsw = reg.read(*this, address);
+    const u16 msw = s_io_table[(offset >> 1) + 1].read(*this, address + 2);
+    return lsw | ((u32)msw << 16);
   }
 
   return ReadHalf(address) | (ReadHalf(address + 2) << 16);
@@ -575,62 +571,14 @@ void Bus::Hardware::WriteByte(u32 address,  u8 value) {
 }
 
 void Bus::Hardware::WriteHalf(u32 address, u16 value) {
-  auto& apu_io = apu.mmio;
+  const u32 offset = address - DISPCNT;
 
-  const bool apu_enable = apu_io.soundcnt.master_enable;
+  if(offset < kIOTableRange) {
+    s_io_table[offset >> 1].write(*this, address, value);
+    return;
+  }
 
   switch(address) {
-    case FIFO_A+0: if(apu_enable) apu_io.fifo[0].WriteHalf(0, value); break;
-    case FIFO_A+2: if(apu_enable) apu_io.fifo[0].WriteHalf(2, value); break;
-    case FIFO_B+0: if(apu_enable) apu_io.fifo[1].WriteHalf(0, value); break;
-    case FIFO_B+2: if(apu_enable) apu_io.fifo[1].WriteHalf(2, value); break;
-
-    // Timers 0 - 3
-    case TM0CNT_L: timer.WriteHalf(0, 0, value); break;
-    case TM0CNT_H: timer.WriteHalf(0, 2, value); break;
-    case TM1CNT_L: timer.WriteHalf(1, 0, value); break;
-    case TM1CNT_H: timer.WriteHalf(1, 2, value); break;
-    case TM2CNT_L: timer.WriteHalf(2, 0, value); break;
-    case TM2CNT_H: timer.WriteHalf(2, 2, value); break;
-    case TM3CNT_L: timer.WriteHalf(3, 0, value); break;
-    case TM3CNT_H: timer.WriteHalf(3, 2, value); break;
-
-    /* Do not invoke Keypad::UpdateIRQ() twice for a single 16-bit write.
-     * See https://github.com/fleroviux/NanoBoyAdvance/issues/152 for details.
-     */
-    case KEYCNT: {
-      keypad.control.WriteHalf(value);
-      break;
-    }
-
-    // IRQ controller
-    case IE:  irq.WriteHalf(0, value); break;
-    case IF:  irq.WriteHalf(2, value); break;
-    case IME: irq.WriteByte(4, value); break;
-
-    case SIOCNT: {
-      siocnt = (siocnt & 0x80u) | (value & ~0x80u);
-
-      if(!(siocnt & 0x80u) && value & 0x80u) {
-        // bit 0 (from bit  1): internal shift clock (0 = 256 KHz, 1 = 2 MHz)
-        // bit 1 (from bit 12): transfer length (0 = 8-bit, 1 = 32-bit)
-        static const int table[4] {
-          512,
-          64,
-          2048,
-          256
-        };
-
-        siocnt |= 0x80u;
-
-        const int cycles = table[((siocnt >> 1) & 1u) | ((siocnt >> 11) & 2u)];
-
-        bus->scheduler.Add(cycles, Scheduler::EventClass::SIO_transfer_done);
-      }
-
-      break;
-    }
-
     case MGBA_LOG_SEND: {
       if(mgba_log.enable && (value & 0x100) != 0) {
         nba::print("mGBA log: {}\n", mgba_log.message.data());
@@ -655,26 +603,22 @@ void Bus::Hardware::WriteHalf(u32 address, u16 value) {
 }
 
 void Bus::Hardware::WriteWord(u32 address, u32 value) {
-  auto& apu_io = apu.mmio;
+  const u32 offset = address - DISPCNT;
 
-  const bool apu_enable = apu_io.soundcnt.master_enable;
+  if(offset < kIOTableRange) {
+    auto& reg = s_io_table[offset >> 1];
 
-  switch(address) {
-    case FIFO_A: if(apu_enable) apu_io.fifo[0].WriteWord(value); break;
-    case FIFO_B: if(apu_enable) apu_io.fifo[1].WriteWord(value); break;
-
-    // Timers 0 - 3
-    case TM0CNT_L: timer.WriteWord(0, value); break;
-    case TM1CNT_L: timer.WriteWord(1, value); break;
-    case TM2CNT_L: timer.WriteWord(2, value); break;
-    case TM3CNT_L: timer.WriteWord(3, value); break;
-
-    default: {
-      WriteHalf(address + 0, u16(value >> 0));
-      WriteHalf(address + 2, u16(value >> 16));
-      break;
+    if(reg.write32) {
+      reg.write32(*this, address, value);
+    } else {
+      reg.write(*this, address, u16(value >> 0));
+      s_io_table[(offset >> 1) + 1].write(*this, address + 2, u16(value >> 16));
     }
+    return;
   }
+
+  WriteHalf(address + 0, u16(value >> 0));
+  WriteHalf(address + 2, u16(value >> 16));
 }
 
 void Bus::SIOTransferDone() {
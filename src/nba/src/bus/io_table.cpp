@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <nba/bus_trace.hpp>
+
+#include "arm/arm7tdmi.hpp"
+#include "bus/bus.hpp"
+#include "bus/io.hpp"
+
+namespace nba::core {
+
+using Hardware = Bus::Hardware;
+using IORegister = Hardware::IORegister;
+
+static auto ReadBytes(Hardware& hw, u32 address) -> u16 {
+  return hw.ReadByte(address) | (hw.ReadByte(address + 1) << 8);
+}
+
+static void WriteBytes(Hardware& hw, u32 address, u16 value) {
+  hw.WriteByte(address + 0, u8(value >> 0));
+  hw.WriteByte(address + 1, u8(value >> 8));
+}
+
+static constexpr struct {
+  u32 address;
+  char const* name;
+} kRegisterNames[] {
+  { DISPCNT, "DISPCNT" },
+  { GREENSWAP, "GREENSWAP" },
+  { DISPSTAT, "DISPSTAT" },
+  { VCOUNT, "VCOUNT" },
+  { BG0CNT, "BG0CNT" },
+  { BG1CNT, "BG1CNT" },
+  { BG2CNT, "BG2CNT" },
+  { BG3CNT, "BG3CNT" },
+  { BG0HOFS, "BG0HOFS" },
+  { BG0VOFS, "BG0VOFS" },
+  { BG1HOFS, "BG1HOFS" },
+  { BG1VOFS, "BG1VOFS" },
+  { BG2HOFS, "BG2HOFS" },
+  { BG2VOFS, "BG2VOFS" },
+  { BG3HOFS, "BG3HOFS" },
+  { BG3VOFS, "BG3VOFS" },
+  { BG2PA, "BG2PA" },
+  { BG2PB, "BG2PB" },
+  { BG2PC, "BG2PC" },
+  { BG2PD, "BG2PD" },
+  { BG2X + 0, "BG2X_L" },
+  { BG2X + 2, "BG2X_H" },
+  { BG2Y + 0, "BG2Y_L" },
+  { BG2Y + 2, "BG2Y_H" },
+  { BG3PA, "BG3PA" },
+  { BG3PB, "BG3PB" },
+  { BG3PC, "BG3PC" },
+  { BG3PD, "BG3PD" },
+  { BG3X + 0, "BG3X_L" },
+  { BG3X + 2, "BG3X_H" },
+  { BG3Y + 0, "BG3Y_L" },
+  { BG3Y + 2, "BG3Y_H" },
+  { WIN0H, "WIN0H" },
+  { WIN1H, "WIN1H" },
+  { WIN0V, "WIN0V" },
+  { WIN1V, "WIN1V" },
+  { WININ, "WININ" },
+  { WINOUT, "WINOUT" },
+  { MOSAIC, "MOSAIC" },
+  { BLDCNT, "BLDCNT" },
+  { BLDALPHA, "BLDALPHA" },
+  { BLDY, "BLDY" },
+  { SOUND1CNT_L, "SOUND1CNT_L" },
+  { SOUND1CNT_H, "SOUND1CNT_H" },
+  { SOUND1CNT_X, "SOUND1CNT_X" },
+  { SOUND2CNT_L, "SOUND2CNT_L" },
+  { SOUND2CNT_H, "SOUND2CNT_H" },
+  { SOUND3CNT_L, "SOUND3CNT_L" },
+  { SOUND3CNT_H, "SOUND3CNT_H" },
+  { SOUND3CNT_X, "SOUND3CNT_X" },
+  { SOUND4CNT_L, "SOUND4CNT_L" },
+  { SOUND4CNT_H, "SOUND4CNT_H" },
+  { SOUNDCNT_L, "SOUNDCNT_L" },
+  { SOUNDCNT_H, "SOUNDCNT_H" },
+  { SOUNDCNT_X, "SOUNDCNT_X" },
+  { SOUNDBIAS, "SOUNDBIAS" },
+  { WAVE_RAM + 0x0, "WAVE_RAM0_L" },
+  { WAVE_RAM + 0x2, "WAVE_RAM0_H" },
+  { WAVE_RAM + 0x4, "WAVE_RAM1_L" },
+  { WAVE_RAM + 0x6, "WAVE_RAM1_H" },
+  { WAVE_RAM + 0x8, "WAVE_RAM2_L" },
+  { WAVE_RAM + 0xA, "WAVE_RAM2_H" },
+  { WAVE_RAM + 0xC, "WAVE_RAM3_L" },
+  { WAVE_RAM + 0xE, "WAVE_RAM3_H" },
+  { FIFO_A + 0, "FIFO_A_L" },
+  { FIFO_A + 2, "FIFO_A_H" },
+  { FIFO_B + 0, "FIFO_B_L" },
+  { FIFO_B + 2, "FIFO_B_H" },
+  { DMA0SAD + 0, "DMA0SAD_L" },
+  { DMA0SAD + 2, "DMA0SAD_H" },
+  { DMA0DAD + 0, "DMA0DAD_L" },
+  { DMA0DAD + 2, "DMA0DAD_H" },
+  { DMA0CNT_L, "DMA0CNT_L" },
+  { DMA0CNT_H, "DMA0CNT_H" },
+  { DMA1SAD + 0, "DMA1SAD_L" },
+  { DMA1SAD + 2, "DMA1SAD_H" },
+  { DMA1DAD + 0, "DMA1DAD_L" },
+  { DMA1DAD + 2, "DMA1DAD_H" },
+  { DMA1CNT_L, "DMA1CNT_L" },
+  { DMA1CNT_H, "DMA1CNT_H" },
+  { DMA2SAD + 0, "DMA2SAD_L" },
+  { DMA2SAD + 2, "DMA2SAD_H" },
+  { DMA2DAD + 0, "DMA2DAD_L" },
+  { DMA2DAD + 2, "DMA2DAD_H" },
+  { DMA2CNT_L, "DMA2CNT_L" },
+  { DMA2CNT_H, "DMA2CNT_H" },
+  { DMA3SAD + 0, "DMA3SAD_L" },
+  { DMA3SAD + 2, "DMA3SAD_H" },
+  { DMA3DAD + 0, "DMA3DAD_L" },
+  { DMA3DAD + 2, "DMA3DAD_H" },
+  { DMA3CNT_L, "DMA3CNT_L" },
+  { DMA3CNT_H, "DMA3CNT_H" },
+  { TM0CNT_L, "TM0CNT_L" },
+  { TM0CNT_H, "TM0CNT_H" },
+  { TM1CNT_L, "TM1CNT_L" },
+  { TM1CNT_H, "TM1CNT_H" },
+  { TM2CNT_L, "TM2CNT_L" },
+  { TM2CNT_H, "TM2CNT_H" },
+  { TM3CNT_L, "TM3CNT_L" },
+  { TM3CNT_H, "TM3CNT_H" },
+  { SIOMULTI0, "SIOMULTI0" },
+  { SIOMULTI1, "SIOMULTI1" },
+  { SIOMULTI2, "SIOMULTI2" },
+  { SIOMULTI3, "SIOMULTI3" },
+  { SIOCNT, "SIOCNT" },
+  { SIOMLT_SEND, "SIOMLT_SEND" },
+  { KEYINPUT, "KEYINPUT" },
+  { KEYCNT, "KEYCNT" },
+  { RCNT, "RCNT" },
+  { JOYCNT, "JOYCNT" },
+  { JOY_RECV + 0, "JOY_RECV_L" },
+  { JOY_RECV + 2, "JOY_RECV_H" },
+  { JOY_TRANS + 0, "JOY_TRANS_L" },
+  { JOY_TRANS + 2, "JOY_TRANS_H" },
+  { JOYSTAT, "JOYSTAT" },
+  { IE, "IE" },
+  { IF, "IF" },
+  { WAITCNT, "WAITCNT" },
+  { IME, "IME" },
+  { POSTFLG, "POSTFLG" }
+};
+
+const std::array<IORegister, Hardware::kIOTableRange / 2> Hardware::s_io_table = []() {
+  std::array<IORegister, kIOTableRange / 2> table;
+
+  auto reg = [&](u32 address) -> IORegister& {
+    return table[(address - DISPCNT) >> 1];
+  };
+
+  for(auto& entry : table) {
+    entry.read = &ReadBytes;
+    entry.write = &WriteBytes;
+  }
+
+  for(auto& entry : kRegisterNames) {
+    reg(entry.address).name = entry.name;
+  }
+
+  // PPU
+  reg(DISPCNT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.ppu.mmio.dispcnt.ReadHalf();
+  };
+  reg(DISPCNT).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.dispcnt.WriteHalf(value);
+  };
+  reg(GREENSWAP).read = [](Hardware& hw, u32) -> u16 {
+    return hw.ppu.mmio.greenswap;
+  };
+  reg(GREENSWAP).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.greenswap = value & 1;
+  };
+  reg(DISPSTAT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.ppu.mmio.dispstat.ReadHalf();
+  };
+  reg(DISPSTAT).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.dispstat.WriteHalf(value);
+  };
+  reg(VCOUNT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.ppu.mmio.vcount & 0xFF;
+  };
+
+  for(u32 address = BG0CNT; address <= BG3CNT; address += sizeof(u16)) {
+    reg(address).read = [](Hardware& hw, u32 address) -> u16 {
+      return hw.ppu.mmio.bgcnt[(address - BG0CNT) >> 1].ReadHalf();
+    };
+    reg(address).write = [](Hardware& hw, u32 address, u16 value) {
+      hw.ppu.mmio.bgcnt[(address - BG0CNT) >> 1].WriteHalf(value);
+    };
+  }
+
+  for(u32 address = BG0HOFS; address <= BG3VOFS; address += sizeof(u16)) {
+    reg(address).write = [](Hardware& hw, u32 address, u16 value) {
+      const int id = (address - BG0HOFS) >> 2;
+
+      if(address & 2) {
+        hw.ppu.mmio.bgvofs[id] = value & 0x1FF;
+      } else {
+        hw.ppu.mmio.bghofs[id] = value & 0x1FF;
+      }
+    };
+  }
+
+  for(u32 base : {BG2PA, BG3PA}) {
+    for(u32 address = base; address <= base + 6; address += sizeof(u16)) {
+      reg(address).write = [](Hardware& hw, u32 address, u16 value) {
+        auto& ppu_io = hw.ppu.mmio;
+        const int id = (address - BG2PA) >> 4;
+
+        switch((address >> 1) & 3) {
+          case 0: ppu_io.bgpa[id] = (s16)value; break;
+          case 1: ppu_io.bgpb[id] = (s16)value; break;
+          case 2: ppu_io.bgpc[id] = (s16)value; break;
+          case 3: ppu_io.bgpd[id] = (s16)value; break;
+        }
+      };
+    }
+
+    for(u32 address = base + 8; address <= base + 14; address += sizeof(u16)) {
+      reg(address).write = [](Hardware& hw, u32 address, u16 value) {
+        auto& ppu_io = hw.ppu.mmio;
+        const int id = (address - BG2PA) >> 4;
+        const int offset = address & 2;
+
+        auto& point = (address & 4) ? ppu_io.bgy[id] : ppu_io.bgx[id];
+
+        point.Write(offset + 0, u8(value >> 0));
+        point.Write(offset + 1, u8(value >> 8));
+      };
+    }
+  }
+
+  reg(WIN0H).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.winh[0].WriteHalf(value);
+  };
+  reg(WIN1H).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.winh[1].WriteHalf(value);
+  };
+  reg(WIN0V).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.winv[0].WriteHalf(value);
+  };
+  reg(WIN1V).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.winv[1].WriteHalf(value);
+  };
+  reg(WININ).read = [](Hardware& hw, u32) -> u16 {
+    return hw.ppu.mmio.winin.ReadHalf();
+  };
+  reg(WININ).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.winin.WriteHalf(value);
+  };
+  reg(WINOUT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.ppu.mmio.winout.ReadHalf();
+  };
+  reg(WINOUT).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.winout.WriteHalf(value);
+  };
+  reg(MOSAIC).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.mosaic.Write(0, u8(value >> 0));
+    hw.ppu.mmio.mosaic.Write(1, u8(value >> 8));
+  };
+  reg(BLDCNT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.ppu.mmio.bldcnt.ReadHalf();
+  };
+  reg(BLDCNT).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.bldcnt.WriteHalf(value);
+  };
+  reg(BLDALPHA).read = [](Hardware& hw, u32) -> u16 {
+    return hw.ppu.mmio.eva | (hw.ppu.mmio.evb << 8);
+  };
+  reg(BLDALPHA).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.eva = (value >> 0) & 0x1F;
+    hw.ppu.mmio.evb = (value >> 8) & 0x1F;
+  };
+  reg(BLDY).write = [](Hardware& hw, u32, u16 value) {
+    hw.ppu.mmio.evy = value & 0x1F;
+  };
+
+  // Sound
+  for(u32 address : {FIFO_A, FIFO_B}) {
+    reg(address + 0).write = reg(address + 2).write = [](Hardware& hw, u32 address, u16 value) {
+      auto& apu_io = hw.apu.mmio;
+
+      if(apu_io.soundcnt.master_enable) {
+        apu_io.fifo[(address - FIFO_A) >> 2].WriteHalf(address & 2, value);
+      }
+    };
+    reg(address).write32 = [](Hardware& hw, u32 address, u32 value) {
+      auto& apu_io = hw.apu.mmio;
+
+      if(apu_io.soundcnt.master_enable) {
+        apu_io.fifo[(address - FIFO_A) >> 2].WriteWord(value);
+      }
+    };
+  }
+
+  // DMA 0 - 3
+  for(u32 address = DMA0SAD; address <= DMA3CNT_H; address += sizeof(u16)) {
+    reg(address).write = [](Hardware& hw, u32 address, u16 value) {
+      const int chan_id = (address - DMA0SAD) / 12;
+      const int offset = (address - DMA0SAD) % 12;
+
+      hw.dma.Write(chan_id, offset + 0, u8(value >> 0));
+      hw.dma.Write(chan_id, offset + 1, u8(value >> 8));
+    };
+  }
+
+  for(u32 address : {DMA0CNT_L, DMA1CNT_L, DMA2CNT_L, DMA3CNT_L}) {
+    reg(address + 0).read = [](Hardware&, u32) -> u16 {
+      return 0;
+    };
+    reg(address + 2).read = [](Hardware& hw, u32 address) -> u16 {
+      const int chan_id = (address - DMA0SAD) / 12;
+
+      return hw.dma.Read(chan_id, 10) | (hw.dma.Read(chan_id, 11) << 8);
+    };
+  }
+
+  // Timer 0 - 3
+  for(u32 address = TM0CNT_L; address <= TM3CNT_H; address += sizeof(u16)) {
+    reg(address).read = [](Hardware& hw, u32 address) -> u16 {
+      return hw.timer.ReadHalf((address - TM0CNT_L) >> 2, address & 2);
+    };
+    reg(address).write = [](Hardware& hw, u32 address, u16 value) {
+      hw.timer.WriteHalf((address - TM0CNT_L) >> 2, address & 2, value);
+    };
+  }
+
+  for(u32 address = TM0CNT_L; address <= TM3CNT_L; address += sizeof(u32)) {
+    reg(address).read32 = [](Hardware& hw, u32 address) -> u32 {
+      return hw.timer.ReadWord((address - TM0CNT_L) >> 2);
+    };
+    reg(address).write32 = [](Hardware& hw, u32 address, u32 value) {
+      hw.timer.WriteWord((address - TM0CNT_L) >> 2, value);
+    };
+  }
+
+  // Serial communication
+  reg(SIOCNT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.siocnt;
+  };
+  reg(SIOCNT).write = [](Hardware& hw, u32, u16 value) {
+    auto& siocnt = hw.siocnt;
+
+    siocnt = (siocnt & 0x80u) | (value & ~0x80u);
+
+    if(!(siocnt & 0x80u) && value & 0x80u) {
+      // bit 0 (from bit  1): internal shift clock (0 = 256 KHz, 1 = 2 MHz)
+      // bit 1 (from bit 12): transfer length (0 = 8-bit, 1 = 32-bit)
+      static const int table[4] {
+        512,
+        64,
+        2048,
+        256
+      };
+
+      siocnt |= 0x80u;
+
+      const int cycles = table[((siocnt >> 1) & 1u) | ((siocnt >> 11) & 2u)];
+
+      hw.bus->scheduler.Add(cycles, Scheduler::EventClass::SIO_transfer_done);
+    }
+  };
+  reg(RCNT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.rcnt[0] | (hw.rcnt[1] << 8);
+  };
+  reg(RCNT).write = [](Hardware& hw, u32, u16 value) {
+    hw.rcnt[0] = u8(value >> 0);
+    hw.rcnt[1] = u8(value >> 8);
+  };
+
+  // Keypad
+  reg(KEYINPUT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.keypad.input.ReadByte(0) | (hw.keypad.input.ReadByte(1) << 8);
+  };
+  reg(KEYCNT).read = [](Hardware& hw, u32) -> u16 {
+    return hw.keypad.control.ReadByte(0) | (hw.keypad.control.ReadByte(1) << 8);
+  };
+
+  /* Do not invoke Keypad::UpdateIRQ() twice for a single 16-bit write.
+   * See https://github.com/fleroviux/NanoBoyAdvance/issues/152 for details.
+   */
+  reg(KEYCNT).write = [](Hardware& hw, u32, u16 value) {
+    hw.keypad.control.WriteHalf(value);
+  };
+
+  // IRQ controller
+  reg(IE).read = [](Hardware& hw, u32) -> u16 {
+    return hw.irq.ReadHalf(0);
+  };
+  reg(IF).read = [](Hardware& hw, u32) -> u16 {
+    return hw.irq.ReadHalf(2);
+  };
+  reg(IME).read = [](Hardware& hw, u32) -> u16 {
+    return hw.irq.ReadHalf(4);
+  };
+  reg(IE).write = [](Hardware& hw, u32, u16 value) {
+    hw.irq.WriteHalf(0, value);
+  };
+  reg(IF).write = [](Hardware& hw, u32, u16 value) {
+    hw.irq.WriteHalf(2, value);
+  };
+  reg(IME).write = [](Hardware& hw, u32, u16 value) {
+    hw.irq.WriteByte(4, value);
+  };
+
+  return table;
+}();
+
+} // namespace nba::core
+
+namespace nba {
+
+auto GetIORegisterName(u32 address) -> char const* {
+  using namespace core;
+
+  const u32 offset = address - DISPCNT;
+
+  if(offset < Hardware::kIOTableRange) {
+    return Hardware::s_io_table[offset >> 1].name;
+  }
+
+  if(address >= MGBA_LOG_STRING_LO && address < MGBA_LOG_STRING_HI) {
+    return "MGBA_LOG_STRING";
+  }
+
+  switch(address & ~1) {
+    case MGBA_LOG_SEND:   return "MGBA_LOG_SEND";
+    case MGBA_LOG_ENABLE: return "MGBA_LOG_ENABLE";
+  }
+
+  return nullptr;
+}
+
+} // namespace nba
@@ -173,6 +173,36 @@ void Bus::UpdateWaitStateTable() {
     wait16[s][0xE + i] = sram;
     wait32[s][0xE + i] = sram;
   }
+
+  code_region = {};
+}
+
+void Bus::UpdateCodeRegion(u32 page) {
+  if(page == code_region.page) {
+    return;
+  }
+
+  auto s = int(Access::Sequential);
+
+  code_region = {};
+  code_region.page = page;
+
+  switch(page) {
+    case 0x02 ... 0x03: {
+      code_region.kind = CodeRegion::Kind::WRAM;
+      code_region.data = page == 0x02 ? memory.wram.data() : memory.iram.data();
+      code_region.mask = GetWRAMMask(page);
+      code_region.cycles16 = wait16[s][page];
+      code_region.cycles32 = wait32[s][page];
+      break;
+    }
+    case 0x08 ... 0x0D: {
+      code_region.kind = CodeRegion::Kind::ROM;
+      code_region.cycles16 = wait16[s][page];
+      code_region.cycles32 = wait32[s][page];
+      break;
+    }
+  }
 }
 
 } // namespace nba::core
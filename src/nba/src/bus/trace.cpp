@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <nba/log.hpp>
+
+#include "bus/bus.hpp"
+#include "bus/trace.hpp"
+
+namespace nba::core {
+
+static_assert((int)BusTraceRecord::Sequential == (int)Bus::Sequential);
+static_assert((int)BusTraceRecord::Code == (int)Bus::Code);
+static_assert((int)BusTraceRecord::Dma == (int)Bus::Dma);
+static_assert((int)BusTraceRecord::Lock == (int)Bus::Lock);
+
+bool BusTrace::Start(std::string const& path) {
+  const BusTraceHeader header{};
+
+  if(!writer.Start(path, &header, sizeof(header))) {
+    Log<Error>("BusTrace: failed to open '{}' for writing", path);
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace nba::core
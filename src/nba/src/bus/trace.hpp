@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <nba/common/compiler.hpp>
+#include <nba/bus_trace.hpp>
+#include <nba/integer.hpp>
+#include <string>
+
+#include "trace_writer.hpp"
+
+namespace nba::core {
+
+/**
+ * Records bus accesses into a trace file, see nba/bus_trace.hpp.
+ */
+struct BusTrace {
+  bool Start(std::string const& path);
+
+  void Stop() {
+    writer.Stop();
+  }
+
+  bool ALWAYS_INLINE IsActive() const {
+    return writer.IsActive();
+  }
+
+  void ALWAYS_INLINE Record(u64 timestamp, u32 address, u32 value, u64 cycles, int access, int size, bool write) {
+    const BusTraceRecord record{timestamp, address, value, (u32)cycles, (u8)access, (u8)size, write, 0};
+
+    writer.Write(&record, sizeof(record));
+  }
+
+private:
+  TraceWriter writer{0x200000};
+};
+
+} // namespace nba::core
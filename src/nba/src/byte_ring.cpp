@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <chrono>
+
+#include "byte_ring.hpp"
+
+namespace nba::core {
+
+void ByteRing::Span::Read(u64 offset, void* dst, u64 count) const {
+  if(offset < size[0]) {
+    const u64 count_0 = std::min(count, size[0] - offset);
+
+    std::memcpy(dst, data[0] + offset, count_0);
+    std::memcpy((u8*)dst + count_0, data[1], count - count_0);
+  } else {
+    std::memcpy(dst, data[1] + offset - size[0], count);
+  }
+}
+
+ByteRing::~ByteRing() {
+  Stop();
+}
+
+void ByteRing::Start(Consumer consumer) {
+  Stop();
+
+  if(!buffer) {
+    buffer = std::make_unique<u8[]>(capacity);
+  }
+
+  this->consumer = std::move(consumer);
+
+  head = 0;
+  tail = 0;
+  position = 0;
+  running = true;
+
+  thread = std::thread{[this]() {
+    int idle_polls = 0;
+
+    while(running.load()) {
+      if(ConsumeAvailableData()) {
+        idle_polls = 0;
+      } else if(++idle_polls < 1024) {
+        // Data usually arrives every few microseconds, so do not sleep right away.
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }};
+
+  active = true;
+}
+
+void ByteRing::Stop() {
+  if(!active) {
+    return;
+  }
+
+  active = false;
+  running = false;
+  thread.join();
+
+  while(ConsumeAvailableData()) {}
+
+  consumer = {};
+}
+
+void ByteRing::Wait() {
+  while(tail.load(std::memory_order_acquire) != position) {
+    std::this_thread::yield();
+  }
+}
+
+auto ByteRing::ConsumeAvailableData() -> bool {
+  const u64 tail = this->tail.load(std::memory_order_relaxed);
+  const u64 head = this->head.load(std::memory_order_acquire);
+
+  if(head == tail) {
+    return false;
+  }
+
+  const u64 index = tail & (capacity - 1);
+  const u64 size = head - tail;
+  const u64 size_0 = std::min(size, capacity - index);
+
+  consumer({{&buffer[index], &buffer[0]}, {size_0, size - size_0}});
+
+  this->tail.store(head, std::memory_order_release);
+  return true;
+}
+
+} // namespace nba::core
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <nba/common/compiler.hpp>
+#include <nba/integer.hpp>
+#include <thread>
+
+namespace nba::core {
+
+/**
+ * A fixed-size single-producer, single-consumer byte ring buffer, which is drained
+ * by a consumer thread. The buffer is allocated when the consumer is started,
+ * so writing into it never allocates. If the consumer falls behind, the producer
+ * waits for it instead of dropping data.
+ * Start(), Stop() and Wait() must be called from the producer thread.
+ */
+struct ByteRing {
+  /**
+   * Data which is ready to be consumed. Unless size[1] is zero,
+   * it wraps around the end of the buffer and continues at data[1].
+   */
+  struct Span {
+    u8 const* data[2];
+    u64 size[2];
+
+    // Copies 'count' bytes, starting 'offset' bytes into the span.
+    void Read(u64 offset, void* dst, u64 count) const;
+  };
+
+  // Called with all data that is ready, which counts as consumed once the consumer returns.
+  using Consumer = std::function<void(Span const& span)>;
+
+  // The capacity of the ring buffer in bytes, which must be a power of two.
+  explicit ByteRing(u64 capacity) : capacity(capacity) {}
+
+ ~ByteRing();
+
+  void Start(Consumer consumer);
+
+  // Waits until all data has been consumed and joins the consumer thread.
+  void Stop();
+
+  // Waits until all data has been consumed.
+  void Wait();
+
+  bool ALWAYS_INLINE IsActive() const {
+    return active;
+  }
+
+  // Waits until 'size' bytes are free. Append() may then write up to that many bytes.
+  void ALWAYS_INLINE Reserve(u64 size) {
+    while(unlikely(position + size - tail.load(std::memory_order_acquire) > capacity)) {
+      std::this_thread::yield();
+    }
+  }
+
+  void ALWAYS_INLINE Append(void const* data, u64 size) {
+    const u64 index = position & (capacity - 1);
+    const u64 size_0 = std::min(size, capacity - index);
+
+    std::memcpy(&buffer[index], data, size_0);
+    std::memcpy(&buffer[0], (u8 const*)data + size_0, size - size_0);
+
+    position += size;
+  }
+
+  // Makes everything that has been appended so far visible to the consumer.
+  void ALWAYS_INLINE Commit() {
+    head.store(position, std::memory_order_release);
+  }
+
+  void ALWAYS_INLINE Write(void const* data, u64 size) {
+    Reserve(size);
+    Append(data, size);
+    Commit();
+  }
+
+private:
+  auto ConsumeAvailableData() -> bool;
+
+  const u64 capacity;
+
+  bool active = false;
+  Consumer consumer;
+  std::unique_ptr<u8[]> buffer;
+  std::thread thread;
+  std::atomic_bool running = false;
+
+  // Keep the producer and consumer indices on separate cache lines.
+  alignas(64) std::atomic<u64> head = 0;
+  alignas(64) std::atomic<u64> tail = 0;
+
+  // The producer's write position, which is ahead of the head until Commit().
+  alignas(64) u64 position = 0;
+};
+
+} // namespace nba::core
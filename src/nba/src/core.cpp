@@ -6,6 +6,7 @@
  */
 
 #include <nba/common/crc32.hpp>
+#include <nba/rom/header.hpp>
 #include <nba/rom/gpio/rtc.hpp>
 #include <nba/rom/gpio/solar_sensor.hpp>
 
@@ -24,10 +25,17 @@ Core::Core(std::shared_ptr<Config> config)
     , ppu(scheduler, irq, dma, config)
     , timer(scheduler, irq, apu)
     , keypad(scheduler, irq, config)
-    , bus(scheduler, {cpu, irq, dma, apu, ppu, timer, keypad}) {
+    , bus(scheduler, {cpu, irq, dma, apu, ppu, timer, keypad})
+    , idle_loop(cpu, bus) {
   Reset();
 }
 
+Core::~Core() {
+#ifdef NBA_SCHEDULER_STATS
+  scheduler.PrintStats();
+#endif
+}
+
 void Core::Reset() {
   scheduler.Reset();
   cpu.Reset();
@@ -39,24 +47,41 @@ void Core::Reset() {
   bus.Reset();
   keypad.Reset();
 
-  if(config->skip_bios) {
+  // Without a BIOS image, emulated BIOS calls are backed by a minimal replacement.
+  const bool replace_bios = config->hle_bios && !have_bios;
+
+  if(replace_bios) {
+    bus.Attach(arm::BIOS::GetReplacementImage());
+  }
+
+  if(config->skip_bios || replace_bios) {
     SkipBootScreen();
   }
 
+  cpu.HLEBIOS() = config->hle_bios;
+
+  if(sound_main_ram_hook != -1) {
+    pc_hooks.Unregister(sound_main_ram_hook);
+    sound_main_ram_hook = -1;
+  }
+
   if(config->audio.mp2k_hle_enable) {
     apu.GetMP2K().UseCubicFilter() = config->audio.mp2k_hle_cubic;
     apu.GetMP2K().ForceReverb() = config->audio.mp2k_hle_force_reverb;
-    hle_audio_hook = SearchSoundMainRAM();
-    if(hle_audio_hook != 0xFFFFFFFF) {
-      Log<Info>("Core: detected MP2K audio mixer @ 0x{:08X}", hle_audio_hook);
+    u32 sound_main_ram = SearchSoundMainRAM();
+    if(sound_main_ram != 0xFFFFFFFF) {
+      Log<Info>("Core: detected MP2K audio mixer @ 0x{:08X}", sound_main_ram);
+      sound_main_ram_hook = pc_hooks.Register<&Core::SoundMainRAMHook>(sound_main_ram, this);
     }
-  } else {
-    hle_audio_hook = 0xFFFFFFFF;
   }
+
+  idle_loop.Reset();
+  idle_loop.SetOverrideAddress(SearchIdleLoopOverride());
 }
 
 void Core::Attach(std::vector<u8> const& bios) {
   bus.Attach(bios);
+  have_bios = true;
 }
 
 void Core::Attach(ROM&& rom) {
@@ -72,24 +97,63 @@ auto Core::CreateSolarSensor() -> std::unique_ptr<SolarSensor> {
 }
 
 void Core::Run(int cycles) {
-  using HaltControl = Bus::Hardware::HaltControl;
-
   const auto limit = scheduler.GetTimestampNow() + cycles;
 
-  while(scheduler.GetTimestampNow() < limit) {
+  // Without any hooks the emulation loop does not test for them at all.
+  if(pc_hooks.Empty()) {
+    RunUntil<false>(limit);
+  } else {
+    RunUntil<true>(limit);
+  }
+}
+
+template<bool with_hooks>
+void Core::RunUntil(u64 timestamp_limit) {
+  using HaltControl = Bus::Hardware::HaltControl;
+
+  while(scheduler.GetTimestampNow() < timestamp_limit) {
     if(bus.hw.haltcnt == HaltControl::Run) {
-      if(cpu.state.r15 == hle_audio_hook) {
-        // @todo: cache the SoundInfo pointer once we have it?
-        apu.GetMP2K().SoundMainRAM(
-          *bus.GetHostAddress<MP2K::SoundInfo>(
-            *bus.GetHostAddress<u32>(0x03007FF0)
-          )
-        );
+      if constexpr(!with_hooks) {
+        // Unless the idle loop detector must see every instruction,
+        // the CPU runs without interruption until it halts.
+        if(!config->cpu.idle_loop_skip) {
+          if(config->cpu.backend == Config::CPU::Backend::CachedInterpreter) {
+            cpu.RunBlocksUntil(timestamp_limit);
+          } else if(config->cpu.backend == Config::CPU::Backend::JIT) {
+            cpu.RunCompiledUntil(timestamp_limit);
+          } else {
+            cpu.RunUntil(timestamp_limit);
+          }
+          continue;
+        }
+      }
+
+      if(config->cpu.idle_loop_skip && idle_loop.Update() && !cpu.IRQLine() && !dma.IsRunning()) {
+        // The CPU spins until an event changes the hardware state.
+        bus.Step(scheduler.GetRemainingCycleCount());
+        continue;
+      }
+
+      if constexpr(with_hooks) {
+        const u32 address = (cpu.state.r15 & ~1) - (cpu.state.cpsr.f.thumb ? 4 : 8);
+
+        // Code in hooked pages runs one instruction at a time, so that no hook is missed.
+        if(pc_hooks.IsPageHooked(address)) {
+          pc_hooks.Call(address);
+          cpu.Run();
+          continue;
+        }
       }
 
-      cpu.Run();
+      if(config->cpu.backend == Config::CPU::Backend::CachedInterpreter && !idle_loop.IsWatching()) {
+        cpu.RunBlock(timestamp_limit);
+      } else if(config->cpu.backend == Config::CPU::Backend::JIT && !idle_loop.IsWatching()) {
+        cpu.RunCompiledBlock(timestamp_limit);
+      } else {
+        cpu.Run();
+      }
     } else {
-      while(scheduler.GetTimestampNow() < limit && !irq.ShouldUnhaltCPU()) {
+      while(scheduler.GetTimestampNow() < timestamp_limit && !irq.ShouldUnhaltCPU()) {
         if(dma.IsRunning()) {
           dma.Run();
           if(irq.ShouldUnhaltCPU()) continue; // can become true during the DMA
@@ -135,19 +199,45 @@ auto Core::SearchSoundMainRAM() -> u32 {
        */
       address = read<u32>(rom.data(), address + 0x74);
       if(address & 1) {
-        address &= ~1;
-        address += sizeof(u16) * 2;
-      } else {
-        address &= ~3;
-        address += sizeof(u32) * 2;
+        return address & ~1;
       }
-      return address;
+      return address & ~3;
     }
   }
 
   return 0xFFFFFFFF;
 }
 
+void Core::SoundMainRAMHook() {
+  // @todo: cache the SoundInfo pointer once we have it?
+  apu.GetMP2K().SoundMainRAM(
+    *bus.GetHostAddress<MP2K::SoundInfo>(
+      *bus.GetHostAddress<u32>(0x03007FF0)
+    )
+  );
+}
+
+auto Core::SearchIdleLoopOverride() -> u32 {
+  auto& rom = bus.memory.rom.GetRawROM();
+
+  if(rom.size() < sizeof(Header) || config->cpu.idle_loop_overrides.empty()) {
+    return 0xFFFFFFFF;
+  }
+
+  auto header = reinterpret_cast<Header*>(rom.data());
+  auto game_code = std::string{};
+  game_code.assign(header->game.code, 4);
+
+  auto match = config->cpu.idle_loop_overrides.find(game_code);
+
+  if(match != config->cpu.idle_loop_overrides.end()) {
+    Log<Info>("Core: using idle loop @ 0x{:08X} for game {}", match->second, game_code);
+    return match->second;
+  }
+
+  return 0xFFFFFFFF;
+}
+
 auto Core::GetROM() -> ROM& {
   return bus.memory.rom;
 }
@@ -160,6 +250,10 @@ auto Core::GetVRAM() -> u8* {
   return ppu.GetVRAM();
 }
 
+auto Core::GetDirtyVideoPages() -> VideoPages {
+  return ppu.GetAndClearDirtyPages();
+}
+
 auto Core::PeekByteIO(u32 address) -> u8  {
   return bus.hw.ReadByte(address);
 }
@@ -184,6 +278,60 @@ Scheduler& Core::GetScheduler() {
   return scheduler;
 }
 
+auto Core::GetSchedulerStats([[maybe_unused]] Scheduler::EventClass event_class) -> Scheduler::EventClassStats {
+#ifdef NBA_SCHEDULER_STATS
+  return scheduler.GetEventClassStats(event_class);
+#else
+  return {};
+#endif
+}
+
+auto Core::AddWatchpoint(u32 address, u32 size, WatchpointCallback callback) -> int {
+  return bus.AddWatchpoint(address, size, std::move(callback));
+}
+
+void Core::RemoveWatchpoint(int id) {
+  bus.RemoveWatchpoint(id);
+}
+
+auto Core::AddPCHook(u32 address, PCHookCallback callback) -> int {
+  return pc_hooks.Register(address, std::move(callback));
+}
+
+void Core::RemovePCHook(int id) {
+  pc_hooks.Unregister(id);
+}
+
+bool Core::StartBusTrace([[maybe_unused]] std::string const& path) {
+#ifdef NBA_BUS_TRACE
+  return bus.trace.Start(path);
+#else
+  Log<Error>("Core: bus tracing is not available, the core was built without NBA_BUS_TRACE");
+  return false;
+#endif
+}
+
+void Core::StopBusTrace() {
+#ifdef NBA_BUS_TRACE
+  bus.trace.Stop();
+#endif
+}
+
+bool Core::StartCPUTrace([[maybe_unused]] std::string const& path) {
+#ifdef NBA_ARM_TRACE
+  return cpu.trace.Start(path);
+#else
+  Log<Error>("Core: CPU tracing is not available, the core was built without NBA_ARM_TRACE");
+  return false;
+#endif
+}
+
+void Core::StopCPUTrace() {
+#ifdef NBA_ARM_TRACE
+  cpu.trace.Stop();
+#endif
+}
+
 } // namespace nba::core
 
 auto CreateCore(
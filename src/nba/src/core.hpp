@@ -9,6 +9,8 @@
 #include <nba/scheduler.hpp>
 
 #include "arm/arm7tdmi.hpp"
+#include "arm/idle_loop.hpp"
+#include "arm/pc_hooks.hpp"
 #include "bus/bus.hpp"
 #include "hw/apu/apu.hpp"
 #include "hw/ppu/ppu.hpp"
@@ -21,6 +23,7 @@ namespace nba::core {
 
 struct Core final : CoreBase {
   Core(std::shared_ptr<Config> config);
+ ~Core() override;
 
   void Reset() override;
 
@@ -35,6 +38,7 @@ struct Core final : CoreBase {
   auto GetROM() -> ROM& override;
   auto GetPRAM() -> u8* override;
   auto GetVRAM() -> u8* override;
+  auto GetDirtyVideoPages() -> VideoPages override;
   auto PeekByteIO(u32 address) -> u8  override;
   auto PeekHalfIO(u32 address) -> u16 override;
   auto PeekWordIO(u32 address) -> u32 override;
@@ -42,12 +46,26 @@ struct Core final : CoreBase {
   auto GetBGVOFS(int id) -> u16 override;
 
   Scheduler& GetScheduler() override;
+  auto GetSchedulerStats(Scheduler::EventClass event_class) -> Scheduler::EventClassStats override;
+  auto AddWatchpoint(u32 address, u32 size, WatchpointCallback callback) -> int override;
+  void RemoveWatchpoint(int id) override;
+  auto AddPCHook(u32 address, PCHookCallback callback) -> int override;
+  void RemovePCHook(int id) override;
+  bool StartBusTrace(std::string const& path) override;
+  void StopBusTrace() override;
+  bool StartCPUTrace(std::string const& path) override;
+  void StopCPUTrace() override;
 
 private:
+  template<bool with_hooks>
+  void RunUntil(u64 timestamp_limit);
+
   void SkipBootScreen();
+  void SoundMainRAMHook();
   auto SearchSoundMainRAM() -> u32;
+  auto SearchIdleLoopOverride() -> u32;
 
-  u32 hle_audio_hook;
+  bool have_bios = false;
   std::shared_ptr<Config> config;
 
   Scheduler scheduler;
@@ -60,6 +78,9 @@ private:
   Timer timer;
   KeyPad keypad;
   Bus bus;
+  arm::IdleLoopDetector idle_loop;
+  arm::PCHooks pc_hooks;
+  int sound_main_ram_hook = -1;
 };
 
 } // namespace nba::core
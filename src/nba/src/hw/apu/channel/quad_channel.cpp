@@ -13,7 +13,7 @@ QuadChannel::QuadChannel(Scheduler& scheduler, Scheduler::EventClass event_class
     : BaseChannel(true, true)
     , scheduler(scheduler)
     , event_class(event_class) {
-  scheduler.Register(event_class, this, &QuadChannel::Generate);
+  scheduler.Register<&QuadChannel::Generate>(event_class, this);
 
   Reset();
 }
@@ -72,7 +72,7 @@ DMA::DMA(Bus& bus, IRQ& irq, Scheduler& scheduler)
     : bus(bus)
     , irq(irq)
     , scheduler(scheduler) {
-  scheduler.Register(Scheduler::EventClass::DMA_activated, this, &DMA::OnActivated);
+  scheduler.Register<&DMA::OnActivated>(Scheduler::EventClass::DMA_activated, this);
 
   Reset();
 }
@@ -15,7 +15,7 @@ KeyPad::KeyPad(Scheduler& scheduler, IRQ& irq, std::shared_ptr<Config> config)
     : scheduler(scheduler)
     , irq(irq)
     , config(config) {
-  scheduler.Register(Scheduler::EventClass::KeyPad_Poll, this, &KeyPad::Poll);
+  scheduler.Register<&KeyPad::Poll>(Scheduler::EventClass::KeyPad_Poll, this);
 
   Reset();
 }
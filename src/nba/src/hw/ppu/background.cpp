@@ -170,4 +170,247 @@ template<int mode> void PPU::DrawBackgroundImpl(int cycles) {
   }
 }
 
+void PPU::RenderScanlineBG() {
+  // BG pixels are not used during forced blank.
+  if(ForcedBlank()) {
+    return;
+  }
+
+  const u16 latched_dispcnt_and_current_dispcnt = mmio.dispcnt_latch[0] & mmio.dispcnt.hword;
+  const int mode = mmio.dispcnt.mode;
+
+  if(mode <= 1) {
+    for(int id = 0; id <= (mode == 0 ? 3 : 1); id++) {
+      if(latched_dispcnt_and_current_dispcnt & (256U << id)) {
+        RenderScanlineTextBG(id);
+      }
+    }
+  }
+
+  if(mode == 1 || mode == 2) {
+    for(int id = 0; id <= (mode == 2 ? 1 : 0); id++) {
+      if(latched_dispcnt_and_current_dispcnt & (1024U << id)) {
+        RenderScanlineAffineBG(id);
+      }
+    }
+  }
+
+  if(latched_dispcnt_and_current_dispcnt & 1024U) {
+    switch(mode) {
+      case 3: RenderScanlineBitmapBG<3>(); break;
+      case 4: RenderScanlineBitmapBG<4>(); break;
+      case 5: RenderScanlineBitmapBG<5>(); break;
+    }
+  }
+}
+
+void PPU::RenderScanlineTextBG(int id) {
+  const auto& bgcnt = mmio.bgcnt[id];
+  const u32 tile_base = bgcnt.tile_block << 14;
+  const uint bghofs = mmio.bghofs[id];
+
+  uint line = mmio.vcount + mmio.bgvofs[id];
+
+  if(bgcnt.mosaic_enable) {
+    line -= (uint)mmio.mosaic.bg._counter_y;
+  }
+
+  const uint grid_y = line >> 3;
+  const uint tile_y = line & 7U;
+  const uint screen_y = (grid_y >> 5) & 1U;
+
+  uint grid_x = bghofs >> 3;
+  int x = -(int)(bghofs & 7U);
+
+  const auto Plot = [&](uint index) {
+    if(x >= 0 && x < 240) {
+      bg.buffer[x][id] = index;
+    }
+    x++;
+  };
+
+  while(x < 240) {
+    const uint screen_x = (grid_x >> 5) & 1U;
+
+    uint map_block = bgcnt.map_block;
+
+    switch(bgcnt.size) {
+      case 1: map_block += screen_x; break;
+      case 2: map_block += screen_y; break;
+      case 3: map_block += screen_x + (screen_y << 1); break;
+    }
+
+    const u32 address = (map_block << 11) + ((grid_y & 31U) << 6) + ((grid_x & 31U) << 1);
+
+    const u16 tile = FetchVRAM_BG_Scanline<u16>(address);
+
+    const uint number = tile & 0x3FFU;
+    const bool flip_x = tile & (1U << 10);
+    const bool flip_y = tile & (1U << 11);
+    const uint palette = tile >> 12;
+
+    const uint real_tile_y = flip_y ? (7 - tile_y) : tile_y;
+
+    const u32 tile_base_address = tile_base + (number << (bgcnt.full_palette ? 6 : 5));
+
+    if(tile_base_address < TileCache::kSize) {
+      const uint row_size = bgcnt.full_palette ? 8U : 4U;
+      const u32 row_address = tile_base_address + real_tile_y * row_size;
+
+      // Latch the last halfword which the fetches below would have read.
+      vram_bg_latch = read<u16>(vram, flip_x ? row_address : (row_address + row_size - 2U));
+
+      if(bgcnt.full_palette) {
+        const u8* row = tile_cache.GetRow8BPP(vram, tile_base_address, real_tile_y, flip_x);
+
+        for(int i = 0; i < 8; i++) {
+          Plot(row[i]);
+        }
+      } else {
+        const u8* row = tile_cache.GetRow4BPP(vram, tile_base_address, real_tile_y, flip_x);
+
+        for(int i = 0; i < 8; i++) {
+          uint index = row[i];
+
+          if(index != 0U) {
+            index |= palette << 4;
+          }
+
+          Plot(index);
+        }
+      }
+
+      grid_x++;
+      continue;
+    }
+
+    u32 tile_address;
+    int fetches;
+
+    if(bgcnt.full_palette) {
+      tile_address = tile_base + (number << 6) + (real_tile_y << 3);
+
+      if(flip_x) {
+        tile_address += 6;
+      }
+
+      fetches = 4;
+    } else {
+      tile_address = tile_base + (number << 5) + (real_tile_y << 2);
+
+      if(flip_x) {
+        tile_address += 2;
+      }
+
+      fetches = 2;
+    }
+
+    for(int i = 0; i < fetches; i++) {
+      u16 data = FetchVRAM_BG_Scanline<u16>(tile_address);
+
+      if(flip_x) {
+        data = (data >> 8) | (data << 8);
+
+        if(!bgcnt.full_palette) {
+          data = ((data & 0xF0F0U) >> 4) | ((data & 0x0F0FU) << 4);
+        }
+
+        tile_address -= sizeof(u16);
+      } else {
+        tile_address += sizeof(u16);
+      }
+
+      if(bgcnt.full_palette) {
+        Plot(data & 0xFFU);
+        Plot(data >> 8);
+      } else {
+        for(int j = 0; j < 4; j++) {
+          uint index = data & 0x0FU;
+
+          if(index != 0U) {
+            index |= palette << 4;
+          }
+
+          Plot(index);
+
+          data >>= 4;
+        }
+      }
+    }
+
+    grid_x++;
+  }
+}
+
+void PPU::RenderScanlineAffineBG(int id) {
+  const auto& bgcnt = mmio.bgcnt[2 + id];
+
+  const int log_size = bgcnt.size;
+  const s32 size = 128 << log_size;
+  const s32 mask = size - 1;
+
+  const s16 bgpa = mmio.bgpa[id];
+  const s16 bgpc = mmio.bgpc[id];
+
+  s32 ref_x = bg.affine[id].x;
+  s32 ref_y = bg.affine[id].y;
+
+  for(int screen_x = 0; screen_x < 240; screen_x++) {
+    s32 x = ref_x >> 8;
+    s32 y = ref_y >> 8;
+
+    ref_x += bgpa;
+    ref_y += bgpc;
+
+    if(bgcnt.wraparound) {
+      x &= mask;
+      y &= mask;
+    } else if(((x | y) & -size) != 0) {
+      bg.buffer[screen_x][2 + id] = 0U;
+      continue;
+    }
+
+    const u16 address = (bgcnt.map_block << 11) + ((y >> 3) << (4 + log_size)) + (x >> 3);
+    const u8 tile = FetchVRAM_BG_Scanline<u8>(address);
+    const u16 tile_address = (bgcnt.tile_block << 14) + (tile << 6) + ((y & 7) << 3) + (x & 7);
+
+    bg.buffer[screen_x][2 + id] = FetchVRAM_BG_Scanline<u8>(tile_address);
+  }
+}
+
+template<int mode> void PPU::RenderScanlineBitmapBG() {
+  constexpr s32 width  = mode == 5 ? 160 : 240;
+  constexpr s32 height = mode == 5 ? 128 : 160;
+
+  const u32 frame_address = mode == 3 ? 0U : mmio.dispcnt.frame * 0xA000U;
+
+  const s16 bgpa = mmio.bgpa[0];
+  const s16 bgpc = mmio.bgpc[0];
+
+  s32 ref_x = bg.affine[0].x;
+  s32 ref_y = bg.affine[0].y;
+
+  for(int screen_x = 0; screen_x < 240; screen_x++) {
+    const s32 x = ref_x >> 8;
+    const s32 y = ref_y >> 8;
+
+    ref_x += bgpa;
+    ref_y += bgpc;
+
+    u32 color = 0U;
+
+    if(x >= 0 && x < width && y >= 0 && y < height) {
+      const u32 offset = (u32)y * width + (u32)x;
+
+      if constexpr(mode == 4) {
+        color = FetchVRAM_BG_Scanline<u8>(frame_address + offset);
+      } else {
+        color = FetchVRAM_BG_Scanline<u16>(frame_address + offset * 2U) | 0x8000'0000;
+      }
+    }
+
+    bg.buffer[screen_x][2] = color;
+  }
+}
+
 } // namespace nba::core
@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "hw/ppu/compose.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #define NBA_COMPOSE_X64
+
+  #include <immintrin.h>
+
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+
+  #if defined(__GNUC__) || defined(__clang__)
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+  #else
+    #define TARGET_AVX2
+  #endif
+#endif
+
+namespace nba::core {
+
+void Compose(ComposeLine const& line, u32* out) {
+  static const auto compose = HostSupportsAVX2() ? ComposeAVX2 : (HostSupportsSSE2() ? ComposeSSE2 : ComposeScalar);
+
+  compose(line, out);
+}
+
+void ComposeScalar(ComposeLine const& line, u32* out) {
+  u16 colors[240];
+
+  for(int x = 0; x < 240; x++) {
+    colors[x] = Blend(line.color_a[x], line.color_b[x], line.eva[x], line.evb[x]);
+  }
+
+  if(line.greenswap) {
+    for(int x = 0; x < 240; x += 2) {
+      const u16 mask = line.greenswap_mask[x];
+
+      const u16 color_l = colors[x + 0];
+      const u16 color_r = colors[x + 1];
+
+      colors[x + 0] = (color_l & ~mask) | (color_r & mask);
+      colors[x + 1] = (color_r & ~mask) | (color_l & mask);
+    }
+  }
+
+  for(int x = 0; x < 240; x++) {
+    out[x] = RGB555(colors[x]);
+  }
+}
+
+#ifdef NBA_COMPOSE_X64
+
+/* The SIMD implementations work on 16-bit lanes, which are wide enough for
+ * all intermediate results. Green is expanded to six bits with bit 15 as the
+ * least significant bit and reduced to five bits after blending, like in Blend().
+ */
+
+template<bool greenswap>
+static void ComposeSSE2Impl(ComposeLine const& line, u32* out) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i mask31 = _mm_set1_epi16(31);
+  const __m128i mask62 = _mm_set1_epi16(62);
+  const __m128i max63 = _mm_set1_epi16(63);
+  const __m128i round = _mm_set1_epi16(8);
+  const __m128i alpha = _mm_set1_epi16((s16)0xFF00);
+
+  const auto Mix = [&](__m128i a, __m128i b, __m128i eva, __m128i evb) {
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a, eva), _mm_mullo_epi16(b, evb)), round), 4);
+  };
+
+  const auto Green = [&](__m128i color) {
+    return _mm_or_si128(_mm_and_si128(_mm_srli_epi16(color, 4), mask62), _mm_srli_epi16(color, 15));
+  };
+
+  const auto Expand = [&](__m128i value) {
+    return _mm_or_si128(_mm_slli_epi16(value, 3), _mm_srli_epi16(value, 2));
+  };
+
+  for(int x = 0; x < 240; x += 8) {
+    const __m128i color_a = _mm_loadu_si128((__m128i const*)&line.color_a[x]);
+    const __m128i color_b = _mm_loadu_si128((__m128i const*)&line.color_b[x]);
+    const __m128i eva = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const*)&line.eva[x]), zero);
+    const __m128i evb = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const*)&line.evb[x]), zero);
+
+    const __m128i r = _mm_min_epi16(Mix(_mm_and_si128(color_a, mask31), _mm_and_si128(color_b, mask31), eva, evb), mask31);
+    const __m128i g = _mm_srli_epi16(_mm_min_epi16(Mix(Green(color_a), Green(color_b), eva, evb), max63), 1);
+    const __m128i b = _mm_min_epi16(Mix(
+      _mm_and_si128(_mm_srli_epi16(color_a, 10), mask31),
+      _mm_and_si128(_mm_srli_epi16(color_b, 10), mask31), eva, evb), mask31);
+
+    __m128i color = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(b, 10), _mm_slli_epi16(g, 5)), r);
+
+    if constexpr(greenswap) {
+      const __m128i mask = _mm_loadu_si128((__m128i const*)&line.greenswap_mask[x]);
+      const __m128i swapped = _mm_or_si128(_mm_slli_epi32(color, 16), _mm_srli_epi32(color, 16));
+
+      color = _mm_or_si128(_mm_andnot_si128(mask, color), _mm_and_si128(mask, swapped));
+    }
+
+    const __m128i r8 = Expand(_mm_and_si128(color, mask31));
+    const __m128i g8 = Expand(_mm_and_si128(_mm_srli_epi16(color, 5), mask31));
+    const __m128i b8 = Expand(_mm_and_si128(_mm_srli_epi16(color, 10), mask31));
+
+    const __m128i lo = _mm_or_si128(b8, _mm_slli_epi16(g8, 8));
+    const __m128i hi = _mm_or_si128(r8, alpha);
+
+    _mm_storeu_si128((__m128i*)&out[x + 0], _mm_unpacklo_epi16(lo, hi));
+    _mm_storeu_si128((__m128i*)&out[x + 4], _mm_unpackhi_epi16(lo, hi));
+  }
+}
+
+template<bool greenswap>
+TARGET_AVX2 static void ComposeAVX2Impl(ComposeLine const& line, u32* out) {
+  const __m256i mask31 = _mm256_set1_epi16(31);
+  const __m256i mask62 = _mm256_set1_epi16(62);
+  const __m256i max63 = _mm256_set1_epi16(63);
+  const __m256i round = _mm256_set1_epi16(8);
+  const __m256i alpha = _mm256_set1_epi16((s16)0xFF00);
+
+  // Lambdas do not inherit the target attribute of the enclosing function, so use macros here.
+  #define MIX(a, b) _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(a, eva), _mm256_mullo_epi16(b, evb)), round), 4)
+  #define GREEN(color) _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(color, 4), mask62), _mm256_srli_epi16(color, 15))
+  #define EXPAND(value) _mm256_or_si256(_mm256_slli_epi16(value, 3), _mm256_srli_epi16(value, 2))
+
+  for(int x = 0; x < 240; x += 16) {
+    const __m256i color_a = _mm256_loadu_si256((__m256i const*)&line.color_a[x]);
+    const __m256i color_b = _mm256_loadu_si256((__m256i const*)&line.color_b[x]);
+    const __m256i eva = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const*)&line.eva[x]));
+    const __m256i evb = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const*)&line.evb[x]));
+
+    const __m256i r = _mm256_min_epi16(MIX(_mm256_and_si256(color_a, mask31), _mm256_and_si256(color_b, mask31)), mask31);
+    const __m256i g = _mm256_srli_epi16(_mm256_min_epi16(MIX(GREEN(color_a), GREEN(color_b)), max63), 1);
+    const __m256i b = _mm256_min_epi16(MIX(
+      _mm256_and_si256(_mm256_srli_epi16(color_a, 10), mask31),
+      _mm256_and_si256(_mm256_srli_epi16(color_b, 10), mask31)), mask31);
+
+    __m256i color = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(b, 10), _mm256_slli_epi16(g, 5)), r);
+
+    if constexpr(greenswap) {
+      const __m256i mask = _mm256_loadu_si256((__m256i const*)&line.greenswap_mask[x]);
+      const __m256i swapped = _mm256_or_si256(_mm256_slli_epi32(color, 16), _mm256_srli_epi32(color, 16));
+
+      color = _mm256_or_si256(_mm256_andnot_si256(mask, color), _mm256_and_si256(mask, swapped));
+    }
+
+    const __m256i r8 = EXPAND(_mm256_and_si256(color, mask31));
+    const __m256i g8 = EXPAND(_mm256_and_si256(_mm256_srli_epi16(color, 5), mask31));
+    const __m256i b8 = EXPAND(_mm256_and_si256(_mm256_srli_epi16(color, 10), mask31));
+
+    const __m256i lo = _mm256_or_si256(b8, _mm256_slli_epi16(g8, 8));
+    const __m256i hi = _mm256_or_si256(r8, alpha);
+
+    // The unpack instructions work within 128-bit lanes: pixels 0 - 3 and 8 - 11, 4 - 7 and 12 - 15.
+    const __m256i argb_0 = _mm256_unpacklo_epi16(lo, hi);
+    const __m256i argb_1 = _mm256_unpackhi_epi16(lo, hi);
+
+    _mm256_storeu_si256((__m256i*)&out[x + 0], _mm256_permute2x128_si256(argb_0, argb_1, 0x20));
+    _mm256_storeu_si256((__m256i*)&out[x + 8], _mm256_permute2x128_si256(argb_0, argb_1, 0x31));
+  }
+
+  #undef MIX
+  #undef GREEN
+  #undef EXPAND
+}
+
+void ComposeSSE2(ComposeLine const& line, u32* out) {
+  if(line.greenswap) {
+    ComposeSSE2Impl<true>(line, out);
+  } else {
+    ComposeSSE2Impl<false>(line, out);
+  }
+}
+
+TARGET_AVX2 void ComposeAVX2(ComposeLine const& line, u32* out) {
+  if(line.greenswap) {
+    ComposeAVX2Impl<true>(line, out);
+  } else {
+    ComposeAVX2Impl<false>(line, out);
+  }
+}
+
+bool HostSupportsSSE2() {
+  // SSE2 is part of the x86-64 baseline.
+  return true;
+}
+
+bool HostSupportsAVX2() {
+#ifdef _MSC_VER
+  int info[4];
+
+  __cpuid(info, 1);
+
+  // The OS must save the YMM registers (OSXSAVE, AVX and XCR0 bits 1 and 2).
+  if((info[2] & (3 << 27)) != (3 << 27) || (_xgetbv(0) & 6U) != 6U) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+
+  return info[1] & (1 << 5);
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#else
+
+void ComposeSSE2(ComposeLine const& line, u32* out) {
+  ComposeScalar(line, out);
+}
+
+void ComposeAVX2(ComposeLine const& line, u32* out) {
+  ComposeScalar(line, out);
+}
+
+bool HostSupportsSSE2() {
+  return false;
+}
+
+bool HostSupportsAVX2() {
+  return false;
+}
+
+#endif // NBA_COMPOSE_X64
+
+auto Blend(u16 color_a, u16 color_b, int eva, int evb) -> u16 {
+  const int r_a =  (color_a >>  0) & 31;
+  const int g_a = ((color_a >>  4) & 62) | (color_a >> 15);
+  const int b_a =  (color_a >> 10) & 31;
+
+  const int r_b =  (color_b >>  0) & 31;
+  const int g_b = ((color_b >>  4) & 62) | (color_b >> 15);
+  const int b_b =  (color_b >> 10) & 31;
+
+  eva = std::min<int>(16, eva);
+  evb = std::min<int>(16, evb);
+
+  const int r = std::min<u8>((r_a * eva + r_b * evb + 8) >> 4, 31);
+  const int g = std::min<u8>((g_a * eva + g_b * evb + 8) >> 4, 63) >> 1;
+  const int b = std::min<u8>((b_a * eva + b_b * evb + 8) >> 4, 31);
+
+  return (u16)((b << 10) | (g << 5) | r);
+}
+
+auto Brighten(u16 color, int evy) -> u16 {
+  evy = std::min<int>(16, evy);
+
+  int r =  (color >>  0) & 31;
+  int g = ((color >>  4) & 62) | (color >> 15);
+  int b =  (color >> 10) & 31;
+
+  r += ((31 - r) * evy + 8) >> 4;
+  g += ((63 - g) * evy + 8) >> 4;
+  b += ((31 - b) * evy + 8) >> 4;
+
+  g >>= 1;
+
+  return (u16)((b << 10) | (g << 5) | r);
+}
+
+auto Darken(u16 color, int evy) -> u16 {
+  evy = std::min<int>(16, evy);
+
+  int r =  (color >>  0) & 31;
+  int g = ((color >>  4) & 62) | (color >> 15);
+  int b =  (color >> 10) & 31;
+
+  r -= (r * evy + 7) >> 4;
+  g -= (g * evy + 7) >> 4;
+  b -= (b * evy + 7) >> 4;
+
+  g >>= 1;
+
+  return (u16)((b << 10) | (g << 5) | r);
+}
+
+auto RGB555(u16 rgb555) -> u32 {
+  const uint r = (rgb555 >>  0) & 31U;
+  const uint g = (rgb555 >>  5) & 31U;
+  const uint b = (rgb555 >> 10) & 31U;
+
+  return 0xFF000000 | (r << 3 | r >> 2) << 16 | (g << 3 | g >> 2) << 8 | (b << 3 | b >> 2);
+}
+
+} // namespace nba::core
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <nba/common/compiler.hpp>
+#include <nba/integer.hpp>
+
+namespace nba::core {
+
+/**
+ * Color special effects and output conversion of one scanline.
+ *
+ * The merge engine records the top two colors of each pixel together with
+ * a pair of blend coefficients and the whole scanline is composed at its end.
+ * Every effect is a blend (a * eva + b * evb) / 16: brightness increase
+ * blends with white, brightness decrease with black and a pixel without
+ * an effect has eva = 16 and evb = 0. This gives the exact same results
+ * as Blend(), Brighten() and Darken().
+ */
+struct ComposeLine {
+  u16 color_a[240];
+  u16 color_b[240];
+  u8 eva[240];
+  u8 evb[240];
+
+  // Green bits which are swapped with those of the other pixel of the pair (GREENSWAP).
+  u16 greenswap_mask[240];
+  bool greenswap;
+
+  void ALWAYS_INLINE SetNone(uint x, u16 color) {
+    Set(x, color, 0U, 16, 0);
+  }
+
+  void ALWAYS_INLINE SetBlend(uint x, u16 color_a, u16 color_b, int eva, int evb) {
+    Set(x, color_a, color_b, std::min(16, eva), std::min(16, evb));
+  }
+
+  void ALWAYS_INLINE SetBrighten(uint x, u16 color, int evy) {
+    evy = std::min(16, evy);
+
+    Set(x, color, 0xFFFFU, 16 - evy, evy);
+  }
+
+  void ALWAYS_INLINE SetDarken(uint x, u16 color, int evy) {
+    Set(x, color, 0U, 16 - std::min(16, evy), 0);
+  }
+
+  // Sets whether the pixel pair which ends with pixel 'x' has its green bits swapped.
+  void ALWAYS_INLINE SetGreenswap(uint x, bool enable) {
+    const u16 mask = enable ? (31U << 5) : 0U;
+
+    greenswap_mask[x - 1] = mask;
+    greenswap_mask[x - 0] = mask;
+    greenswap |= enable;
+  }
+
+private:
+  void ALWAYS_INLINE Set(uint x, u16 color_a, u16 color_b, int eva, int evb) {
+    this->color_a[x] = color_a;
+    this->color_b[x] = color_b;
+    this->eva[x] = (u8)eva;
+    this->evb[x] = (u8)evb;
+  }
+};
+
+// Composes a scanline into 240 ARGB8888 pixels, using the fastest implementation that the host supports.
+void Compose(ComposeLine const& line, u32* out);
+
+// Individual implementations of Compose(). On hosts other than x86-64 the SSE2 and AVX2 ones fall back to ComposeScalar().
+void ComposeScalar(ComposeLine const& line, u32* out);
+void ComposeSSE2(ComposeLine const& line, u32* out);
+void ComposeAVX2(ComposeLine const& line, u32* out);
+
+bool HostSupportsSSE2();
+bool HostSupportsAVX2();
+
+auto Blend(u16 color_a, u16 color_b, int eva, int evb) -> u16;
+auto Brighten(u16 color, int evy) -> u16;
+auto Darken(u16 color, int evy) -> u16;
+auto RGB555(u16 rgb555) -> u32;
+
+} // namespace nba::core
@@ -7,16 +7,210 @@
 
 #include <algorithm>
 
+#include "hw/ppu/compose.hpp"
 #include "ppu.hpp"
 
 namespace nba::core {
 
-static u32 RGB555(u16 rgb555) {
-  const uint r = (rgb555 >>  0) & 31U;
-  const uint g = (rgb555 >>  5) & 31U;
-  const uint b = (rgb555 >> 10) & 31U;
+static constexpr int k_min_max_bg[8][2] {
+  {0,  3}, // Mode 0 (BG0 - BG3 text-mode)
+  {0,  2}, // Mode 1 (BG0 - BG1 text-mode, BG2 affine)
+  {2,  3}, // Mode 2 (BG2 - BG3 affine)
+  {2,  2}, // Mode 3 (BG2 240x160 65526-color bitmap)
+  {2,  2}, // Mode 4 (BG2 240x160 256-color bitmap, double-buffered)
+  {2,  2}, // Mode 5 (BG2 160x128 65536-color bitmap, double-buffered)
+  {0, -1}, // Mode 6 (invalid)
+  {0, -1}, // Mode 7 (invalid)
+};
+
+PPU::Merge::Setup::Setup(MMIO const& mmio) {
+  const int mode = mmio.dispcnt.mode;
+
+  const int min_bg = k_min_max_bg[mode][0];
+  const int max_bg = k_min_max_bg[mode][1];
+
+  const u16 latched_dispcnt_and_current_dispcnt = mmio.dispcnt_latch[0] & mmio.dispcnt.hword;
+
+  for(int priority = 0; priority <= 3; priority++) {
+    for(int id = min_bg; id <= max_bg; id++) {
+      if(mmio.bgcnt[id].priority == priority && (latched_dispcnt_and_current_dispcnt & (256U << id))) {
+        bg_list[bg_count++] = id;
+      }
+    }
+  }
+
+  enable_obj = latched_dispcnt_and_current_dispcnt & (256U << LAYER_OBJ);
 
-  return 0xFF000000 | (r << 3 | r >> 2) << 16 | (g << 3 | g >> 2) << 8 | (b << 3 | b >> 2);
+  enable_win0 = mmio.dispcnt.enable[ENABLE_WIN0];
+  enable_win1 = mmio.dispcnt.enable[ENABLE_WIN1];
+  enable_objwin = mmio.dispcnt.enable[ENABLE_OBJWIN] && enable_obj;
+
+  have_windows = enable_win0 || enable_win1 || enable_objwin;
+}
+
+auto PPU::Merge::SelectWindow(Setup const& setup, MMIO const& mmio, bool const window[2], Sprite::Pixel const& sprite_pixel) -> int const* {
+  // @todo: optimize this, this is baaad
+  if(!setup.have_windows) {
+    return nullptr;
+  }
+
+  if(setup.enable_win0 && window[0]) {
+    return mmio.winin.enable[0];
+  }
+
+  if(setup.enable_win1 && window[1]) {
+    return mmio.winin.enable[1];
+  }
+
+  if(setup.enable_objwin && sprite_pixel.window) {
+    return mmio.winout.enable[1];
+  }
+
+  return mmio.winout.enable[0];
+}
+
+template<typename ReadPalette>
+static void ALWAYS_INLINE ResolveColor(u32& color, ReadPalette& read_palette) {
+  // @todo: make it clear what the meaning of 0x8000'0000 is.
+  if((color & 0x8000'0000) == 0) {
+    color = read_palette(color << 1);
+  }
+}
+
+template<typename ReadPalette>
+bool PPU::Merge::SelectLayers(
+  Setup const& setup,
+  MMIO const& mmio,
+  int const* win_layer_enable,
+  u32 const (*bg_buffer)[4],
+  uint x,
+  uint const mosaic_x[2],
+  Sprite::Pixel const& sprite_pixel,
+  Sprite::Pixel& sprite_pixel_latch,
+  int layers[2],
+  u32 colors[2],
+  ReadPalette&& read_palette
+) {
+  uint priorities[2] {3U, 3U};
+
+  layers[0] = LAYER_BD;
+  layers[1] = LAYER_BD;
+  colors[0] = 0U;
+  colors[1] = 0U;
+
+  int bg_list_index = 0;
+
+  // @todo: avoid extracting the top two layers in cases where it is not necessary.
+  // bg_count never exceeds kMaxBGs, but GCC cannot tell and warns about reading past bg_list without the second check.
+  for(int j = 0; j < 2; j++) {
+    while(bg_list_index < setup.bg_count && bg_list_index < Setup::kMaxBGs) {
+      const int bg_id = setup.bg_list[bg_list_index];
+
+      bg_list_index++;
+
+      if(win_layer_enable == nullptr || win_layer_enable[bg_id]) {
+        const auto& bgcnt = mmio.bgcnt[bg_id];
+        const uint mx = x - (bgcnt.mosaic_enable ? mosaic_x[0] : 0U);
+        const u32 bg_color = bg_buffer[mx][bg_id];
+
+        if(bg_color != 0U) {
+          layers[j] = bg_id;
+          colors[j] = bg_color;
+          priorities[j] = (uint)bgcnt.priority;
+          break;
+        }
+      }
+    }
+  }
+
+  bool force_alpha_blend = false;
+
+  Sprite::Pixel current_sprite_pixel;
+
+  current_sprite_pixel.data = setup.enable_obj ? sprite_pixel.data : 0U;
+
+  if(!current_sprite_pixel.mosaic || !sprite_pixel_latch.mosaic || mosaic_x[1] == 0U) {
+    sprite_pixel_latch = current_sprite_pixel;
+  }
+
+  if(setup.enable_obj && (win_layer_enable == nullptr || win_layer_enable[LAYER_OBJ])) {
+    const auto pixel = sprite_pixel_latch;
+
+    if(pixel.color != 0U) {
+      if(pixel.priority <= priorities[0]) {
+        // We do not care about the priority at this point, so we do not update it.
+        layers[1] = layers[0];
+        colors[1] = colors[0];
+        layers[0] = LAYER_OBJ;
+        colors[0] = pixel.color | 256U;
+
+        force_alpha_blend = pixel.alpha;
+      } else if(pixel.priority <= priorities[1]) {
+        // We do not care about the priority at this point, so we do not update it.
+        layers[1] = LAYER_OBJ;
+        colors[1] = pixel.color | 256U;
+      }
+    }
+  }
+
+  ResolveColor(colors[0], read_palette);
+  return force_alpha_blend;
+}
+
+template<typename ReadPalette>
+void PPU::Merge::ApplyEffect(
+  MMIO const& mmio,
+  int const* win_layer_enable,
+  int const layers[2],
+  u32 colors[2],
+  bool force_alpha_blend,
+  ReadPalette&& read_palette,
+  ComposeLine& line,
+  uint x
+) {
+  const bool have_src = mmio.bldcnt.targets[1][layers[1]];
+
+  if(force_alpha_blend && have_src) {
+    ResolveColor(colors[1], read_palette);
+
+    line.SetBlend(x, colors[0], colors[1], mmio.eva, mmio.evb);
+    return;
+  }
+
+  if(win_layer_enable == nullptr || win_layer_enable[LAYER_SFX]) {
+    const bool have_dst = mmio.bldcnt.targets[0][layers[0]];
+
+    switch(mmio.bldcnt.sfx) {
+      case BlendControl::SFX_NONE: {
+        break;
+      }
+      case BlendControl::SFX_BLEND: {
+        if(have_dst && have_src) {
+          ResolveColor(colors[1], read_palette);
+
+          line.SetBlend(x, colors[0], colors[1], mmio.eva, mmio.evb);
+          return;
+        }
+        break;
+      }
+      case BlendControl::SFX_BRIGHTEN: {
+        if(have_dst) {
+          line.SetBrighten(x, colors[0], mmio.evy);
+          return;
+        }
+        break;
+      }
+      case BlendControl::SFX_DARKEN: {
+        if(have_dst) {
+          line.SetDarken(x, colors[0], mmio.evy);
+          return;
+        }
+        break;
+      }
+    }
+  }
+
+  line.SetNone(x, colors[0]);
 }
 
 void PPU::InitMerge() {
@@ -29,6 +223,7 @@ void PPU::InitMerge() {
   merge.mosaic_x[1] = 0U;
   merge.forced_blank = false;
   merge.sprite_pixel_latch.data = 0U;
+  merge.line.greenswap = false;
 }
 
 void PPU::DrawMerge() {
@@ -47,48 +242,11 @@ void PPU::DrawMerge() {
 }
 
 void PPU::DrawMergeImpl(int cycles) {
-  static constexpr int k_min_max_bg[8][2] {
-    {0,  3}, // Mode 0 (BG0 - BG3 text-mode)
-    {0,  2}, // Mode 1 (BG0 - BG1 text-mode, BG2 affine)
-    {2,  3}, // Mode 2 (BG2 - BG3 affine)
-    {2,  2}, // Mode 3 (BG2 240x160 65526-color bitmap)
-    {2,  2}, // Mode 4 (BG2 240x160 256-color bitmap, double-buffered)
-    {2,  2}, // Mode 5 (BG2 160x128 65536-color bitmap, double-buffered)
-    {0, -1}, // Mode 6 (invalid)
-    {0, -1}, // Mode 7 (invalid)
-  };
+  const Merge::Setup setup{mmio};
 
-  const int mode = mmio.dispcnt.mode;
-
-  const int min_bg = k_min_max_bg[mode][0];
-  const int max_bg = k_min_max_bg[mode][1];
-
-  const u16 latched_dispcnt_and_current_dispcnt = mmio.dispcnt_latch[0] & mmio.dispcnt.hword;
-
-  // Enabled BGs sorted from highest to lowest priority.
-  int bg_list[4];
-  int bg_count = 0;
-
-  for(int priority = 0; priority <= 3; priority++) {
-    for(int id = min_bg; id <= max_bg; id++) {
-      if(mmio.bgcnt[id].priority == priority && (latched_dispcnt_and_current_dispcnt & (256U << id))) {
-        bg_list[bg_count++] = id;
-      }
-    }
-  }
-
-  const bool enable_obj = latched_dispcnt_and_current_dispcnt & (256U << LAYER_OBJ);
-
-  const bool enable_win0 = mmio.dispcnt.enable[ENABLE_WIN0];
-  const bool enable_win1 = mmio.dispcnt.enable[ENABLE_WIN1];
-  const bool enable_objwin = mmio.dispcnt.enable[ENABLE_OBJWIN] && enable_obj;
-
-  const bool have_windows = enable_win0 || enable_win1 || enable_objwin;
-
-  const int* win_layer_enable; // @todo: use bool
-
-  auto layers = merge.layers;
-  auto colors = merge.colors;
+  const auto read_palette = [this](uint address) {
+    return FetchPRAM(merge.cycle, address);
+  };
 
   for(int i = 0; i < cycles; i++) {
     const int cycle = (int)merge.cycle - 46;
@@ -99,154 +257,33 @@ void PPU::DrawMergeImpl(int cycles) {
     }
 
     const uint x = (uint)cycle >> 2;
-
-    // @todo: optimize this, this is baaad
-    if(have_windows) {
-      if(enable_win0 && window.buffer[x][0]) {
-        win_layer_enable = mmio.winin.enable[0];
-      } else if(enable_win1 && window.buffer[x][1]) {
-        win_layer_enable = mmio.winin.enable[1];
-      } else if(enable_objwin && sprite.buffer_rd[x].window) {
-        win_layer_enable = mmio.winout.enable[1];
-      } else {
-        win_layer_enable = mmio.winout.enable[0];
-      }
-    }
-
     const int phase = cycle & 3;
 
     if(phase == 0) {
       merge.forced_blank = ForcedBlank();
 
       if(!merge.forced_blank) {
-        uint priorities[2] {3U, 3U};
-
-        layers[0] = LAYER_BD;
-        layers[1] = LAYER_BD;
-        colors[0] = 0U;
-        colors[1] = 0U;
-
-        int bg_list_index = 0;
-
-        // @todo: avoid extracting the top two layers in cases where it is not necessary.
-        for(int j = 0; j < 2; j++) {
-          while(bg_list_index < bg_count) {
-            const int bg_id = bg_list[bg_list_index];
-
-            bg_list_index++;
-
-            if(!have_windows || win_layer_enable[bg_id]) {
-              const auto& bgcnt = mmio.bgcnt[bg_id];
-              const uint mx = x - (bgcnt.mosaic_enable ? merge.mosaic_x[0] : 0U);
-              const u32 bg_color = bg.buffer[mx][bg_id];
-
-              if(bg_color != 0U) {
-                layers[j] = bg_id;
-                colors[j] = bg_color;
-                priorities[j] = (uint)bgcnt.priority;
-                break;
-              }
-            }
-          }
-        }
-
-        merge.force_alpha_blend = false;
-
-        const auto current_sprite_pixel = enable_obj ? sprite.buffer_rd[x] : Sprite::Pixel{0U};
-
-        if(!current_sprite_pixel.mosaic || !merge.sprite_pixel_latch.mosaic || merge.mosaic_x[1] == 0U) {
-          merge.sprite_pixel_latch = current_sprite_pixel;
-        }
-
-        if(enable_obj && (!have_windows || win_layer_enable[LAYER_OBJ])) {
-          const auto pixel = merge.sprite_pixel_latch;
-
-          if(pixel.color != 0U) {
-            if(pixel.priority <= priorities[0]) {
-              // We do not care about the priority at this point, so we do not update it.
-              layers[1] = layers[0];
-              colors[1] = colors[0];
-              layers[0] = LAYER_OBJ;
-              colors[0] = pixel.color | 256U;
-
-              merge.force_alpha_blend = pixel.alpha;
-            } else if(pixel.priority <= priorities[1]) {
-              // We do not care about the priority at this point, so we do not update it.
-              layers[1] = LAYER_OBJ;
-              colors[1] = pixel.color | 256U;
-            }
-          }
-        }
+        const int* win_layer_enable = Merge::SelectWindow(setup, mmio, window.buffer[x], sprite.buffer_rd[x]);
 
-        // @todo: make it clear what the meaning of 0x8000'0000 is.
-        if((colors[0] & 0x8000'0000) == 0) {
-          colors[0] = FetchPRAM(merge.cycle, colors[0] << 1);
-        }
-      } else {
-        colors[0] = 0x7FFFU; // output white
+        merge.force_alpha_blend = Merge::SelectLayers(
+          setup, mmio, win_layer_enable, bg.buffer, x, merge.mosaic_x, sprite.buffer_rd[x],
+          merge.sprite_pixel_latch, merge.layers, merge.colors, read_palette);
       }
     } else if(phase == 2) {
       if(!merge.forced_blank) {
-        const bool have_src = mmio.bldcnt.targets[1][layers[1]];
-
-        if(merge.force_alpha_blend && have_src) {
-          // @todo: make it clear what the meaning of 0x8000'0000 is.
-          if((colors[1] & 0x8000'0000) == 0) {
-            colors[1] = FetchPRAM(merge.cycle, colors[1] << 1);
-          }
-
-          colors[0] = Blend(colors[0], colors[1], mmio.eva, mmio.evb);
-        } else if(!have_windows || win_layer_enable[LAYER_SFX]) {
-          const bool have_dst = mmio.bldcnt.targets[0][layers[0]];
-
-          switch(mmio.bldcnt.sfx) {
-            case BlendControl::SFX_BLEND: {
-              if(have_dst && have_src) {
-                // @todo: make it clear what the meaning of 0x8000'0000 is.
-                if((colors[1] & 0x8000'0000) == 0) {
-                  colors[1] = FetchPRAM(merge.cycle, colors[1] << 1);
-                }
-
-                colors[0] = Blend(colors[0], colors[1], mmio.eva, mmio.evb);
-              }
-              break;
-            }
-            case BlendControl::SFX_BRIGHTEN: {
-              if(have_dst) {
-                colors[0] = Brighten(colors[0], mmio.evy);
-              }
-              break;
-            }
-            case BlendControl::SFX_DARKEN: {
-              if(have_dst) {
-                colors[0] = Darken(colors[0], mmio.evy);
-              }
-              break;
-            }
-          }
-        }
+        const int* win_layer_enable = Merge::SelectWindow(setup, mmio, window.buffer[x], sprite.buffer_rd[x]);
+
+        Merge::ApplyEffect(mmio, win_layer_enable, merge.layers, merge.colors, merge.force_alpha_blend, read_palette, merge.line, x);
+      } else {
+        merge.line.SetNone(x, 0x7FFFU); // output white
       }
 
       if(x & 1) {
-        u16 color_l = merge.color_l;
-        u16 color_r = colors[0];
-
-        if(mmio.greenswap & 1) {
-          const u16 mask = 31U << 5;
-
-          u16 g_l = color_l & mask;
-          u16 g_r = color_r & mask;
-
-          color_l = (color_l & ~mask) | g_r;
-          color_r = (color_r & ~mask) | g_l;
-        }
-
-        u32* out = &output[frame][mmio.vcount * 240 + (x & ~1)];
+        merge.line.SetGreenswap(x, mmio.greenswap & 1);
+      }
 
-        out[0] = RGB555(color_l);
-        out[1] = RGB555(color_r);
-      } else {
-        merge.color_l = colors[0];
+      if(x == 239U) {
+        Compose(merge.line, &output[frame][mmio.vcount * 240]);
       }
 
       if(++merge.mosaic_x[0] == (uint)mmio.mosaic.bg.size_x) {
@@ -264,55 +301,52 @@ void PPU::DrawMergeImpl(int cycles) {
   }
 }
 
-auto PPU::Blend(u16 color_a, u16 color_b, int eva, int evb) -> u16 {
-  const int r_a =  (color_a >>  0) & 31;
-  const int g_a = ((color_a >>  4) & 62) | (color_a >> 15);
-  const int b_a =  (color_a >> 10) & 31;
+void PPU::RenderScanlineMerge(u32* out) {
+  const Merge::Setup setup{mmio};
 
-  const int r_b =  (color_b >>  0) & 31;
-  const int g_b = ((color_b >>  4) & 62) | (color_b >> 15);
-  const int b_b =  (color_b >> 10) & 31;
+  const bool forced_blank = ForcedBlank();
 
-  eva = std::min<int>(16, eva);
-  evb = std::min<int>(16, evb);
+  const auto read_palette = [this](uint address) {
+    return read<u16>(pram, address);
+  };
 
-  const int r = std::min<u8>((r_a * eva + r_b * evb + 8) >> 4, 31);
-  const int g = std::min<u8>((g_a * eva + g_b * evb + 8) >> 4, 63) >> 1;
-  const int b = std::min<u8>((b_a * eva + b_b * evb + 8) >> 4, 31);
+  uint mosaic_x[2] {0U, 0U};
+  Sprite::Pixel sprite_pixel_latch;
 
-  return (u16)((b << 10) | (g << 5) | r);
-}
+  sprite_pixel_latch.data = 0U;
 
-auto PPU::Brighten(u16 color, int evy) -> u16 {
-  evy = std::min<int>(16, evy);
+  auto& line = merge.line;
 
-  int r =  (color >>  0) & 31;
-  int g = ((color >>  4) & 62) | (color >> 15);
-  int b =  (color >> 10) & 31;
+  for(uint x = 0; x < 240; x++) {
+    if(!forced_blank) {
+      int layers[2];
+      u32 colors[2];
 
-  r += ((31 - r) * evy + 8) >> 4;
-  g += ((63 - g) * evy + 8) >> 4;
-  b += ((31 - b) * evy + 8) >> 4;
+      const int* win_layer_enable = Merge::SelectWindow(setup, mmio, window.buffer[x], sprite.buffer_rd[x]);
 
-  g >>= 1;
-  
-  return (u16)((b << 10) | (g << 5) | r);
-}
+      const bool force_alpha_blend = Merge::SelectLayers(
+        setup, mmio, win_layer_enable, bg.buffer, x, mosaic_x, sprite.buffer_rd[x],
+        sprite_pixel_latch, layers, colors, read_palette);
 
-auto PPU::Darken(u16 color, int evy) -> u16 {
-  evy = std::min<int>(16, evy);
+      Merge::ApplyEffect(mmio, win_layer_enable, layers, colors, force_alpha_blend, read_palette, line, x);
+    } else {
+      line.SetNone(x, 0x7FFFU); // output white
+    }
 
-  int r =  (color >>  0) & 31;
-  int g = ((color >>  4) & 62) | (color >> 15);
-  int b =  (color >> 10) & 31;
+    if(x & 1) {
+      line.SetGreenswap(x, mmio.greenswap & 1);
+    }
 
-  r -= (r * evy + 7) >> 4;
-  g -= (g * evy + 7) >> 4;
-  b -= (b * evy + 7) >> 4;
+    if(++mosaic_x[0] == (uint)mmio.mosaic.bg.size_x) {
+      mosaic_x[0] = 0U;
+    }
 
-  g >>= 1;
+    if(++mosaic_x[1] == (uint)mmio.mosaic.obj.size_x) {
+      mosaic_x[1] = 0U;
+    }
+  }
 
-  return (u16)((b << 10) | (g << 5) | r);
+  Compose(line, out);
 }
 
 } // namespace nba::core
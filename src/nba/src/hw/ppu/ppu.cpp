@@ -5,6 +5,7 @@
  * Refer to the included LICENSE file.
  */
 
+#include <algorithm>
 #include <cstring>
 
 #include "hw/ppu/ppu.hpp"
@@ -20,28 +21,40 @@ PPU::PPU(
     , irq(irq)
     , dma(dma)
     , config(config) {
-  scheduler.Register(Scheduler::EventClass::PPU_hdraw_vdraw, this, &PPU::BeginHDrawVDraw);
-  scheduler.Register(Scheduler::EventClass::PPU_hblank_vdraw, this, &PPU::BeginHBlankVDraw);
-  scheduler.Register(Scheduler::EventClass::PPU_hdraw_vblank, this, &PPU::BeginHDrawVBlank);
-  scheduler.Register(Scheduler::EventClass::PPU_hblank_vblank, this, &PPU::BeginHBlankVBlank);
-  scheduler.Register(Scheduler::EventClass::PPU_begin_sprite_fetch, this, &PPU::BeginSpriteDrawing);
-
-  scheduler.Register(Scheduler::EventClass::PPU_update_vcount_flag, this, &PPU::UpdateVerticalCounterFlag);
-  scheduler.Register(Scheduler::EventClass::PPU_video_dma, this, &PPU::RequestVideoDMA);
-  scheduler.Register(Scheduler::EventClass::PPU_latch_dispcnt, this, &PPU::LatchDISPCNT);
-  scheduler.Register(Scheduler::EventClass::PPU_hblank_irq, this, &PPU::RequestHblankIRQ);
-  scheduler.Register(Scheduler::EventClass::PPU_vblank_irq, this, &PPU::RequestVblankIRQ);
-  scheduler.Register(Scheduler::EventClass::PPU_vcount_irq, this, &PPU::RequestVcountIRQ);
+  scheduler.Register<&PPU::BeginHDrawVDraw>(Scheduler::EventClass::PPU_hdraw_vdraw, this);
+  scheduler.Register<&PPU::BeginHBlankVDraw>(Scheduler::EventClass::PPU_hblank_vdraw, this);
+  scheduler.Register<&PPU::BeginHDrawVBlank>(Scheduler::EventClass::PPU_hdraw_vblank, this);
+  scheduler.Register<&PPU::BeginHBlankVBlank>(Scheduler::EventClass::PPU_hblank_vblank, this);
+  scheduler.Register<&PPU::BeginSpriteDrawing>(Scheduler::EventClass::PPU_begin_sprite_fetch, this);
+
+  scheduler.Register<&PPU::UpdateVerticalCounterFlag>(Scheduler::EventClass::PPU_update_vcount_flag, this);
+  scheduler.Register<&PPU::RequestVideoDMA>(Scheduler::EventClass::PPU_video_dma, this);
+  scheduler.Register<&PPU::LatchDISPCNT>(Scheduler::EventClass::PPU_latch_dispcnt, this);
+  scheduler.Register<&PPU::RequestHblankIRQ>(Scheduler::EventClass::PPU_hblank_irq, this);
+  scheduler.Register<&PPU::RequestVblankIRQ>(Scheduler::EventClass::PPU_vblank_irq, this);
+  scheduler.Register<&PPU::RequestVcountIRQ>(Scheduler::EventClass::PPU_vcount_irq, this);
+
+  for(auto& buffer : output) {
+    buffer = std::make_unique<u32[]>(240 * 160);
+  }
 
   mmio.dispcnt.ppu = this;
   mmio.dispstat.ppu = this;
   Reset();
 }
 
+PPU::~PPU() {
+  StopRenderThread();
+}
+
 void PPU::Reset() {
+  StopRenderThread();
+
   std::memset(pram, 0, 0x00400);
   std::memset(oam,  0, 0x00400);
   std::memset(vram, 0, 0x18000);
+  tile_cache.Reset();
+  MarkAllPagesDirty();
 
   vram_bg_latch = 0U;
 
@@ -95,19 +108,39 @@ void PPU::Reset() {
   // @todo: initialize window with the appropriate timing.
   bg = {};
   sprite = {};
-  sprite.buffer_rd = sprite.buffer[0];
-  sprite.buffer_wr = sprite.buffer[1];
+  sprite.buffer_rd = sprite_buffer[0];
+  sprite.buffer_wr = sprite_buffer[1];
+  std::memset(sprite_buffer, 0, sizeof(sprite_buffer));
   window = {};
   merge = {};
+  scanline = {};
+
+  // The merge engine only runs in V-draw, it must not draw V-blank line 225 into the output.
+  merge.cycle = 1006U;
 
   frame = 0;
   dma3_video_transfer_running = false;
 }
 
+void PPU::MarkAllPagesDirty() {
+  for(u32 address = 0; address < 0x400; address += 1U << VideoPages::kPageShift) {
+    MarkDirty(dirty_pages.pram, address);
+    MarkDirty(dirty_pages.oam, address);
+  }
+
+  for(u32 address = 0; address < 0x18000; address += 1U << VideoPages::kPageShift) {
+    MarkDirty(dirty_pages.vram, address);
+  }
+}
+
 void PPU::BeginHDrawVDraw() {
   auto& dispstat = mmio.dispstat;
   auto& vcount = mmio.vcount;
 
+  if(scanline.deferred_bg) {
+    ResolveDeferredBG();
+  }
+
   DrawBackground();
   DrawWindow();
   DrawMerge();
@@ -136,6 +169,8 @@ void PPU::BeginHDrawVDraw() {
   }
 
   InitWindow();
+
+  scanline.deferred_bg = UseScanlineRenderer();
 }
 
 void PPU::BeginHBlankVDraw() {
@@ -154,6 +189,10 @@ void PPU::BeginHDrawVBlank() {
   auto& vcount = mmio.vcount;
   auto& dispstat = mmio.dispstat;
 
+  if(scanline.deferred_bg) {
+    ResolveDeferredBG();
+  }
+
   DrawWindow();
 
   scheduler.Add(1, Scheduler::EventClass::PPU_update_vcount_flag);
@@ -177,7 +216,12 @@ void PPU::BeginHDrawVBlank() {
     scheduler.Add(1007, Scheduler::EventClass::PPU_hblank_vdraw);
     vcount = 0;
 
-    config->video_dev->Draw(output[frame]);
+    // The render thread may still be drawing the frame.
+    if(scanline.threaded) {
+      render_thread->Wait();
+    }
+
+    config->video_dev->Draw(output[frame].get());
     frame ^= 1;
 
     InitBackground();
@@ -193,6 +237,8 @@ void PPU::BeginHDrawVBlank() {
   UpdateVideoTransferDMA();
 
   InitWindow();
+
+  scanline.deferred_bg = UseScanlineRenderer();
 }
 
 void PPU::BeginHBlankVBlank() {
@@ -211,20 +257,152 @@ void PPU::BeginSpriteDrawing() {
   const uint vcount = mmio.vcount;
 
   if(vcount < 160U) {
+    if(scanline.deferred_obj) {
+      ResolveDeferredOBJ();
+    }
+
     DrawSprite();
   }
 
   if(vcount == 227U || vcount < 160U) {
+    // The sprite engine is about to begin drawing the first scanline of the next frame.
+    if(vcount == 227U) {
+      LatchRenderer();
+    }
+
+    if(scanline.push_sprites) {
+      PushWriteSprites();
+      scanline.push_sprites = false;
+    }
+
     std::swap(sprite.buffer_rd, sprite.buffer_wr);
 
+    if(scanline.threaded) {
+      PushSwapSpriteBuffers();
+
+      // The scanline may have fallen back to the engines before the sprite buffers were swapped.
+      if(vcount < 160U && !scanline.deferred_bg) {
+        PullSprites();
+      }
+    }
+
     if(vcount != 159U) {
       InitSprite();
+
+      scanline.deferred_obj = UseScanlineRenderer();
     }
   }
 
   scheduler.Add(1232, Scheduler::EventClass::PPU_begin_sprite_fetch);
 }
 
+void PPU::SyncDeferred(int targets) {
+  if(scanline.deferred_bg && (targets & SYNC_BG)) {
+    ResolveDeferredBG();
+  }
+
+  if(scanline.deferred_obj && (targets & SYNC_OBJ)) {
+    ResolveDeferredOBJ();
+  }
+
+  if(!scanline.deferred_bg) {
+    DrawBackground();
+  }
+
+  if(!scanline.deferred_obj) {
+    DrawSprite();
+  }
+
+  if(!scanline.deferred_bg) {
+    DrawWindow();
+    DrawMerge();
+  }
+}
+
+void PPU::ResolveDeferredBG() {
+  const u64 timestamp_now = scheduler.GetTimestampNow();
+
+  // The window engine is the only one of the three engines which runs in V-blank as well.
+  const uint cycle = window.cycle + (uint)(timestamp_now - window.timestamp_last_sync);
+
+  // The window engine only depends on registers, which have not been written yet.
+  RenderScanlineWindow(std::min(cycle, 1024U));
+
+  if(mmio.vcount < 160U) {
+    /* Unless the BG and merge engines are done with the scanline, they catch up
+     * cycle-accurately from the start of the scanline. With the render thread
+     * they do so on the emulation thread, with the sprites and the VRAM latch
+     * of the replica.
+     */
+    if(cycle < 1007U) {
+      if(scanline.threaded) {
+        PullSprites();
+        vram_bg_latch = replica->vram_bg_latch;
+        scanline.push_bg_latch = true;
+      }
+      scanline.deferred_bg = false;
+      return;
+    }
+
+    if(scanline.threaded) {
+      PushDrawScanline();
+    } else {
+      RenderScanlineBG();
+      RenderScanlineMerge(&output[frame][mmio.vcount * 240]);
+    }
+
+    for(auto& text : bg.text) {
+      text.fetches = 0;
+    }
+
+    /* Text BGs keep fetching tile data in H-blank, which may conflict with
+     * CPU and DMA accesses. The BG engine replays the rest of the scanline from
+     * cycle 972, so that it repeats the last map fetch of each BG (one every
+     * 32 cycles) and the tile fetches which follow it. Otherwise it is only
+     * left with the end of the scanline (mosaic and BG X/Y update).
+     */
+    if(mmio.dispcnt.mode <= 1 && cycle < 1232U) {
+      bg.cycle = 971U;
+      scanline.push_bg_latch = scanline.threaded;
+    } else {
+      bg.cycle = std::min(cycle, 1231U);
+    }
+    bg.timestamp_last_sync = bg.timestamp_init + bg.cycle;
+
+    merge.cycle = 1006U;
+    merge.timestamp_last_sync = timestamp_now;
+  }
+
+  scanline.deferred_bg = false;
+}
+
+void PPU::ResolveDeferredOBJ() {
+  const u64 timestamp_now = scheduler.GetTimestampNow();
+
+  // Otherwise the sprite engine catches up cycle-accurately from the start of the scanline.
+  if(timestamp_now - sprite.timestamp_init < sprite.latch_cycle_limit) {
+    // The replica then needs the sprites that the engine draws.
+    scanline.push_sprites = scanline.threaded;
+    scanline.deferred_obj = false;
+    return;
+  }
+
+  scanline.deferred_obj = false;
+
+  if(scanline.threaded) {
+    PushDrawSprites();
+  } else {
+    RenderScanlineSprite();
+  }
+
+  if(sprite.latch_cycle_limit > 1192U) {
+    UpdateSpriteMosaicY();
+  }
+
+  sprite.cycle = sprite.latch_cycle_limit;
+  sprite.timestamp_last_sync = timestamp_now;
+}
+
 void PPU::UpdateVerticalCounterFlag() {
   auto& dispstat = mmio.dispstat;
   auto vcount_flag_new = dispstat.vcount_setting == mmio.vcount;
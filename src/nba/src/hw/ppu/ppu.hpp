@@ -8,15 +8,20 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <nba/common/compiler.hpp>
 #include <nba/common/punning.hpp>
 #include <nba/config.hpp>
 #include <nba/integer.hpp>
 #include <nba/save_state.hpp>
 #include <nba/scheduler.hpp>
+#include <nba/video_pages.hpp>
 #include <type_traits>
 
+#include "hw/ppu/compose.hpp"
 #include "hw/ppu/registers.hpp"
+#include "hw/ppu/render_thread.hpp"
+#include "hw/ppu/tile_cache.hpp"
 #include "hw/dma/dma.hpp"
 #include "hw/irq/irq.hpp"
 
@@ -30,6 +35,8 @@ struct PPU {
     std::shared_ptr<Config> config
   );
 
+ ~PPU();
+
   void Reset();
 
   void LoadState(SaveState const& state);
@@ -43,6 +50,13 @@ struct PPU {
     return vram;
   }
 
+  auto GetAndClearDirtyPages() -> VideoPages {
+    const VideoPages pages = dirty_pages;
+
+    dirty_pages = {};
+    return pages;
+  }
+
   template<typename T>
   auto ALWAYS_INLINE ReadPRAM(u32 address) noexcept -> T {
     return read<T>(pram, address & 0x3FF);
@@ -50,11 +64,19 @@ struct PPU {
 
   template<typename T>
   void ALWAYS_INLINE WritePRAM(u32 address, T value) noexcept {
+    if(unlikely(scanline.deferred_bg)) {
+      Sync(SYNC_BG);
+    }
+
     if constexpr (std::is_same_v<T, u8>) {
       write<u16>(pram, address & 0x3FE, value * 0x0101);
+      MirrorWrite<u16>(MEMORY_PRAM, address & 0x3FE);
     } else {
       write<T>(pram, address & 0x3FF, value);
+      MirrorWrite<T>(MEMORY_PRAM, address & 0x3FF);
     }
+
+    MarkDirty(dirty_pages.pram, address & 0x3FF);
   }
 
   auto ALWAYS_INLINE GetSpriteVRAMBoundary() noexcept -> u32 {
@@ -95,16 +117,29 @@ struct PPU {
 
   template<typename T>
   auto ALWAYS_INLINE WriteVRAM_BG(u32 address, T value) noexcept {
+    if(unlikely(scanline.deferred_bg)) {
+      Sync(SYNC_BG);
+    }
+
     if constexpr (std::is_same_v<T, u8>) {
       write<u16>(vram, address & ~1, value * 0x0101);
+      MirrorWrite<u16>(MEMORY_VRAM, address & ~1);
     } else {
       write<T>(vram, address, value);
+      MirrorWrite<T>(MEMORY_VRAM, address);
     }
+
+    tile_cache.Invalidate(address);
+    MarkDirty(dirty_pages.vram, address);
   }
 
   template<typename T>
   auto ALWAYS_INLINE WriteVRAM_OBJ(u32 address, T value, u32 boundary) noexcept {
     if constexpr (!std::is_same_v<T, u8>) {
+      if(unlikely(scanline.deferred_obj)) {
+        Sync(SYNC_OBJ);
+      }
+
       if(address >= 0x18000) {
         address &= ~0x8000;
 
@@ -114,6 +149,8 @@ struct PPU {
       }
 
       write<T>(vram, address, value);
+      MirrorWrite<T>(MEMORY_VRAM, address);
+      MarkDirty(dirty_pages.vram, address);
     }
   }
 
@@ -125,7 +162,13 @@ struct PPU {
   template<typename T>
   void ALWAYS_INLINE WriteOAM(u32 address, T value) noexcept {
     if constexpr (!std::is_same_v<T, u8>) {
+      if(unlikely(scanline.deferred_obj)) {
+        Sync(SYNC_OBJ);
+      }
+
       write<T>(oam, address & 0x3FF, value);
+      MirrorWrite<T>(MEMORY_OAM, address & 0x3FF);
+      MarkDirty(dirty_pages.oam, address & 0x3FF);
     }
   }
 
@@ -145,7 +188,47 @@ struct PPU {
     return scheduler.GetTimestampNow() == sprite.timestamp_oam_access + 1U;
   }
 
-  void Sync() {
+  /* Whether the engines which fetch from a memory have no fetches left
+   * in the current scanline, based on their progress at the last sync.
+   * If so, CPU and DMA accesses cannot conflict with the PPU and the PPU
+   * does not need to be synchronized first. An engine only becomes busy
+   * again at the start of the next scanline, which is a scheduler event.
+   * Engines whose scanline is deferred have not made any progress yet,
+   * so the sync resolves the scanline to find out about conflicts.
+   */
+  bool ALWAYS_INLINE IsIdlePRAM() const noexcept {
+    return merge.cycle >= 1006U;
+  }
+
+  bool ALWAYS_INLINE IsIdleVRAM_BG() const noexcept {
+    return bg.cycle >= 1232U;
+  }
+
+  bool ALWAYS_INLINE IsIdleVRAM_OBJ() const noexcept {
+    return sprite.cycle >= sprite.latch_cycle_limit || !mmio.dispcnt.enable[LAYER_OBJ];
+  }
+
+  bool ALWAYS_INLINE IsIdleOAM() const noexcept {
+    return IsIdleVRAM_OBJ();
+  }
+
+  enum SyncTarget {
+    SYNC_BG  = 1, // BG, window and merge engines
+    SYNC_OBJ = 2, // sprite engine
+    SYNC_ALL = 3
+  };
+
+  /* Brings the PPU up to date before state which it reads is modified.
+   * Deferred scanlines (see Config::PPU::Renderer) are only resolved
+   * for the engines in 'targets', which must cover all engines that read
+   * the modified state. Other engines are always brought up to date.
+   */
+  void Sync(int targets = SYNC_ALL) {
+    if(unlikely(scanline.deferred_bg || scanline.deferred_obj)) {
+      SyncDeferred(targets);
+      return;
+    }
+
     // @todo: only update the window when it is necessary or else
     // we will have a major performance caveat due to the window being updated 
     // during V-blank and games typically updating graphics during V-blank.
@@ -352,18 +435,21 @@ private:
       u16 data;
     };
 
-    Pixel buffer[2][240];
+    // Point into sprite_buffer, which is kept apart so that this state can be copied without the pixels.
     Pixel* buffer_rd;
     Pixel* buffer_wr;
 
     uint latch_cycle_limit;
   } sprite;
 
+  Sprite::Pixel sprite_buffer[2][240];
+
   void InitSprite();
   void DrawSprite();
   void DrawSpriteImpl(int cycles);
   void DrawSpriteFetchOAM(uint cycle);
   void DrawSpriteFetchVRAM(uint cycle);
+  void UpdateSpriteMosaicY();
 
   struct Window {
     u64 timestamp_last_sync;
@@ -387,18 +473,147 @@ private:
     int layers[2];
     bool force_alpha_blend;
     u32 colors[2];
-    u16 color_l;
     bool forced_blank;
     Sprite::Pixel sprite_pixel_latch;
+
+    // Color special effects of the current scanline, which are applied once the scanline has been merged.
+    ComposeLine line;
+
+    /**
+     * Layer and color special effect selection, shared by the merge engine and the scanline renderer.
+     * Setup holds the state that stays the same for a scanline (or a call to DrawMergeImpl()).
+     * The ReadPalette functor reads a color from PRAM, given its byte address.
+     */
+    struct Setup {
+      explicit Setup(MMIO const& mmio);
+
+      static constexpr int kMaxBGs = 4;
+
+      // Enabled BGs sorted from highest to lowest priority.
+      int bg_list[kMaxBGs]{};
+      int bg_count = 0;
+
+      bool enable_obj = false;
+      bool enable_win0 = false;
+      bool enable_win1 = false;
+      bool enable_objwin = false;
+      bool have_windows = false;
+    };
+
+    // Returns the layer enable bits of the window which contains the pixel, or nullptr if all windows are disabled.
+    static auto SelectWindow(Setup const& setup, MMIO const& mmio, bool const window[2], Sprite::Pixel const& sprite_pixel) -> int const*;
+
+    /**
+     * Finds the top two layers of a pixel and fetches the color of the top layer.
+     * Returns true if the top layer is a semi-transparent sprite.
+     */
+    template<typename ReadPalette>
+    static bool SelectLayers(
+      Setup const& setup,
+      MMIO const& mmio,
+      int const* win_layer_enable,
+      u32 const (*bg_buffer)[4],
+      uint x,
+      uint const mosaic_x[2],
+      Sprite::Pixel const& sprite_pixel,
+      Sprite::Pixel& sprite_pixel_latch,
+      int layers[2],
+      u32 colors[2],
+      ReadPalette&& read_palette
+    );
+
+    // Records the color special effect of pixel 'x' into 'line' (see ComposeLine).
+    template<typename ReadPalette>
+    static void ApplyEffect(
+      MMIO const& mmio,
+      int const* win_layer_enable,
+      int const layers[2],
+      u32 colors[2],
+      bool force_alpha_blend,
+      ReadPalette&& read_palette,
+      ComposeLine& line,
+      uint x
+    );
   } merge;
 
   void InitMerge();
   void DrawMerge();
   void DrawMergeImpl(int cycles);
-  
-  static auto Blend(u16 color_a, u16 color_b, int eva, int evb) -> u16;
-  static auto Brighten(u16 color, int evy) -> u16;
-  static auto Darken(u16 color, int evy) -> u16;
+
+  /* Scanline renderer: while a scanline is deferred its engines do not run.
+   * Once the visible part of the scanline has ended, it is drawn in one go
+   * from the (unchanged) registers and memory. A write that happens earlier
+   * makes the engines catch up cycle-accurately for the rest of the scanline.
+   */
+  struct Scanline {
+    bool deferred_bg;   // BG, window and merge engines of the current scanline
+    bool deferred_obj;  // sprite engine (which draws the next scanline)
+    bool threaded;      // whether the render thread is running
+    bool push_sprites;  // whether the sprite engine drew a scanline which the replica needs
+    bool push_bg_latch; // whether the BG engine fetched from VRAM since the replica last did
+  } scanline{};
+
+  bool UseScanlineRenderer() const {
+    return scanline.threaded || config->ppu.renderer == Config::PPU::Renderer::Scanline;
+  }
+
+  void SyncDeferred(int targets);
+  void ResolveDeferredBG();
+  void ResolveDeferredOBJ();
+  void RenderScanlineBG();
+  void RenderScanlineTextBG(int id);
+  void RenderScanlineAffineBG(int id);
+  template<int mode> void RenderScanlineBitmapBG();
+  void RenderScanlineWindow(uint cycle_end);
+  void RenderScanlineMerge(u32* out);
+  void RenderScanlineSprite();
+
+  template<size_t n>
+  static void ALWAYS_INLINE MarkDirty(std::array<u64, n>& pages, u32 address) {
+    const u32 page = address >> VideoPages::kPageShift;
+
+    pages[page >> 6] |= 1ULL << (page & 63U);
+  }
+
+  void MarkAllPagesDirty();
+
+  /* Threaded renderer: deferred scanlines are drawn by a replica of the PPU
+   * on the render thread, from a snapshot of the registers and engine state
+   * that the scanline renderer would have drawn them from. Writes to video
+   * memory are mirrored into the replica, in order with the snapshots.
+   * Scanlines which fall back to the engines are drawn on the emulation
+   * thread, so that access conflicts are emulated like with the scanline
+   * renderer, and the sprite pixels are exchanged with the replica.
+   */
+  enum Memory {
+    MEMORY_PRAM,
+    MEMORY_OAM,
+    MEMORY_VRAM
+  };
+
+  struct RenderCommand;
+  struct Replica {};
+
+  // Constructs a replica, which draws scanlines on the render thread and never runs any events.
+  PPU(PPU const& ppu, Replica);
+
+  template<typename T>
+  void ALWAYS_INLINE MirrorWrite(Memory memory, u32 address) {
+    if(unlikely(scanline.threaded)) {
+      PushWriteMemory(memory, address, sizeof(T));
+    }
+  }
+
+  void LatchRenderer();
+  void StartRenderThread();
+  void StopRenderThread();
+  void PushWriteMemory(Memory memory, u32 address, int size);
+  void PushDrawSprites();
+  void PushWriteSprites();
+  void PushSwapSpriteBuffers();
+  void PullSprites();
+  void PushDrawScanline();
+  void HandleRenderCommand(u8 const* data, u32 size);
 
   bool ALWAYS_INLINE ForcedBlank() const {
     return (mmio.dispcnt_latch[0] | mmio.dispcnt.hword) & 0x80U;
@@ -423,6 +638,20 @@ private:
     return read<T>(&vram_bg_latch, address & 1U);
   }
 
+  /**
+   * FetchVRAM_BG() for the scanline renderer, which checks for forced blank once per scanline.
+   * The scanline renderer draws one BG after another, so fetches beyond the BG VRAM
+   * boundary may see a different latched value than with the interleaved fetches of the BG engine.
+   */
+  template<typename T>
+  auto ALWAYS_INLINE FetchVRAM_BG_Scanline(uint address) -> T {
+    if(likely(address < GetSpriteVRAMBoundary())) {
+      vram_bg_latch = read<u16>(vram, address & ~1U);
+      return read<T>(vram, address);
+    }
+    return read<T>(&vram_bg_latch, address & 1U);
+  }
+
   template<typename T>
   auto ALWAYS_INLINE FetchVRAM_OBJ(uint cycle, uint address) -> T {
     // @todo: OBJ circuitry seems to ignore 'forced blank'. But is that really true?
@@ -445,16 +674,26 @@ private:
 
   u16 vram_bg_latch;
 
+  TileCache tile_cache;
+
+  // Pages written since the last call to GetAndClearDirtyPages().
+  VideoPages dirty_pages;
+
   Scheduler& scheduler;
   IRQ& irq;
   DMA& dma;
   std::shared_ptr<Config> config;
 
-  u32 output[2][240 * 160];
+  // Only allocated for the PPU on the emulation thread, replicas draw into its output.
+  std::unique_ptr<u32[]> output[2];
   int frame;
 
   bool dma3_video_transfer_running;
 
+  // Only allocated once the threaded renderer is used.
+  std::unique_ptr<PPU> replica;
+  std::unique_ptr<RenderThread> render_thread;
+
   #include "background.inl"
 };
 
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "hw/ppu/render_thread.hpp"
+
+namespace nba::core {
+
+void RenderThread::Start(Handler handler) {
+  ring.Start([handler = std::move(handler)](ByteRing::Span const& span) {
+    const u64 end = span.size[0] + span.size[1];
+
+    u8 command[kMaxCommandSize];
+
+    // Copy each command out of the ring buffer, so that it is contiguous.
+    for(u64 offset = 0; offset < end;) {
+      u32 size;
+
+      span.Read(offset, &size, sizeof(u32));
+      span.Read(offset + sizeof(u32), command, size);
+
+      handler(command, size);
+
+      offset += sizeof(u32) + size;
+    }
+  });
+}
+
+} // namespace nba::core
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <nba/common/compiler.hpp>
+#include <nba/integer.hpp>
+
+#include "byte_ring.hpp"
+
+namespace nba::core {
+
+/**
+ * Runs commands recorded by the emulation thread on a separate thread, in order.
+ * A command is a block of bytes which is passed through a ByteRing, prefixed with its size,
+ * and handed to the handler on the render thread.
+ */
+struct RenderThread {
+  using Handler = std::function<void(u8 const* data, u32 size)>;
+
+  // The largest command which Push() accepts, in bytes.
+  static constexpr u32 kMaxCommandSize = 2048;
+
+  // The capacity of the ring buffer in bytes, which must be a power of two.
+  explicit RenderThread(u64 capacity) : ring(capacity) {}
+
+  void Start(Handler handler);
+
+  // Waits until all pushed commands have been handled and joins the render thread.
+  void Stop() {
+    ring.Stop();
+  }
+
+  // Waits until all pushed commands have been handled.
+  void Wait() {
+    ring.Wait();
+  }
+
+  bool ALWAYS_INLINE IsActive() const {
+    return ring.IsActive();
+  }
+
+  void ALWAYS_INLINE Push(void const* data, u32 size) {
+    ring.Reserve(sizeof(u32) + size);
+    ring.Append(&size, sizeof(u32));
+    ring.Append(data, size);
+    ring.Commit();
+  }
+
+private:
+  ByteRing ring;
+};
+
+} // namespace nba::core
@@ -15,6 +15,9 @@ void PPU::LoadState(SaveState const& state) {
   auto& ss_ppu = state.ppu;
   auto& mosaic = mmio.mosaic;
 
+  // The render thread restarts with a copy of the loaded video memory on the next frame.
+  StopRenderThread();
+
   /**
    * We have to restore VCOUNT before DISPSTAT,
    * because otherwise loading DISPSTAT might (incorrectly) trigger a V-count IRQ.
@@ -64,9 +67,14 @@ void PPU::LoadState(SaveState const& state) {
   std::memcpy(pram, state.bus.memory.pram, 0x400);
   std::memcpy(oam,  state.bus.memory.oam,  0x400);
   std::memcpy(vram, state.bus.memory.vram, 0x18000);
+  tile_cache.Reset();
+  MarkAllPagesDirty();
 
   vram_bg_latch = ss_ppu.vram_bg_latch;
   dma3_video_transfer_running = ss_ppu.dma3_video_transfer_running;
+
+  // Let the engines catch up cycle-accurately for the rest of the current scanline.
+  scanline = {};
 }
 
 void PPU::CopyState(SaveState& state) {
@@ -63,17 +63,7 @@ void PPU::DrawSpriteImpl(int cycles) {
     }
 
     if(cycle == 1192U) { // cycle 1232 in the scanline
-      auto& mosaic = mmio.mosaic;
-
-      if(sprite.vcount < 159) {
-        if(++mosaic.obj._counter_y == mosaic.obj.size_y) {
-          mosaic.obj._counter_y = 0;
-        } else {
-          mosaic.obj._counter_y &= 15;
-        }
-      } else {
-        mosaic.obj._counter_y = 0;
-      }
+      UpdateSpriteMosaicY();
     }
 
     if(++sprite.cycle == cycle_limit) {
@@ -82,6 +72,20 @@ void PPU::DrawSpriteImpl(int cycles) {
   }
 }
 
+void PPU::UpdateSpriteMosaicY() {
+  auto& mosaic = mmio.mosaic;
+
+  if(sprite.vcount < 159) {
+    if(++mosaic.obj._counter_y == mosaic.obj.size_y) {
+      mosaic.obj._counter_y = 0;
+    } else {
+      mosaic.obj._counter_y &= 15;
+    }
+  } else {
+    mosaic.obj._counter_y = 0;
+  }
+}
+
 void PPU::DrawSpriteFetchOAM(uint cycle) {
   static constexpr int k_sprite_size[4][4][2] = {
     { { 8 , 8  }, { 16, 16 }, { 32, 32 }, { 64, 64 } }, // Square
@@ -438,4 +442,39 @@ void PPU::DrawSpriteFetchVRAM(uint cycle) {
   }
 }
 
+void PPU::RenderScanlineSprite() {
+  const uint cycle_limit = sprite.latch_cycle_limit;
+
+  /**
+   * Run the same state machine as DrawSpriteImpl(), but only on the cycles
+   * in which it does anything and skip the cycles which the OAM fetch unit
+   * spends waiting for the drawer unit, while the drawer unit is idle.
+   */
+  if(mmio.dispcnt.enable[LAYER_OBJ]) {
+    auto& oam_fetch = sprite.oam_fetch;
+
+    uint cycle = 0U;
+
+    while(cycle < cycle_limit) {
+      if(!sprite.drawing) {
+        if(oam_fetch.step == 6) {
+          break;
+        }
+
+        if(oam_fetch.wait > 0 && !oam_fetch.delay_wait) {
+          const int steps = std::min(oam_fetch.wait, (int)(cycle_limit - cycle) >> 1);
+
+          oam_fetch.wait -= steps;
+          cycle += steps << 1;
+          continue;
+        }
+      }
+
+      DrawSpriteFetchVRAM(cycle);
+      DrawSpriteFetchOAM(cycle);
+      cycle += 2U;
+    }
+  }
+}
+
 } // namespace nba::core
@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <cstring>
+#include <utility>
+
+#include "hw/ppu/ppu.hpp"
+
+namespace nba::core {
+
+struct PPU::RenderCommand {
+  enum class Type : u8 {
+    WriteMemory,
+    DrawSprites,
+    WriteSprites,
+    SwapSpriteBuffers,
+    DrawScanline
+  };
+
+  struct WriteMemory {
+    Type type = Type::WriteMemory;
+    u8 memory;
+    u8 size;
+    u32 address;
+    u32 value;
+  };
+
+  struct DrawSprites {
+    Type type = Type::DrawSprites;
+    Sprite sprite;
+    MMIO mmio;
+  };
+
+  struct WriteSprites {
+    Type type = Type::WriteSprites;
+    Sprite::Pixel pixels[240];
+  };
+
+  struct SwapSpriteBuffers {
+    Type type = Type::SwapSpriteBuffers;
+  };
+
+  struct DrawScanline {
+    Type type = Type::DrawScanline;
+    MMIO mmio;
+    Background::Affine affine[2];
+    bool window[240][2];
+    bool set_vram_bg_latch;
+    u16 vram_bg_latch;
+    u32* out;
+  };
+
+  static_assert(sizeof(DrawSprites) <= RenderThread::kMaxCommandSize);
+  static_assert(sizeof(DrawScanline) <= RenderThread::kMaxCommandSize);
+};
+
+PPU::PPU(PPU const& ppu, Replica)
+    : scheduler(ppu.scheduler)
+    , irq(ppu.irq)
+    , dma(ppu.dma)
+    , config(ppu.config) {
+  mmio.dispcnt.ppu = this;
+  mmio.dispstat.ppu = this;
+
+  bg = {};
+  sprite = {};
+  window = {};
+  merge = {};
+  scanline = {};
+}
+
+void PPU::LatchRenderer() {
+  const bool threaded = config->ppu.renderer == Config::PPU::Renderer::Threaded;
+
+  if(threaded != scanline.threaded) {
+    if(threaded) {
+      StartRenderThread();
+    } else {
+      StopRenderThread();
+    }
+  }
+}
+
+void PPU::StartRenderThread() {
+  if(!replica) {
+    replica.reset(new PPU{*this, Replica{}});
+    render_thread = std::make_unique<RenderThread>(0x400000);
+  }
+
+  std::memcpy(replica->pram, pram, sizeof(pram));
+  std::memcpy(replica->oam,  oam,  sizeof(oam));
+  std::memcpy(replica->vram, vram, sizeof(vram));
+  replica->tile_cache.Reset();
+  std::memcpy(replica->sprite_buffer, sprite_buffer, sizeof(sprite_buffer));
+
+  replica->vram_bg_latch = vram_bg_latch;
+
+  const int index_rd = sprite.buffer_rd == sprite_buffer[0] ? 0 : 1;
+
+  replica->sprite.buffer_rd = replica->sprite_buffer[index_rd];
+  replica->sprite.buffer_wr = replica->sprite_buffer[index_rd ^ 1];
+
+  render_thread->Start([this](u8 const* data, u32 size) {
+    HandleRenderCommand(data, size);
+  });
+
+  scanline.threaded = true;
+}
+
+void PPU::StopRenderThread() {
+  if(scanline.threaded) {
+    render_thread->Stop();
+    scanline.threaded = false;
+  }
+}
+
+void PPU::PushWriteMemory(Memory memory, u32 address, int size) {
+  const u8* data = memory == MEMORY_PRAM ? pram : (memory == MEMORY_OAM ? oam : vram);
+
+  RenderCommand::WriteMemory command;
+
+  command.memory = (u8)memory;
+  command.size = (u8)size;
+  command.address = address;
+  command.value = size == sizeof(u32) ? read<u32>(data, address) : read<u16>(data, address);
+
+  render_thread->Push(&command, sizeof(command));
+}
+
+void PPU::PushDrawSprites() {
+  RenderCommand::DrawSprites command;
+
+  command.sprite = sprite;
+  command.mmio = mmio;
+
+  render_thread->Push(&command, sizeof(command));
+}
+
+void PPU::PushWriteSprites() {
+  RenderCommand::WriteSprites command;
+
+  std::memcpy(command.pixels, sprite.buffer_wr, sizeof(command.pixels));
+
+  render_thread->Push(&command, sizeof(command));
+}
+
+void PPU::PullSprites() {
+  render_thread->Wait();
+
+  std::memcpy(sprite.buffer_rd, replica->sprite.buffer_rd, sizeof(Sprite::Pixel) * 240);
+}
+
+void PPU::PushSwapSpriteBuffers() {
+  RenderCommand::SwapSpriteBuffers command;
+
+  render_thread->Push(&command, sizeof(command));
+}
+
+void PPU::PushDrawScanline() {
+  RenderCommand::DrawScanline command;
+
+  command.mmio = mmio;
+  command.affine[0] = bg.affine[0];
+  command.affine[1] = bg.affine[1];
+  std::memcpy(command.window, window.buffer, sizeof(window.buffer));
+  command.set_vram_bg_latch = scanline.push_bg_latch;
+  command.vram_bg_latch = vram_bg_latch;
+  command.out = &output[frame][mmio.vcount * 240];
+
+  scanline.push_bg_latch = false;
+
+  render_thread->Push(&command, sizeof(command));
+}
+
+void PPU::HandleRenderCommand(u8 const* data, [[maybe_unused]] u32 size) {
+  using Type = RenderCommand::Type;
+
+  // Copy each command, as the command data has no particular alignment.
+  const auto Read = [&](auto& command) {
+    std::memcpy(&command, data, sizeof(command));
+  };
+
+  switch((Type)data[0]) {
+    case Type::WriteMemory: {
+      RenderCommand::WriteMemory command;
+
+      Read(command);
+
+      u8* memory = replica->vram;
+
+      if(command.memory == MEMORY_PRAM) memory = replica->pram;
+      if(command.memory == MEMORY_OAM)  memory = replica->oam;
+
+      if(command.size == sizeof(u32)) {
+        write<u32>(memory, command.address, command.value);
+      } else {
+        write<u16>(memory, command.address, (u16)command.value);
+      }
+
+      if(command.memory == MEMORY_VRAM) {
+        replica->tile_cache.Invalidate(command.address);
+      }
+      break;
+    }
+    case Type::DrawSprites: {
+      RenderCommand::DrawSprites command;
+
+      Read(command);
+
+      auto& sprite = replica->sprite;
+      auto buffer_rd = sprite.buffer_rd;
+      auto buffer_wr = sprite.buffer_wr;
+
+      sprite = command.sprite;
+      sprite.buffer_rd = buffer_rd;
+      sprite.buffer_wr = buffer_wr;
+      replica->mmio = command.mmio;
+
+      // Done by InitSprite() for the engine on the emulation thread.
+      std::memset(buffer_wr, 0, sizeof(Sprite::Pixel) * 240);
+
+      replica->RenderScanlineSprite();
+      break;
+    }
+    case Type::WriteSprites: {
+      RenderCommand::WriteSprites command;
+
+      Read(command);
+
+      std::memcpy(replica->sprite.buffer_wr, command.pixels, sizeof(command.pixels));
+      break;
+    }
+    case Type::SwapSpriteBuffers: {
+      std::swap(replica->sprite.buffer_rd, replica->sprite.buffer_wr);
+      break;
+    }
+    case Type::DrawScanline: {
+      RenderCommand::DrawScanline command;
+
+      Read(command);
+
+      replica->mmio = command.mmio;
+      replica->bg.affine[0] = command.affine[0];
+      replica->bg.affine[1] = command.affine[1];
+      std::memcpy(replica->window.buffer, command.window, sizeof(command.window));
+
+      if(command.set_vram_bg_latch) {
+        replica->vram_bg_latch = command.vram_bg_latch;
+      }
+
+      replica->RenderScanlineBG();
+      replica->RenderScanlineMerge(command.out);
+      break;
+    }
+  }
+}
+
+} // namespace nba::core
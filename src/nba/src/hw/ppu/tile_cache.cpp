@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <cstring>
+
+#include "hw/ppu/tile_cache.hpp"
+
+namespace nba::core {
+
+void TileCache::Reset() {
+  std::memset(dirty_4bpp, 0xFF, sizeof(dirty_4bpp));
+  std::memset(dirty_8bpp, 0xFF, sizeof(dirty_8bpp));
+}
+
+void TileCache::Decode4BPP(u8 const* vram, uint number) {
+  auto& tile = tiles_4bpp[number];
+  const u8* data = &vram[number << 5];
+
+  for(uint y = 0; y < 8; y++) {
+    for(uint x = 0; x < 8; x++) {
+      const u8 index = (data[x >> 1] >> ((x & 1U) << 2)) & 15U;
+
+      tile.rows[0][y][x] = index;
+      tile.rows[1][y][7 - x] = index;
+    }
+
+    data += 4;
+  }
+
+  dirty_4bpp[number >> 6] &= ~(1ULL << (number & 63U));
+}
+
+void TileCache::Decode8BPP(u8 const* vram, uint number) {
+  auto& tile = tiles_8bpp[number];
+  const u8* data = &vram[number << 6];
+
+  for(uint y = 0; y < 8; y++) {
+    for(uint x = 0; x < 8; x++) {
+      tile.rows[0][y][x] = data[x];
+      tile.rows[1][y][7 - x] = data[x];
+    }
+
+    data += 8;
+  }
+
+  dirty_8bpp[number >> 6] &= ~(1ULL << (number & 63U));
+}
+
+} // namespace nba::core
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <nba/common/compiler.hpp>
+#include <nba/integer.hpp>
+
+namespace nba::core {
+
+/**
+ * BG tiles decoded to one byte per pixel, for the text BGs of the scanline renderer.
+ *
+ * Each tile is stored both as is and horizontally flipped, so that a row of a tile
+ * can be plotted without unpacking or swapping any pixels. Tiles are decoded when
+ * they are first used after a write to any of their bytes, which most tiles never
+ * see from one frame to the next. 4BPP tiles hold the color index without the palette.
+ */
+struct TileCache {
+  // Only tiles below the sprite VRAM boundary of the text BG modes are cached.
+  static constexpr u32 kSize = 0x10000;
+
+  void Reset();
+
+  void ALWAYS_INLINE Invalidate(u32 address) {
+    if(address < kSize) {
+      dirty_4bpp[address >> 11] |= 1ULL << ((address >> 5) & 63U);
+      dirty_8bpp[address >> 12] |= 1ULL << ((address >> 6) & 63U);
+    }
+  }
+
+  // Returns the eight pixels of row 'y' of the 4BPP tile at 'address', which must be below kSize.
+  auto ALWAYS_INLINE GetRow4BPP(u8 const* vram, u32 address, uint y, bool flip_x) -> u8 const* {
+    const uint number = address >> 5;
+
+    if(dirty_4bpp[number >> 6] & (1ULL << (number & 63U))) {
+      Decode4BPP(vram, number);
+    }
+    return tiles_4bpp[number].rows[flip_x][y];
+  }
+
+  // Returns the eight pixels of row 'y' of the 8BPP tile at 'address', which must be below kSize.
+  auto ALWAYS_INLINE GetRow8BPP(u8 const* vram, u32 address, uint y, bool flip_x) -> u8 const* {
+    const uint number = address >> 6;
+
+    if(dirty_8bpp[number >> 6] & (1ULL << (number & 63U))) {
+      Decode8BPP(vram, number);
+    }
+    return tiles_8bpp[number].rows[flip_x][y];
+  }
+
+private:
+  struct Tile {
+    u8 rows[2][8][8]; // [flip_x][y][x]
+  };
+
+  void Decode4BPP(u8 const* vram, uint number);
+  void Decode8BPP(u8 const* vram, uint number);
+
+  u64 dirty_4bpp[kSize / 32 / 64];
+  u64 dirty_8bpp[kSize / 64 / 64];
+
+  Tile tiles_4bpp[kSize / 32];
+  Tile tiles_8bpp[kSize / 64];
+};
+
+} // namespace nba::core
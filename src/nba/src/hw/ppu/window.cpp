@@ -5,6 +5,8 @@
  * Refer to the included LICENSE file.
  */
 
+#include <algorithm>
+
 #include "ppu.hpp"
 
 namespace nba::core {
@@ -66,4 +68,42 @@ void PPU::DrawWindow() {
   window.timestamp_last_sync = timestamp_now;
 }
 
+void PPU::RenderScanlineWindow(uint cycle_end) {
+  const uint x_end = (cycle_end + 3U) >> 2;
+
+  for(int i = 0; i < 2; i++) {
+    const uint min = (uint)mmio.winh[i].min;
+    const uint max = (uint)mmio.winh[i].max;
+
+    uint x = (window.cycle + 3U) >> 2;
+
+    // The flag only changes at 'min' and 'max', so draw the spans between them.
+    while(x < x_end) {
+      if(x == min) {
+        window.h_flag[i] = true;
+      }
+
+      if(x == max) {
+        window.h_flag[i] = false;
+      }
+
+      uint x_next = x_end;
+
+      if(min > x && min < x_next) x_next = min;
+      if(max > x && max < x_next) x_next = max;
+
+      const bool inside = window.h_flag[i] && window.v_flag[i];
+
+      for(uint span_x = x; span_x < std::min(x_next, 240U); span_x++) {
+        window.buffer[span_x][i] = inside;
+      }
+
+      x = x_next;
+    }
+  }
+
+  window.cycle = std::max(window.cycle, cycle_end);
+  window.timestamp_last_sync = scheduler.GetTimestampNow();
+}
+
 } // namespace nba::core
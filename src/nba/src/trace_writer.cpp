@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include "trace_writer.hpp"
+
+namespace nba::core {
+
+TraceWriter::~TraceWriter() {
+  Stop();
+}
+
+bool TraceWriter::Start(std::string const& path, void const* header, size_t header_size) {
+  Stop();
+
+  file = std::fopen(path.c_str(), "wb");
+
+  if(file == nullptr) {
+    return false;
+  }
+
+  std::fwrite(header, header_size, 1, file);
+
+  ring.Start([this](ByteRing::Span const& span) {
+    for(int i = 0; i < 2; i++) {
+      std::fwrite(span.data[i], 1, span.size[i], file);
+    }
+  });
+
+  return true;
+}
+
+void TraceWriter::Stop() {
+  if(!ring.IsActive()) {
+    return;
+  }
+
+  ring.Stop();
+
+  std::fclose(file);
+  file = nullptr;
+}
+
+} // namespace nba::core
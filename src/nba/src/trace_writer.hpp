@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <nba/common/compiler.hpp>
+#include <nba/integer.hpp>
+#include <string>
+
+#include "byte_ring.hpp"
+
+namespace nba::core {
+
+/**
+ * Writes a trace file through a ByteRing, whose consumer thread performs the I/O,
+ * so that the emulation thread never does.
+ */
+struct TraceWriter {
+  // The capacity of the ring buffer in bytes, which must be a power of two.
+  explicit TraceWriter(u64 capacity) : ring(capacity) {}
+
+ ~TraceWriter();
+
+  // Opens the trace file and writes the header into it.
+  bool Start(std::string const& path, void const* header, size_t header_size);
+  void Stop();
+
+  bool ALWAYS_INLINE IsActive() const {
+    return ring.IsActive();
+  }
+
+  void ALWAYS_INLINE Write(void const* data, u64 size) {
+    ring.Write(data, size);
+  }
+
+private:
+  ByteRing ring;
+  std::FILE* file = nullptr;
+};
+
+} // namespace nba::core
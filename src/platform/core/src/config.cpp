@@ -35,6 +35,7 @@ void PlatformConfig::Load(std::string const& path) {
       auto general = general_result.unwrap();
       this->bios_path = toml::find_or<std::string>(general, "bios_path", "bios.bin");
       this->skip_bios = toml::find_or<toml::boolean>(general, "bios_skip", false);
+      this->hle_bios = toml::find_or<toml::boolean>(general, "bios_hle", false);
       this->save_folder = toml::find_or<std::string>(general, "save_folder", "");
     }
   }
@@ -71,6 +72,41 @@ void PlatformConfig::Load(std::string const& path) {
     }
   }
 
+  if(data.contains("cpu")) {
+    auto cpu_result = toml::expect<toml::value>(data.at("cpu"));
+
+    if(cpu_result.is_ok()) {
+      auto cpu = cpu_result.unwrap();
+      auto backend = toml::find_or<std::string>(cpu, "backend", "interpreter");
+
+      const std::map<std::string, Config::CPU::Backend> backends{
+        { "interpreter", Config::CPU::Backend::Interpreter       },
+        { "cached",      Config::CPU::Backend::CachedInterpreter },
+        { "jit",         Config::CPU::Backend::JIT               }
+      };
+
+      auto match = backends.find(backend);
+
+      if(match == backends.end()) {
+        Log<Warn>("Config: unknown CPU backend: {} (defaulting to interpreter).", backend);
+        this->cpu.backend = Config::CPU::Backend::Interpreter;
+      } else {
+        this->cpu.backend = match->second;
+      }
+
+      this->cpu.idle_loop_skip = toml::find_or<toml::boolean>(cpu, "idle_loop_skip", false);
+      this->cpu.idle_loop_overrides.clear();
+
+      for(auto const& [game_code, address] : toml::find_or<toml::table>(cpu, "idle_loops", toml::table{})) {
+        if(address.is_integer()) {
+          this->cpu.idle_loop_overrides[game_code] = (u32)address.as_integer();
+        } else {
+          Log<Warn>("Config: idle loop address for game {} is not an integer.", game_code);
+        }
+      }
+    }
+  }
+
   if(data.contains("video")) {
     auto video_result = toml::expect<toml::value>(data.at("video"));
 
@@ -102,6 +138,22 @@ void PlatformConfig::Load(std::string const& path) {
       }
 
       this->video.lcd_ghosting = toml::find_or<bool>(video, "lcd_ghosting", true);
+
+      const std::map<std::string, Config::PPU::Renderer> renderers{
+        { "accurate", Config::PPU::Renderer::Accurate },
+        { "scanline", Config::PPU::Renderer::Scanline },
+        { "threaded", Config::PPU::Renderer::Threaded }
+      };
+
+      auto renderer = toml::find_or<std::string>(video, "renderer", "accurate");
+      auto renderer_match = renderers.find(renderer);
+
+      if(renderer_match == renderers.end()) {
+        Log<Warn>("Config: unknown PPU renderer: {} (defaulting to accurate).", renderer);
+        this->ppu.renderer = Config::PPU::Renderer::Accurate;
+      } else {
+        this->ppu.renderer = renderer_match->second;
+      }
     }
   }
 
@@ -154,6 +206,7 @@ void PlatformConfig::Save(std::string const& path) {
   // General
   data["general"]["bios_path"] = this->bios_path;
   data["general"]["bios_skip"] = this->skip_bios;
+  data["general"]["bios_hle"] = this->hle_bios;
   data["general"]["save_folder"] = this->save_folder;
 
   // Cartridge
@@ -172,9 +225,24 @@ void PlatformConfig::Save(std::string const& path) {
   data["cartridge"]["force_solar_sensor"] = this->cartridge.force_solar_sensor;
   data["cartridge"]["solar_sensor_level"] = this->cartridge.solar_sensor_level;
 
+  // CPU
+  std::string backend;
+  switch(this->cpu.backend) {
+    case Config::CPU::Backend::Interpreter:       backend = "interpreter"; break;
+    case Config::CPU::Backend::CachedInterpreter: backend = "cached"; break;
+    case Config::CPU::Backend::JIT:               backend = "jit"; break;
+  }
+  data["cpu"]["backend"] = backend;
+  data["cpu"]["idle_loop_skip"] = this->cpu.idle_loop_skip;
+
+  for(auto const& [game_code, address] : this->cpu.idle_loop_overrides) {
+    data["cpu"]["idle_loops"][game_code] = (toml::integer)address;
+  }
+
   // Video
   std::string filter;
   std::string color_correction;
+  std::string renderer;
 
   switch(this->video.filter) {
     case Video::Filter::Nearest: filter = "nearest"; break;
@@ -188,9 +256,16 @@ void PlatformConfig::Save(std::string const& path) {
     case Video::Color::AGB:   color_correction = "agb"; break;
   }
 
+  switch(this->ppu.renderer) {
+    case Config::PPU::Renderer::Accurate: renderer = "accurate"; break;
+    case Config::PPU::Renderer::Scanline: renderer = "scanline"; break;
+    case Config::PPU::Renderer::Threaded: renderer = "threaded"; break;
+  }
+
   data["video"]["filter"] = filter;
   data["video"]["color_correction"] = color_correction;
   data["video"]["lcd_ghosting"] = this->video.lcd_ghosting;
+  data["video"]["renderer"] = renderer;
 
   // Audio
   std::string resampler;
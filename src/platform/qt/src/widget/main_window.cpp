@@ -172,6 +172,12 @@ void MainWindow::CreateVideoMenu(QMenu* parent) {
   }, &config->video.color, false, reload_config);
 
   CreateBooleanOption(menu, "LCD ghosting", &config->video.lcd_ghosting, false, reload_config);
+
+  CreateSelectionOption(menu->addMenu(tr("Renderer")), {
+    { "Accurate", nba::Config::PPU::Renderer::Accurate },
+    { "Scanline", nba::Config::PPU::Renderer::Scanline },
+    { "Threaded", nba::Config::PPU::Renderer::Threaded }
+  }, &config->ppu.renderer, false);
 }
 
 void MainWindow::CreateAudioMenu(QMenu* parent) {
@@ -220,6 +226,7 @@ void MainWindow::CreateSystemMenu(QMenu* parent) {
   });
 
   CreateBooleanOption(menu, "Skip BIOS", &config->skip_bios);
+  CreateBooleanOption(menu, "HLE BIOS calls", &config->hle_bios, true);
 
   menu->addSeparator();
 
@@ -732,6 +739,11 @@ void MainWindow::LoadROM(std::u16string const& path) {
 
     switch(nba::BIOSLoader::Load(core, QString::fromStdString(config->bios_path).toStdU16String())) {
       case nba::BIOSLoader::Result::CannotFindFile: {
+        // The core can run without a BIOS image when BIOS calls are emulated.
+        if(config->hle_bios) {
+          break;
+        }
+
         QMessageBox box {this};
         box.setText(tr("A Game Boy Advance BIOS file is required but cannot be located.\n\nWould you like to add one now?"));
         box.setIcon(QMessageBox::Question);
@@ -0,0 +1,746 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <cstdio>
+#include <fmt/format.h>
+#include <memory>
+#include <nba/core.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Runs the same program on a core which uses the interpreter and on a core which uses the JIT,
+ * in chunks of a random number of cycles, and checks that the register file, the pipeline,
+ * the timestamp and work RAM match after every chunk. Halfway through, both cores load
+ * the state of the interpreter core.
+ *
+ * The programs are generated by this test: random ARM and Thumb code (in ROM and in IWRAM)
+ * with loads and stores to EWRAM, self-modifying code in IWRAM and EWRAM (which the JIT stops
+ * compiling once it has been overwritten often enough), an LDM with user mode registers,
+ * an invalid CPU mode and timer IRQs. They run a second time with idle loop skipping enabled.
+ * A BIOS and ROMs given on the command line are run in addition to them:
+ * nba-test-arm-jit [bios rom...]
+ */
+
+using namespace nba;
+
+static constexpr int kCyclesPerFrame = 280896;
+
+enum Register {
+  R0, R1, R2, R3, R4, R5, R6, R7, R8, R9, R10, R11, R12, SP, LR, PC
+};
+
+enum Condition : u32 {
+  EQ = 0,
+  AL = 14
+};
+
+enum DataOp : u32 {
+  AND = 0,
+  SUB = 2,
+  ADD = 4,
+  TST = 8,
+  ORR = 12,
+  MOV = 13
+};
+
+struct Random {
+  u32 state;
+
+  auto Next() -> u32 {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  auto Range(u32 count) -> u32 {
+    return Next() % count;
+  }
+};
+
+struct Assembler {
+  explicit Assembler(u32 base) : base(base) {}
+
+  auto Here() const -> u32 {
+    return base + (u32)data.size();
+  }
+
+  void Word(u32 value) {
+    for(int i = 0; i < 4; i++) data.push_back((u8)(value >> (i * 8)));
+  }
+
+  void Half(u16 value) {
+    data.push_back((u8)value);
+    data.push_back((u8)(value >> 8));
+  }
+
+  void PatchWord(u32 address, u32 value) {
+    for(int i = 0; i < 4; i++) data[address - base + i] = (u8)(value >> (i * 8));
+  }
+
+  void PatchHalf(u32 address, u16 value) {
+    data[address - base + 0] = (u8)value;
+    data[address - base + 1] = (u8)(value >> 8);
+  }
+
+  void Align(size_t alignment) {
+    while(data.size() % alignment) data.push_back(0);
+  }
+
+  u32 base;
+  std::vector<u8> data;
+};
+
+// ARM instruction encodings
+
+static auto Imm(u32 imm8, u32 rotate) -> u32 {
+  return (1 << 25) | (rotate << 8) | imm8;
+}
+
+static auto ShiftImm(u32 rm, u32 type, u32 amount) -> u32 {
+  return (amount << 7) | (type << 5) | rm;
+}
+
+static auto ShiftReg(u32 rm, u32 type, u32 rs) -> u32 {
+  return (rs << 8) | (type << 5) | (1 << 4) | rm;
+}
+
+static auto Data(u32 cond, u32 opcode, bool set_flags, u32 rd, u32 rn, u32 operand) -> u32 {
+  return (cond << 28) | (opcode << 21) | ((u32)set_flags << 20) | (rn << 16) | (rd << 12) | operand;
+}
+
+static auto Branch(u32 cond, bool link, u32 address, u32 target) -> u32 {
+  return (cond << 28) | (5 << 25) | ((u32)link << 24) | (((target - address - 8) >> 2) & 0xFFFFFF);
+}
+
+static auto BranchExchange(u32 rm) -> u32 {
+  return 0xE12FFF10 | rm;
+}
+
+static auto Transfer(u32 cond, bool load, bool byte, bool pre, bool add, bool writeback, u32 rd, u32 rn, u32 offset, bool register_offset) -> u32 {
+  return (cond << 28) | (1 << 26) | ((u32)register_offset << 25) | ((u32)pre << 24) | ((u32)add << 23) |
+         ((u32)byte << 22) | ((u32)writeback << 21) | ((u32)load << 20) | (rn << 16) | (rd << 12) | offset;
+}
+
+static auto HalfwordTransfer(u32 cond, bool load, u32 opcode, bool pre, bool add, bool writeback, u32 rd, u32 rn, u32 offset, bool immediate) -> u32 {
+  return (cond << 28) | ((u32)pre << 24) | ((u32)add << 23) | ((u32)immediate << 22) | ((u32)writeback << 21) |
+         ((u32)load << 20) | (rn << 16) | (rd << 12) | ((offset & 0xF0) << 4) | (1 << 7) | (opcode << 5) | (1 << 4) | (offset & 0xF);
+}
+
+static auto BlockTransfer(u32 cond, bool load, bool pre, bool add, bool user_mode, bool writeback, u32 rn, u32 list) -> u32 {
+  return (cond << 28) | (1 << 27) | ((u32)pre << 24) | ((u32)add << 23) | ((u32)user_mode << 22) |
+         ((u32)writeback << 21) | ((u32)load << 20) | (rn << 16) | list;
+}
+
+static auto MSRControl(u32 imm8) -> u32 {
+  return 0xE321F000 | imm8;
+}
+
+static void LoadConstant(Assembler& code, u32 rd, u32 value) {
+  code.Word(Data(AL, MOV, false, rd, 0, Imm(value & 0xFF, 0)));
+
+  for(u32 i = 1; i < 4; i++) {
+    const u32 byte = (value >> (i * 8)) & 0xFF;
+
+    if(byte != 0) {
+      code.Word(Data(AL, ORR, false, rd, rd, Imm(byte, 16 - i * 4)));
+    }
+  }
+}
+
+// Calls the code at the address in R12, which returns with BX LR.
+static void CallR12(Assembler& code) {
+  code.Word(Data(AL, MOV, false, LR, 0, ShiftImm(PC, 0, 0)));
+  code.Word(BranchExchange(R12));
+}
+
+// Copies the given number of bytes (a multiple of 16) with LDM and STM.
+static void Copy(Assembler& code, u32 src, u32 dst, u32 size) {
+  LoadConstant(code, R1, src);
+  LoadConstant(code, R2, dst);
+  LoadConstant(code, R3, size / 16);
+
+  const u32 loop = code.Here();
+  code.Word(BlockTransfer(AL, true,  false, true, false, true, R1, 0xF0));
+  code.Word(BlockTransfer(AL, false, false, true, false, true, R2, 0xF0));
+  code.Word(Data(AL, SUB, true, R3, R3, Imm(1, 0)));
+  code.Word(Branch(1, false, code.Here(), loop));
+}
+
+// Thumb instruction encodings
+
+static auto ThumbHighRegister(u32 opcode, u32 rd, u32 rs) -> u16 {
+  return (u16)(0x4400 | (opcode << 8) | ((rd >> 3) << 7) | ((rs >> 3) << 6) | ((rs & 7) << 3) | (rd & 7));
+}
+
+static constexpr u16 kThumbNOP = 0x46C0; // MOV R8, R8
+static constexpr u16 kThumbReturn = 0x4770; // BX LR
+
+/**
+ * Emits a random ARM instruction (or a conditional branch over a few of them).
+ * Loads and stores use R9 as the base (in EWRAM) and R10 as the register offset.
+ * Only the first data_registers registers are written.
+ */
+static void EmitRandomARM(Assembler& code, Random& random, u32 data_registers, bool allow_branch) {
+  const u32 cond = random.Range(4) == 0 ? random.Range(15) : AL;
+  const u32 kind = random.Range(100);
+
+  const auto Src = [&]() { return random.Range(8); };
+  const auto Dst = [&]() { return random.Range(data_registers); };
+
+  if(kind < 50) {
+    const u32 opcode = random.Range(16);
+    const bool set_flags = (opcode >= 8 && opcode <= 11) || random.Range(2) == 0;
+
+    switch(random.Range(3)) {
+      case 0: {
+        const u32 rn = random.Range(10) == 0 ? (u32)PC : Src();
+        code.Word(Data(cond, opcode, set_flags, Dst(), rn, Imm(random.Range(256), random.Range(16))));
+        break;
+      }
+      case 1: {
+        const u32 rn = random.Range(10) == 0 ? (u32)PC : Src();
+        const u32 rm = random.Range(10) == 0 ? (u32)PC : Src();
+        code.Word(Data(cond, opcode, set_flags, Dst(), rn, ShiftImm(rm, random.Range(4), random.Range(32))));
+        break;
+      }
+      case 2: {
+        code.Word(Data(cond, opcode, set_flags, Dst(), Src(), ShiftReg(Src(), random.Range(4), Src())));
+        break;
+      }
+    }
+  } else if(kind < 56) {
+    const bool set_flags = random.Range(2) == 0;
+    const bool accumulate = random.Range(2) == 0;
+
+    // The destination registers must differ from each other and from Rm.
+    const u32 rd = Dst();
+    const u32 rd2 = (rd + 1 + random.Range(data_registers - 1)) % data_registers;
+    u32 rm = Src();
+
+    while(rm == rd || rm == rd2) rm = Src();
+
+    if(random.Range(2) == 0) {
+      code.Word((cond << 28) | ((u32)accumulate << 21) | ((u32)set_flags << 20) | (rd << 16) | (Src() << 12) | (Src() << 8) | 0x90 | rm);
+    } else {
+      const bool sign_extend = random.Range(2) == 0;
+      code.Word((cond << 28) | (1 << 23) | ((u32)sign_extend << 22) | ((u32)accumulate << 21) | ((u32)set_flags << 20) | (rd << 16) | (rd2 << 12) | (Src() << 8) | 0x90 | rm);
+    }
+  } else if(kind < 70) {
+    const bool load = random.Range(2) == 0;
+    const bool pre = random.Range(2) == 0;
+    const bool writeback = pre ? random.Range(2) == 0 : random.Range(4) == 0;
+    const bool register_offset = random.Range(3) == 0;
+    const u32 offset = register_offset ? ShiftImm(R10, random.Range(2), random.Range(2)) : random.Range(256);
+
+    if(load && pre && !writeback && random.Range(8) == 0) {
+      // Literal loads from the code
+      code.Word(Transfer(cond, true, random.Range(2) == 0, true, true, false, Dst(), PC, random.Range(256), false));
+    } else {
+      code.Word(Transfer(cond, load, random.Range(2) == 0, pre, random.Range(2) == 0, writeback, load ? Dst() : Src(), R9, offset, register_offset));
+    }
+  } else if(kind < 78) {
+    const bool load = random.Range(2) == 0;
+    const bool pre = random.Range(2) == 0;
+    const bool writeback = pre && random.Range(2) == 0;
+    const bool immediate = random.Range(3) != 0;
+    const u32 opcode = load ? 1 + random.Range(3) : 1;
+
+    code.Word(HalfwordTransfer(cond, load, opcode, pre, random.Range(2) == 0, writeback, load ? Dst() : Src(), R9, immediate ? random.Range(256) : (u32)R10, immediate));
+  } else if(kind < 82) {
+    const bool load = random.Range(2) == 0;
+    const u32 list = 1 + random.Range(load ? (1 << data_registers) - 1 : 255);
+
+    code.Word(BlockTransfer(cond, load, random.Range(2) == 0, random.Range(2) == 0, false, random.Range(2) == 0, R9, list));
+  } else if(kind < 84) {
+    code.Word((cond << 28) | 0x01000090 | (random.Range(2) << 22) | (R9 << 16) | (Dst() << 12) | Src());
+  } else if(kind < 90) {
+    if(random.Range(2) == 0) {
+      code.Word((cond << 28) | 0x010F0000 | (Dst() << 12)); // MRS Rd, CPSR
+    } else {
+      code.Word((cond << 28) | 0x0128F000 | Src()); // MSR CPSR_f, Rm
+    }
+  } else if(allow_branch) {
+    const u32 count = 1 + random.Range(3);
+    const u32 address = code.Here();
+
+    code.Word(Branch(cond, false, address, address + 4 + count * 4));
+    for(u32 i = 0; i < count; i++) EmitRandomARM(code, random, data_registers, false);
+  } else {
+    code.Word(Data(cond, ADD, true, Dst(), Src(), ShiftImm(Src(), 0, 0)));
+  }
+}
+
+/**
+ * Emits a random Thumb instruction or a short sequence of them.
+ * R0 to R5 hold data, loads and stores use R7 as the base (in EWRAM) and R6 as the offset.
+ * R11 and R12 are used as scratch registers.
+ */
+static void EmitRandomThumb(Assembler& code, Random& random, bool allow_sequence) {
+  const u32 kind = random.Range(100);
+
+  const auto Src = [&]() { return random.Range(8); };
+  const auto Dst = [&]() { return random.Range(6); };
+
+  const auto EmitSkip = [&](u32 count) {
+    for(u32 i = 0; i < count; i++) EmitRandomThumb(code, random, false);
+  };
+
+  if(kind < 10) {
+    code.Half((u16)((random.Range(3) << 11) | (random.Range(32) << 6) | (Src() << 3) | Dst()));
+  } else if(kind < 18) {
+    code.Half((u16)(0x1800 | (random.Range(4) << 9) | (Src() << 6) | (Src() << 3) | Dst()));
+  } else if(kind < 28) {
+    code.Half((u16)(0x2000 | (random.Range(4) << 11) | (Dst() << 8) | random.Range(256)));
+  } else if(kind < 48) {
+    code.Half((u16)(0x4000 | (random.Range(16) << 6) | (Src() << 3) | Dst()));
+  } else if(kind < 54) {
+    const u32 opcode = random.Range(3);
+
+    switch(random.Range(3)) {
+      case 0: code.Half(ThumbHighRegister(opcode, Dst(), R8 + random.Range(5))); break;
+      case 1: code.Half(ThumbHighRegister(opcode, R11 + random.Range(2), Src())); break;
+      case 2: code.Half(ThumbHighRegister(1, R8 + random.Range(5), R8 + random.Range(5))); break;
+    }
+  } else if(kind < 58) {
+    code.Half((u16)(0x4800 | (Dst() << 8) | random.Range(256)));
+  } else if(kind < 66) {
+    const bool load = random.Range(2) == 0;
+    const u32 rd = load ? Dst() : Src();
+
+    if(random.Range(2) == 0) {
+      code.Half((u16)(0x5000 | ((u32)load << 11) | (random.Range(2) << 10) | (R6 << 6) | (R7 << 3) | rd));
+    } else {
+      // STRH, LDSB, LDRH and LDSH
+      const u32 opcode = load ? 1 + random.Range(3) : 0;
+      code.Half((u16)(0x5200 | (opcode << 10) | (R6 << 6) | (R7 << 3) | rd));
+    }
+  } else if(kind < 76) {
+    const bool load = random.Range(2) == 0;
+    const u32 rd = load ? Dst() : Src();
+
+    if(random.Range(2) == 0) {
+      code.Half((u16)(0x6000 | (random.Range(2) << 12) | ((u32)load << 11) | (random.Range(32) << 6) | (R7 << 3) | rd));
+    } else {
+      code.Half((u16)(0x8000 | ((u32)load << 11) | (random.Range(32) << 6) | (R7 << 3) | rd));
+    }
+  } else if(kind < 80) {
+    const bool load = random.Range(2) == 0;
+    code.Half((u16)(0x9000 | ((u32)load << 11) | ((load ? Dst() : Src()) << 8) | random.Range(16)));
+  } else if(kind < 83) {
+    code.Half((u16)(0xA000 | (random.Range(2) << 11) | (Dst() << 8) | random.Range(256)));
+  } else if(kind < 86 && allow_sequence) {
+    if(random.Range(2) == 0) {
+      const u32 words = 1 + random.Range(8);
+
+      code.Half((u16)(0xB080 | words)); // SUB SP, #imm
+      code.Half((u16)(0x9000 | (Src() << 8) | random.Range(words)));
+      code.Half((u16)(0xB000 | words)); // ADD SP, #imm
+    } else {
+      // The instruction in between may overwrite the stack, so only data registers are pushed.
+      const u32 list = 1 + random.Range(63);
+
+      code.Half((u16)(0xB400 | list)); // PUSH
+      EmitRandomThumb(code, random, false);
+      code.Half((u16)(0xBC00 | list)); // POP
+    }
+  } else if(kind < 92 && allow_sequence) {
+    const u32 count = 1 + random.Range(3);
+    code.Half((u16)(0xD000 | (random.Range(14) << 8) | (count - 1)));
+    EmitSkip(count);
+  } else if(kind < 94 && allow_sequence) {
+    const u32 count = 1 + random.Range(3);
+    code.Half((u16)(0xE000 | (count - 1)));
+    EmitSkip(count);
+  } else if(kind < 96 && allow_sequence) {
+    // BL to a subroutine that is skipped by a branch
+    code.Half(ThumbHighRegister(2, R12, LR));
+    code.Half(0xF000);
+    code.Half(0xF801);
+    code.Half(0xE001);
+    EmitRandomThumb(code, random, false);
+    code.Half(kThumbReturn);
+    code.Half(ThumbHighRegister(2, LR, R12));
+  } else if(kind < 98 && allow_sequence) {
+    // BX PC to a few ARM instructions and back
+    if(code.Here() & 2) {
+      code.Half(kThumbNOP);
+    }
+    code.Half(0x4778);
+    code.Half(kThumbNOP);
+
+    const u32 count = 1 + random.Range(3);
+    for(u32 i = 0; i < count; i++) EmitRandomARM(code, random, 6, false);
+
+    code.Word(Data(AL, ADD, false, R12, PC, Imm(1, 0)));
+    code.Word(BranchExchange(R12));
+  } else {
+    code.Half((u16)(0x4000 | (random.Range(16) << 6) | (Src() << 3) | Dst()));
+  }
+}
+
+/**
+ * Patches the immediate of an ADD instruction with R0 before it is fetched, after it has
+ * been fetched and some time before it runs. Returns with R0 updated by the ADD instructions.
+ */
+static void EmitSelfModifyingARM(Assembler& code) {
+  const u32 adr = code.Here();
+  code.Word(0);
+  code.Word(Data(AL, AND, false, R3, R0, Imm(0xFF, 0)));
+  code.Word(Data(AL, MOV, false, R4, 0, Imm(0xE2, 4)));
+  code.Word(Data(AL, ORR, false, R4, R4, Imm(0x80, 8)));
+  code.Word(Data(AL, ORR, false, R4, R4, ShiftImm(R3, 0, 0))); // R4 = ADD R0, R0, #imm
+  code.Word(Transfer(AL, false, false, true, true, false, R4, R2, 0, false));
+  code.Word(Transfer(AL, false, false, true, true, false, R4, PC, 0, false));
+  code.Word(Data(AL, MOV, false, R0, 0, ShiftImm(R0, 0, 0)));
+  code.Word(Data(AL, ADD, false, R0, R0, Imm(1, 0))); // patched after it has been fetched
+  code.Word(Transfer(AL, false, false, true, true, false, R4, PC, 4, false));
+  code.Word(Data(AL, MOV, false, R0, 0, ShiftImm(R0, 0, 0)));
+  code.Word(Data(AL, MOV, false, R0, 0, ShiftImm(R0, 0, 0)));
+  code.Word(Data(AL, ADD, false, R0, R0, Imm(2, 0))); // patched before it is fetched
+  code.Word(Data(AL, MOV, false, R5, 0, Imm(3, 0)));
+  const u32 loop = code.Here();
+  code.Word(Data(AL, SUB, true, R5, R5, Imm(1, 0)));
+  code.Word(Branch(1, false, code.Here(), loop));
+  const u32 patched = code.Here();
+  code.Word(Data(AL, ADD, false, R0, R0, Imm(0, 0)));
+  code.Word(Data(AL, MOV, false, R0, 0, ShiftImm(R0, 3, 3)));
+  code.Word(BranchExchange(LR));
+  code.PatchWord(adr, Data(AL, ADD, false, R2, PC, Imm(patched - adr - 8, 0)));
+}
+
+// Same as EmitSelfModifyingARM() for Thumb code.
+static void EmitSelfModifyingThumb(Assembler& code) {
+  const u32 adr = code.Here();
+  code.Half(0);
+  code.Half(0x23FF); // MOVS R3, #0xFF
+  code.Half(0x4003); // ANDS R3, R0
+  code.Half(0x2430); // MOVS R4, #0x30
+  code.Half(0x0224); // LSLS R4, R4, #8
+  code.Half(0x431C); // ORRS R4, R3 (R4 = ADDS R0, #imm)
+  code.Half(0x8014); // STRH R4, [R2]
+  code.Half(0x4679); // MOV R1, PC
+  code.Half(0x804C); // STRH R4, [R1, #2]
+  code.Half(kThumbNOP);
+  code.Half(0x3001); // ADDS R0, #1, patched after it has been fetched
+  code.Half(0x4679); // MOV R1, PC
+  code.Half(0x808C); // STRH R4, [R1, #4]
+  code.Half(kThumbNOP);
+  code.Half(kThumbNOP);
+  code.Half(0x3002); // ADDS R0, #2, patched before it is fetched
+  if(code.Here() & 2) {
+    code.Half(kThumbNOP);
+  }
+  const u32 patched = code.Here();
+  code.Half(0x3000); // ADDS R0, #0
+  code.Half(0x0040); // LSLS R0, R0, #1
+  code.Half(kThumbReturn);
+  code.PatchHalf(adr, (u16)(0xA200 | ((patched - ((adr + 4) & ~3)) >> 2))); // ADD R2, PC, #imm
+}
+
+static auto GenerateBIOS() -> std::vector<u8> {
+  Assembler code{0};
+
+  // Any SWI halts the CPU until the next IRQ.
+  code.Word(Branch(AL, false, 0x00, 0x1C));
+  code.Word(0);
+  code.Word(Branch(AL, false, 0x08, 0x20));
+  code.Word(0);
+  code.Word(0);
+  code.Word(0);
+  code.Word(Branch(AL, false, 0x18, 0x34));
+  code.Word(Branch(AL, false, 0x1C, 0x1C));
+  code.Word(0xE92D5000); // STMFD SP!, {R12, LR}
+  code.Word(0xE3A0C301); // MOV R12, #0x04000000
+  code.Word(0xE5CCC301); // STRB R12, [R12, #0x301]
+  code.Word(0xE8BD5000); // LDMFD SP!, {R12, LR}
+  code.Word(0xE1B0F00E); // MOVS PC, LR
+  code.Word(0xE92D500F); // STMFD SP!, {R0-R3, R12, LR}
+  code.Word(0xE3A00301); // MOV R0, #0x04000000
+  code.Word(0xE28FE000); // ADD LR, PC, #0
+  code.Word(0xE510F004); // LDR PC, [R0, #-4]
+  code.Word(0xE8BD500F); // LDMFD SP!, {R0-R3, R12, LR}
+  code.Word(0xE25EF004); // SUBS PC, LR, #4
+
+  code.data.resize(0x4000);
+  return code.data;
+}
+
+static auto GenerateROM(u32 seed) -> std::vector<u8> {
+  static constexpr u32 kARMCodeIWRAM = 0x03000400;
+  static constexpr u32 kSMCCodeIWRAM = 0x03000000;
+  static constexpr u32 kSMCCodeEWRAM = 0x02000000;
+  static constexpr u32 kDataEWRAM = 0x02020000;
+
+  Random random{seed};
+  Assembler code{0x08000000};
+
+  code.Word(0);
+
+  const u32 irq_handler = code.Here();
+  code.Word(Data(AL, MOV, false, R0, 0, Imm(0x01, 3)));
+  code.Word(Data(AL, ADD, false, R0, R0, Imm(0x02, 12)));
+  code.Word(Data(AL, MOV, false, R1, 0, Imm(0x08, 0)));
+  code.Word(HalfwordTransfer(AL, false, 1, true, true, false, R1, R0, 2, true)); // IF
+  LoadConstant(code, R0, 0x03007000);
+  code.Word(Transfer(AL, true, false, true, true, false, R1, R0, 0, false));
+  code.Word(Data(AL, ADD, false, R1, R1, Imm(1, 0)));
+  code.Word(Transfer(AL, false, false, true, true, false, R1, R0, 0, false));
+  code.Word(BranchExchange(LR));
+
+  code.Align(16);
+  const u32 arm_code = code.Here();
+  for(int i = 0; i < 160; i++) EmitRandomARM(code, random, 8, true);
+  code.Word(BranchExchange(LR));
+  code.Align(16);
+  const u32 arm_code_size = code.Here() - arm_code;
+
+  const u32 thumb_code = code.Here();
+  for(int i = 0; i < 160; i++) EmitRandomThumb(code, random, true);
+  code.Half(kThumbReturn);
+  code.Align(16);
+
+  Assembler smc_arm{kSMCCodeIWRAM};
+  Assembler smc_thumb{kSMCCodeEWRAM};
+  EmitSelfModifyingARM(smc_arm);
+  EmitSelfModifyingThumb(smc_thumb);
+  smc_arm.Align(16);
+  smc_thumb.Align(16);
+
+  const u32 smc_arm_code = code.Here();
+  code.data.insert(code.data.end(), smc_arm.data.begin(), smc_arm.data.end());
+  const u32 smc_thumb_code = code.Here();
+  code.data.insert(code.data.end(), smc_thumb.data.begin(), smc_thumb.data.end());
+
+  const u32 main = code.Here();
+  code.PatchWord(0x08000000, Branch(AL, false, 0x08000000, main));
+
+  LoadConstant(code, SP, 0x03007F00);
+  LoadConstant(code, R0, 0x03007FFC);
+  LoadConstant(code, R1, irq_handler);
+  code.Word(Transfer(AL, false, false, true, true, false, R1, R0, 0, false));
+
+  // Timer 0 requests an IRQ every 512 cycles.
+  code.Word(Data(AL, MOV, false, R0, 0, Imm(0x01, 3)));
+  code.Word(Data(AL, ADD, false, R2, R0, Imm(0x02, 12)));
+  code.Word(Data(AL, MOV, false, R1, 0, Imm(0x08, 0)));
+  code.Word(HalfwordTransfer(AL, false, 1, true, true, false, R1, R2, 0, true)); // IE
+  code.Word(Data(AL, MOV, false, R1, 0, Imm(0x01, 0)));
+  code.Word(HalfwordTransfer(AL, false, 1, true, true, false, R1, R2, 8, true)); // IME
+  LoadConstant(code, R1, 0x00C0FE00);
+  code.Word(Transfer(AL, false, false, true, true, false, R1, R0, 0x100, false));
+
+  Copy(code, arm_code, kARMCodeIWRAM, arm_code_size);
+  Copy(code, smc_arm_code, kSMCCodeIWRAM, (u32)smc_arm.data.size());
+  Copy(code, smc_thumb_code, kSMCCodeEWRAM, (u32)smc_thumb.data.size());
+
+  for(u32 reg = R0; reg <= R7; reg++) LoadConstant(code, reg, random.Next());
+  LoadConstant(code, R10, random.Range(256));
+  code.Word(Data(AL, MOV, false, R8, 0, Imm(0, 0)));
+
+  const u32 loop = code.Here();
+
+  // Random ARM code in ROM and IWRAM
+  LoadConstant(code, R9, kDataEWRAM);
+  code.Word(Branch(AL, true, code.Here(), arm_code));
+  LoadConstant(code, R9, kDataEWRAM);
+  LoadConstant(code, R12, kARMCodeIWRAM);
+  CallR12(code);
+
+  // Random Thumb code in ROM
+  LoadConstant(code, R7, kDataEWRAM + 0x4000);
+  code.Word(Data(AL, MOV, false, R6, 0, Imm(random.Range(32) * 2, 0)));
+  LoadConstant(code, R12, thumb_code | 1);
+  CallR12(code);
+
+  // Self-modifying code in IWRAM and EWRAM
+  code.Word(Data(AL, MOV, false, R0, 0, ShiftImm(R8, 0, 0)));
+  LoadConstant(code, R12, kSMCCodeIWRAM);
+  CallR12(code);
+  code.Word(Data(AL, MOV, false, R0, 0, ShiftImm(R8, 0, 0)));
+  LoadConstant(code, R12, kSMCCodeEWRAM | 1);
+  CallR12(code);
+
+  // Registers are accessed right after an LDM with user mode registers and in an invalid mode.
+  code.Word(MSRControl(0xD3));
+  LoadConstant(code, R1, kDataEWRAM + 0x8000);
+  code.Word(BlockTransfer(AL, false, false, true, true, false, R1, 0x7F00));
+  code.Word(BlockTransfer(AL, true,  false, true, true, false, R1, 0x7F00));
+  code.Word(Data(AL, MOV, false, R2, 0, ShiftImm(SP, 0, 0)));
+  code.Word(Data(AL, ADD, false, R3, LR, ShiftImm(R8, 0, 0)));
+  code.Word(Data(AL, MOV, false, R4, 0, ShiftImm(R9, 0, 0)));
+  code.Word(MSRControl(0xD4));
+  code.Word(Data(AL, MOV, false, R2, 0, ShiftImm(SP, 0, 0)));
+  code.Word(Data(AL, ADD, false, R3, R8, ShiftImm(R12, 0, 0)));
+  code.Word(Data(AL, MOV, false, R5, 0, ShiftImm(LR, 0, 0)));
+  code.Word(0xE10F0000); // MRS R0, CPSR
+  code.Word(MSRControl(0xD3));
+  code.Word(MSRControl(0x1F));
+
+  // Wait for an IRQ every 16 iterations.
+  code.Word(Data(AL, ADD, false, R8, R8, Imm(1, 0)));
+  code.Word(Data(AL, TST, true, 0, R8, Imm(15, 0)));
+  code.Word((EQ << 28) | 0x0F000000);
+  code.Word(Branch(AL, false, code.Here(), loop));
+
+  code.data.resize(0x10000);
+  return code.data;
+}
+
+static auto CreateCoreWithBackend(std::vector<u8> const& bios, std::vector<u8> const& rom, Config::CPU::Backend backend, bool idle_loop_skip) -> std::unique_ptr<CoreBase> {
+  auto config = std::make_shared<Config>();
+  config->skip_bios = true;
+  config->cpu.backend = backend;
+  config->cpu.idle_loop_skip = idle_loop_skip;
+
+  auto core = CreateCore(config);
+  core->Attach(bios);
+  core->Attach(ROM{std::vector<u8>{rom}, nullptr, nullptr});
+  core->Reset();
+  return core;
+}
+
+static bool Compare(SaveState const& a, SaveState const& b, std::string& error) {
+  for(int i = 0; i < 16; i++) {
+    if(a.arm.regs.gpr[i] != b.arm.regs.gpr[i]) {
+      error = fmt::format("r{}: 0x{:08X} (interpreter) != 0x{:08X} (JIT)", i, a.arm.regs.gpr[i], b.arm.regs.gpr[i]);
+      return false;
+    }
+  }
+
+  for(int bank = 0; bank < 6; bank++) {
+    for(int i = 0; i < 7; i++) {
+      if(a.arm.regs.bank[bank][i] != b.arm.regs.bank[bank][i]) {
+        error = fmt::format("banked register {} of bank {}: 0x{:08X} (interpreter) != 0x{:08X} (JIT)", i, bank, a.arm.regs.bank[bank][i], b.arm.regs.bank[bank][i]);
+        return false;
+      }
+    }
+
+    if(a.arm.regs.spsr[bank] != b.arm.regs.spsr[bank]) {
+      error = fmt::format("SPSR of bank {}: 0x{:08X} (interpreter) != 0x{:08X} (JIT)", bank, a.arm.regs.spsr[bank], b.arm.regs.spsr[bank]);
+      return false;
+    }
+  }
+
+  if(a.arm.regs.cpsr != b.arm.regs.cpsr) {
+    error = fmt::format("CPSR: 0x{:08X} (interpreter) != 0x{:08X} (JIT)", a.arm.regs.cpsr, b.arm.regs.cpsr);
+    return false;
+  }
+
+  if(a.arm.pipe.access != b.arm.pipe.access || a.arm.pipe.opcode[0] != b.arm.pipe.opcode[0] || a.arm.pipe.opcode[1] != b.arm.pipe.opcode[1]) {
+    error = fmt::format("pipeline: 0x{:08X} 0x{:08X} {} (interpreter) != 0x{:08X} 0x{:08X} {} (JIT)",
+      a.arm.pipe.opcode[0], a.arm.pipe.opcode[1], a.arm.pipe.access, b.arm.pipe.opcode[0], b.arm.pipe.opcode[1], b.arm.pipe.access);
+    return false;
+  }
+
+  if(a.timestamp != b.timestamp) {
+    error = fmt::format("timestamp: {} (interpreter) != {} (JIT)", a.timestamp, b.timestamp);
+    return false;
+  }
+
+  if(a.bus.memory.wram != b.bus.memory.wram || a.bus.memory.iram != b.bus.memory.iram) {
+    error = "work RAM differs";
+    return false;
+  }
+
+  return true;
+}
+
+static bool Test(std::string const& name, std::vector<u8> const& bios, std::vector<u8> const& rom, int cycles, bool idle_loop_skip) {
+  auto interpreter = CreateCoreWithBackend(bios, rom, Config::CPU::Backend::Interpreter, idle_loop_skip);
+  auto jit = CreateCoreWithBackend(bios, rom, Config::CPU::Backend::JIT, idle_loop_skip);
+
+  auto state_a = std::make_unique<SaveState>();
+  auto state_b = std::make_unique<SaveState>();
+
+  Random random{0x12345678};
+  int chunks = 0;
+  bool reloaded = false;
+
+  for(int elapsed = 0; elapsed < cycles;) {
+    const int chunk = 1 + (int)random.Range(8192);
+
+    interpreter->Run(chunk);
+    jit->Run(chunk);
+    elapsed += chunk;
+    chunks++;
+
+    interpreter->CopyState(*state_a);
+    jit->CopyState(*state_b);
+
+    std::string error;
+
+    if(!Compare(*state_a, *state_b, error)) {
+      fmt::print(stderr, "{}: mismatch after {} chunks ({} cycles): {}\n", name, chunks, elapsed, error);
+      return false;
+    }
+
+    if(!reloaded && elapsed >= cycles / 2) {
+      interpreter->LoadState(*state_a);
+      jit->LoadState(*state_a);
+      reloaded = true;
+    }
+  }
+
+  fmt::print("{}: {} chunks match\n", name, chunks);
+  return true;
+}
+
+static auto ReadFile(char const* path) -> std::vector<u8> {
+  std::vector<u8> data;
+
+  if(FILE* file = std::fopen(path, "rb")) {
+    std::fseek(file, 0, SEEK_END);
+    data.resize((size_t)std::ftell(file));
+    std::fseek(file, 0, SEEK_SET);
+    if(std::fread(data.data(), 1, data.size(), file) != data.size()) {
+      data.clear();
+    }
+    std::fclose(file);
+  }
+
+  return data;
+}
+
+int main(int argc, char** argv) {
+  bool success = true;
+
+#if !defined(__x86_64__) && !defined(_M_X64)
+  fmt::print("the JIT is not available on this host, both cores use the interpreter\n");
+#endif
+
+  const auto bios = GenerateBIOS();
+
+  for(u32 seed = 1; seed <= 4; seed++) {
+    const auto rom = GenerateROM(seed * 0x9E3779B9);
+
+    for(bool idle_loop_skip : {false, true}) {
+      const auto name = fmt::format("generated ROM #{}{}", seed, idle_loop_skip ? " (idle loop skip)" : "");
+
+      success &= Test(name, bios, rom, 4 * kCyclesPerFrame, idle_loop_skip);
+    }
+  }
+
+  if(argc > 2) {
+    const auto user_bios = ReadFile(argv[1]);
+
+    for(int i = 2; i < argc; i++) {
+      const auto rom = ReadFile(argv[i]);
+
+      if(user_bios.empty() || rom.empty()) {
+        fmt::print(stderr, "failed to read {} or {}\n", argv[1], argv[i]);
+        success = false;
+        continue;
+      }
+
+      success &= Test(argv[i], user_bios, rom, 60 * kCyclesPerFrame, false);
+    }
+  }
+
+  return success ? 0 : 1;
+}
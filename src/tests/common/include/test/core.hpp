@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <nba/core.hpp>
+#include <string>
+#include <vector>
+
+namespace nba::test {
+
+/**
+ * Creates a core which runs a program of ARM instructions from the start of the ROM,
+ * without a BIOS image: BIOS calls are emulated and the boot screen is skipped,
+ * so the program starts in system mode with the stack pointers that the BIOS sets up.
+ * The ROM is padded to 4 KiB.
+ */
+auto CreateCore(std::vector<u32> const& program, std::shared_ptr<Config> config) -> std::unique_ptr<CoreBase>;
+
+/**
+ * Runs a test once with each CPU backend and returns whether it passed with all of them.
+ * The test is given a fresh config which selects the backend and a name for its output.
+ */
+bool RunWithEachBackend(std::function<bool(std::shared_ptr<Config> config, std::string const& name)> test);
+
+// Reads a word from IWRAM (the offset is relative to 0x03000000) of a save state.
+auto ReadIWRAM(SaveState const& state, u32 offset) -> u32;
+
+} // namespace nba::test
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <test/core.hpp>
+#include <utility>
+
+namespace nba::test {
+
+auto CreateCore(std::vector<u32> const& program, std::shared_ptr<Config> config) -> std::unique_ptr<CoreBase> {
+  std::vector<u8> rom;
+
+  for(u32 word : program) {
+    for(int i = 0; i < 4; i++) rom.push_back((u8)(word >> (i * 8)));
+  }
+  rom.resize(0x1000);
+
+  config->hle_bios = true;
+
+  auto core = nba::CreateCore(config);
+  core->Attach(ROM{std::move(rom), nullptr, nullptr});
+  core->Reset();
+  return core;
+}
+
+bool RunWithEachBackend(std::function<bool(std::shared_ptr<Config> config, std::string const& name)> test) {
+  const std::pair<Config::CPU::Backend, const char*> backends[] {
+    { Config::CPU::Backend::Interpreter, "interpreter" },
+    { Config::CPU::Backend::CachedInterpreter, "cached interpreter" },
+    { Config::CPU::Backend::JIT, "JIT" }
+  };
+
+  bool success = true;
+
+  for(auto [backend, name] : backends) {
+    auto config = std::make_shared<Config>();
+    config->cpu.backend = backend;
+
+    success &= test(config, name);
+  }
+
+  return success;
+}
+
+auto ReadIWRAM(SaveState const& state, u32 offset) -> u32 {
+  auto& iram = state.bus.memory.iram;
+
+  return iram[offset] | (iram[offset + 1] << 8) | (iram[offset + 2] << 16) | ((u32)iram[offset + 3] << 24);
+}
+
+} // namespace nba::test
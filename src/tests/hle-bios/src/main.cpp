@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <fmt/format.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <test/core.hpp>
+#include <vector>
+
+/**
+ * Runs programs without a BIOS image, with BIOS calls emulated. The first program installs
+ * an IRQ handler, enables the V-Blank IRQ and calls VBlankIntrWait and Div in a loop,
+ * so it depends on the IRQ dispatch and the SWIs of the replacement BIOS.
+ *
+ * The second program makes the calls listed in a table and stores r0, r1 and r3 after each one.
+ * The registers and the memory written by the calls are compared against known answers.
+ * The compressed data was made by an encoder outside of the core.
+ */
+
+using namespace nba;
+
+static constexpr int kFrames = 10;
+
+static const std::vector<u32> kProgram{
+  0xE321F01F, // 0x08000000: msr cpsr_c, #0x1F    (system mode, IRQs enabled)
+  0xE3A00403, // 0x08000004: mov r0, #0x03000000
+  0xE2800C7F, // 0x08000008: add r0, r0, #0x7F00
+  0xE28000FC, // 0x0800000C: add r0, r0, #0xFC
+  0xE28F1048, // 0x08000010: add r1, pc, #0x48     (irq_handler)
+  0xE5801000, // 0x08000014: str r1, [r0]
+  0xE3A00301, // 0x08000018: mov r0, #0x04000000
+  0xE3A01008, // 0x0800001C: mov r1, #8
+  0xE1C010B4, // 0x08000020: strh r1, [r0, #4]    (DISPSTAT: V-Blank IRQ)
+  0xE2802C02, // 0x08000024: add r2, r0, #0x200
+  0xE3A01001, // 0x08000028: mov r1, #1
+  0xE1C210B0, // 0x0800002C: strh r1, [r2]        (IE: V-Blank)
+  0xE1C210B8, // 0x08000030: strh r1, [r2, #8]    (IME)
+  // loop:
+  0xEF050000, // 0x08000034: swi 0x05             (VBlankIntrWait)
+  0xE3A02403, // 0x08000038: mov r2, #0x03000000
+  0xE5921004, // 0x0800003C: ldr r1, [r2, #4]
+  0xE2811001, // 0x08000040: add r1, r1, #1
+  0xE5821004, // 0x08000044: str r1, [r2, #4]     (count returns from VBlankIntrWait)
+  0xE3A00064, // 0x08000048: mov r0, #100
+  0xE3A01007, // 0x0800004C: mov r1, #7
+  0xEF060000, // 0x08000050: swi 0x06             (Div)
+  0xE5820008, // 0x08000054: str r0, [r2, #8]
+  0xE582100C, // 0x08000058: str r1, [r2, #12]
+  0xEAFFFFF4, // 0x0800005C: b loop
+  // irq_handler:
+  0xE2801C02, // 0x08000060: add r1, r0, #0x200
+  0xE1D120B2, // 0x08000064: ldrh r2, [r1, #2]    (IF)
+  0xE1C120B2, // 0x08000068: strh r2, [r1, #2]
+  0xE15030B8, // 0x0800006C: ldrh r3, [r0, #-8]   (flags for IntrWait)
+  0xE1833002, // 0x08000070: orr r3, r3, r2
+  0xE14030B8, // 0x08000074: strh r3, [r0, #-8]
+  0xE3A01403, // 0x08000078: mov r1, #0x03000000
+  0xE5912000, // 0x0800007C: ldr r2, [r1]
+  0xE2822001, // 0x08000080: add r2, r2, #1
+  0xE5812000, // 0x08000084: str r2, [r1]         (count IRQs)
+  0xE12FFF1E  // 0x08000088: bx lr
+};
+
+static bool TestIRQ(std::shared_ptr<Config> config, std::string const& name) {
+  auto core = test::CreateCore(kProgram, config);
+  core->Run(kFrames * CoreBase::kCyclesPerFrame);
+
+  auto state = std::make_unique<SaveState>();
+  core->CopyState(*state);
+
+  const u32 irqs = test::ReadIWRAM(*state, 0);
+  const u32 waits = test::ReadIWRAM(*state, 4);
+  const u32 quotient = test::ReadIWRAM(*state, 8);
+  const u32 remainder = test::ReadIWRAM(*state, 12);
+
+  // The first V-Blank happens after 160 of the 228 lines of a frame.
+  if(irqs < kFrames - 1 || irqs > kFrames || waits != irqs) {
+    fmt::print(stderr, "{}: {} V-Blank IRQs and {} returns from VBlankIntrWait in {} frames\n", name, irqs, waits, kFrames);
+    return false;
+  }
+
+  if(quotient != 14 || remainder != 2) {
+    fmt::print(stderr, "{}: Div(100, 7) returned {} remainder {}\n", name, quotient, remainder);
+    return false;
+  }
+
+  fmt::print("{}: {} frames waited for\n", name, waits);
+  return true;
+}
+
+// Calls the stub at the address in r4 with the arguments in r0-r3, for each entry of the call table.
+static const std::vector<u32> kCallDriver{
+  0xE3A08302, // 0x08000000: mov r8, #0x08000000
+  0xE3888C01, // 0x08000004: orr r8, r8, #0x100   (call table)
+  0xE3A09403, // 0x08000008: mov r9, #0x03000000
+  // loop:
+  0xE8B8001F, // 0x0800000C: ldmia r8!, {r0-r4}
+  0xE3540000, // 0x08000010: cmp r4, #0
+  0x0A000003, // 0x08000014: beq done
+  0xE1A0E00F, // 0x08000018: mov lr, pc
+  0xE12FFF14, // 0x0800001C: bx r4
+  0xE8A9000B, // 0x08000020: stmia r9!, {r0, r1, r3}
+  0xEAFFFFF8, // 0x08000024: b loop
+  // done:
+  0xEAFFFFFE  // 0x08000028: b done
+};
+
+/**
+ * Builds the ROM for kCallDriver: the call table at 0x08000100 and, from 0x08000800 on,
+ * the data used by the calls and a stub for each SWI, which calls it and returns.
+ */
+struct CallProgram {
+  static constexpr u32 kCallTable = 0x08000100;
+  static constexpr u32 kData = 0x08000800;
+  static constexpr int kMaxCalls = (kData - kCallTable) / 20 - 1;
+
+  // Appends data, aligned to a word, and returns its address.
+  auto Data(std::vector<u8> const& bytes) -> u32 {
+    const u32 address = kData + (u32)data.size();
+
+    data.insert(data.end(), bytes.begin(), bytes.end());
+    data.resize((data.size() + 3) & ~3);
+    return address;
+  }
+
+  auto Word(u32 word) -> u32 {
+    return Data({(u8)word, (u8)(word >> 8), (u8)(word >> 16), (u8)(word >> 24)});
+  }
+
+  // Appends a call to the table and returns its index, which selects its results.
+  auto Call(int swi, u32 r0, u32 r1, u32 r2 = 0, u32 r3 = 0) -> int {
+    if(stubs.count(swi) == 0) {
+      stubs[swi] = Word(0xEF000000 | (swi << 16)); // swi #swi
+      Word(0xE12FFF1E); // bx lr
+    }
+
+    calls.insert(calls.end(), {r0, r1, r2, r3, stubs[swi]});
+    return (int)calls.size() / 5 - 1;
+  }
+
+  auto Build() const -> std::vector<u32> {
+    std::vector<u32> program = kCallDriver;
+
+    program.resize((kCallTable & 0xFFFF) / sizeof(u32));
+    program.insert(program.end(), calls.begin(), calls.end());
+    program.resize((kData & 0xFFFF) / sizeof(u32));
+
+    for(size_t i = 0; i < data.size(); i += sizeof(u32)) {
+      program.push_back(data[i] | (data[i + 1] << 8) | (data[i + 2] << 16) | ((u32)data[i + 3] << 24));
+    }
+    return program;
+  }
+
+  std::vector<u32> calls;
+  std::vector<u8> data;
+  std::map<int, u32> stubs;
+};
+
+struct RegisterCheck {
+  std::string name;
+  int call;
+  int reg; // 0, 1 or 3
+  u32 expected;
+};
+
+struct MemoryCheck {
+  std::string name;
+  u32 address;
+  std::vector<u8> expected;
+};
+
+static const std::vector<u8> kLZ77Text{'A', 'B', 'C', 'D', 'A', 'B', 'C', 'D', 'A', 'B', 'C', 'D', 'A', 'B', 'C', 'D', 'E', 'F', 'G'};
+
+static const std::vector<u8> kLZ77Data{
+  0x10, 0x13, 0x00, 0x00, 0x08, 0x41, 0x42, 0x43, 0x44, 0x90, 0x03, 0x45, 0x46, 0x47
+};
+
+// 41 bytes: 'A' ten times, "bcd" and 'e' 28 times.
+static const std::vector<u8> kRLData{
+  0x30, 0x29, 0x00, 0x00, 0x87, 0x41, 0x02, 0x62, 0x63, 0x64, 0x99, 0x65
+};
+
+static const std::vector<u8> kHuffText{
+  'A', 'B', 'R', 'A', 'C', 'A', 'D', 'A', 'B', 'R', 'A', '!', 'A', 'B', 'R', 'A', 'C', 'A', 'D', 'A', 'B', 'R', 'A', '!'
+};
+
+static const std::vector<u8> kHuff8Data{
+  0x28, 0x18, 0x00, 0x00, 0x05, 0x80, 0x41, 0x00, 0xC0, 0x81, 0x21, 0x42, 0x52, 0xC0, 0x43, 0x44,
+  0x45, 0xAE, 0xE7, 0x5C, 0x00, 0xE4, 0x7A, 0xCE
+};
+
+static const std::vector<u8> kHuff4Data{
+  0x24, 0x18, 0x00, 0x00, 0x05, 0x80, 0x04, 0x80, 0x01, 0x40, 0xC0, 0x02, 0x03, 0x05, 0x00, 0x00,
+  0x13, 0x62, 0xF6, 0x9D, 0xFB, 0xCE, 0xCB, 0xBE, 0x65, 0xDF, 0x09, 0x31, 0x00, 0x00, 0x00, 0xC0
+};
+
+static auto Repeat(u8 value, int count) -> std::vector<u8> {
+  return std::vector<u8>(count, value);
+}
+
+static auto Concat(std::vector<u8> a, std::vector<u8> const& b) -> std::vector<u8> {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+static void AddMathCalls(CallProgram& program, std::vector<RegisterCheck>& checks) {
+  const struct {
+    s32 numerator;
+    s32 denominator;
+    s32 quotient;
+    s32 remainder;
+  } divisions[] {
+    {  100,      7,  14,  2 },
+    { -100,      7, -14, -2 },
+    {  100,     -7, -14,  2 },
+    // The quotient does not fit into 32 bits and wraps around.
+    { INT32_MIN, -1, INT32_MIN, 0 }
+  };
+
+  for(auto& division : divisions) {
+    const auto name = fmt::format("Div({}, {})", division.numerator, division.denominator);
+    const int call = program.Call(0x06, (u32)division.numerator, (u32)division.denominator);
+
+    checks.push_back({name, call, 0, (u32)division.quotient});
+    checks.push_back({name, call, 1, (u32)division.remainder});
+    checks.push_back({name, call, 3, division.quotient < 0 ? -(u32)division.quotient : (u32)division.quotient});
+  }
+
+  const struct {
+    u32 value;
+    u32 root;
+  } roots[] {
+    { 0, 0 },
+    { 1, 1 },
+    { 2, 1 },
+    { 0x10000, 0x100 },
+    { 0xFFFFFFFF, 0xFFFF }
+  };
+
+  for(auto& root : roots) {
+    checks.push_back({fmt::format("Sqrt(0x{:X})", root.value), program.Call(0x08, root.value, 0), 0, root.root});
+  }
+
+  // The full circle is 0x10000. Angles near a full circle wrap around to zero.
+  const struct {
+    s32 x;
+    s32 y;
+    u32 angle;
+  } angles[] {
+    {  0x0100,  0x0000, 0x0000 },
+    { -0x0100,  0x0000, 0x8000 },
+    {  0x0000,  0x0100, 0x4000 },
+    {  0x0000, -0x0100, 0xC000 },
+    {  0x4000,  0x4000, 0x2000 },
+    {  0x4000,  0x2000, 0x12E4 },
+    {  0x1000,  0x3000, 0x32E5 },
+    { -0x1000,  0x3000, 0x4D1C },
+    { -0x3000,  0x1000, 0x72E4 },
+    { -0x3000, -0x1000, 0x8D1B },
+    { -0x1000, -0x3000, 0xB2E5 },
+    {  0x1000, -0x3000, 0xCD1C },
+    {  0x3000, -0x1000, 0xF2E4 },
+    {  0x4000, -0x0001, 0xFFFF },
+    {  0x40000000, -1,  0x0000 }
+  };
+
+  for(auto& angle : angles) {
+    const auto name = fmt::format("ArcTan2({}, {})", angle.x, angle.y);
+
+    checks.push_back({name, program.Call(0x0A, (u32)angle.x, (u32)angle.y), 0, angle.angle});
+  }
+}
+
+static void AddCopyCalls(CallProgram& program, std::vector<MemoryCheck>& checks) {
+  std::vector<u8> source;
+
+  for(int i = 0; i < 64; i++) {
+    source.push_back((u8)(i * 7 + 1));
+  }
+
+  const u32 src = program.Data(source);
+  const u32 fill = program.Word(0xDEADBEEF);
+
+  const auto head = [&](size_t count) {
+    return std::vector<u8>{source.begin(), source.begin() + count};
+  };
+
+  // Each check covers the bytes right after the copy too, which must be left alone.
+  program.Call(0x0B, src, 0x03001000, 5);
+  checks.push_back({"CpuSet: copy 5 halfwords", 0x03001000, Concat(head(10), Repeat(0, 6))});
+  program.Call(0x0B, src, 0x02000000, 3 | (1 << 26));
+  checks.push_back({"CpuSet: copy 3 words", 0x02000000, Concat(head(12), Repeat(0, 4))});
+  program.Call(0x0B, fill, 0x02000100, 3 | (1 << 24));
+  checks.push_back({"CpuSet: fill 3 halfwords", 0x02000100, {0xEF, 0xBE, 0xEF, 0xBE, 0xEF, 0xBE, 0, 0}});
+  program.Call(0x0B, fill, 0x03001100, 2 | (1 << 24) | (1 << 26));
+  checks.push_back({"CpuSet: fill 2 words", 0x03001100, {0xEF, 0xBE, 0xAD, 0xDE, 0xEF, 0xBE, 0xAD, 0xDE, 0, 0, 0, 0}});
+
+  // CpuFastSet rounds the count up to a multiple of eight words.
+  program.Call(0x0C, src, 0x03001200, 3);
+  checks.push_back({"CpuFastSet: copy 3 words", 0x03001200, Concat(head(32), Repeat(0, 4))});
+  program.Call(0x0C, fill, 0x02000200, 9 | (1 << 24));
+  checks.push_back({"CpuFastSet: fill 9 words", 0x02000200, Repeat(0, 68)});
+
+  auto& filled = checks.back().expected;
+
+  for(int i = 0; i < 64; i++) {
+    filled[i] = (u8)(0xDEADBEEF >> ((i & 3) * 8));
+  }
+}
+
+static void AddUnCompCalls(CallProgram& program, std::vector<MemoryCheck>& checks) {
+  const u32 lz77 = program.Data(kLZ77Data);
+  const u32 rl = program.Data(kRLData);
+  const u32 huff8 = program.Data(kHuff8Data);
+  const u32 huff4 = program.Data(kHuff4Data);
+  const u32 ones = program.Word(0xFFFFFFFF);
+
+  const auto rl_text = Concat(Concat(Repeat('A', 10), {'b', 'c', 'd'}), Repeat('e', 28));
+
+  program.Call(0x11, lz77, 0x02001000);
+  checks.push_back({"LZ77UnCompWram", 0x02001000, Concat(kLZ77Text, Repeat(0, 1))});
+  program.Call(0x14, rl, 0x02001100);
+  checks.push_back({"RLUnCompWram", 0x02001100, rl_text});
+  program.Call(0x13, huff8, 0x02001200);
+  checks.push_back({"HuffUnComp (8-bit)", 0x02001200, Concat(kHuffText, Repeat(0, 4))});
+  program.Call(0x13, huff4, 0x03001400);
+  checks.push_back({"HuffUnComp (4-bit)", 0x03001400, Concat(kHuffText, Repeat(0, 4))});
+
+  // The VRAM variants only write whole halfwords, so the last of an odd number of bytes is not written.
+  program.Call(0x0C, ones, 0x06000000, 32 | (1 << 24));
+  program.Call(0x12, lz77, 0x06000000);
+  checks.push_back({"LZ77UnCompVram", 0x06000000, Concat(std::vector<u8>{kLZ77Text.begin(), kLZ77Text.end() - 1}, Repeat(0xFF, 2))});
+  program.Call(0x15, rl, 0x06000040);
+  checks.push_back({"RLUnCompVram", 0x06000040, Concat(std::vector<u8>{rl_text.begin(), rl_text.end() - 1}, Repeat(0xFF, 1))});
+
+  // Compressed data in VRAM and in a mirror of EWRAM, which have no host address in the core.
+  program.Call(0x0C, lz77, 0x06010000, 4);
+  program.Call(0x11, 0x06010000, 0x02004000);
+  checks.push_back({"LZ77UnCompWram from VRAM", 0x02004000, kLZ77Text});
+  program.Call(0x0C, lz77, 0x02003000, 4);
+  program.Call(0x11, 0x02043000, 0x03002000);
+  checks.push_back({"LZ77UnCompWram from an EWRAM mirror", 0x03002000, kLZ77Text});
+}
+
+// Reads a byte of EWRAM, IWRAM or VRAM from a save state.
+static auto ReadByte(SaveState const& state, u32 address) -> u8 {
+  auto& memory = state.bus.memory;
+
+  switch(address >> 24) {
+    case 0x02: return memory.wram[address & 0x3FFFF];
+    case 0x03: return memory.iram[address & 0x7FFF];
+    case 0x06: return memory.vram[address & 0x17FFF];
+  }
+  return 0;
+}
+
+static bool TestCalls(std::shared_ptr<Config> config, std::string const& name) {
+  CallProgram program;
+  std::vector<RegisterCheck> register_checks;
+  std::vector<MemoryCheck> memory_checks;
+
+  AddMathCalls(program, register_checks);
+  AddCopyCalls(program, memory_checks);
+  AddUnCompCalls(program, memory_checks);
+
+  if(program.calls.size() / 5 > CallProgram::kMaxCalls) {
+    fmt::print(stderr, "{}: too many calls\n", name);
+    return false;
+  }
+
+  auto core = test::CreateCore(program.Build(), config);
+  core->RunForOneFrame();
+
+  auto state = std::make_unique<SaveState>();
+  core->CopyState(*state);
+
+  bool success = true;
+
+  for(auto& check : register_checks) {
+    const u32 value = test::ReadIWRAM(*state, check.call * 12 + (check.reg == 3 ? 8 : check.reg * 4));
+
+    if(value != check.expected) {
+      fmt::print(stderr, "{}: {}: r{} is 0x{:08X}, expected 0x{:08X}\n", name, check.name, check.reg, value, check.expected);
+      success = false;
+    }
+  }
+
+  for(auto& check : memory_checks) {
+    for(size_t i = 0; i < check.expected.size(); i++) {
+      const u8 value = ReadByte(*state, check.address + i);
+
+      if(value != check.expected[i]) {
+        fmt::print(stderr, "{}: {}: byte {} is 0x{:02X}, expected 0x{:02X}\n", name, check.name, i, value, check.expected[i]);
+        success = false;
+        break;
+      }
+    }
+  }
+
+  if(success) {
+    fmt::print("{}: {} calls with known answers\n", name, program.calls.size() / 5);
+  }
+
+  return success;
+}
+
+int main() {
+  bool success = true;
+
+  success &= test::RunWithEachBackend(TestIRQ);
+  success &= test::RunWithEachBackend(TestCalls);
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <test/core.hpp>
+#include <vector>
+
+/**
+ * Runs short ARM programs with and without idle loop skipping and checks that skipping
+ * does not change what the programs observe. A loop which polls a timer counter must never
+ * be skipped, because the counter changes without any event: the counter value read right
+ * after the loop would be off. A loop which polls a flag in RAM, set by the V-Blank IRQ handler,
+ * must be skipped, but must still see each V-Blank IRQ in the same scanline.
+ * A PC hook on the first instruction of each loop counts how often the loop actually runs.
+ */
+
+using namespace nba;
+
+static constexpr int kFrames = 10;
+
+// Skipping the RAM flag poll must save at least this factor of passes through the loop.
+static constexpr int kMinSkipRatio = 4;
+
+static const std::vector<u32> kTimerPoll{
+  0xE3A00301, // 0x08000000: mov r0, #0x04000000
+  0xE2800C01, // 0x08000004: add r0, r0, #0x100
+  0xE3A01502, // 0x08000008: mov r1, #0x00800000
+  0xE5801000, // 0x0800000C: str r1, [r0]         (TM0CNT: enable timer 0)
+  // poll:
+  0xE1D010B0, // 0x08000010: ldrh r1, [r0]        (TM0CNT_L)
+  0xE1B017A1, // 0x08000014: movs r1, r1, lsr #15
+  0x0AFFFFFC, // 0x08000018: beq poll
+  0xE1D010B0, // 0x0800001C: ldrh r1, [r0]
+  0xE3A02403, // 0x08000020: mov r2, #0x03000000
+  0xE5821000, // 0x08000024: str r1, [r2]         (counter after the loop)
+  0xEAFFFFFE  // 0x08000028: b 0x08000028
+};
+
+static const std::vector<u32> kRAMFlagPoll{
+  0xE321F01F, // 0x08000000: msr cpsr_c, #0x1F    (system mode, IRQs enabled)
+  0xE3A00403, // 0x08000004: mov r0, #0x03000000
+  0xE2800C7F, // 0x08000008: add r0, r0, #0x7F00
+  0xE28000FC, // 0x0800000C: add r0, r0, #0xFC
+  0xE28F104C, // 0x08000010: add r1, pc, #0x4C     (irq_handler)
+  0xE5801000, // 0x08000014: str r1, [r0]
+  0xE3A00301, // 0x08000018: mov r0, #0x04000000
+  0xE3A01008, // 0x0800001C: mov r1, #8
+  0xE1C010B4, // 0x08000020: strh r1, [r0, #4]    (DISPSTAT: V-Blank IRQ)
+  0xE2802C02, // 0x08000024: add r2, r0, #0x200
+  0xE3A01001, // 0x08000028: mov r1, #1
+  0xE1C210B0, // 0x0800002C: strh r1, [r2]        (IE: V-Blank)
+  0xE1C210B8, // 0x08000030: strh r1, [r2, #8]    (IME)
+  0xE3A03403, // 0x08000034: mov r3, #0x03000000
+  // poll:
+  0xE5931000, // 0x08000038: ldr r1, [r3]         (flag)
+  0xE3510000, // 0x0800003C: cmp r1, #0
+  0x0AFFFFFC, // 0x08000040: beq poll
+  0xE3A01000, // 0x08000044: mov r1, #0
+  0xE5831000, // 0x08000048: str r1, [r3]
+  0xE5934004, // 0x0800004C: ldr r4, [r3, #4]
+  0xE2844001, // 0x08000050: add r4, r4, #1
+  0xE5834004, // 0x08000054: str r4, [r3, #4]     (count flags seen)
+  0xE1D050B6, // 0x08000058: ldrh r5, [r0, #6]    (VCOUNT)
+  0xE5835008, // 0x0800005C: str r5, [r3, #8]
+  0xEAFFFFF4, // 0x08000060: b poll
+  // irq_handler:
+  0xE2801C02, // 0x08000064: add r1, r0, #0x200
+  0xE1D120B2, // 0x08000068: ldrh r2, [r1, #2]    (IF)
+  0xE1C120B2, // 0x0800006C: strh r2, [r1, #2]
+  0xE3A01403, // 0x08000070: mov r1, #0x03000000
+  0xE3A02001, // 0x08000074: mov r2, #1
+  0xE5812000, // 0x08000078: str r2, [r1]         (set flag)
+  0xE12FFF1E  // 0x0800007C: bx lr
+};
+
+struct Result {
+  std::vector<u32> words; // the first words of IWRAM
+  int passes = 0; // number of times the loop at the hooked address was run
+};
+
+static auto Run(std::vector<u32> const& program, std::shared_ptr<Config> config, bool idle_loop_skip, int count, u32 loop) -> Result {
+  config->cpu.idle_loop_skip = idle_loop_skip;
+
+  Result result;
+
+  auto core = test::CreateCore(program, config);
+  core->AddPCHook(loop, [&](u32) { result.passes++; });
+  core->Run(kFrames * CoreBase::kCyclesPerFrame);
+
+  auto state = std::make_unique<SaveState>();
+  core->CopyState(*state);
+
+  for(int i = 0; i < count; i++) {
+    result.words.push_back(test::ReadIWRAM(*state, i * sizeof(u32)));
+  }
+
+  return result;
+}
+
+static bool TestTimerPoll(std::shared_ptr<Config> config, std::string const& name) {
+  const auto result = Run(kTimerPoll, config, false, 1, 0x08000010);
+  const auto result_skip = Run(kTimerPoll, config, true, 1, 0x08000010);
+
+  const u32 counter = result.words[0];
+  const u32 counter_skip = result_skip.words[0];
+
+  if(counter < 0x8000) {
+    fmt::print(stderr, "{}: timer poll: the loop did not exit\n", name);
+    return false;
+  }
+
+  if(counter_skip != counter || result_skip.passes != result.passes) {
+    fmt::print(stderr, "{}: timer poll: read 0x{:04X} after {} passes with skipping, 0x{:04X} after {} passes without\n",
+      name, counter_skip, result_skip.passes, counter, result.passes);
+    return false;
+  }
+
+  fmt::print("{}: timer poll: not skipped\n", name);
+  return true;
+}
+
+static bool TestRAMFlagPoll(std::shared_ptr<Config> config, std::string const& name) {
+  const auto result = Run(kRAMFlagPoll, config, false, 3, 0x08000038);
+  const auto result_skip = Run(kRAMFlagPoll, config, true, 3, 0x08000038);
+
+  const auto& words = result.words;
+  const auto& words_skip = result_skip.words;
+
+  // The first V-Blank happens after 160 of the 228 lines of a frame.
+  if(words[1] < kFrames - 1 || words[2] != 160) {
+    fmt::print(stderr, "{}: RAM flag poll: saw {} flags in {} frames, the last one in line {}\n", name, words[1], kFrames, words[2]);
+    return false;
+  }
+
+  if(words_skip != words) {
+    fmt::print(stderr, "{}: RAM flag poll: saw {} flags, the last one in line {} with skipping, {} flags in line {} without\n",
+      name, words_skip[1], words_skip[2], words[1], words[2]);
+    return false;
+  }
+
+  // Each skip covers the time until the next scheduler event, which is several passes through the loop.
+  if(result_skip.passes * kMinSkipRatio > result.passes) {
+    fmt::print(stderr, "{}: RAM flag poll: the loop ran {} times with skipping, {} times without\n", name, result_skip.passes, result.passes);
+    return false;
+  }
+
+  fmt::print("{}: RAM flag poll: skipped, {} passes instead of {}\n", name, result_skip.passes, result.passes);
+  return true;
+}
+
+int main() {
+  bool success = true;
+
+  success &= test::RunWithEachBackend(TestTimerPoll);
+  success &= test::RunWithEachBackend(TestRAMFlagPoll);
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <test/core.hpp>
+#include <vector>
+
+/**
+ * Reads IE, IF and IME with halfword, word and byte loads, once the V-Blank flag is set in IF.
+ * The V-Blank IRQ is not enabled in IE, so the IRQ is never taken.
+ */
+
+using namespace nba;
+
+static const std::vector<u32> kProgram{
+  0xE3A00301, // 0x08000000: mov r0, #0x04000000
+  0xE3A01008, // 0x08000004: mov r1, #8
+  0xE1C010B4, // 0x08000008: strh r1, [r0, #4]    (DISPSTAT: V-Blank IRQ)
+  0xE2802C02, // 0x0800000C: add r2, r0, #0x200
+  0xE3A01A02, // 0x08000010: mov r1, #0x2000
+  0xE1C210B0, // 0x08000014: strh r1, [r2]        (IE: Game Pak)
+  0xE3A01001, // 0x08000018: mov r1, #1
+  0xE1C210B8, // 0x0800001C: strh r1, [r2, #8]    (IME)
+  // wait:
+  0xE1D010B6, // 0x08000020: ldrh r1, [r0, #6]    (VCOUNT)
+  0xE35100A1, // 0x08000024: cmp r1, #161
+  0x1AFFFFFC, // 0x08000028: bne wait
+  0xE3A03403, // 0x0800002C: mov r3, #0x03000000
+  0xE1D210B0, // 0x08000030: ldrh r1, [r2]        (IE)
+  0xE5831000, // 0x08000034: str r1, [r3]
+  0xE1D210B2, // 0x08000038: ldrh r1, [r2, #2]    (IF)
+  0xE5831004, // 0x0800003C: str r1, [r3, #4]
+  0xE1D210B8, // 0x08000040: ldrh r1, [r2, #8]    (IME)
+  0xE5831008, // 0x08000044: str r1, [r3, #8]
+  0xE5921000, // 0x08000048: ldr r1, [r2]         (IE and IF)
+  0xE583100C, // 0x0800004C: str r1, [r3, #12]
+  0xE5921008, // 0x08000050: ldr r1, [r2, #8]     (IME)
+  0xE5831010, // 0x08000054: str r1, [r3, #16]
+  0xE5D21008, // 0x08000058: ldrb r1, [r2, #8]    (IME)
+  0xE5831014, // 0x0800005C: str r1, [r3, #20]
+  0xEAFFFFFE  // 0x08000060: b 0x08000060
+};
+
+static bool Test(std::shared_ptr<Config> config, std::string const& name) {
+  auto core = test::CreateCore(kProgram, config);
+  core->RunForOneFrame();
+
+  auto state = std::make_unique<SaveState>();
+  core->CopyState(*state);
+
+  const struct {
+    const char* load;
+    u32 offset;
+    u32 expected;
+  } checks[] {
+    { "ldrh IE",     0, 0x2000 },
+    { "ldrh IF",     4, 0x0001 },
+    { "ldrh IME",    8, 0x0001 },
+    { "ldr IE/IF",  12, 0x0001'2000 },
+    { "ldr IME",    16, 0x0001 },
+    { "ldrb IME",   20, 0x0001 }
+  };
+
+  bool success = true;
+
+  for(auto& check : checks) {
+    const u32 value = test::ReadIWRAM(*state, check.offset);
+
+    if(value != check.expected) {
+      fmt::print(stderr, "{}: {} returned 0x{:08X}, expected 0x{:08X}\n", name, check.load, value, check.expected);
+      success = false;
+    }
+  }
+
+  if(success) {
+    fmt::print("{}: IE, IF and IME read back\n", name);
+  }
+
+  return success;
+}
+
+int main() {
+  return test::RunWithEachBackend(Test) ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <test/core.hpp>
+#include <vector>
+
+/**
+ * Registers PC hooks on a loop which runs 100 times and on the instruction after it,
+ * and checks how often they are called. Hooks must be kept when the core is reset
+ * and must not be called anymore once they have been removed.
+ */
+
+using namespace nba;
+
+static const std::vector<u32> kProgram{
+  0xE3A00000, // 0x08000000: mov r0, #0
+  0xE3A01064, // 0x08000004: mov r1, #100
+  // loop:
+  0xE2800001, // 0x08000008: add r0, r0, #1
+  0xE2511001, // 0x0800000C: subs r1, r1, #1
+  0x1AFFFFFC, // 0x08000010: bne loop
+  0xE3A02403, // 0x08000014: mov r2, #0x03000000
+  0xE5820000, // 0x08000018: str r0, [r2]
+  0xEAFFFFFE  // 0x0800001C: b 0x0800001C
+};
+
+static bool Test(std::shared_ptr<Config> config, std::string const& name) {
+  auto core = test::CreateCore(kProgram, config);
+
+  int loop_calls = 0;
+  int exit_calls = 0;
+
+  const int loop_hook = core->AddPCHook(0x08000008, [&](u32 address) {
+    if(address == 0x08000008) loop_calls++;
+  });
+
+  core->AddPCHook(0x08000014, [&](u32) { exit_calls++; });
+
+  const struct {
+    bool remove_loop_hook;
+    int loop_calls;
+    int exit_calls;
+  } runs[] {
+    { false, 100, 1 },
+    { false, 200, 2 }, // after a reset
+    { true,  200, 3 }  // after a reset, without the loop hook
+  };
+
+  for(int i = 0; i < 3; i++) {
+    if(i != 0) {
+      core->Reset();
+    }
+
+    if(runs[i].remove_loop_hook) {
+      core->RemovePCHook(loop_hook);
+    }
+
+    core->RunForOneFrame();
+
+    if(loop_calls != runs[i].loop_calls || exit_calls != runs[i].exit_calls) {
+      fmt::print(stderr, "{}: run {}: hooks were called {} and {} times, expected {} and {}\n",
+        name, i, loop_calls, exit_calls, runs[i].loop_calls, runs[i].exit_calls);
+      return false;
+    }
+  }
+
+  fmt::print("{}: hooks called as expected\n", name);
+  return true;
+}
+
+int main() {
+  return test::RunWithEachBackend(Test) ? 0 : 1;
+}
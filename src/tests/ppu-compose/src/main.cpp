@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <fmt/format.h>
+#include <random>
+#include <vector>
+
+#include "hw/ppu/compose.hpp"
+
+/**
+ * Checks that every implementation of Compose() gives the same output as applying
+ * Blend(), Brighten() and Darken() to each pixel, followed by GREENSWAP and RGB555(),
+ * which is what the merge engine did before it recorded the effects per scanline.
+ * All values of EVA, EVB and EVY (including those above 16) are tested, each with
+ * every combination of the color channels of the two blended pixels.
+ */
+
+using namespace nba;
+using namespace nba::core;
+
+enum class Effect {
+  None,
+  Blend,
+  Brighten,
+  Darken
+};
+
+struct Implementation {
+  const char* name;
+  void (*compose)(ComposeLine const&, u32*);
+};
+
+static std::vector<Implementation> g_implementations;
+
+/* Returns pairs of colors in which every channel takes all combinations of values
+ * between the first and the second color. Green is six bits wide, with bit 15 as
+ * its least significant bit.
+ */
+static auto GenerateColorPairs() -> std::vector<std::pair<u16, u16>> {
+  std::vector<std::pair<u16, u16>> pairs;
+
+  const auto Color = [](uint r, uint g6, uint b) {
+    return (u16)(r | (g6 >> 1) << 5 | b << 10 | (g6 & 1U) << 15);
+  };
+
+  for(uint i = 0; i < 4096; i++) {
+    const u16 color_a = Color((i >> 6) & 31U, i >> 6, (i >> 7) & 31U);
+    const u16 color_b = Color(i & 31U, i & 63U, (i >> 1) & 31U);
+
+    pairs.emplace_back(color_a, color_b);
+  }
+
+  return pairs;
+}
+
+static bool Check(ComposeLine const& line, u32 const expected[240], Effect effect, int eva, int evb, int evy) {
+  for(auto& implementation : g_implementations) {
+    u32 output[240];
+
+    implementation.compose(line, output);
+
+    for(uint x = 0; x < 240; x++) {
+      if(output[x] != expected[x]) {
+        fmt::print(stderr, "{}: effect {} eva={} evb={} evy={} greenswap={} a=0x{:04X} b=0x{:04X}: got 0x{:08X}, expected 0x{:08X}\n",
+          implementation.name, (int)effect, eva, evb, evy, line.greenswap, line.color_a[x], line.color_b[x], output[x], expected[x]);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static bool TestEffect(Effect effect, int eva, int evb, int evy, std::vector<std::pair<u16, u16>> const& pairs, std::mt19937& rng) {
+  for(size_t base = 0; base < pairs.size(); base += 240) {
+    ComposeLine line{};
+    u16 colors[240];
+    u32 expected[240];
+
+    for(uint x = 0; x < 240; x++) {
+      const auto [color_a, color_b] = pairs[(base + x) % pairs.size()];
+
+      switch(effect) {
+        case Effect::None: {
+          line.SetNone(x, color_a);
+          colors[x] = color_a;
+          break;
+        }
+        case Effect::Blend: {
+          line.SetBlend(x, color_a, color_b, eva, evb);
+          colors[x] = Blend(color_a, color_b, eva, evb);
+          break;
+        }
+        case Effect::Brighten: {
+          line.SetBrighten(x, color_a, evy);
+          colors[x] = Brighten(color_a, evy);
+          break;
+        }
+        case Effect::Darken: {
+          line.SetDarken(x, color_a, evy);
+          colors[x] = Darken(color_a, evy);
+          break;
+        }
+      }
+    }
+
+    for(uint x = 0; x < 240; x++) {
+      expected[x] = RGB555(colors[x]);
+    }
+
+    if(!Check(line, expected, effect, eva, evb, evy)) {
+      return false;
+    }
+
+    // GREENSWAP swaps the green bits of some of the pixel pairs.
+    for(uint x = 1; x < 240; x += 2) {
+      const bool greenswap = rng() & 1;
+
+      line.SetGreenswap(x, greenswap);
+
+      if(greenswap) {
+        const u16 mask = 31U << 5;
+
+        const u16 g_l = colors[x - 1] & mask;
+        const u16 g_r = colors[x - 0] & mask;
+
+        expected[x - 1] = RGB555((colors[x - 1] & ~mask) | g_r);
+        expected[x - 0] = RGB555((colors[x - 0] & ~mask) | g_l);
+      }
+    }
+
+    if(!Check(line, expected, effect, eva, evb, evy)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main() {
+  g_implementations.push_back({"scalar", ComposeScalar});
+
+  if(HostSupportsSSE2()) {
+    g_implementations.push_back({"SSE2", ComposeSSE2});
+  }
+
+  if(HostSupportsAVX2()) {
+    g_implementations.push_back({"AVX2", ComposeAVX2});
+  }
+
+  const auto pairs = GenerateColorPairs();
+
+  std::mt19937 rng{0x5EED};
+
+  bool success = TestEffect(Effect::None, 0, 0, 0, pairs, rng);
+
+  for(int eva = 0; eva < 32; eva++) {
+    for(int evb = 0; evb < 32; evb++) {
+      success &= TestEffect(Effect::Blend, eva, evb, 0, pairs, rng);
+    }
+  }
+
+  for(int evy = 0; evy < 32; evy++) {
+    success &= TestEffect(Effect::Brighten, 0, 0, evy, pairs, rng);
+    success &= TestEffect(Effect::Darken, 0, 0, evy, pairs, rng);
+  }
+
+  for(auto& implementation : g_implementations) {
+    fmt::print("{}: {}\n", implementation.name, success ? "bit-exact" : "mismatch");
+  }
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <test/core.hpp>
+#include <vector>
+
+/**
+ * Runs a program which fills PRAM, VRAM and OAM with pseudo-random words and shows a new scene
+ * every 16 frames, going through all video modes with random windows, blending and mosaic.
+ * Each frame, it writes to video memory and I/O registers at a random point of a random scanline
+ * and accesses VRAM and PRAM again in H-blank, measuring both with timer 0.
+ * The scanline and the threaded renderer must output the same frames as the accurate renderer
+ * and the CPU must observe the same access timing with all of them.
+ */
+
+using namespace nba;
+
+static constexpr int kFrames = 130;
+
+static const std::vector<u32> kProgram{
+  0xE3A00301, // 0x08000000: mov r0, #0x04000000
+  0xE3A06403, // 0x08000004: mov r6, #0x03000000
+  0xE3A07406, // 0x08000008: mov r7, #0x06000000
+  0xE3A0A405, // 0x0800000C: mov r10, #0x05000000
+  0xE3A0B407, // 0x08000010: mov r11, #0x07000000
+  0xE59F41D4, // 0x08000014: ldr r4, seed
+  0xE3A05000, // 0x08000018: mov r5, #0                (frame counter)
+  0xE1A0100A, // 0x0800001C: mov r1, r10
+  0xE3A02C01, // 0x08000020: mov r2, #0x100
+  0xE1A0E00F, // 0x08000024: mov lr, pc
+  0xEA000069, // 0x08000028: b fill                    (PRAM)
+  0xE1A01007, // 0x0800002C: mov r1, r7
+  0xE3A02A06, // 0x08000030: mov r2, #0x6000
+  0xE1A0E00F, // 0x08000034: mov lr, pc
+  0xEA000065, // 0x08000038: b fill                    (VRAM)
+  0xE1A0100B, // 0x0800003C: mov r1, r11
+  0xE3A02C01, // 0x08000040: mov r2, #0x100
+  0xE1A0E00F, // 0x08000044: mov lr, pc
+  0xEA000061, // 0x08000048: b fill                    (OAM)
+  0xE59F11A0, // 0x0800004C: ldr r1, bgcnt01
+  0xE5801008, // 0x08000050: str r1, [r0, #0x08]       (BG0CNT and BG1CNT)
+  0xE59F119C, // 0x08000054: ldr r1, bgcnt23
+  0xE580100C, // 0x08000058: str r1, [r0, #0x0C]       (BG2CNT and BG3CNT)
+  0xE3A01502, // 0x0800005C: mov r1, #0x00800000
+  0xE5801100, // 0x08000060: str r1, [r0, #0x100]      (TM0CNT: enable timer 0)
+  0xE280EC01, // 0x08000064: add lr, r0, #0x100
+  // frame:
+  0xE1D010B6, // 0x08000068: ldrh r1, [r0, #6]         (VCOUNT)
+  0xE35100A0, // 0x0800006C: cmp r1, #160
+  0x1AFFFFFC, // 0x08000070: bne frame
+  0xE2855001, // 0x08000074: add r5, r5, #1
+  0xE28F1F5F, // 0x08000078: adr r1, dispcnt
+  0xE1A02225, // 0x0800007C: mov r2, r5, lsr #4
+  0xE2022007, // 0x08000080: and r2, r2, #7
+  0xE1A02082, // 0x08000084: mov r2, r2, lsl #1
+  0xE19110B2, // 0x08000088: ldrh r1, [r1, r2]
+  0xE1C010B0, // 0x0800008C: strh r1, [r0]             (DISPCNT: next scene every 16 frames)
+  0xE1C051B0, // 0x08000090: strh r5, [r0, #0x10]      (BG0HOFS)
+  0xE1A01085, // 0x08000094: mov r1, r5, lsl #1
+  0xE1C011B6, // 0x08000098: strh r1, [r0, #0x16]      (BG1VOFS)
+  0xE1C051B8, // 0x0800009C: strh r5, [r0, #0x18]      (BG2HOFS)
+  0xE1C011BE, // 0x080000A0: strh r1, [r0, #0x1E]      (BG3VOFS)
+  0xE28510C0, // 0x080000A4: add r1, r5, #0xC0
+  0xE1C012B0, // 0x080000A8: strh r1, [r0, #0x20]      (BG2PA)
+  0xE1C052B2, // 0x080000AC: strh r5, [r0, #0x22]      (BG2PB)
+  0xE1C012B6, // 0x080000B0: strh r1, [r0, #0x26]      (BG2PD)
+  0xE1C013B0, // 0x080000B4: strh r1, [r0, #0x30]      (BG3PA)
+  0xE1C013B6, // 0x080000B8: strh r1, [r0, #0x36]      (BG3PD)
+  0xE1A01485, // 0x080000BC: mov r1, r5, lsl #9
+  0xE5801028, // 0x080000C0: str r1, [r0, #0x28]       (BG2X)
+  0xE580103C, // 0x080000C4: str r1, [r0, #0x3C]       (BG3Y)
+  0xE0244684, // 0x080000C8: eor r4, r4, r4, lsl #13
+  0xE02448A4, // 0x080000CC: eor r4, r4, r4, lsr #17
+  0xE0244284, // 0x080000D0: eor r4, r4, r4, lsl #5
+  0xE5804040, // 0x080000D4: str r4, [r0, #0x40]       (WIN0H and WIN1H)
+  0xE0244684, // 0x080000D8: eor r4, r4, r4, lsl #13
+  0xE02448A4, // 0x080000DC: eor r4, r4, r4, lsr #17
+  0xE0244284, // 0x080000E0: eor r4, r4, r4, lsl #5
+  0xE5804044, // 0x080000E4: str r4, [r0, #0x44]       (WIN0V and WIN1V)
+  0xE0244684, // 0x080000E8: eor r4, r4, r4, lsl #13
+  0xE02448A4, // 0x080000EC: eor r4, r4, r4, lsr #17
+  0xE0244284, // 0x080000F0: eor r4, r4, r4, lsl #5
+  0xE5804048, // 0x080000F4: str r4, [r0, #0x48]       (WININ and WINOUT)
+  0xE0244684, // 0x080000F8: eor r4, r4, r4, lsl #13
+  0xE02448A4, // 0x080000FC: eor r4, r4, r4, lsr #17
+  0xE0244284, // 0x08000100: eor r4, r4, r4, lsl #5
+  0xE580404C, // 0x08000104: str r4, [r0, #0x4C]       (MOSAIC)
+  0xE0244684, // 0x08000108: eor r4, r4, r4, lsl #13
+  0xE02448A4, // 0x0800010C: eor r4, r4, r4, lsr #17
+  0xE0244284, // 0x08000110: eor r4, r4, r4, lsl #5
+  0xE5804050, // 0x08000114: str r4, [r0, #0x50]       (BLDCNT and BLDALPHA)
+  0xE0244684, // 0x08000118: eor r4, r4, r4, lsl #13
+  0xE02448A4, // 0x0800011C: eor r4, r4, r4, lsr #17
+  0xE0244284, // 0x08000120: eor r4, r4, r4, lsl #5
+  0xE5804054, // 0x08000124: str r4, [r0, #0x54]       (BLDY)
+  0xE205807F, // 0x08000128: and r8, r5, #0x7F
+  0xE2888008, // 0x0800012C: add r8, r8, #8
+  // line:
+  0xE1D010B6, // 0x08000130: ldrh r1, [r0, #6]         (VCOUNT)
+  0xE1510008, // 0x08000134: cmp r1, r8
+  0x1AFFFFFC, // 0x08000138: bne line
+  0xE0244684, // 0x0800013C: eor r4, r4, r4, lsl #13
+  0xE02448A4, // 0x08000140: eor r4, r4, r4, lsr #17
+  0xE0244284, // 0x08000144: eor r4, r4, r4, lsl #5
+  0xE20410FF, // 0x08000148: and r1, r4, #0xFF
+  // delay:
+  0xE2511001, // 0x0800014C: subs r1, r1, #1
+  0x5AFFFFFD, // 0x08000150: bpl delay
+  0xE205C0FF, // 0x08000154: and r12, r5, #0xFF
+  0xE086C18C, // 0x08000158: add r12, r6, r12, lsl #3
+  0xE1A01824, // 0x0800015C: mov r1, r4, lsr #16
+  0xE3C11003, // 0x08000160: bic r1, r1, #3
+  0xE2042FFF, // 0x08000164: and r2, r4, #0x3FC
+  0xE1DE90B0, // 0x08000168: ldrh r9, [lr]             (TM0CNT_L)
+  0xE7874001, // 0x0800016C: str r4, [r7, r1]          (BG VRAM)
+  0xE7973001, // 0x08000170: ldr r3, [r7, r1]
+  0xE78A4002, // 0x08000174: str r4, [r10, r2]         (PRAM)
+  0xE19A30B2, // 0x08000178: ldrh r3, [r10, r2]
+  0xE18B40B2, // 0x0800017C: strh r4, [r11, r2]        (OAM)
+  0xE1C041B0, // 0x08000180: strh r4, [r0, #0x10]      (BG0HOFS)
+  0xE1C045B2, // 0x08000184: strh r4, [r0, #0x52]      (BLDALPHA)
+  0xE1DE30B0, // 0x08000188: ldrh r3, [lr]             (TM0CNT_L)
+  0xE0433009, // 0x0800018C: sub r3, r3, r9
+  0xE58C3000, // 0x08000190: str r3, [r12]
+  // hblank:
+  0xE1D010B4, // 0x08000194: ldrh r1, [r0, #4]         (DISPSTAT)
+  0xE3110002, // 0x08000198: tst r1, #2
+  0x0AFFFFFC, // 0x0800019C: beq hblank
+  0xE204100F, // 0x080001A0: and r1, r4, #0x0F
+  // hblank_delay:
+  0xE2511001, // 0x080001A4: subs r1, r1, #1
+  0x5AFFFFFD, // 0x080001A8: bpl hblank_delay
+  0xE1DE90B0, // 0x080001AC: ldrh r9, [lr]             (TM0CNT_L)
+  0xE5973000, // 0x080001B0: ldr r3, [r7]              (BG VRAM)
+  0xE5973800, // 0x080001B4: ldr r3, [r7, #0x800]
+  0xE5973FFC, // 0x080001B8: ldr r3, [r7, #0xFFC]
+  0xE7874002, // 0x080001BC: str r4, [r7, r2]
+  0xE19A30B2, // 0x080001C0: ldrh r3, [r10, r2]        (PRAM)
+  0xE1DE30B0, // 0x080001C4: ldrh r3, [lr]             (TM0CNT_L)
+  0xE0433009, // 0x080001C8: sub r3, r3, r9
+  0xE58C3004, // 0x080001CC: str r3, [r12, #4]
+  0xEAFFFFA4, // 0x080001D0: b frame
+  // fill:
+  0xE0244684, // 0x080001D4: eor r4, r4, r4, lsl #13
+  0xE02448A4, // 0x080001D8: eor r4, r4, r4, lsr #17
+  0xE0244284, // 0x080001DC: eor r4, r4, r4, lsl #5
+  0xE4814004, // 0x080001E0: str r4, [r1], #4
+  0xE2522001, // 0x080001E4: subs r2, r2, #1
+  0x1AFFFFF9, // 0x080001E8: bne fill
+  0xE12FFF1E, // 0x080001EC: bx lr
+  // seed:
+  0x2545F491, // 0x080001F0: .word 0x2545F491
+  // bgcnt01:
+  0x51801000, // 0x080001F4: .word 0x51801000
+  // bgcnt23:
+  0x33831242, // 0x080001F8: .word 0x33831242
+  // dispcnt:
+  0x1F40FF40, // 0x080001FC: .hword 0xFF40, 0x1F40
+  0x7F42FF41, // 0x08000200: .hword 0xFF41, 0x7F42
+  0x1454F443, // 0x08000204: .hword 0xF443, 0x1454
+  0x1F209445  // 0x08000208: .hword 0x9445, 0x1F20
+};
+
+struct FrameHashes : VideoDevice {
+  void Draw(u32* buffer) override {
+    u64 hash = 0xCBF29CE484222325ULL;
+
+    for(int i = 0; i < 240 * 160; i++) {
+      hash = (hash ^ buffer[i]) * 0x100000001B3ULL;
+    }
+
+    hashes.push_back(hash);
+  }
+
+  std::vector<u64> hashes;
+};
+
+struct Result {
+  std::vector<u64> frames;
+
+  // The timer ticks measured by the program, for the mid-scanline and the H-blank accesses of each frame.
+  std::vector<u32> timings;
+};
+
+static auto Run(Config::PPU::Renderer renderer) -> Result {
+  auto config = std::make_shared<Config>();
+  auto frame_hashes = std::make_shared<FrameHashes>();
+
+  config->ppu.renderer = renderer;
+  config->video_dev = frame_hashes;
+
+  auto core = test::CreateCore(kProgram, config);
+
+  for(int frame = 0; frame < kFrames; frame++) {
+    core->RunForOneFrame();
+  }
+
+  auto state = std::make_unique<SaveState>();
+  core->CopyState(*state);
+
+  Result result;
+  result.frames = frame_hashes->hashes;
+
+  // The frame counter starts at one, once the first V-Blank is reached.
+  for(int frame = 1; frame < kFrames; frame++) {
+    result.timings.push_back(test::ReadIWRAM(*state, frame * 8));
+    result.timings.push_back(test::ReadIWRAM(*state, frame * 8 + 4));
+  }
+
+  return result;
+}
+
+static bool Compare(Result const& result, Result const& expected, const char* name) {
+  bool success = true;
+
+  if(result.frames.size() != expected.frames.size()) {
+    fmt::print(stderr, "{}: drew {} frames, expected {}\n", name, result.frames.size(), expected.frames.size());
+    return false;
+  }
+
+  for(size_t i = 0; i < result.frames.size(); i++) {
+    if(result.frames[i] != expected.frames[i]) {
+      fmt::print(stderr, "{}: frame {} differs from the accurate renderer\n", name, i);
+      success = false;
+      break;
+    }
+  }
+
+  for(size_t i = 0; i < result.timings.size(); i++) {
+    if(result.timings[i] != expected.timings[i]) {
+      fmt::print(stderr, "{}: the {} accesses in frame {} took {} cycles, expected {}\n",
+        name, (i & 1) ? "H-blank" : "mid-scanline", i / 2 + 1, result.timings[i], expected.timings[i]);
+      success = false;
+      break;
+    }
+  }
+
+  if(success) {
+    fmt::print("{}: same frames and access timing as the accurate renderer\n", name);
+  }
+
+  return success;
+}
+
+int main() {
+  const auto accurate = Run(Config::PPU::Renderer::Accurate);
+
+  bool success = true;
+
+  success &= Compare(Run(Config::PPU::Renderer::Scanline), accurate, "scanline");
+  success &= Compare(Run(Config::PPU::Renderer::Threaded), accurate, "threaded");
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <test/core.hpp>
+#include <vector>
+
+/**
+ * Runs a program which writes to one page of PRAM, OAM and BG VRAM each with the CPU
+ * and copies a few halfwords to OBJ VRAM with DMA3. Checks that exactly those pages
+ * are reported by GetDirtyVideoPages() and that the pages are cleared once reported.
+ */
+
+using namespace nba;
+
+static const std::vector<u32> kProgram{
+  0xE3A00405, // 0x08000000: mov r0, #0x05000000
+  0xE3A0101F, // 0x08000004: mov r1, #0x1F
+  0xE2802C02, // 0x08000008: add r2, r0, #0x200
+  0xE1C210B0, // 0x0800000C: strh r1, [r2]        (PRAM page 2)
+  0xE3A00406, // 0x08000010: mov r0, #0x06000000
+  0xE2802C12, // 0x08000014: add r2, r0, #0x1200
+  0xE5821034, // 0x08000018: str r1, [r2, #0x34]  (VRAM page 0x12)
+  0xE3A00407, // 0x0800001C: mov r0, #0x07000000
+  0xE2802C03, // 0x08000020: add r2, r0, #0x300
+  0xE1C210B0, // 0x08000024: strh r1, [r2]        (OAM page 3)
+  0xE3A00301, // 0x08000028: mov r0, #0x04000000
+  0xE28000D4, // 0x0800002C: add r0, r0, #0xD4
+  0xE3A01302, // 0x08000030: mov r1, #0x08000000
+  0xE5801000, // 0x08000034: str r1, [r0]         (DMA3SAD)
+  0xE3A01406, // 0x08000038: mov r1, #0x06000000
+  0xE2811801, // 0x0800003C: add r1, r1, #0x10000
+  0xE5801004, // 0x08000040: str r1, [r0, #4]     (DMA3DAD: VRAM page 0x100)
+  0xE3A01102, // 0x08000044: mov r1, #0x80000000
+  0xE3811008, // 0x08000048: orr r1, r1, #8
+  0xE5801008, // 0x0800004C: str r1, [r0, #8]     (DMA3CNT: 8 halfwords, start now)
+  0xEAFFFFFE  // 0x08000050: b 0x08000050
+};
+
+static auto CountPages(VideoPages const& pages) -> int {
+  int count = 0;
+
+  for(int page = 0; page < VideoPages::kPRAMPageCount; page++) count += VideoPages::Test(pages.pram, page);
+  for(int page = 0; page < VideoPages::kOAMPageCount;  page++) count += VideoPages::Test(pages.oam,  page);
+  for(int page = 0; page < VideoPages::kVRAMPageCount; page++) count += VideoPages::Test(pages.vram, page);
+
+  return count;
+}
+
+static bool Test(std::shared_ptr<Config> config, std::string const& name) {
+  auto core = test::CreateCore(kProgram, config);
+
+  const int page_count = VideoPages::kPRAMPageCount + VideoPages::kOAMPageCount + VideoPages::kVRAMPageCount;
+
+  if(CountPages(core->GetDirtyVideoPages()) != page_count) {
+    fmt::print(stderr, "{}: not all pages are dirty after a reset\n", name);
+    return false;
+  }
+
+  core->RunForOneFrame();
+
+  const VideoPages pages = core->GetDirtyVideoPages();
+
+  const bool expected_pages_dirty =
+    VideoPages::Test(pages.pram, 0x002) &&
+    VideoPages::Test(pages.oam,  0x003) &&
+    VideoPages::Test(pages.vram, 0x012) &&
+    VideoPages::Test(pages.vram, 0x100);
+
+  if(!expected_pages_dirty || CountPages(pages) != 4) {
+    fmt::print(stderr, "{}: {} dirty pages, expected PRAM page 2, OAM page 3 and VRAM pages 0x12 and 0x100\n", name, CountPages(pages));
+    return false;
+  }
+
+  core->RunForOneFrame();
+
+  if(CountPages(core->GetDirtyVideoPages()) != 0) {
+    fmt::print(stderr, "{}: pages are still dirty after they were reported\n", name);
+    return false;
+  }
+
+  fmt::print("{}: dirty pages reported and cleared\n", name);
+  return true;
+}
+
+int main() {
+  return test::RunWithEachBackend(Test) ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <test/core.hpp>
+#include <vector>
+
+/**
+ * Watches four ranges of work RAM, which are written by byte, halfword and word stores,
+ * a store to a mirror of EWRAM, a DMA and an emulated CpuSet call, and checks the
+ * address, size, value and timestamp of each hit. Writes next to a watched range,
+ * in the same or in the following memory page, must not be reported. Watchpoints must be
+ * kept when the core is reset and must not be hit anymore once they have been removed.
+ */
+
+using namespace nba;
+
+static const std::vector<u32> kProgram{
+  0xE3A00403, // 0x08000000: mov r0, #0x03000000
+  0xE2800C01, // 0x08000004: add r0, r0, #0x100
+  0xE59F10F0, // 0x08000008: ldr r1, [pc, #0xF0]  (0x11223344)
+  0xE5C01000, // 0x0800000C: strb r1, [r0]
+  0xE1C010B2, // 0x08000010: strh r1, [r0, #2]
+  0xE5801004, // 0x08000014: str r1, [r0, #4]
+  0xE5801010, // 0x08000018: str r1, [r0, #0x10]  (same page, not watched)
+  0xE5801100, // 0x0800001C: str r1, [r0, #0x100] (next page, not watched)
+  0xE3A02402, // 0x08000020: mov r2, #0x02000000
+  0xE2822701, // 0x08000024: add r2, r2, #0x40000
+  0xE5821404, // 0x08000028: str r1, [r2, #0x404] (EWRAM mirror)
+  0xE3A03301, // 0x0800002C: mov r3, #0x04000000
+  0xE28330D4, // 0x08000030: add r3, r3, #0xD4
+  0xE3A04302, // 0x08000034: mov r4, #0x08000000
+  0xE2844F41, // 0x08000038: add r4, r4, #0x104
+  0xE5834000, // 0x0800003C: str r4, [r3]         (DMA3SAD)
+  0xE3A05402, // 0x08000040: mov r5, #0x02000000
+  0xE2855B02, // 0x08000044: add r5, r5, #0x800
+  0xE5835004, // 0x08000048: str r5, [r3, #4]     (DMA3DAD)
+  0xE3A05321, // 0x0800004C: mov r5, #0x84000000
+  0xE2855002, // 0x08000050: add r5, r5, #2
+  0xE5835008, // 0x08000054: str r5, [r3, #8]     (DMA3CNT: two words, start now)
+  0xE1A00004, // 0x08000058: mov r0, r4
+  0xE3A01403, // 0x0800005C: mov r1, #0x03000000
+  0xE2811C06, // 0x08000060: add r1, r1, #0x600
+  0xE3A02301, // 0x08000064: mov r2, #0x04000000
+  0xE2822002, // 0x08000068: add r2, r2, #2
+  0xEF0B0000, // 0x0800006C: swi #0x0B0000        (CpuSet: two words)
+  0xEAFFFFFE  // 0x08000070: b 0x08000070
+};
+
+static const u32 kData[] {0x11223344, 0xCAFEBABE, 0x12345678};
+
+struct Hit {
+  u32 address;
+  int size;
+  u32 value;
+  u64 timestamp;
+};
+
+// The timestamps are in cycles since the last reset.
+static const std::vector<Hit> kExpectedHits{
+  { 0x03000100, 1, 0x00000044,  50 },
+  { 0x03000102, 2, 0x00003344,  59 },
+  { 0x03000104, 4, 0x11223344,  68 },
+  { 0x02040404, 4, 0x11223344, 112 },
+  { 0x02000800, 4, 0xCAFEBABE, 210 },
+  { 0x02000804, 4, 0x12345678, 222 },
+  { 0x03000600, 4, 0xCAFEBABE, 264 },
+  { 0x03000604, 4, 0x12345678, 279 }
+};
+
+static bool Test(std::shared_ptr<Config> config, std::string const& name) {
+  std::vector<u32> program = kProgram;
+
+  program.resize(0x100 / sizeof(u32));
+  program.insert(program.end(), std::begin(kData), std::end(kData));
+
+  auto core = test::CreateCore(program, config);
+
+  std::vector<Hit> hits;
+
+  const auto callback = [&](u32 address, int size, u32 value, u64 timestamp) {
+    hits.push_back({address, size, value, timestamp});
+  };
+
+  if(core->AddWatchpoint(0x06000000, 4, callback) != -1) {
+    fmt::print(stderr, "{}: a watchpoint in VRAM was accepted\n", name);
+    return false;
+  }
+
+  const int cpu_watchpoint = core->AddWatchpoint(0x03000100, 16, callback);
+
+  core->AddWatchpoint(0x02000400, 8, callback);
+  core->AddWatchpoint(0x02000800, 8, callback);
+  core->AddWatchpoint(0x03000600, 8, callback);
+
+  const struct {
+    bool remove_cpu_watchpoint;
+    size_t first_hit;
+  } runs[] {
+    { false, 0 },
+    { false, 0 }, // after a reset
+    { true,  3 }  // after a reset, without the watchpoint on the CPU stores
+  };
+
+  for(int i = 0; i < 3; i++) {
+    if(i != 0) {
+      core->Reset();
+    }
+
+    if(runs[i].remove_cpu_watchpoint) {
+      core->RemoveWatchpoint(cpu_watchpoint);
+    }
+
+    hits.clear();
+    core->RunForOneFrame();
+
+    const std::vector<Hit> expected_hits{kExpectedHits.begin() + runs[i].first_hit, kExpectedHits.end()};
+
+    if(hits.size() != expected_hits.size()) {
+      fmt::print(stderr, "{}: run {}: {} watchpoint hits, expected {}\n", name, i, hits.size(), expected_hits.size());
+      return false;
+    }
+
+    for(size_t j = 0; j < hits.size(); j++) {
+      auto& hit = hits[j];
+      auto& expected = expected_hits[j];
+
+      if(hit.address != expected.address || hit.size != expected.size || hit.value != expected.value || hit.timestamp != expected.timestamp) {
+        fmt::print(stderr, "{}: run {}: hit {} is a {}-byte write of 0x{:08X} to 0x{:08X} at {}, expected a {}-byte write of 0x{:08X} to 0x{:08X} at {}\n",
+          name, i, j, hit.size, hit.value, hit.address, hit.timestamp, expected.size, expected.value, expected.address, expected.timestamp);
+        return false;
+      }
+    }
+  }
+
+  fmt::print("{}: watchpoints hit as expected\n", name);
+  return true;
+}
+
+int main() {
+  return test::RunWithEachBackend(Test) ? 0 : 1;
+}
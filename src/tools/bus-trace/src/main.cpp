@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fmt/format.h>
+#include <map>
+#include <nba/bus_trace.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Summarizes a bus trace recorded by a core built with NBA_BUS_TRACE:
+ * the cycles spent per memory region, per wait state class and per MMIO register.
+ */
+
+using namespace nba;
+
+static constexpr int kCyclesPerFrame = 280896;
+
+enum Region {
+  BIOS,
+  EWRAM,
+  IWRAM,
+  MMIO,
+  PRAM,
+  VRAM,
+  OAM,
+  ROM_WS0,
+  ROM_WS1,
+  ROM_WS2,
+  SRAM,
+  Unmapped,
+  RegionCount
+};
+
+static const char* const kRegionNames[RegionCount] {
+  "BIOS",
+  "EWRAM",
+  "IWRAM",
+  "MMIO",
+  "PRAM",
+  "VRAM",
+  "OAM",
+  "ROM (WS0)",
+  "ROM (WS1)",
+  "ROM (WS2)",
+  "SRAM",
+  "Unmapped"
+};
+
+enum Requester {
+  CPU_Code,
+  CPU_Data,
+  DMA,
+  RequesterCount
+};
+
+static const char* const kRequesterNames[RequesterCount] {
+  "CPU code",
+  "CPU data",
+  "DMA"
+};
+
+struct Counter {
+  u64 accesses = 0;
+  u64 cycles = 0;
+
+  void Add(BusTraceRecord const& record) {
+    accesses++;
+    cycles += record.cycles;
+  }
+};
+
+static auto GetRegion(u32 address) -> Region {
+  switch(address >> 24) {
+    case 0x00: return BIOS;
+    case 0x02: return EWRAM;
+    case 0x03: return IWRAM;
+    case 0x04: return MMIO;
+    case 0x05: return PRAM;
+    case 0x06: return VRAM;
+    case 0x07: return OAM;
+    case 0x08 ... 0x09: return ROM_WS0;
+    case 0x0A ... 0x0B: return ROM_WS1;
+    case 0x0C ... 0x0D: return ROM_WS2;
+    case 0x0E ... 0x0F: return SRAM;
+  }
+
+  return Unmapped;
+}
+
+static auto GetRequester(BusTraceRecord const& record) -> Requester {
+  if(record.access & BusTraceRecord::Dma) return DMA;
+  if(record.access & BusTraceRecord::Code) return CPU_Code;
+  return CPU_Data;
+}
+
+static auto GetSizeIndex(BusTraceRecord const& record) -> int {
+  switch(record.size) {
+    case 1:  return 0;
+    case 2:  return 1;
+    default: return 2;
+  }
+}
+
+static auto Percent(u64 value, u64 total) -> double {
+  return total == 0 ? 0.0 : value * 100.0 / total;
+}
+
+int main(int argc, char** argv) {
+  if(argc != 2) {
+    fmt::print(stderr, "usage: {} <trace file>\n", argv[0]);
+    return 1;
+  }
+
+  std::FILE* file = std::fopen(argv[1], "rb");
+
+  if(file == nullptr) {
+    fmt::print(stderr, "error: failed to open '{}'\n", argv[1]);
+    return 1;
+  }
+
+  BusTraceHeader header;
+
+  if(std::fread(&header, sizeof(header), 1, file) != 1 ||
+     header.magic != BusTraceHeader::kMagic ||
+     header.version != BusTraceHeader::kVersion ||
+     header.record_size != sizeof(BusTraceRecord)) {
+    fmt::print(stderr, "error: '{}' is not a supported bus trace\n", argv[1]);
+    std::fclose(file);
+    return 1;
+  }
+
+  Counter total;
+  std::array<std::array<Counter, RequesterCount>, RegionCount> regions{};
+
+  // Wait state classes: region, sequential or non-sequential, 8-, 16- or 32-bit
+  std::array<std::array<std::array<Counter, 3>, 2>, RegionCount> classes{};
+
+  // MMIO accesses by register name and direction (read or write)
+  std::map<std::string, std::array<Counter, 2>> registers;
+
+  u64 timestamp_first = ~0ULL;
+  u64 timestamp_last = 0;
+
+  std::vector<BusTraceRecord> records(65536);
+
+  while(true) {
+    const size_t count = std::fread(records.data(), sizeof(BusTraceRecord), records.size(), file);
+
+    if(count == 0) {
+      break;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+      auto const& record = records[i];
+      const Region region = GetRegion(record.address);
+      const int sequential = record.access & BusTraceRecord::Sequential;
+
+      total.Add(record);
+      regions[region][GetRequester(record)].Add(record);
+      classes[region][sequential][GetSizeIndex(record)].Add(record);
+
+      if(region == MMIO) {
+        const char* name = GetIORegisterName(record.address);
+
+        registers[name ? name : "(unmapped)"][record.write ? 1 : 0].Add(record);
+      }
+
+      timestamp_first = std::min(timestamp_first, record.timestamp);
+      timestamp_last  = std::max(timestamp_last, record.timestamp + record.cycles);
+    }
+  }
+
+  std::fclose(file);
+
+  if(total.accesses == 0) {
+    fmt::print("The trace is empty.\n");
+    return 0;
+  }
+
+  const u64 elapsed = timestamp_last - timestamp_first;
+
+  fmt::print("{} accesses, {} of {} cycles spent on the bus ({:.1f}%), {:.1f} frames\n\n",
+    total.accesses, total.cycles, elapsed, Percent(total.cycles, elapsed), (double)elapsed / kCyclesPerFrame);
+
+  fmt::print("{:<10} {:>12} {:>12} {:>7} {:>12} {:>8} {:>8} {:>8}\n",
+    "Region", "Accesses", "Cycles", "Bus %", "Cycles/frame", kRequesterNames[0], kRequesterNames[1], kRequesterNames[2]);
+
+  for(int region = 0; region < RegionCount; region++) {
+    Counter sum;
+
+    for(auto const& counter : regions[region]) {
+      sum.accesses += counter.accesses;
+      sum.cycles += counter.cycles;
+    }
+
+    if(sum.accesses == 0) {
+      continue;
+    }
+
+    fmt::print("{:<10} {:>12} {:>12} {:>6.1f}% {:>12.0f} {:>7.1f}% {:>7.1f}% {:>7.1f}%\n",
+      kRegionNames[region], sum.accesses, sum.cycles, Percent(sum.cycles, total.cycles),
+      sum.cycles * (double)kCyclesPerFrame / elapsed,
+      Percent(regions[region][CPU_Code].cycles, sum.cycles),
+      Percent(regions[region][CPU_Data].cycles, sum.cycles),
+      Percent(regions[region][DMA].cycles, sum.cycles));
+  }
+
+  fmt::print("\n{:<10} {:>4} {:>6} {:>12} {:>12} {:>7} {:>14}\n",
+    "Region", "Type", "Width", "Accesses", "Cycles", "Bus %", "Cycles/access");
+
+  for(int region = 0; region < RegionCount; region++) {
+    for(int sequential = 0; sequential < 2; sequential++) {
+      for(int size = 0; size < 3; size++) {
+        auto const& counter = classes[region][sequential][size];
+
+        if(counter.accesses == 0) {
+          continue;
+        }
+
+        fmt::print("{:<10} {:>4} {:>6} {:>12} {:>12} {:>6.1f}% {:>14.2f}\n",
+          kRegionNames[region], sequential ? "S" : "N", 8 << size, counter.accesses, counter.cycles,
+          Percent(counter.cycles, total.cycles), (double)counter.cycles / counter.accesses);
+      }
+    }
+  }
+
+  if(!registers.empty()) {
+    std::vector<std::pair<std::string, std::array<Counter, 2>>> by_cycles{registers.begin(), registers.end()};
+
+    std::sort(by_cycles.begin(), by_cycles.end(), [](auto const& a, auto const& b) {
+      return a.second[0].cycles + a.second[1].cycles > b.second[0].cycles + b.second[1].cycles;
+    });
+
+    fmt::print("\n{:<16} {:>12} {:>12} {:>12} {:>7}\n",
+      "MMIO register", "Reads", "Writes", "Cycles", "Bus %");
+
+    for(auto const& [name, counters] : by_cycles) {
+      const u64 cycles = counters[0].cycles + counters[1].cycles;
+
+      fmt::print("{:<16} {:>12} {:>12} {:>12} {:>6.1f}%\n",
+        name, counters[0].accesses, counters[1].accesses, cycles, Percent(cycles, total.cycles));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fmt/format.h>
+#include <functional>
+#include <map>
+#include <nba/cpu_trace.hpp>
+#include <vector>
+
+/**
+ * Decodes a CPU trace recorded by a core built with NBA_ARM_TRACE,
+ * either into one line of text per instruction or into a flat profile
+ * of the cycles spent per function.
+ */
+
+using namespace nba;
+
+static bool ForEachRecord(char const* path, std::function<void(CPUTraceRecord const&)> callback) {
+  std::FILE* file = std::fopen(path, "rb");
+
+  if(file == nullptr) {
+    fmt::print(stderr, "error: failed to open '{}'\n", path);
+    return false;
+  }
+
+  CPUTraceHeader header;
+
+  if(std::fread(&header, sizeof(header), 1, file) != 1 ||
+     header.magic != CPUTraceHeader::kMagic ||
+     header.version != CPUTraceHeader::kVersion) {
+    fmt::print(stderr, "error: '{}' is not a supported CPU trace\n", path);
+    std::fclose(file);
+    return false;
+  }
+
+  CPUTraceCodec codec;
+  CPUTraceRecord record;
+  std::vector<u8> buffer(0x100000);
+  size_t size = 0;
+
+  while(true) {
+    size += std::fread(&buffer[size], 1, buffer.size() - size, file);
+
+    if(size == 0) {
+      break;
+    }
+
+    size_t offset = 0;
+
+    while(int length = codec.Decode(&buffer[offset], size - offset, record)) {
+      callback(record);
+      offset += length;
+    }
+
+    if(offset == 0) {
+      fmt::print(stderr, "warning: the trace ends with an incomplete record\n");
+      break;
+    }
+
+    // Move the incomplete record (if any) to the start of the buffer.
+    std::memmove(&buffer[0], &buffer[offset], size - offset);
+    size -= offset;
+  }
+
+  std::fclose(file);
+  return true;
+}
+
+static bool IsThumbBL(u32 opcode) {
+  return (opcode & 0xF800) == 0xF800;
+}
+
+static bool IsCall(CPUTraceRecord const& record, bool lr_was_set) {
+  const u32 opcode = record.opcode;
+
+  if(record.IsThumb()) {
+    // BL (second half), BX Rm after MOV LR, PC
+    return IsThumbBL(opcode) || (lr_was_set && (opcode & 0xFF87) == 0x4700);
+  }
+
+  // BL, BX Rm after MOV LR, PC
+  return (opcode & 0x0F000000) == 0x0B000000 || (lr_was_set && (opcode & 0x0FFFFFF0) == 0x012FFF10);
+}
+
+static bool IsMoveLRPC(CPUTraceRecord const& record) {
+  return record.IsThumb() ? record.opcode == 0x46FE : record.opcode == 0xE1A0E00F;
+}
+
+static int PrintText(char const* path) {
+  u64 timestamp = 0;
+
+  const bool success = ForEachRecord(path, [&](CPUTraceRecord const& record) {
+    if(record.IsThumb()) {
+      fmt::print("{:>12} {:08X}: {:04X}     THUMB CPSR={:08X} {:>3}\n", timestamp, record.pc, record.opcode, record.cpsr, record.cycles);
+    } else {
+      fmt::print("{:>12} {:08X}: {:08X} ARM   CPSR={:08X} {:>3}\n", timestamp, record.pc, record.opcode, record.cpsr, record.cycles);
+    }
+
+    timestamp += record.cycles;
+  });
+
+  return success ? 0 : 1;
+}
+
+static int PrintFunctions(char const* path) {
+  struct Function {
+    u32 address;
+    u64 calls = 0;
+    u64 instructions = 0;
+    u64 cycles = 0;
+  };
+
+  std::map<u32, Function> functions;
+
+  // Pass 1: function entry points are the targets of calls and the IRQ vector.
+  {
+    bool first = true;
+    bool call = false;
+    bool lr_was_set = false;
+    u32 pc_next = 0;
+
+    functions[0x18] = {0x18};
+
+    const bool success = ForEachRecord(path, [&](CPUTraceRecord const& record) {
+      if(first || (call && record.pc != pc_next)) {
+        auto& function = functions[record.pc];
+        function.address = record.pc;
+        function.calls++;
+        first = false;
+      }
+
+      // The first half of a Thumb BL does not change the PC.
+      call = IsCall(record, lr_was_set);
+      lr_was_set = IsMoveLRPC(record);
+      pc_next = record.pc + (record.IsThumb() ? 2 : 4);
+    });
+
+    if(!success) {
+      return 1;
+    }
+  }
+
+  // Pass 2: attribute each instruction to the closest function entry point below it.
+  u64 total_cycles = 0;
+  Function unknown{0};
+
+  ForEachRecord(path, [&](CPUTraceRecord const& record) {
+    auto match = functions.upper_bound(record.pc);
+    auto& function = match == functions.begin() ? unknown : std::prev(match)->second;
+
+    function.instructions++;
+    function.cycles += record.cycles;
+    total_cycles += record.cycles;
+  });
+
+  std::vector<Function> sorted;
+
+  for(auto const& [address, function] : functions) {
+    if(function.instructions != 0) sorted.push_back(function);
+  }
+
+  if(unknown.instructions != 0) {
+    sorted.push_back(unknown);
+  }
+
+  std::sort(sorted.begin(), sorted.end(), [](Function const& a, Function const& b) {
+    return a.cycles > b.cycles;
+  });
+
+  fmt::print("{:<10} {:>10} {:>14} {:>14} {:>7}\n", "Function", "Calls", "Instructions", "Cycles", "Cycles %");
+
+  for(auto const& function : sorted) {
+    fmt::print("{:08X}   {:>10} {:>14} {:>14} {:>7.2f}%\n",
+      function.address, function.calls, function.instructions, function.cycles,
+      total_cycles == 0 ? 0.0 : function.cycles * 100.0 / total_cycles);
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if(argc == 3 && std::strcmp(argv[1], "text") == 0) {
+    return PrintText(argv[2]);
+  }
+
+  if(argc == 3 && std::strcmp(argv[1], "functions") == 0) {
+    return PrintFunctions(argv[2]);
+  }
+
+  fmt::print(stderr, "usage: {} text|functions <trace file>\n", argv[0]);
+  return 1;
+}
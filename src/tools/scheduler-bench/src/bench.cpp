@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <nba/scheduler.hpp>
+#include <nba/scheduler_trace.hpp>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "legacy_scheduler.hpp"
+#include "wheel_scheduler.hpp"
+
+/**
+ * Replays a scheduler trace recorded by nba-scheduler-record, both on the
+ * scheduler of the core, on the binary heap it replaced and on the core
+ * scheduler with a timing wheel in front of its heap, and reports
+ * the host time and the number of events fired per second for each.
+ */
+
+using namespace nba;
+using nba::core::Scheduler;
+
+struct Program {
+  struct Op {
+    SchedulerTraceRecord::Op op;
+    Scheduler::EventClass event_class;
+    u8 priority;
+    u32 id; // dense event ID, or the number of calls for AddCycles
+    u64 value;
+  };
+
+  // Operations done outside of any event callback.
+  std::vector<Op> main;
+
+  // Operations done by the callback of each event, indexed by event ID.
+  std::vector<std::vector<Op>> callbacks;
+
+  u64 fire_count = 0;
+  u64 add_cycles_count = 0;
+};
+
+static bool Load(char const* path, Program& program) {
+  std::FILE* file = std::fopen(path, "rb");
+
+  if(file == nullptr) {
+    fmt::print(stderr, "error: failed to open '{}'\n", path);
+    return false;
+  }
+
+  SchedulerTraceHeader header;
+
+  if(std::fread(&header, sizeof(header), 1, file) != 1 ||
+     header.magic != SchedulerTraceHeader::kMagic ||
+     header.version != SchedulerTraceHeader::kVersion ||
+     header.record_size != sizeof(SchedulerTraceRecord)) {
+    fmt::print(stderr, "error: '{}' is not a supported scheduler trace\n", path);
+    std::fclose(file);
+    return false;
+  }
+
+  std::unordered_map<u64, u32> ids;
+
+  // The events whose callbacks are currently running. -1 stands for the main list.
+  std::vector<int> stack{-1};
+
+  const auto ops = [&]() -> std::vector<Program::Op>& {
+    return stack.back() == -1 ? program.main : program.callbacks[stack.back()];
+  };
+
+  SchedulerTraceRecord record;
+
+  while(std::fread(&record, sizeof(record), 1, file) == 1) {
+    using Op = SchedulerTraceRecord::Op;
+
+    switch(record.op) {
+      case Op::AddCycles: {
+        ops().push_back({record.op, {}, 0, record.count, record.value});
+        program.add_cycles_count += record.count;
+        break;
+      }
+      case Op::Add: {
+        const u32 id = (u32)program.callbacks.size();
+
+        ids[record.uid] = id;
+        program.callbacks.emplace_back();
+        ops().push_back({record.op, (Scheduler::EventClass)record.event_class, record.priority, id, record.value});
+        break;
+      }
+      case Op::Cancel: {
+        auto match = ids.find(record.uid);
+
+        if(match != ids.end()) {
+          ops().push_back({record.op, {}, 0, match->second, 0});
+        }
+        break;
+      }
+      case Op::Fire: {
+        auto match = ids.find(record.uid);
+
+        if(match == ids.end()) {
+          fmt::print(stderr, "error: event {} fired before it was added\n", record.uid);
+          std::fclose(file);
+          return false;
+        }
+        stack.push_back((int)match->second);
+        program.fire_count++;
+        break;
+      }
+      case Op::Return: {
+        if(stack.size() > 1) {
+          stack.pop_back();
+        }
+        break;
+      }
+    }
+  }
+
+  std::fclose(file);
+  return true;
+}
+
+template<typename SchedulerT>
+struct Replay {
+  using Event = typename SchedulerT::Event;
+
+  Replay(Program const& program) : program(program) {
+    for(int i = 0; i < (int)Scheduler::EventClass::EndOfQueue; i++) {
+      if constexpr(std::is_same_v<SchedulerT, LegacyScheduler>) {
+        scheduler.Register((Scheduler::EventClass)i, this, &Replay::OnEvent);
+      } else {
+        scheduler.template Register<&Replay::OnEvent>((Scheduler::EventClass)i, this);
+      }
+    }
+  }
+
+  auto Run() -> double {
+    scheduler.Reset();
+    events.assign(program.callbacks.size(), nullptr);
+    fire_count = 0;
+
+    const auto time_start = std::chrono::steady_clock::now();
+
+    Execute(program.main);
+
+    const auto time_end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(time_end - time_start).count();
+  }
+
+  // Number of events fired by the last run.
+  u64 fire_count = 0;
+
+private:
+  void Execute(std::vector<Program::Op> const& ops) {
+    for(auto const& op : ops) {
+      switch(op.op) {
+        case SchedulerTraceRecord::Op::AddCycles: {
+          const int cycles = (int)(op.value / op.id);
+
+          for(u32 i = 1; i < op.id; i++) {
+            scheduler.AddCycles(cycles);
+          }
+          scheduler.AddCycles((int)(op.value - (u64)cycles * (op.id - 1)));
+          break;
+        }
+        case SchedulerTraceRecord::Op::Add: {
+          events[op.id] = scheduler.Add(op.value, op.event_class, op.priority, op.id);
+          break;
+        }
+        case SchedulerTraceRecord::Op::Cancel: {
+          // Events with equal timestamps may fire in a different order than recorded.
+          if(events[op.id] != nullptr) {
+            scheduler.Cancel(events[op.id]);
+            events[op.id] = nullptr;
+          }
+          break;
+        }
+        default: {
+          break;
+        }
+      }
+    }
+  }
+
+  void OnEvent(u64 id) {
+    fire_count++;
+    events[id] = nullptr;
+    Execute(program.callbacks[id]);
+  }
+
+  Program const& program;
+  SchedulerT scheduler;
+  std::vector<Event*> events;
+};
+
+template<typename SchedulerT>
+static void Benchmark(char const* name, Program const& program, int iterations) {
+  Replay<SchedulerT> replay{program};
+  double best = 1e9;
+
+  for(int i = 0; i < iterations; i++) {
+    best = std::min(best, replay.Run());
+  }
+
+  fmt::print("{:<28} {:>10.3f} {:>14.2f} {:>16.2f}\n", name, best * 1e3,
+    program.fire_count / best / 1e6, best * 1e9 / program.add_cycles_count);
+
+  if(replay.fire_count != program.fire_count) {
+    fmt::print("warning: {} events fired during the replay\n", replay.fire_count);
+  }
+}
+
+int main(int argc, char** argv) {
+  if(argc != 2 && argc != 3) {
+    fmt::print(stderr, "usage: {} <trace file> [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  const int iterations = argc == 3 ? std::atoi(argv[2]) : 10;
+
+  Program program;
+
+  if(!Load(argv[1], program)) {
+    return 1;
+  }
+
+  fmt::print("{} events fired, {} calls to AddCycles(), best of {} runs\n\n",
+    program.fire_count, program.add_cycles_count, iterations);
+
+  fmt::print("{:<28} {:>10} {:>14} {:>16}\n", "Scheduler", "ms", "Mevents/s", "ns/AddCycles()");
+
+  Benchmark<LegacyScheduler>("binary heap (baseline)", program, iterations);
+  Benchmark<Scheduler>("4-ary heap", program, iterations);
+  Benchmark<WheelScheduler>("4-ary heap + timing wheel", program, iterations);
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <nba/log.hpp>
+#include <nba/integer.hpp>
+#include <nba/scheduler.hpp>
+
+/**
+ * The binary heap scheduler which the core used before the event queue
+ * became a 4-ary heap, kept as the baseline of the benchmark.
+ * Save state support has been left out.
+ */
+struct LegacyScheduler {
+  template<class T>
+  using EventMethodWithUserData = void (T::*)(u64);
+
+  using EventClass = nba::core::Scheduler::EventClass;
+
+  struct Event {
+    u64 timestamp;
+
+  private:
+    friend struct LegacyScheduler;
+    int handle;
+    u64 key;
+    u64 uid;
+    u64 user_data;
+    EventClass event_class;
+  };
+
+  LegacyScheduler() {
+    for(int i = 0; i < kMaxEvents; i++) {
+      heap[i] = new Event();
+      heap[i]->handle = i;
+    }
+
+    for(int i = 0; i < (int)EventClass::Count; i++) {
+      callbacks[i] = [i](u64) {
+        nba::Assert(false, "Scheduler: unhandled event class: {}", i);
+      };
+    }
+
+    Reset();
+  }
+
+ ~LegacyScheduler() {
+    for(int i = 0; i < kMaxEvents; i++) {
+      delete heap[i];
+    }
+  }
+
+  void Reset() {
+    heap_size = 0;
+    timestamp_now = 0;
+    next_uid = 1;
+
+    Add(std::numeric_limits<u64>::max(), EventClass::EndOfQueue);
+  }
+
+  auto GetTimestampNow() const -> u64 {
+    return timestamp_now;
+  }
+
+  void AddCycles(int cycles) {
+    auto timestamp_next = timestamp_now + cycles;
+    Step(timestamp_next);
+    timestamp_now = timestamp_next;
+  }
+
+  template<class T>
+  void Register(EventClass event_class, T* object, EventMethodWithUserData<T> method) {
+    callbacks[(int)event_class] = [object, method](u64 user_data) {
+      (object->*method)(user_data);
+    };
+  }
+
+  auto Add(u64 delay, EventClass event_class, uint priority = 0, u64 user_data = 0) -> Event* {
+    int n = heap_size++;
+    int p = Parent(n);
+
+    nba::Assert(
+      heap_size <= kMaxEvents,
+      "Scheduler: reached maximum number of events."
+    );
+
+    nba::Assert(priority <= 3, "Scheduler: priority must be between 0 and 3.");
+
+    auto event = heap[n];
+    event->timestamp = GetTimestampNow() + delay;
+    event->key = (event->timestamp << 2) | priority;
+    event->uid = next_uid++;
+    event->user_data = user_data;
+    event->event_class = event_class;
+
+    while(n != 0 && heap[p]->key > heap[n]->key) {
+      Swap(n, p);
+      n = p;
+      p = Parent(n);
+    }
+
+    return event;
+  }
+
+  void Cancel(Event* event) {
+    Remove(event->handle);
+  }
+
+private:
+  static constexpr int kMaxEvents = 64;
+
+  static constexpr int Parent(int n) { return (n - 1) / 2; }
+  static constexpr int LeftChild(int n) { return n * 2 + 1; }
+  static constexpr int RightChild(int n) { return n * 2 + 2; }
+
+  void Step(u64 timestamp_next) {
+    while(heap[0]->timestamp <= timestamp_next && heap_size > 0) {
+      auto event = heap[0];
+      timestamp_now = event->timestamp;
+      callbacks[(int)event->event_class](event->user_data);
+      Remove(event->handle);
+    }
+  }
+
+  void Remove(int n) {
+    Swap(n, --heap_size);
+
+    int p = Parent(n);
+    if(n != 0 && heap[p]->key > heap[n]->key) {
+      do {
+        Swap(n, p);
+        n = p;
+        p = Parent(n);
+      } while(n != 0 && heap[p]->key > heap[n]->key);
+    } else {
+      Heapify(n);
+    }
+  }
+
+  void Swap(int i, int j) {
+    auto tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+    heap[i]->handle = i;
+    heap[j]->handle = j;
+  }
+
+  void Heapify(int n) {
+    int l = LeftChild(n);
+    int r = RightChild(n);
+
+    if(l < heap_size && heap[l]->key < heap[n]->key) {
+      Swap(l, n);
+      Heapify(l);
+    }
+
+    if(r < heap_size && heap[r]->key < heap[n]->key) {
+      Swap(r, n);
+      Heapify(r);
+    }
+  }
+
+  Event* heap[kMaxEvents];
+  int heap_size;
+  u64 timestamp_now;
+  u64 next_uid;
+
+  std::function<void(u64)> callbacks[(int)EventClass::Count];
+};
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <nba/core.hpp>
+#include <nba/scheduler_trace.hpp>
+#include <vector>
+
+/**
+ * Runs a game headless for a number of frames and records all operations
+ * on the event queue of the scheduler into a trace file for nba-scheduler-bench.
+ * Requires a core built with NBA_SCHEDULER_TRACE.
+ */
+
+using namespace nba;
+
+static bool ReadFile(char const* path, std::vector<u8>& data) {
+  std::FILE* file = std::fopen(path, "rb");
+
+  if(file == nullptr) {
+    fmt::print(stderr, "error: failed to open '{}'\n", path);
+    return false;
+  }
+
+  std::fseek(file, 0, SEEK_END);
+  data.resize(std::ftell(file));
+  std::fseek(file, 0, SEEK_SET);
+
+  const bool success = std::fread(data.data(), 1, data.size(), file) == data.size();
+
+  std::fclose(file);
+  return success;
+}
+
+int main(int argc, char** argv) {
+  if(argc != 5) {
+    fmt::print(stderr, "usage: {} <bios> <rom> <frames> <trace file>\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<u8> bios;
+  std::vector<u8> rom;
+
+  if(!ReadFile(argv[1], bios) || !ReadFile(argv[2], rom)) {
+    return 1;
+  }
+
+  if(bios.size() != 0x4000) {
+    fmt::print(stderr, "error: the BIOS must be 16 KiB\n");
+    return 1;
+  }
+
+  const int frames = std::atoi(argv[3]);
+
+  auto config = std::make_shared<Config>();
+
+  config->skip_bios = true;
+
+  auto core = CreateCore(config);
+
+  core->Attach(bios);
+  core->Attach(ROM{std::move(rom), nullptr, nullptr});
+  core->Reset();
+
+  // Let the game boot before recording.
+  for(int i = 0; i < 60; i++) {
+    core->RunForOneFrame();
+  }
+
+  auto& scheduler = core->GetScheduler();
+
+  scheduler.StartTrace();
+
+  for(int i = 0; i < frames; i++) {
+    core->RunForOneFrame();
+  }
+
+  const auto trace = scheduler.StopTrace();
+
+  std::FILE* file = std::fopen(argv[4], "wb");
+
+  if(file == nullptr) {
+    fmt::print(stderr, "error: failed to open '{}' for writing\n", argv[4]);
+    return 1;
+  }
+
+  const SchedulerTraceHeader header{};
+
+  std::fwrite(&header, sizeof(header), 1, file);
+  std::fwrite(trace.data(), sizeof(SchedulerTraceRecord), trace.size(), file);
+  std::fclose(file);
+
+  fmt::print("Recorded {} operations in {} frames.\n", trace.size(), frames);
+  return 0;
+}
@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2023 fleroviux
+ *
+ * Licensed under GPLv3 or any later version.
+ * Refer to the included LICENSE file.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <nba/common/compiler.hpp>
+#include <nba/log.hpp>
+#include <nba/integer.hpp>
+#include <nba/scheduler.hpp>
+#include <type_traits>
+
+/**
+ * The scheduler of the core with a two-level timing wheel in front of its heap.
+ * The wheel was meant to speed up the many periodic near-future events,
+ * but it replays recorded traces no faster than the heap alone.
+ * Save state support has been left out.
+ */
+struct WheelScheduler {
+  using EventClass = nba::core::Scheduler::EventClass;
+
+  struct Event {
+    u64 timestamp;
+
+  private:
+    friend struct WheelScheduler;
+    u64 uid;
+    u64 user_data;
+    EventClass event_class;
+  };
+
+  WheelScheduler() {
+    Register<&WheelScheduler::EndOfQueue>(EventClass::EndOfQueue, this);
+
+    // The fallback gets the event class in place of an object.
+    for(int i = 0; i < (int)EventClass::Count; i++) {
+      callbacks[i] = { (void*)(uintptr_t)i, [](void* event_class, u64) {
+        nba::Assert(false, "Scheduler: unhandled event class: {}", (int)(uintptr_t)event_class);
+      }};
+    }
+
+    Reset();
+  }
+
+  void Reset() {
+    ResetQueue();
+    timestamp_now = 0;
+    next_uid = 1;
+
+    Add(std::numeric_limits<u64>::max(), EventClass::EndOfQueue);
+  }
+
+  auto GetTimestampNow() const -> u64 {
+    return timestamp_now;
+  }
+
+  void AddCycles(int cycles) {
+    auto timestamp_next = timestamp_now + cycles;
+    if(unlikely(NextKey() >> 2 <= timestamp_next)) {
+      Step(timestamp_next);
+    }
+    timestamp_now = timestamp_next;
+  }
+
+  template<auto method, class T>
+  void Register(EventClass event_class, T* object) {
+    callbacks[(int)event_class] = { object, [](void* object, u64 user_data) {
+      if constexpr(std::is_invocable_v<decltype(method), T*, u64>) {
+        (((T*)object)->*method)(user_data);
+      } else {
+        (((T*)object)->*method)();
+      }
+    }};
+  }
+
+  auto Add(u64 delay, EventClass event_class, uint priority = 0, u64 user_data = 0) -> Event* {
+    nba::Assert(free_count != 0, "Scheduler: reached maximum number of events.");
+
+    nba::Assert(priority <= 3, "Scheduler: priority must be between 0 and 3.");
+
+    int slot = free_slots[--free_count];
+
+    auto event = &events[slot];
+    event->timestamp = GetTimestampNow() + delay;
+    event->uid = (next_uid++ << kSlotBits) | slot;
+    event->user_data = user_data;
+    event->event_class = event_class;
+
+    Insert(slot, (event->timestamp << 2) | priority);
+
+    return event;
+  }
+
+  void Cancel(Event* event) {
+    Remove(event - events);
+  }
+
+private:
+  static constexpr int kMaxEvents = 64;
+  static constexpr int kSlotBits = 6;
+
+  // Values of location[] for events which are not stored in the heap.
+  static constexpr u8 kSlotFree = 0xFF;
+  static constexpr u8 kSlotInWheel0 = 0xFE;
+  static constexpr u8 kSlotInWheel1 = 0xFD;
+
+  void ResetQueue() {
+    heap_size = 0;
+    free_count = kMaxEvents;
+
+    for(int i = 0; i < kMaxEvents; i++) {
+      free_slots[i] = (u8)(kMaxEvents - 1 - i);
+      location[i] = kSlotFree;
+    }
+
+    ResetWheel();
+  }
+
+  auto NextKey() const -> u64 {
+    return std::min(wheel_key, Key(0));
+  }
+
+  void Step(u64 timestamp_next) {
+    while(NextKey() >> 2 <= timestamp_next) {
+      if(wheel_cascade ? wheel_key <= Key(0) : Less(wheel_key, WheelHead(), Key(0), heap_slot[0])) {
+        StepWheel();
+      } else {
+        Fire(heap_slot[0]);
+      }
+    }
+  }
+
+  // Events with equal keys fire in the order they were created, no matter if they are in the wheel or the heap.
+  bool Less(u64 key_a, int slot_a, u64 key_b, int slot_b) const {
+    return key_a < key_b || (key_a == key_b && events[slot_a].uid < events[slot_b].uid);
+  }
+
+  void Fire(int slot) {
+    auto& event = events[slot];
+    timestamp_now = event.timestamp;
+    auto& callback = callbacks[(int)event.event_class];
+    callback.thunk(callback.object, event.user_data);
+    Remove(slot);
+  }
+
+  void Insert(int slot, u64 key) {
+    if(InsertWheel(slot, key)) {
+      return;
+    }
+    SiftUp(heap_size++, key, slot);
+  }
+
+  void Remove(int slot) {
+    if(location[slot] == kSlotInWheel0 || location[slot] == kSlotInWheel1) {
+      RemoveWheel(slot);
+    } else {
+      RemoveHeap(location[slot]);
+    }
+
+    location[slot] = kSlotFree;
+    free_slots[free_count++] = (u8)slot;
+  }
+
+  // 4-ary min-heap, as in the core.
+  static constexpr int kKeyOffset = 3;
+
+  static constexpr int Parent(int n) { return (n - 1) >> 2; }
+  static constexpr int FirstChild(int n) { return (n << 2) + 1; }
+
+  auto Key(int n) -> u64& { return heap_key[kKeyOffset + n]; }
+  auto Key(int n) const -> u64 { return heap_key[kKeyOffset + n]; }
+
+  void RemoveHeap(int n) {
+    int last = --heap_size;
+
+    if(n != last) {
+      u64 key = Key(last);
+      int last_slot = heap_slot[last];
+
+      if(n != 0 && Less(key, last_slot, Key(Parent(n)), heap_slot[Parent(n)])) {
+        SiftUp(n, key, last_slot);
+      } else {
+        SiftDown(n, key, last_slot);
+      }
+    }
+  }
+
+  void Place(int n, u64 key, int slot) {
+    Key(n) = key;
+    heap_slot[n] = (u8)slot;
+    location[slot] = (u8)n;
+  }
+
+  void SiftUp(int n, u64 key, int slot) {
+    while(n != 0) {
+      int p = Parent(n);
+      if(!Less(key, slot, Key(p), heap_slot[p])) {
+        break;
+      }
+      Place(n, Key(p), heap_slot[p]);
+      n = p;
+    }
+
+    Place(n, key, slot);
+  }
+
+  void SiftDown(int n, u64 key, int slot) {
+    while(true) {
+      int c = FirstChild(n);
+      if(c >= heap_size) {
+        break;
+      }
+
+      int c_min = c;
+      int c_end = std::min(c + 4, heap_size);
+
+      for(int i = c + 1; i < c_end; i++) {
+        if(Less(Key(i), heap_slot[i], Key(c_min), heap_slot[c_min])) {
+          c_min = i;
+        }
+      }
+
+      if(!Less(Key(c_min), heap_slot[c_min], key, slot)) {
+        break;
+      }
+      Place(n, Key(c_min), heap_slot[c_min]);
+      n = c_min;
+    }
+
+    Place(n, key, slot);
+  }
+
+  /**
+   * Two-level timing wheel in front of the heap, for the many near-future events.
+   * Level 0 has one bucket per cycle of the current 1024-cycle block,
+   * so all events in a level 0 bucket share the same timestamp and are kept sorted by priority.
+   * Level 1 has one bucket for each of the following 63 blocks.
+   * Its buckets are moved (cascaded) into level 0 once their block becomes the current block.
+   * Events further in the future are stored in the heap.
+   */
+  static constexpr int kWheel0Bits = 10;
+  static constexpr int kWheel0Size = 1 << kWheel0Bits;
+  static constexpr int kWheel0Mask = kWheel0Size - 1;
+  static constexpr int kWheel1Size = 64;
+  static constexpr u8 kNil = 0xFF;
+
+  static int CountTrailingZeros(u64 value) {
+#if defined(__clang__) || defined(__GNUC__)
+    return __builtin_ctzll(value);
+#else
+    int count = 0;
+    while((value & 1) == 0) {
+      value >>= 1;
+      count++;
+    }
+    return count;
+#endif
+  }
+
+  void ResetWheel() {
+    std::fill(std::begin(wheel0_head), std::end(wheel0_head), kNil);
+    std::fill(std::begin(wheel0_bits), std::end(wheel0_bits), 0);
+    std::fill(std::begin(wheel1_head), std::end(wheel1_head), kNil);
+    wheel1_bits = 0;
+    wheel_key = std::numeric_limits<u64>::max();
+    wheel_cascade = false;
+  }
+
+  bool InsertWheel(int slot, u64 key) {
+    u64 timestamp = key >> 2;
+    u64 block = timestamp >> kWheel0Bits;
+    u64 block_now = timestamp_now >> kWheel0Bits;
+
+    if(block == block_now) {
+      int bucket = timestamp & kWheel0Mask;
+      u8* link = &wheel0_head[bucket];
+
+      while(*link != kNil && Less(wheel_event_key[*link], *link, key, slot)) {
+        link = &wheel_next[*link];
+      }
+      wheel_next[slot] = *link;
+      *link = (u8)slot;
+
+      wheel0_bits[bucket >> 6] |= 1ULL << (bucket & 63);
+      location[slot] = kSlotInWheel0;
+
+      if(key < wheel_key) {
+        wheel_key = key;
+        wheel_cascade = false;
+      }
+    } else if(block - block_now < kWheel1Size) {
+      int bucket = block & (kWheel1Size - 1);
+      u64 cascade_key = (block << kWheel0Bits) << 2;
+
+      wheel_next[slot] = wheel1_head[bucket];
+      wheel1_head[bucket] = (u8)slot;
+
+      wheel1_bits |= 1ULL << bucket;
+      location[slot] = kSlotInWheel1;
+
+      if(cascade_key < wheel_key) {
+        wheel_key = cascade_key;
+        wheel_cascade = true;
+      }
+    } else {
+      return false;
+    }
+
+    wheel_event_key[slot] = key;
+    return true;
+  }
+
+  void RemoveWheel(int slot) {
+    u64 key = wheel_event_key[slot];
+    u64 timestamp = key >> 2;
+
+    if(location[slot] == kSlotInWheel0) {
+      int bucket = timestamp & kWheel0Mask;
+
+      Unlink(wheel0_head[bucket], slot);
+
+      if(wheel0_head[bucket] == kNil) {
+        wheel0_bits[bucket >> 6] &= ~(1ULL << (bucket & 63));
+      }
+
+      if(key == wheel_key && !wheel_cascade) {
+        UpdateWheelKey();
+      }
+    } else {
+      int bucket = (timestamp >> kWheel0Bits) & (kWheel1Size - 1);
+
+      Unlink(wheel1_head[bucket], slot);
+
+      if(wheel1_head[bucket] == kNil) {
+        wheel1_bits &= ~(1ULL << bucket);
+
+        if(wheel_cascade) {
+          UpdateWheelKey();
+        }
+      }
+    }
+  }
+
+  void Unlink(u8& head, int slot) {
+    u8* link = &head;
+
+    while(*link != slot) {
+      link = &wheel_next[*link];
+    }
+    *link = wheel_next[slot];
+  }
+
+  void StepWheel() {
+    if(wheel_cascade) {
+      timestamp_now = wheel_key >> 2;
+      Cascade();
+    } else {
+      Fire(WheelHead());
+    }
+  }
+
+  auto WheelHead() const -> int {
+    return wheel0_head[(wheel_key >> 2) & kWheel0Mask];
+  }
+
+  void Cascade() {
+    int bucket = (timestamp_now >> kWheel0Bits) & (kWheel1Size - 1);
+    int slot = wheel1_head[bucket];
+
+    wheel1_head[bucket] = kNil;
+    wheel1_bits &= ~(1ULL << bucket);
+
+    while(slot != kNil) {
+      int next = wheel_next[slot];
+      InsertWheel(slot, wheel_event_key[slot]);
+      slot = next;
+    }
+
+    UpdateWheelKey();
+  }
+
+  void UpdateWheelKey() {
+    int word = (timestamp_now & kWheel0Mask) >> 6;
+    u64 bits = wheel0_bits[word] & (~0ULL << (timestamp_now & 63));
+
+    while(bits == 0 && ++word < kWheel0Size / 64) {
+      bits = wheel0_bits[word];
+    }
+
+    if(bits != 0) {
+      int bucket = (word << 6) | CountTrailingZeros(bits);
+
+      wheel_key = wheel_event_key[wheel0_head[bucket]];
+      wheel_cascade = false;
+    } else if(wheel1_bits != 0) {
+      u64 block_now = timestamp_now >> kWheel0Bits;
+      int shift = (block_now + 1) & (kWheel1Size - 1);
+      u64 bits = (wheel1_bits >> shift) | (wheel1_bits << ((kWheel1Size - shift) & 63));
+      u64 block = block_now + 1 + CountTrailingZeros(bits);
+
+      wheel_key = (block << kWheel0Bits) << 2;
+      wheel_cascade = true;
+    } else {
+      wheel_key = std::numeric_limits<u64>::max();
+      wheel_cascade = false;
+    }
+  }
+
+  void EndOfQueue() {
+    nba::Assert(false, "Scheduler: reached end of the event queue.");
+  }
+
+  alignas(64) u64 heap_key[kKeyOffset + kMaxEvents];
+  u8 heap_slot[kMaxEvents];
+  u8 location[kMaxEvents];
+  int heap_size;
+  u8 free_slots[kMaxEvents];
+  int free_count;
+  Event events[kMaxEvents];
+  u64 timestamp_now;
+  u64 next_uid;
+
+  u64 wheel_key;
+  bool wheel_cascade;
+  u64 wheel0_bits[kWheel0Size / 64];
+  u64 wheel1_bits;
+  u8 wheel0_head[kWheel0Size];
+  u8 wheel1_head[kWheel1Size];
+  u8 wheel_next[kMaxEvents];
+  u64 wheel_event_key[kMaxEvents];
+
+  struct Callback {
+    void* object;
+    void (*thunk)(void*, u64);
+  } callbacks[(int)EventClass::Count];
+
+};